@@ -0,0 +1,105 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Event counters. Consecutive entries with the same metric name are exported as one
+ * Prometheus family distinguished by their labels.
+ */
+typedef enum {
+    PERF_METRICS_HAP_SESSIONS_OPENED,  /* pair-setup/pair-verify reached a secure session */
+    PERF_METRICS_HAP_SESSIONS_CLOSED,  /* secure session released by the HTTP server */
+    PERF_METRICS_HAP_DECRYPT_FAILURES, /* AEAD tag mismatch on a received frame */
+    PERF_METRICS_HAP_BYTES_SENT,       /* plaintext bytes passed to hap_httpd_send */
+    PERF_METRICS_HAP_BYTES_RECEIVED,   /* plaintext bytes returned by hap_httpd_recv */
+    PERF_METRICS_HAP_FRAMES_SENT,      /* encrypted frames written */
+    PERF_METRICS_HAP_SOCKET_WRITES,    /* sendmsg() calls carrying those frames */
+    PERF_METRICS_HAP_CHAR_UPDATES,     /* characteristic value changes to be notified */
+    PERF_METRICS_HAP_EVENTS_SENT,      /* EVENT messages, one per notified session */
+    PERF_METRICS_HAP_EVENTS_DEFERRED,  /* sessions held back by the notification rate limit */
+    PERF_METRICS_NVS_COMMIT_FAILURES,  /* nvs_set/nvs_commit errors */
+    PERF_METRICS_COUNTER_MAX,
+} perf_metrics_counter_t;
+
+/* Latency histograms, all in microseconds with the same fixed buckets */
+typedef enum {
+    PERF_METRICS_HTTP_API_ON,
+    PERF_METRICS_HTTP_API_OFF,
+    PERF_METRICS_HTTP_API_TIMER_OFF,
+    PERF_METRICS_HTTP_API_CANCEL_TIMER,
+    PERF_METRICS_HTTP_API_BATCH,
+    PERF_METRICS_HTTP_API_STATUS,
+    PERF_METRICS_HTTP_API_EVENTS,
+    PERF_METRICS_HTTP_API_TRACE,
+    PERF_METRICS_HTTP_METRICS,
+    PERF_METRICS_HTTP_STATIC,
+    PERF_METRICS_HAP_PAIR_SETUP,
+    PERF_METRICS_HAP_PAIR_VERIFY,
+    PERF_METRICS_HAP_ACCESSORIES,
+    PERF_METRICS_HAP_CHARS_GET,
+    PERF_METRICS_HAP_CHARS_PUT,
+    PERF_METRICS_HAP_PAIRINGS,
+    PERF_METRICS_HAP_IDENTIFY,
+    PERF_METRICS_HAP_PREPARE,
+    PERF_METRICS_HAP_NOTIFY_SEND,      /* one event message to one controller */
+    PERF_METRICS_FAN_STATE_CHANGE,     /* change_fan_state/batch/timer transitions */
+    PERF_METRICS_NVS_COMMIT,           /* successful level commit incl. nvs_open */
+    PERF_METRICS_HISTOGRAM_MAX,
+} perf_metrics_histogram_t;
+
+/* Called with consecutive pieces of the exported text. Returns 0 to continue. */
+typedef int (*perf_metrics_write_fn_t)(const char *buf, size_t len, void *ctx);
+
+#if CONFIG_PERF_METRICS_ENABLE
+
+/** Add n to a counter. Lock-free, safe from any task. */
+void perf_metrics_add(perf_metrics_counter_t id, uint32_t n);
+
+/** Current time in microseconds, to be passed to perf_metrics_observe_since(). */
+int64_t perf_metrics_begin(void);
+
+/** Record a duration in microseconds. Lock-free, safe from any task. */
+void perf_metrics_observe(perf_metrics_histogram_t id, uint32_t value_us);
+
+/** Record the time elapsed since start_us. */
+void perf_metrics_observe_since(perf_metrics_histogram_t id, int64_t start_us);
+
+/** Report the stack high-water mark of task under name. Pass NULL for the calling task.
+ * Registering the same task again is a no-op.
+ */
+void perf_metrics_watch_task(const char *name, TaskHandle_t task);
+
+/** Write all metrics plus heap and stack gauges in Prometheus text format 0.0.4.
+ * Returns 0, or the first non-zero value returned by write_fn.
+ */
+int perf_metrics_export(perf_metrics_write_fn_t write_fn, void *ctx);
+
+#else /* CONFIG_PERF_METRICS_ENABLE */
+
+static inline void perf_metrics_add(perf_metrics_counter_t id, uint32_t n) {}
+static inline int64_t perf_metrics_begin(void) { return 0; }
+static inline void perf_metrics_observe(perf_metrics_histogram_t id, uint32_t value_us) {}
+static inline void perf_metrics_observe_since(perf_metrics_histogram_t id, int64_t start_us) {}
+static inline void perf_metrics_watch_task(const char *name, TaskHandle_t task) {}
+static inline int perf_metrics_export(perf_metrics_write_fn_t write_fn, void *ctx)
+{
+    return 0;
+}
+
+#endif /* CONFIG_PERF_METRICS_ENABLE */
+
+static inline void perf_metrics_inc(perf_metrics_counter_t id)
+{
+    perf_metrics_add(id, 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
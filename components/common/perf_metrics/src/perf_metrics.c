@@ -0,0 +1,291 @@
+#include "perf_metrics.h"
+
+#if CONFIG_PERF_METRICS_ENABLE
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_system.h>
+#include <esp_timer.h>
+
+/* Bucket upper bounds in microseconds; one more implicit +Inf bucket follows */
+static const uint32_t s_bounds_us[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000,
+};
+#define NUM_BOUNDS (sizeof(s_bounds_us) / sizeof(s_bounds_us[0]))
+
+typedef struct {
+    atomic_uint buckets[NUM_BOUNDS + 1]; /* non-cumulative, summed at export */
+    atomic_uint sum_us;                  /* wraps after ~71 min of total latency */
+} perf_metrics_hist_t;
+
+/* Each core adds into its own copy so the cores never contend on the same word. A
+ * task that migrates between reading the core id and the add still adds atomically,
+ * only into the other core's copy, which the exporter sums anyway.
+ */
+typedef struct {
+    atomic_uint counters[PERF_METRICS_COUNTER_MAX];
+    perf_metrics_hist_t hists[PERF_METRICS_HISTOGRAM_MAX];
+} perf_metrics_core_t;
+
+static perf_metrics_core_t s_cores[portNUM_PROCESSORS];
+
+typedef struct {
+    const char *name;
+    const char *labels; /* without braces, may be NULL */
+    const char *help;
+} perf_metrics_desc_t;
+
+static const perf_metrics_desc_t s_counter_desc[PERF_METRICS_COUNTER_MAX] = {
+    [PERF_METRICS_HAP_SESSIONS_OPENED] = {"hap_sessions_opened_total", NULL,
+                                          "HomeKit secure sessions established"},
+    [PERF_METRICS_HAP_SESSIONS_CLOSED] = {"hap_sessions_closed_total", NULL,
+                                          "HomeKit secure sessions released"},
+    [PERF_METRICS_HAP_DECRYPT_FAILURES] = {"hap_decrypt_failures_total", NULL,
+                                           "HomeKit frames that failed authentication"},
+    [PERF_METRICS_HAP_BYTES_SENT] = {"hap_bytes_total", "direction=\"tx\"",
+                                     "Plaintext bytes on HomeKit sessions"},
+    [PERF_METRICS_HAP_BYTES_RECEIVED] = {"hap_bytes_total", "direction=\"rx\"", NULL},
+    [PERF_METRICS_HAP_FRAMES_SENT] = {"hap_tx_frames_total", NULL,
+                                      "Encrypted HomeKit frames sent"},
+    [PERF_METRICS_HAP_SOCKET_WRITES] = {"hap_tx_socket_writes_total", NULL,
+                                        "Socket writes carrying encrypted HomeKit frames"},
+    [PERF_METRICS_HAP_CHAR_UPDATES] = {"hap_char_updates_total", NULL,
+                                       "Characteristic value changes to be notified"},
+    [PERF_METRICS_HAP_EVENTS_SENT] = {"hap_events_sent_total", NULL,
+                                      "HomeKit event notifications sent, one per session"},
+    [PERF_METRICS_HAP_EVENTS_DEFERRED] = {"hap_events_deferred_total", NULL,
+                                          "Event notifications postponed by the rate limit"},
+    [PERF_METRICS_NVS_COMMIT_FAILURES] = {"nvs_commit_failures_total", NULL,
+                                          "Failed NVS writes of the fan level"},
+};
+
+static const perf_metrics_desc_t s_hist_desc[PERF_METRICS_HISTOGRAM_MAX] = {
+    [PERF_METRICS_HTTP_API_ON] = {"http_request_duration_seconds", "handler=\"api_on\"",
+                                  "Web server request handling time"},
+    [PERF_METRICS_HTTP_API_OFF] = {"http_request_duration_seconds", "handler=\"api_off\""},
+    [PERF_METRICS_HTTP_API_TIMER_OFF] = {"http_request_duration_seconds",
+                                         "handler=\"api_timer_off\""},
+    [PERF_METRICS_HTTP_API_CANCEL_TIMER] = {"http_request_duration_seconds",
+                                            "handler=\"api_cancel_timer\""},
+    [PERF_METRICS_HTTP_API_BATCH] = {"http_request_duration_seconds", "handler=\"api_batch\""},
+    [PERF_METRICS_HTTP_API_STATUS] = {"http_request_duration_seconds", "handler=\"api_status\""},
+    [PERF_METRICS_HTTP_API_EVENTS] = {"http_request_duration_seconds", "handler=\"api_events\""},
+    [PERF_METRICS_HTTP_API_TRACE] = {"http_request_duration_seconds", "handler=\"api_trace\""},
+    [PERF_METRICS_HTTP_METRICS] = {"http_request_duration_seconds", "handler=\"metrics\""},
+    [PERF_METRICS_HTTP_STATIC] = {"http_request_duration_seconds", "handler=\"static\""},
+    [PERF_METRICS_HAP_PAIR_SETUP] = {"hap_request_duration_seconds", "handler=\"pair_setup\"",
+                                     "HomeKit request handling time"},
+    [PERF_METRICS_HAP_PAIR_VERIFY] = {"hap_request_duration_seconds", "handler=\"pair_verify\""},
+    [PERF_METRICS_HAP_ACCESSORIES] = {"hap_request_duration_seconds", "handler=\"accessories\""},
+    [PERF_METRICS_HAP_CHARS_GET] = {"hap_request_duration_seconds",
+                                    "handler=\"characteristics_get\""},
+    [PERF_METRICS_HAP_CHARS_PUT] = {"hap_request_duration_seconds",
+                                    "handler=\"characteristics_put\""},
+    [PERF_METRICS_HAP_PAIRINGS] = {"hap_request_duration_seconds", "handler=\"pairings\""},
+    [PERF_METRICS_HAP_IDENTIFY] = {"hap_request_duration_seconds", "handler=\"identify\""},
+    [PERF_METRICS_HAP_PREPARE] = {"hap_request_duration_seconds", "handler=\"prepare\""},
+    [PERF_METRICS_HAP_NOTIFY_SEND] = {"hap_notification_send_duration_seconds", NULL,
+                                      "Time to send one event message to one controller"},
+    [PERF_METRICS_FAN_STATE_CHANGE] = {"fan_state_change_duration_seconds", NULL,
+                                       "Fan state transition incl. relay switching"},
+    [PERF_METRICS_NVS_COMMIT] = {"nvs_commit_duration_seconds", NULL,
+                                 "Time to persist the fan level to NVS"},
+};
+
+typedef struct {
+    _Atomic(TaskHandle_t) task;
+    _Atomic(const char *) name; /* set after task, exported only once non-NULL */
+} perf_metrics_task_t;
+
+static perf_metrics_task_t s_tasks[CONFIG_PERF_METRICS_MAX_TASKS];
+
+void perf_metrics_add(perf_metrics_counter_t id, uint32_t n)
+{
+    atomic_fetch_add_explicit(&s_cores[xPortGetCoreID()].counters[id], n, memory_order_relaxed);
+}
+
+int64_t perf_metrics_begin(void)
+{
+    return esp_timer_get_time();
+}
+
+void perf_metrics_observe(perf_metrics_histogram_t id, uint32_t value_us)
+{
+    int b = 0;
+    while (b < NUM_BOUNDS && value_us > s_bounds_us[b]) {
+        b++;
+    }
+    perf_metrics_hist_t *h = &s_cores[xPortGetCoreID()].hists[id];
+    atomic_fetch_add_explicit(&h->buckets[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, value_us, memory_order_relaxed);
+}
+
+void perf_metrics_observe_since(perf_metrics_histogram_t id, int64_t start_us)
+{
+    perf_metrics_observe(id, (uint32_t)(esp_timer_get_time() - start_us));
+}
+
+void perf_metrics_watch_task(const char *name, TaskHandle_t task)
+{
+    if (!task) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+    for (int i = 0; i < CONFIG_PERF_METRICS_MAX_TASKS; i++) {
+        TaskHandle_t cur = atomic_load(&s_tasks[i].task);
+        if (cur == task) {
+            return;
+        }
+        if (!cur && atomic_compare_exchange_strong(&s_tasks[i].task, &cur, task)) {
+            atomic_store(&s_tasks[i].name, name);
+            return;
+        }
+        if (cur == task) {
+            return; /* registered concurrently by another caller */
+        }
+    }
+}
+
+/* Output is collected in a small buffer and handed to write_fn in large pieces */
+typedef struct {
+    perf_metrics_write_fn_t write_fn;
+    void *ctx;
+    int err;
+    size_t len;
+    char buf[512];
+} perf_metrics_out_t;
+
+static void out_flush(perf_metrics_out_t *out)
+{
+    if (out->len && !out->err) {
+        out->err = out->write_fn(out->buf, out->len, out->ctx);
+    }
+    out->len = 0;
+}
+
+static void out_printf(perf_metrics_out_t *out, const char *fmt, ...)
+{
+    for (int attempt = 0; attempt < 2 && !out->err; attempt++) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(out->buf + out->len, sizeof(out->buf) - out->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && out->len + n < sizeof(out->buf)) {
+            out->len += n;
+            return;
+        }
+        out_flush(out); /* did not fit, retry in an empty buffer */
+    }
+}
+
+/* Microseconds as a decimal number of seconds without trailing zeros */
+static const char *fmt_seconds(char *buf, size_t size, uint64_t us)
+{
+    int n = snprintf(buf, size, "%llu.%06u", (unsigned long long)(us / 1000000),
+                     (unsigned)(us % 1000000));
+    while (n > 0 && buf[n - 1] == '0') {
+        buf[--n] = '\0';
+    }
+    if (n > 0 && buf[n - 1] == '.') {
+        buf[--n] = '\0';
+    }
+    return buf;
+}
+
+static void out_family(perf_metrics_out_t *out, const perf_metrics_desc_t *desc,
+                       const perf_metrics_desc_t *prev, const char *type)
+{
+    if (prev && strcmp(prev->name, desc->name) == 0) {
+        return;
+    }
+    if (desc->help) {
+        out_printf(out, "# HELP %s %s\n", desc->name, desc->help);
+    }
+    out_printf(out, "# TYPE %s %s\n", desc->name, type);
+}
+
+static void export_counters(perf_metrics_out_t *out)
+{
+    for (int id = 0; id < PERF_METRICS_COUNTER_MAX; id++) {
+        const perf_metrics_desc_t *desc = &s_counter_desc[id];
+        uint64_t value = 0;
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            value += atomic_load_explicit(&s_cores[core].counters[id], memory_order_relaxed);
+        }
+        out_family(out, desc, id ? &s_counter_desc[id - 1] : NULL, "counter");
+        out_printf(out, "%s%s%s%s %llu\n", desc->name, desc->labels ? "{" : "",
+                   desc->labels ? desc->labels : "", desc->labels ? "}" : "",
+                   (unsigned long long)value);
+    }
+}
+
+static void export_histograms(perf_metrics_out_t *out)
+{
+    char le[24];
+    for (int id = 0; id < PERF_METRICS_HISTOGRAM_MAX; id++) {
+        const perf_metrics_desc_t *desc = &s_hist_desc[id];
+        const char *sep = desc->labels ? "," : "";
+        const char *labels = desc->labels ? desc->labels : "";
+        uint64_t buckets[NUM_BOUNDS + 1] = {0};
+        uint64_t sum_us = 0;
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            perf_metrics_hist_t *h = &s_cores[core].hists[id];
+            for (int b = 0; b <= NUM_BOUNDS; b++) {
+                buckets[b] += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            }
+            sum_us += atomic_load_explicit(&h->sum_us, memory_order_relaxed);
+        }
+        out_family(out, desc, id ? &s_hist_desc[id - 1] : NULL, "histogram");
+        uint64_t cumulative = 0;
+        for (int b = 0; b < NUM_BOUNDS; b++) {
+            cumulative += buckets[b];
+            out_printf(out, "%s_bucket{%s%sle=\"%s\"} %llu\n", desc->name, labels, sep,
+                       fmt_seconds(le, sizeof(le), s_bounds_us[b]),
+                       (unsigned long long)cumulative);
+        }
+        cumulative += buckets[NUM_BOUNDS];
+        out_printf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", desc->name, labels, sep,
+                   (unsigned long long)cumulative);
+        out_printf(out, "%s_sum%s%s%s %s\n", desc->name, desc->labels ? "{" : "", labels,
+                   desc->labels ? "}" : "", fmt_seconds(le, sizeof(le), sum_us));
+        out_printf(out, "%s_count%s%s%s %llu\n", desc->name, desc->labels ? "{" : "", labels,
+                   desc->labels ? "}" : "", (unsigned long long)cumulative);
+    }
+}
+
+static void export_gauges(perf_metrics_out_t *out)
+{
+    char up[24];
+    out_printf(out, "# HELP uptime_seconds Time since boot\n# TYPE uptime_seconds gauge\n"
+               "uptime_seconds %s\n", fmt_seconds(up, sizeof(up), esp_timer_get_time()));
+    out_printf(out, "# HELP heap_free_bytes Free heap\n# TYPE heap_free_bytes gauge\n"
+               "heap_free_bytes %u\n", (unsigned)esp_get_free_heap_size());
+    out_printf(out, "# HELP heap_min_free_bytes Lowest free heap since boot\n"
+               "# TYPE heap_min_free_bytes gauge\nheap_min_free_bytes %u\n",
+               (unsigned)esp_get_minimum_free_heap_size());
+    out_printf(out, "# HELP task_stack_min_free_bytes Stack high-water mark\n"
+               "# TYPE task_stack_min_free_bytes gauge\n");
+    for (int i = 0; i < CONFIG_PERF_METRICS_MAX_TASKS; i++) {
+        TaskHandle_t task = atomic_load(&s_tasks[i].task);
+        const char *name = atomic_load(&s_tasks[i].name);
+        if (task && name) {
+            out_printf(out, "task_stack_min_free_bytes{task=\"%s\"} %u\n", name,
+                       (unsigned)uxTaskGetStackHighWaterMark(task));
+        }
+    }
+}
+
+int perf_metrics_export(perf_metrics_write_fn_t write_fn, void *ctx)
+{
+    perf_metrics_out_t out = {.write_fn = write_fn, .ctx = ctx};
+    export_counters(&out);
+    export_histograms(&out);
+    export_gauges(&out);
+    out_flush(&out);
+    return out.err;
+}
+
+#endif /* CONFIG_PERF_METRICS_ENABLE */
@@ -0,0 +1,65 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stages of a control request, from socket receive to the relay edge and the
+ * notifications sent afterwards. Names appear as span names in the exported trace.
+ */
+typedef enum {
+    PERF_TRACE_SOCK_RECV,        /* raw recv() on a HAP socket, arg = bytes */
+    PERF_TRACE_HAP_DECRYPT,      /* ChaCha20-Poly1305 frame decrypt, arg = frame size */
+    PERF_TRACE_HAP_PUT,          /* PUT /characteristics handler, arg = content length */
+    PERF_TRACE_HTTP_API,         /* web REST handler, arg = socket fd */
+    PERF_TRACE_JSON_PARSE,       /* json_parse_start on a request body, arg = length */
+    PERF_TRACE_FAN_SERV_WRITE,   /* HomeKit fan service write callback, arg = char count */
+    PERF_TRACE_CHANGE_FAN_STATE, /* fan state transition, arg = new state word */
+    PERF_TRACE_GPIO_WRITE,       /* relay register writes incl. dead time, arg = pin mask */
+    PERF_TRACE_NOTIFY_SEND,      /* HAP event sent to one controller, arg = socket fd */
+    PERF_TRACE_SSE_SEND,         /* web event stream broadcast, arg = bytes */
+    PERF_TRACE_STAGE_MAX,
+} perf_trace_stage_t;
+
+/* Called with consecutive pieces of the exported JSON. Returns 0 to continue. */
+typedef int (*perf_trace_write_fn_t)(const char *buf, size_t len, void *ctx);
+
+#if CONFIG_PERF_TRACE_ENABLE
+
+/** Current time in microseconds, to be passed to perf_trace_end(). */
+int64_t perf_trace_begin(void);
+
+/** Record a span for stage that started at start_us and ends now. Lock-free and safe
+ * to call from any task.
+ */
+void perf_trace_end(perf_trace_stage_t stage, int64_t start_us, uint32_t arg);
+
+/** Write the spans currently in the ring as a Chrome trace-event JSON document.
+ * Spans overwritten while exporting are skipped. Returns the number of spans written.
+ */
+int perf_trace_export(perf_trace_write_fn_t write_fn, void *ctx);
+
+/** Drop all recorded spans. */
+void perf_trace_clear(void);
+
+#else /* CONFIG_PERF_TRACE_ENABLE */
+
+static inline int64_t perf_trace_begin(void) { return 0; }
+static inline void perf_trace_end(perf_trace_stage_t stage, int64_t start_us, uint32_t arg) {}
+static inline int perf_trace_export(perf_trace_write_fn_t write_fn, void *ctx)
+{
+    static const char empty[] = "{\"traceEvents\":[]}";
+    write_fn(empty, sizeof(empty) - 1, ctx);
+    return 0;
+}
+static inline void perf_trace_clear(void) {}
+
+#endif /* CONFIG_PERF_TRACE_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif
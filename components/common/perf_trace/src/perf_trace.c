@@ -0,0 +1,113 @@
+#include "perf_trace.h"
+
+#if CONFIG_PERF_TRACE_ENABLE
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define RING_SIZE CONFIG_PERF_TRACE_RING_SIZE
+#define RING_MASK (RING_SIZE - 1)
+
+_Static_assert((RING_SIZE & RING_MASK) == 0, "PERF_TRACE_RING_SIZE must be a power of two");
+
+/* Each slot is guarded by a sequence number: 0 while being written, ticket + 1 once
+ * complete. Writers claim a ticket with a single fetch_add and never wait; the exporter
+ * copies a slot and keeps it only if the sequence number was stable around the copy.
+ */
+typedef struct {
+    atomic_uint seq;
+    uint32_t dur_us;
+    int64_t start_us;
+    uint32_t task;
+    uint16_t stage;
+    uint16_t reserved;
+    uint32_t arg;
+} perf_trace_slot_t;
+
+static perf_trace_slot_t s_ring[RING_SIZE];
+static atomic_uint s_head;
+
+static const char *const s_stage_names[PERF_TRACE_STAGE_MAX] = {
+    [PERF_TRACE_SOCK_RECV] = "sock_recv",
+    [PERF_TRACE_HAP_DECRYPT] = "hap_decrypt",
+    [PERF_TRACE_HAP_PUT] = "hap_put_characteristics",
+    [PERF_TRACE_HTTP_API] = "http_api",
+    [PERF_TRACE_JSON_PARSE] = "json_parse",
+    [PERF_TRACE_FAN_SERV_WRITE] = "fan_serv_write",
+    [PERF_TRACE_CHANGE_FAN_STATE] = "change_fan_state",
+    [PERF_TRACE_GPIO_WRITE] = "gpio_write",
+    [PERF_TRACE_NOTIFY_SEND] = "hap_notify_send",
+    [PERF_TRACE_SSE_SEND] = "sse_send",
+};
+
+int64_t perf_trace_begin(void)
+{
+    return esp_timer_get_time();
+}
+
+void perf_trace_end(perf_trace_stage_t stage, int64_t start_us, uint32_t arg)
+{
+    int64_t now = esp_timer_get_time();
+    unsigned ticket = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    perf_trace_slot_t *slot = &s_ring[ticket & RING_MASK];
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->start_us = start_us;
+    slot->dur_us = (uint32_t)(now - start_us);
+    slot->task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+    slot->stage = stage;
+    slot->arg = arg;
+    atomic_store_explicit(&slot->seq, ticket + 1, memory_order_release);
+}
+
+void perf_trace_clear(void)
+{
+    for (int i = 0; i < RING_SIZE; i++) {
+        atomic_store_explicit(&s_ring[i].seq, 0, memory_order_relaxed);
+    }
+}
+
+int perf_trace_export(perf_trace_write_fn_t write_fn, void *ctx)
+{
+    char buf[192];
+    int count = 0;
+    unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+    unsigned first = head > RING_SIZE ? head - RING_SIZE : 0;
+
+    static const char header[] = "{\"traceEvents\":[";
+    static const char footer[] = "],\"displayTimeUnit\":\"ms\"}";
+    if (write_fn(header, sizeof(header) - 1, ctx) != 0) {
+        return count;
+    }
+    for (unsigned ticket = first; ticket != head; ticket++) {
+        perf_trace_slot_t *slot = &s_ring[ticket & RING_MASK];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != ticket + 1) {
+            continue;
+        }
+        perf_trace_slot_t copy;
+        memcpy(&copy, slot, sizeof(copy));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != ticket + 1 ||
+                copy.stage >= PERF_TRACE_STAGE_MAX) {
+            continue; /* overwritten while copying */
+        }
+        int len = snprintf(buf, sizeof(buf),
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"arg\":%u,\"seq\":%u}}",
+                count ? "," : "", s_stage_names[copy.stage], (long long)copy.start_us,
+                (unsigned)copy.dur_us, (unsigned)copy.task, (unsigned)copy.arg, ticket);
+        if (write_fn(buf, len, ctx) != 0) {
+            return count;
+        }
+        count++;
+    }
+    write_fn(footer, sizeof(footer) - 1, ctx);
+    return count;
+}
+
+#endif /* CONFIG_PERF_TRACE_ENABLE */
@@ -350,6 +350,16 @@ typedef struct {
      * to increment c#. Note thar c# will still increment on a firmware upgrade though.
      */
     bool disable_config_num_update;
+    /** Time (in milliseconds) for which characteristic value changes are collected before
+     * the event notifications are sent, so that back to back updates go out as a single
+     * event with the latest values. Stateless characteristics, like the Programmable Switch
+     * Event, are always notified right away. 0 disables the coalescing.
+     */
+    uint16_t notif_coalesce_ms;
+    /** Minimum interval (in milliseconds) between two event notifications to the same
+     * controller. Changes within the interval are deferred, not dropped. 0 disables the limit.
+     */
+    uint16_t notif_min_interval_ms;
 } hap_cfg_t;
 
 /** Get HomeKit Configuration
@@ -914,6 +924,29 @@ char *hap_serv_get_type_uuid(hap_serv_t *hs);
  */
 hap_serv_t *hap_char_get_parent(hap_char_t *hc);
 
+/**
+ * @brief Set characteristic private data
+ *
+ * This can be used to tag a characteristic, so that the service read/write
+ * callbacks can tell characteristics apart without comparing type UUIDs.
+ *
+ * @param[in] hc HAP Characteristic object handle
+ * @param[in] priv Private data for the characteristic
+ */
+void hap_char_set_priv(hap_char_t *hc, void *priv);
+
+/**
+ * @brief Get characteristic private data
+ *
+ * This will get the private data associated with the characteristic, which
+ * was set using hap_char_set_priv().
+ *
+ * @param[in] hc HAP Characteristic object handle
+ *
+ * @return Pointer to the private data (can be NULL)
+ */
+void *hap_char_get_priv(hap_char_t *hc);
+
 /**
  * @brief Get the next characteristic in a given service object
  *
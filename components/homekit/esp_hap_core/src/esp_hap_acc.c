@@ -21,6 +21,7 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *
  */
+#include <stdlib.h>
 #include <string.h>
 #include <esp_wifi.h>
 #include <hap_platform_memory.h>
@@ -351,6 +352,8 @@ static void hap_remove_acc_from_list(__hap_acc_t *primary, __hap_acc_t *old)
         cur = cur->next;
     }
     cur->next = cur->next->next;
+    /* The accessory may be added again, which appends it to the list */
+    old->next = NULL;
 }
 
 #define HAP_BRIDGE_KEYSTORE     "hap_bridge"
@@ -397,8 +400,10 @@ void hap_add_accessory(hap_acc_t *ha)
                 eth_mac[3], eth_mac[4], eth_mac[5]);
         hap_platform_memory_free(((__hap_char_t *)hc)->val.s);
         ((__hap_char_t *)hc)->val.s = strdup(name);
+        ((__hap_char_t *)hc)->str_cap = strlen(name) + 1;
     }
     hap_acc_get_info(&hap_priv.primary_acc);
+    hap_priv.acc_db_gen++;
 }
 
 void hap_add_bridged_accessory(hap_acc_t *ha, int aid)
@@ -414,6 +419,7 @@ void hap_add_bridged_accessory(hap_acc_t *ha, int aid)
     }
 
     hap_add_acc_to_list(primary_acc, _ha);
+    hap_priv.acc_db_gen++;
     if (!hap_priv.cfg.disable_config_num_update) {
         hap_update_config_number();
     }
@@ -426,6 +432,7 @@ void hap_remove_bridged_accessory(hap_acc_t *ha)
     } else {
         if (ha) {
             hap_remove_acc_from_list(primary_acc, (__hap_acc_t *)ha);
+            hap_priv.acc_db_gen++;
             if (!hap_priv.cfg.disable_config_num_update) {
                 hap_update_config_number();
             }
@@ -489,3 +496,109 @@ hap_acc_t *hap_acc_get_by_aid(int32_t aid)
     }
     return NULL;
 }
+
+/* Index of all characteristics, sorted by (aid, iid), for the lookups done
+ * while handling /characteristics requests. It is rebuilt by the first
+ * lookup after accessories were added or removed, so that it is only ever
+ * touched from the HTTP server task. If the index cannot be allocated,
+ * lookups walk the lists until the next change of acc_db_gen.
+ */
+typedef struct {
+    uint64_t key;
+    hap_char_t *hc;
+} hap_char_index_entry_t;
+
+static struct {
+    hap_char_index_entry_t *entries;
+    int count;
+    uint32_t acc_db_gen;
+    bool valid;
+    bool failed;
+} hap_char_index;
+
+static inline uint64_t hap_char_index_key(int32_t aid, int32_t iid)
+{
+    return ((uint64_t)(uint32_t)aid << 32) | (uint32_t)iid;
+}
+
+static int hap_char_index_cmp(const void *a, const void *b)
+{
+    uint64_t ka = ((const hap_char_index_entry_t *)a)->key;
+    uint64_t kb = ((const hap_char_index_entry_t *)b)->key;
+    return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+static void hap_char_index_build(void)
+{
+    uint32_t acc_db_gen = hap_priv.acc_db_gen;
+    hap_platform_memory_free(hap_char_index.entries);
+    hap_char_index.entries = NULL;
+    hap_char_index.count = 0;
+    hap_char_index.acc_db_gen = acc_db_gen;
+    hap_char_index.valid = false;
+    hap_char_index.failed = false;
+
+    hap_acc_t *ha;
+    hap_serv_t *hs;
+    hap_char_t *hc;
+    int count = 0;
+    for (ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha)) {
+        for (hs = hap_acc_get_first_serv(ha); hs; hs = hap_serv_get_next(hs)) {
+            for (hc = hap_serv_get_first_char(hs); hc; hc = hap_char_get_next(hc)) {
+                count++;
+            }
+        }
+    }
+    hap_char_index_entry_t *entries = hap_platform_memory_calloc(count ? count : 1,
+            sizeof(hap_char_index_entry_t));
+    if (!entries) {
+        /* Not retried for this generation, see hap_get_char_by_aid_iid() */
+        ESP_MFI_DEBUG(ESP_MFI_DEBUG_WARN, "Failed to allocate characteristic index");
+        hap_char_index.failed = true;
+        return;
+    }
+    int i = 0;
+    for (ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha)) {
+        for (hs = hap_acc_get_first_serv(ha); hs; hs = hap_serv_get_next(hs)) {
+            for (hc = hap_serv_get_first_char(hs); hc && i < count; hc = hap_char_get_next(hc)) {
+                entries[i].key = hap_char_index_key(((__hap_acc_t *)ha)->aid,
+                        ((__hap_char_t *)hc)->iid);
+                entries[i].hc = hc;
+                i++;
+            }
+        }
+    }
+    qsort(entries, i, sizeof(hap_char_index_entry_t), hap_char_index_cmp);
+    hap_char_index.entries = entries;
+    hap_char_index.count = i;
+    hap_char_index.valid = true;
+}
+
+/**
+ * @brief get target characteristics by AID and IID, using the index
+ */
+hap_char_t *hap_get_char_by_aid_iid(int32_t aid, int32_t iid)
+{
+    if (hap_char_index.acc_db_gen != hap_priv.acc_db_gen ||
+            (!hap_char_index.valid && !hap_char_index.failed)) {
+        hap_char_index_build();
+    }
+    if (!hap_char_index.valid) {
+        return hap_acc_get_char_by_iid(hap_acc_get_by_aid(aid), iid);
+    }
+    uint64_t key = hap_char_index_key(aid, iid);
+    int lo = 0, hi = hap_char_index.count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (hap_char_index.entries[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < hap_char_index.count && hap_char_index.entries[lo].key == key) {
+        return hap_char_index.entries[lo].hc;
+    }
+    /* Not indexed, e.g. a characteristic added to a live accessory */
+    return hap_acc_get_char_by_iid(hap_acc_get_by_aid(aid), iid);
+}
@@ -0,0 +1,544 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on ESPRESSIF SYSTEMS products only, in
+ * which case, it is free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <esp_hap_acc.h>
+#include <esp_hap_acc_db.h>
+#include <esp_hap_char.h>
+#include <esp_hap_database.h>
+#include <esp_hap_serv.h>
+#include <esp_mfi_base64.h>
+#include <esp_mfi_debug.h>
+#include <hap_platform_memory.h>
+#include <inttypes.h>
+#include <string.h>
+
+int hap_add_char_val_json(hap_char_format_t format, char *key, hap_val_t *val,
+                          json_gen_str_t *jptr) {
+  switch (format) {
+  case HAP_CHAR_FORMAT_BOOL: {
+    json_gen_obj_set_bool(jptr, key, val->b);
+    break;
+  }
+  case HAP_CHAR_FORMAT_UINT8:
+  case HAP_CHAR_FORMAT_UINT16:
+  case HAP_CHAR_FORMAT_UINT32:
+  case HAP_CHAR_FORMAT_INT: {
+    json_gen_obj_set_int(jptr, key, val->i);
+    break;
+  }
+  case HAP_CHAR_FORMAT_FLOAT: {
+    json_gen_obj_set_float(jptr, key, val->f);
+    break;
+  }
+  case HAP_CHAR_FORMAT_STRING: {
+    if (val->s) {
+      json_gen_obj_set_string(jptr, key, val->s);
+    } else {
+      json_gen_obj_set_null(jptr, key);
+    }
+    break;
+  }
+  case HAP_CHAR_FORMAT_DATA:
+  case HAP_CHAR_FORMAT_TLV8: {
+    if (val->d.buf) {
+      json_gen_obj_start_long_string(jptr, key, NULL);
+      uint8_t *buf = val->d.buf;
+      uint32_t buflen = val->d.buflen;
+      char tmp[100];
+      while (buflen) {
+        int tmp_len = sizeof(tmp);
+        if (buflen > 60) {
+          esp_mfi_base64_encode((char *)buf, 60, tmp, tmp_len, &tmp_len);
+          buflen -= 60;
+          buf += 60;
+        } else {
+          esp_mfi_base64_encode((char *)buf, buflen, tmp, tmp_len, &tmp_len);
+          buflen -= buflen;
+        }
+        tmp[tmp_len] = 0;
+        json_gen_add_to_long_string(jptr, tmp);
+      }
+      json_gen_end_long_string(jptr);
+    } else {
+      json_gen_obj_set_null(jptr, key);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return HAP_SUCCESS;
+}
+
+static int hap_add_char_format_json(__hap_char_t *hc, json_gen_str_t *jptr) {
+  switch (hc->format) {
+  case HAP_CHAR_FORMAT_UINT8:
+    return json_gen_obj_set_string(jptr, "format", "uint8");
+  case HAP_CHAR_FORMAT_UINT16:
+    return json_gen_obj_set_string(jptr, "format", "uint16");
+  case HAP_CHAR_FORMAT_UINT32:
+    return json_gen_obj_set_string(jptr, "format", "uint32");
+  case HAP_CHAR_FORMAT_INT:
+    return json_gen_obj_set_string(jptr, "format", "int");
+  case HAP_CHAR_FORMAT_BOOL:
+    return json_gen_obj_set_string(jptr, "format", "bool");
+  case HAP_CHAR_FORMAT_STRING:
+    return json_gen_obj_set_string(jptr, "format", "string");
+  case HAP_CHAR_FORMAT_FLOAT:
+    return json_gen_obj_set_string(jptr, "format", "float");
+  case HAP_CHAR_FORMAT_DATA:
+    return json_gen_obj_set_string(jptr, "format", "data");
+  case HAP_CHAR_FORMAT_TLV8:
+    return json_gen_obj_set_string(jptr, "format", "tlv8");
+  default:
+    break;
+  }
+  return HAP_SUCCESS;
+}
+
+int hap_add_char_type(__hap_char_t *hc, json_gen_str_t *jptr) {
+  return json_gen_obj_set_string(jptr, "type", (char *)hc->type_uuid);
+}
+
+int hap_add_char_meta(__hap_char_t *hc, json_gen_str_t *jptr) {
+  hap_add_char_format_json(hc, jptr);
+
+  if (hc->constraint_flags & HAP_CHAR_MIN_FLAG)
+    hap_add_char_val_json(hc->format, "minValue", &hc->min, jptr);
+  if (hc->constraint_flags & HAP_CHAR_MAX_FLAG)
+    hap_add_char_val_json(hc->format, "maxValue", &hc->max, jptr);
+  if (hc->constraint_flags & HAP_CHAR_STEP_FLAG)
+    hap_add_char_val_json(hc->format, "minStep", &hc->step, jptr);
+
+  /* maxLen and maxDataLen are constraints for "string" and "data" format
+   * of characteristics, respectively. However, the constraints themselves
+   * are integers. So, we pass the format as HAP_CHAR_FORMAT_INT
+   */
+  if (hc->constraint_flags & HAP_CHAR_MAXLEN_FLAG)
+    hap_add_char_val_json(HAP_CHAR_FORMAT_INT, "maxLen", &hc->max, jptr);
+  if (hc->constraint_flags & HAP_CHAR_MAXDATALEN_FLAG)
+    hap_add_char_val_json(HAP_CHAR_FORMAT_INT, "maxDataLen", &hc->max, jptr);
+
+  if (hc->description)
+    json_gen_obj_set_string(jptr, "description", hc->description);
+  if (hc->unit)
+    json_gen_obj_set_string(jptr, "unit", hc->unit);
+
+  return HAP_SUCCESS;
+}
+
+int hap_add_char_perms(__hap_char_t *hc, json_gen_str_t *jptr) {
+  json_gen_push_array(jptr, "perms");
+  if (hc->permission & HAP_CHAR_PERM_PR)
+    json_gen_arr_set_string(jptr, "pr");
+  if (hc->permission & HAP_CHAR_PERM_PW)
+    json_gen_arr_set_string(jptr, "pw");
+  if (hc->permission & HAP_CHAR_PERM_EV)
+    json_gen_arr_set_string(jptr, "ev");
+  if (hc->permission & HAP_CHAR_PERM_AA)
+    json_gen_arr_set_string(jptr, "aa");
+  if (hc->permission & HAP_CHAR_PERM_TW)
+    json_gen_arr_set_string(jptr, "tw");
+  if (hc->permission & HAP_CHAR_PERM_HD)
+    json_gen_arr_set_string(jptr, "hd");
+  if (hc->permission & HAP_CHAR_PERM_WR)
+    json_gen_arr_set_string(jptr, "wr");
+  json_gen_pop_array(jptr);
+  return HAP_SUCCESS;
+}
+
+int hap_add_char_ev(__hap_char_t *hc, json_gen_str_t *jptr,
+                    uint8_t session_index) {
+  if (hap_char_is_ctrl_subscribed((hap_char_t *)hc, session_index)) {
+    return json_gen_obj_set_bool(jptr, "ev", true);
+  } else {
+    return json_gen_obj_set_bool(jptr, "ev", false);
+  }
+}
+
+static int hap_add_char_valid_vals(__hap_char_t *hc, json_gen_str_t *jptr) {
+  if (hc->valid_vals) {
+    json_gen_push_array(jptr, "valid-values");
+    int i;
+    for (i = 0; i < hc->valid_vals_cnt; i++) {
+      json_gen_arr_set_int(jptr, hc->valid_vals[i]);
+    }
+    json_gen_pop_array(jptr);
+  }
+  if (hc->valid_vals_range) {
+    json_gen_push_array(jptr, "valid-values-range");
+    json_gen_arr_set_int(jptr, hc->valid_vals_range[0]);
+    json_gen_arr_set_int(jptr, hc->valid_vals_range[1]);
+    json_gen_pop_array(jptr);
+  }
+  return HAP_SUCCESS;
+}
+
+/* The "value" member of a characteristic in the accessory database */
+static int hap_add_char_db_val(__hap_char_t *hc, json_gen_str_t *jptr) {
+  if (hc->permission & HAP_CHAR_PERM_SPECIAL_READ) {
+    return json_gen_obj_set_null(jptr, "value");
+  } else if (hc->permission & HAP_CHAR_PERM_WR) {
+    /* TODO: Check what to do for bool/int/float types of control
+     * characteristics with "Write Response" permission.
+     * Ideally, a NULL should have been acceptable as it is independent
+     * of actual datatype, but HAT does not accept it for Wi-Fi
+     * configuration.
+     */
+    return json_gen_obj_set_string(jptr, "value", "");
+  }
+  return hap_add_char_val_json(hc->format, "value", &hc->val, jptr);
+}
+
+/* The accessory database JSON only changes with the accessory configuration,
+ * except for the "value" and "ev" members of each characteristic. Everything
+ * else is generated once and cached. Each characteristic object is split at
+ * a splice point, where its opening brace and dynamic members are inserted
+ * at request time, ahead of its cached "iid", "type", "perms" and metadata.
+ */
+typedef struct {
+  __hap_char_t *hc;
+  uint32_t offset;
+  /* First characteristic of its service: no leading comma, and the service
+   * is bulk read before it.
+   */
+  bool first_in_serv;
+} hap_acc_db_splice_t;
+
+typedef struct {
+  char *buf;
+  uint32_t len;
+  hap_acc_db_splice_t *splices;
+  int splice_cnt;
+  uint32_t config_num;
+  uint32_t acc_db_gen;
+} hap_acc_db_t;
+
+static hap_acc_db_t hap_acc_db;
+
+/* State for generating the cached database. With a NULL buf, only the length
+ * and the number of splice points are counted.
+ */
+typedef struct {
+  hap_acc_db_t db;
+  uint32_t cap;
+  int splice_cap;
+  bool overflow;
+  json_gen_str_t jstr;
+  char jbuf[128];
+} hap_acc_db_gen_t;
+
+static void hap_acc_db_gen_append(char *data, void *priv) {
+  hap_acc_db_gen_t *gen = (hap_acc_db_gen_t *)priv;
+  uint32_t len = strlen(data);
+  if (gen->db.buf) {
+    if (gen->db.len + len > gen->cap) {
+      gen->overflow = true;
+      return;
+    }
+    memcpy(gen->db.buf + gen->db.len, data, len);
+  }
+  gen->db.len += len;
+}
+
+static void hap_acc_db_gen_start(hap_acc_db_gen_t *gen) {
+  gen->jbuf[0] = '\0';
+  json_gen_str_start(&gen->jstr, gen->jbuf, sizeof(gen->jbuf),
+                     hap_acc_db_gen_append, gen);
+}
+
+static void hap_acc_db_gen_splice(hap_acc_db_gen_t *gen, __hap_char_t *hc,
+                                  bool first_in_serv) {
+  /* Flush everything so far, and restart the generator so that the first
+   * cached member after the splice point does not get a leading comma.
+   */
+  json_gen_str_end(&gen->jstr);
+  if (gen->db.splices) {
+    if (gen->db.splice_cnt >= gen->splice_cap) {
+      gen->overflow = true;
+    } else {
+      hap_acc_db_splice_t *splice = &gen->db.splices[gen->db.splice_cnt];
+      splice->hc = hc;
+      splice->offset = gen->db.len;
+      splice->first_in_serv = first_in_serv;
+    }
+  }
+  gen->db.splice_cnt++;
+  hap_acc_db_gen_start(gen);
+}
+
+static void hap_acc_db_gen_char(__hap_char_t *hc, hap_acc_db_gen_t *gen,
+                                bool first_in_serv) {
+  json_gen_str_t *jptr = &gen->jstr;
+  hap_acc_db_gen_splice(gen, hc, first_in_serv);
+  json_gen_obj_set_int(jptr, "iid", hc->iid);
+  hap_add_char_type(hc, jptr);
+  hap_add_char_perms(hc, jptr);
+  hap_add_char_meta(hc, jptr);
+  hap_add_char_valid_vals(hc, jptr);
+  json_gen_end_object(jptr);
+}
+
+static void hap_acc_db_gen_serv(__hap_serv_t *hs, hap_acc_db_gen_t *gen) {
+  json_gen_str_t *jptr = &gen->jstr;
+  json_gen_start_object(jptr);
+  json_gen_obj_set_int(jptr, "iid", hs->iid);
+  json_gen_obj_set_string(jptr, "type", hs->type_uuid);
+  if (hs->hidden)
+    json_gen_obj_set_bool(jptr, "hidden", "true");
+  if (hs->primary)
+    json_gen_obj_set_bool(jptr, "primary", "true");
+  if (hs->linked_servs) {
+    hap_linked_serv_t *linked = hs->linked_servs;
+    json_gen_push_array(jptr, "linked");
+    while (linked) {
+      json_gen_arr_set_int(jptr, ((__hap_serv_t *)linked->hs)->iid);
+      linked = linked->next;
+    }
+    json_gen_pop_array(jptr);
+  }
+
+  json_gen_push_array(jptr, "characteristics");
+  hap_char_t *hc;
+  for (hc = hap_serv_get_first_char((hap_serv_t *)hs); hc;
+       hc = hap_char_get_next(hc)) {
+    hap_acc_db_gen_char((__hap_char_t *)hc, gen,
+                        hc == hap_serv_get_first_char((hap_serv_t *)hs));
+  }
+  json_gen_pop_array(jptr);
+  json_gen_end_object(jptr);
+}
+
+static void hap_acc_db_gen(hap_acc_db_gen_t *gen) {
+  json_gen_str_t *jptr = &gen->jstr;
+  hap_acc_db_gen_start(gen);
+  json_gen_start_object(jptr);
+  json_gen_push_array(jptr, "accessories");
+  hap_acc_t *ha;
+  for (ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha)) {
+    json_gen_start_object(jptr);
+    json_gen_obj_set_int(jptr, "aid", ((__hap_acc_t *)ha)->aid);
+    json_gen_push_array(jptr, "services");
+    hap_serv_t *hs;
+    for (hs = hap_acc_get_first_serv(ha); hs; hs = hap_serv_get_next(hs)) {
+      hap_acc_db_gen_serv((__hap_serv_t *)hs, gen);
+    }
+    json_gen_pop_array(jptr);
+    json_gen_end_object(jptr);
+  }
+  json_gen_pop_array(jptr);
+  json_gen_end_object(jptr);
+  json_gen_str_end(jptr);
+}
+
+static void hap_acc_db_free(hap_acc_db_t *db) {
+  hap_platform_memory_free(db->buf);
+  hap_platform_memory_free(db->splices);
+  memset(db, 0, sizeof(*db));
+}
+
+/* Regenerates the cached database if the accessory configuration changed.
+ * Only called from the httpd task, which is the only user of the cache.
+ */
+static int hap_acc_db_refresh(void) {
+  uint32_t config_num = hap_priv.config_num;
+  uint32_t acc_db_gen = hap_priv.acc_db_gen;
+  if (hap_acc_db.buf && hap_acc_db.config_num == config_num &&
+      hap_acc_db.acc_db_gen == acc_db_gen) {
+    return HAP_SUCCESS;
+  }
+  hap_acc_db_free(&hap_acc_db);
+
+  /* First pass sizes the buffers, second pass fills them */
+  hap_acc_db_gen_t *gen = hap_platform_memory_calloc(1, sizeof(*gen));
+  if (!gen) {
+    return HAP_FAIL;
+  }
+  hap_acc_db_gen(gen);
+  gen->cap = gen->db.len;
+  gen->splice_cap = gen->db.splice_cnt;
+  gen->db.buf = hap_platform_memory_malloc(gen->cap + 1);
+  gen->db.splices = hap_platform_memory_calloc(gen->splice_cap + 1,
+                                               sizeof(hap_acc_db_splice_t));
+  gen->db.len = 0;
+  gen->db.splice_cnt = 0;
+  if (gen->db.buf && gen->db.splices) {
+    hap_acc_db_gen(gen);
+  }
+  if (!gen->db.buf || !gen->db.splices || gen->overflow) {
+    /* Out of memory, or the database changed between the two passes */
+    hap_acc_db_free(&gen->db);
+    hap_platform_memory_free(gen);
+    return HAP_FAIL;
+  }
+  hap_acc_db = gen->db;
+  hap_acc_db.config_num = config_num;
+  hap_acc_db.acc_db_gen = acc_db_gen;
+  hap_platform_memory_free(gen);
+  ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO,
+                "Accessory database cached: %" PRIu32 " bytes, %d chars",
+                hap_acc_db.len, hap_acc_db.splice_cnt);
+  return HAP_SUCCESS;
+}
+
+/* Response body writer for /accessories. Cached and dynamic pieces are packed
+ * into full chunks, instead of a chunk per json_gen buffer flush.
+ */
+typedef struct {
+  hap_acc_db_send_t send;
+  void *priv;
+  esp_err_t err;
+  int len;
+  char buf[1024];
+} hap_acc_db_out_t;
+
+static void hap_acc_db_out_flush(hap_acc_db_out_t *out) {
+  if (out->len && out->err == ESP_OK) {
+    out->err = out->send(out->buf, out->len, out->priv);
+  }
+  out->len = 0;
+}
+
+static void hap_acc_db_out_write(hap_acc_db_out_t *out, const char *data,
+                                 size_t len) {
+  while (len) {
+    size_t n = sizeof(out->buf) - out->len;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(out->buf + out->len, data, n);
+    out->len += n;
+    data += n;
+    len -= n;
+    if (out->len == sizeof(out->buf)) {
+      hap_acc_db_out_flush(out);
+    }
+  }
+}
+
+static void hap_acc_db_out_json_cb(char *data, void *priv) {
+  hap_acc_db_out_write((hap_acc_db_out_t *)priv, data, strlen(data));
+}
+
+static int hap_acc_db_bulk_read(__hap_serv_t *hs, int session_index) {
+  int char_cnt = 0;
+  hap_char_t *hc;
+  for (hc = hap_serv_get_first_char((hap_serv_t *)hs); hc;
+       hc = hap_char_get_next(hc)) {
+    if (((__hap_char_t *)hc)->permission & HAP_CHAR_PERM_PR) {
+      char_cnt++;
+    }
+  }
+  if (!char_cnt) {
+    return HAP_SUCCESS;
+  }
+  hap_read_data_t *read_arr =
+      hap_platform_memory_calloc(char_cnt, sizeof(hap_read_data_t));
+  if (!read_arr) {
+    return HAP_FAIL;
+  }
+
+  hap_status_t *status_codes =
+      hap_platform_memory_calloc(char_cnt, sizeof(hap_status_t));
+  if (!status_codes) {
+    hap_platform_memory_free(read_arr);
+    return HAP_FAIL;
+  }
+
+  /* Create an array of characteristics to read, and then read them in one go
+   */
+  char_cnt = 0;
+  for (hc = hap_serv_get_first_char((hap_serv_t *)hs); hc;
+       hc = hap_char_get_next(hc)) {
+    if (((__hap_char_t *)hc)->permission & HAP_CHAR_PERM_PR) {
+      hap_char_set_owner_ctrl(hc, session_index);
+      ((__hap_char_t *)hc)->update_called = false;
+      read_arr[char_cnt].hc = hc;
+      status_codes[char_cnt] = HAP_STATUS_SUCCESS;
+      read_arr[char_cnt].status = &status_codes[char_cnt];
+      char_cnt++;
+    }
+  }
+
+  hs->bulk_read(&read_arr[0], char_cnt, hs->priv, NULL);
+  hap_platform_memory_free(read_arr);
+  hap_platform_memory_free(status_codes);
+  return HAP_SUCCESS;
+}
+
+/* Writes "{", the "value" and "ev" members, and a trailing comma, which
+ * precede the cached members of the characteristic.
+ */
+static void hap_acc_db_write_dynamic(__hap_char_t *hc, hap_acc_db_out_t *out,
+                                     bool first_in_serv, int session_index) {
+  hap_acc_db_out_write(out, first_in_serv ? "{" : ",{",
+                       first_in_serv ? 1 : 2);
+
+  /* If the Update API has not been called from the service read routine,
+   * reset the owner controller value.
+   * Else, the controller will  miss the next notification.
+   */
+  if (!hc->update_called) {
+    hc->owner_ctrl = 0;
+  }
+  hc->update_called = false;
+
+  char buf[64];
+  json_gen_str_t jstr;
+  buf[0] = '\0';
+  json_gen_str_start(&jstr, buf, sizeof(buf), hap_acc_db_out_json_cb, out);
+  if (hc->permission & HAP_CHAR_PERM_PR) {
+    hap_add_char_db_val(hc, &jstr);
+  }
+  hap_add_char_ev(hc, &jstr, session_index);
+  json_gen_str_end(&jstr);
+  hap_acc_db_out_write(out, ",", 1);
+}
+
+int hap_acc_db_send(int session_index, hap_acc_db_send_t send, void *priv) {
+  if (hap_acc_db_refresh() != HAP_SUCCESS) {
+    return HAP_FAIL;
+  }
+  hap_acc_db_out_t out = {.send = send, .priv = priv, .err = ESP_OK};
+  uint32_t offset = 0;
+  int i;
+  for (i = 0; i < hap_acc_db.splice_cnt && out.err == ESP_OK; i++) {
+    hap_acc_db_splice_t *splice = &hap_acc_db.splices[i];
+    hap_acc_db_out_write(&out, hap_acc_db.buf + offset,
+                         splice->offset - offset);
+    offset = splice->offset;
+    if (splice->first_in_serv &&
+        hap_acc_db_bulk_read((__hap_serv_t *)splice->hc->parent,
+                             session_index) != HAP_SUCCESS) {
+      return HAP_FAIL;
+    }
+    hap_acc_db_write_dynamic(splice->hc, &out, splice->first_in_serv,
+                             session_index);
+  }
+  hap_acc_db_out_write(&out, hap_acc_db.buf + offset, hap_acc_db.len - offset);
+  hap_acc_db_out_flush(&out);
+  return out.err == ESP_OK ? HAP_SUCCESS : HAP_FAIL;
+}
@@ -22,8 +22,10 @@
  *
  */
 
+#include <esp_timer.h>
 #include <hap_platform_memory.h>
 #include <math.h>
+#include <perf_metrics.h>
 #include <string.h>
 #include "esp_mfi_debug.h"
 
@@ -33,8 +35,6 @@
 #include <esp_hap_ip_services.h>
 #include <esp_hap_database.h>
 
-static QueueHandle_t hap_event_queue;
-
 /**
  * @brief get characteristics's value
  */
@@ -67,51 +67,126 @@ static double esp_mfi_fmod(double a, double b)
     return fmod(a, b);
 }
 
-int hap_event_queue_init()
+/* Notifications are not queued per update. A changed characteristic is just
+ * marked dirty, and the HTTP server task later notifies its current value,
+ * so repeated updates within the coalescing window produce a single event
+ * with the latest value, and nothing is dropped when many characteristics
+ * change at once.
+ */
+static esp_timer_handle_t hap_notif_timer;
+
+static void hap_notif_timer_cb(void *arg)
 {
-    hap_event_queue = xQueueCreate( hap_priv.cfg.max_event_notif_chars,
-                    sizeof(hap_char_t *) );
-    if (hap_event_queue) {
-        return HAP_SUCCESS;
-    } else {
+    hap_send_event(HAP_INTERNAL_EVENT_TRIGGER_NOTIF);
+}
+
+int hap_notif_init()
+{
+    const esp_timer_create_args_t args = {
+        .callback = hap_notif_timer_cb,
+        .name = "hap_notif",
+    };
+    if (esp_timer_create(&args, &hap_notif_timer) != ESP_OK) {
         return HAP_FAIL;
     }
+    return HAP_SUCCESS;
 }
 
-int hap_event_queue_deinit()
+int hap_notif_deinit()
 {
-    if (hap_event_queue) {
-        vQueueDelete(hap_event_queue);
-        hap_event_queue = NULL;
+    if (hap_notif_timer) {
+        esp_timer_stop(hap_notif_timer);
+        esp_timer_delete(hap_notif_timer);
+        hap_notif_timer = NULL;
     }
     return HAP_SUCCESS;
 }
 
-hap_char_t * hap_get_pending_notif_char()
+void hap_schedule_notif(uint32_t delay_ms)
 {
-    hap_char_t *hc;
-    if (xQueueReceive(hap_event_queue, &hc, 0) != pdTRUE) {
-        return NULL;
+    if (!delay_ms || !hap_notif_timer || xPortInIsrContext() == pdTRUE) {
+        hap_send_event(HAP_INTERNAL_EVENT_TRIGGER_NOTIF);
+        return;
+    }
+    uint64_t delay_us = (uint64_t)delay_ms * 1000;
+    if (esp_timer_start_once(hap_notif_timer, delay_us) == ESP_ERR_INVALID_STATE) {
+        /* Already armed. Keep the earlier deadline, so that a stream of
+         * updates cannot postpone the flush indefinitely.
+         */
+        uint64_t expiry;
+        if (esp_timer_get_expiry_time(hap_notif_timer, &expiry) == ESP_OK &&
+                expiry > (uint64_t)esp_timer_get_time() + delay_us) {
+            esp_timer_restart(hap_notif_timer, delay_us);
+        }
     }
-    return hc;
 }
 
-static int hap_queue_event(hap_char_t *hc)
+static bool hap_char_notif_pending(__hap_char_t *_hc)
 {
-    int ret;
-    if (!hap_event_queue) {
-        return HAP_FAIL;
-    }
-    if (xPortInIsrContext() == pdTRUE) {
-        ret = xQueueSendFromISR(hap_event_queue, &hc, NULL);
+    return __atomic_load_n(&_hc->notif_dirty, __ATOMIC_ACQUIRE) || _hc->notif_deferred;
+}
+
+hap_char_t *hap_get_next_notif_char(hap_char_t *hc)
+{
+    hap_acc_t *ha = NULL;
+    hap_serv_t *hs = NULL;
+    if (hc) {
+        hs = hap_char_get_parent(hc);
+        ha = hap_serv_get_parent(hs);
+        hc = hap_char_get_next(hc);
     } else {
-        ret = xQueueSend(hap_event_queue, &hc, 0);
+        ha = hap_get_first_acc();
+        hs = ha ? hap_acc_get_first_serv(ha) : NULL;
+        hc = hs ? hap_serv_get_first_char(hs) : NULL;
     }
-    if (ret == pdTRUE) {
-        hap_send_event(HAP_INTERNAL_EVENT_TRIGGER_NOTIF);
-        return HAP_SUCCESS;
+    while (ha) {
+        for (; hc; hc = hap_char_get_next(hc)) {
+            if (hap_char_notif_pending((__hap_char_t *)hc)) {
+                return hc;
+            }
+        }
+        hs = hs ? hap_serv_get_next(hs) : NULL;
+        if (!hs) {
+            ha = hap_acc_get_next(ha);
+            hs = ha ? hap_acc_get_first_serv(ha) : NULL;
+        }
+        hc = hs ? hap_serv_get_first_char(hs) : NULL;
+    }
+    return NULL;
+}
+
+/* Sessions are grouped by the set of characteristics they are notified of,
+ * so that each group shares one event body. Starting from all pending
+ * sessions, every characteristic drops those that disagree with session
+ * first on whether they receive it.
+ */
+uint16_t hap_notif_group(const uint16_t *recipients, int num_chars, uint16_t pending, int first)
+{
+    uint16_t group = 1 << first;
+    uint16_t same = pending & ~group;
+    int j;
+    for (j = 0; j < num_chars && same; j++) {
+        if (recipients[j] & group) {
+            same &= recipients[j];
+        } else {
+            same &= ~recipients[j];
+        }
+    }
+    return group | same;
+}
+
+static int hap_queue_event(hap_char_t *hc)
+{
+    __hap_char_t *_hc = (__hap_char_t *)hc;
+    perf_metrics_inc(PERF_METRICS_HAP_CHAR_UPDATES);
+    __atomic_store_n(&_hc->notif_dirty, true, __ATOMIC_RELEASE);
+    /* Stateless events, like a button press, go out right away */
+    if (_hc->permission & HAP_CHAR_PERM_SPECIAL_READ) {
+        hap_schedule_notif(0);
+    } else {
+        hap_schedule_notif(hap_priv.cfg.notif_coalesce_ms);
     }
-    return HAP_FAIL;
+    return HAP_SUCCESS;
 }
 
 
@@ -179,6 +254,17 @@ int hap_char_check_val_constraints(__hap_char_t *_hc, hap_val_t *val)
     return HAP_SUCCESS;
 }
 
+/* FNV-1a hash of a DATA or TLV8 value */
+static uint32_t hap_char_data_hash(const hap_data_val_t *d)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t i;
+    for (i = 0; d->buf && i < d->buflen; i++) {
+        hash = (hash ^ d->buf[i]) * 16777619u;
+    }
+    return hash;
+}
+
 /**
  * @brief user update characteristics value, preparing for notification
  */
@@ -222,46 +308,66 @@ int hap_char_update_val(hap_char_t *hc, hap_val_t *val)
 			}
 			break;
 		case HAP_CHAR_FORMAT_STRING:
-			/* Not checking all combinations to find if value has changed,
-			 * since generally we do not expect dynamic string values
-			 *
-			 * Eg.
-			 * Both (old and new) values being NULL
-			 * Old value NULL, New non-NULL
-			 * Old value non-NULL, new NULL
-			 */
-			if (_hc->val.s && val->s && !strcmp(_hc->val.s, val->s))
-				value_changed = false;
-			else
-				value_changed = true;
-
-			if (_hc->val.s) {
+			if (!val->s || !_hc->val.s) {
+				value_changed = val->s || _hc->val.s;
+			} else {
+				value_changed = strcmp(_hc->val.s, val->s) ? true : false;
+			}
+			if (!value_changed) {
+				break;
+			}
+			if (!val->s) {
 				hap_platform_memory_free(_hc->val.s);
-                _hc->val.s = NULL;
-            }
-
-			if (val->s) {
-				_hc->val.s = strdup(val->s);
-				if (!_hc->val.s)
+				_hc->val.s = NULL;
+				_hc->str_cap = 0;
+				break;
+			}
+			/* Overwrite the old string in place if it fits, so that
+			 * periodically updated strings do not churn the heap
+			 */
+			size_t len = strlen(val->s) + 1;
+			if (len > _hc->str_cap) {
+				size_t cap = (len + 15) & ~15;
+				char *s = hap_platform_memory_malloc(cap);
+				if (!s)
 					return HAP_FAIL;
+				hap_platform_memory_free(_hc->val.s);
+				_hc->val.s = s;
+				_hc->str_cap = cap;
 			}
+			memcpy(_hc->val.s, val->s, len);
 			break;
         case HAP_CHAR_FORMAT_DATA:
         case HAP_CHAR_FORMAT_TLV8: {
+            /* The buffer belongs to the application and may have been
+             * modified in place or freed, so compare against a hash of the
+             * previous contents instead of the buffer itself.
+             */
+            uint32_t hash = hap_char_data_hash(&val->d);
+            if (_hc->val.d.buflen != val->d.buflen || _hc->data_hash != hash) {
+                value_changed = true;
+            }
             _hc->val.d.buf = val->d.buf;
             _hc->val.d.buflen = val->d.buflen;
-            value_changed = true;
+            _hc->data_hash = hash;
             }
             break;
 		default:
 			break;
 	}
-	if (value_changed || (_hc->permission & HAP_CHAR_PERM_SPECIAL_READ)) {
+	/* A value written by a controller is not notified back to it, so if that
+	 * controller is the only subscriber, there is nothing to queue. Changes with
+	 * no subscriber at all are still queued, since the event path also handles
+	 * the disconnected event (mDNS re-announce) in that case.
+	 */
+	bool only_owner_subscribed = _hc->ev_ctrls && !(_hc->ev_ctrls & ~_hc->owner_ctrl);
+	if ((value_changed && !only_owner_subscribed) ||
+            (_hc->permission & HAP_CHAR_PERM_SPECIAL_READ)) {
 		ESP_MFI_DEBUG_INTR(ESP_MFI_DEBUG_INFO, "Value Changed");
         hap_queue_event(hc);
 	} else {
-        /* If there is no value change, reset the owner flag here itself, as no notification
-         * is being sent anyways. In the absence of this, if there is a GET /characteristics
+        /* If no notification is being sent, reset the owner flag here itself.
+         * In the absence of this, if there is a GET /characteristics
          * followed by some value change from hardware, the owner_ctrl stays assigned to a
          * stale value, and so the controller misses a notification.
          */
@@ -336,6 +442,11 @@ static hap_char_t *hap_char_create(char *type_uuid, uint32_t permission, hap_cha
     }
 
     new_ch->val = val;
+    if (HAP_CHAR_FORMAT_STRING == format && val.s) {
+        new_ch->str_cap = strlen(val.s) + 1;
+    } else if (HAP_CHAR_FORMAT_DATA == format || HAP_CHAR_FORMAT_TLV8 == format) {
+        new_ch->data_hash = hap_char_data_hash(&val.d);
+    }
     new_ch->type_uuid = type_uuid;
     new_ch->format = format;
     new_ch->permission = permission;
@@ -532,6 +643,22 @@ hap_serv_t *hap_char_get_parent(hap_char_t *hc)
 
 }
 
+void hap_char_set_priv(hap_char_t *hc, void *priv)
+{
+    if (hc) {
+        ((__hap_char_t *)hc)->priv = priv;
+    }
+}
+
+void *hap_char_get_priv(hap_char_t *hc)
+{
+    if (hc) {
+        return ((__hap_char_t *)hc)->priv;
+    } else {
+        return NULL;
+    }
+}
+
 #define set_bit(val, index)	((val) |= (1 << index))
 #define reset_bit(val, index)	((val) &= ~(1 << index))
 void hap_char_manage_notification(hap_char_t *hc, int index, bool ev)
@@ -0,0 +1,102 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on ESPRESSIF SYSTEMS products only, in
+ * which case, it is free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include <esp_hap_char_query.h>
+#include <hap.h>
+#include <string.h>
+
+static bool hap_query_val_is_true(const char *val, size_t len) {
+  return (len == 1 && val[0] == '1') ||
+         (len == 4 && !strncmp(val, "true", 4));
+}
+
+int hap_parse_char_query(const char *uri, hap_char_query_t *q) {
+  memset(q, 0, sizeof(*q));
+  const char *p = uri ? strchr(uri, '?') : NULL;
+  if (!p) {
+    return HAP_FAIL;
+  }
+  p++;
+  while (*p) {
+    size_t len = strcspn(p, "&");
+    const char *eq = memchr(p, '=', len);
+    size_t key_len = eq ? (size_t)(eq - p) : len;
+    const char *val = eq ? eq + 1 : p + len;
+    size_t val_len = p + len - val;
+
+    if (key_len == 2 && !strncmp(p, "id", 2)) {
+      q->id = val;
+      q->id_end = val + val_len;
+    } else if (key_len == 4 && !strncmp(p, "meta", 4)) {
+      q->meta = hap_query_val_is_true(val, val_len);
+    } else if (key_len == 5 && !strncmp(p, "perms", 5)) {
+      q->perms = hap_query_val_is_true(val, val_len);
+    } else if (key_len == 4 && !strncmp(p, "type", 4)) {
+      q->type = hap_query_val_is_true(val, val_len);
+    } else if (key_len == 2 && !strncmp(p, "ev", 2)) {
+      q->ev = hap_query_val_is_true(val, val_len);
+    }
+    p += len;
+    if (*p == '&') {
+      p++;
+    }
+  }
+  return q->id ? HAP_SUCCESS : HAP_FAIL;
+}
+
+bool hap_parse_char_id_num(const char **pos, const char *end, int *num) {
+  const char *p = *pos;
+  int val = 0;
+  while (p < end && *p >= '0' && *p <= '9' && p - *pos < 9) {
+    val = val * 10 + (*p - '0');
+    p++;
+  }
+  if (p == *pos || (p < end && *p >= '0' && *p <= '9')) {
+    return false;
+  }
+  *pos = p;
+  *num = val;
+  return true;
+}
+
+bool hap_parse_char_id(const char **pos, const char *end, int *aid, int *iid) {
+  const char *p = *pos;
+  if (!hap_parse_char_id_num(&p, end, aid) || p == end || *p != '.') {
+    return false;
+  }
+  p++;
+  if (!hap_parse_char_id_num(&p, end, iid)) {
+    return false;
+  }
+  if (p < end) {
+    /* A comma must be followed by another element */
+    if (*p != ',' || p + 1 == end) {
+      return false;
+    }
+    p++;
+  }
+  *pos = p;
+  return true;
+}
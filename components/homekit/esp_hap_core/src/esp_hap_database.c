@@ -56,6 +56,8 @@
 #define HAP_MAX_NOTIF_CHARS         8
 #define HAP_SOCK_RECV_TIMEOUT       10
 #define HAP_SOCK_SEND_TIMEOUT       10
+#define HAP_NOTIF_COALESCE_MS       20
+#define HAP_NOTIF_MIN_INTERVAL_MS   100
 
 hap_priv_t hap_priv = {
     .cfg = {
@@ -66,6 +68,8 @@ hap_priv_t hap_priv = {
         .recv_timeout = HAP_SOCK_RECV_TIMEOUT,
         .send_timeout = HAP_SOCK_SEND_TIMEOUT,
         .sw_token_max_len = HAP_SW_TOKEN_MAX_LEN,
+        .notif_coalesce_ms = HAP_NOTIF_COALESCE_MS,
+        .notif_min_interval_ms = HAP_NOTIF_MIN_INTERVAL_MS,
     }
 };
 
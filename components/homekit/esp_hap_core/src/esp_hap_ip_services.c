@@ -25,8 +25,10 @@
  */
 
 #include <esp_hap_acc.h>
+#include <esp_hap_acc_db.h>
 #include <esp_hap_char.h>
 #include <esp_hap_database.h>
+#include <esp_hap_char_query.h>
 #include <esp_hap_ip_services.h>
 #include <esp_hap_main.h>
 #include <esp_hap_mdns.h>
@@ -34,6 +36,7 @@
 #include <esp_hap_pair_setup.h>
 #include <esp_hap_pair_verify.h>
 #include <esp_hap_pairings.h>
+#include <esp_hap_put_parser.h>
 #include <esp_hap_secure_message.h>
 #include <esp_hap_serv.h>
 #include <esp_hap_wac.h>
@@ -49,6 +52,9 @@
 #include <json_generator.h>
 #include <json_parser.h>
 #include <lwip/sockets.h>
+#include <perf_metrics.h>
+#include <perf_trace.h>
+#include <stdlib.h>
 
 #ifdef ESP_MFI_DEBUG_ENABLE
 #define ESP_MFI_DEBUG_PLAIN(fmt, ...)                                          \
@@ -61,6 +67,21 @@
 
 static bool http_debug;
 
+/* Defines fn##_metered, which records the handling time of fn in histogram id.
+ * The response is corked, so the status line, headers and body written by
+ * httpd_resp_send() leave as a single encrypted frame where they fit.
+ */
+#define HAP_METERED_HANDLER(fn, id)                                            \
+  static int fn##_metered(httpd_req_t *req) {                                 \
+    int64_t start = perf_metrics_begin();                                      \
+    int fd = httpd_req_to_sockfd(req);                                         \
+    hap_httpd_cork(fd);                                                        \
+    int ret = fn(req);                                                         \
+    hap_httpd_uncork(fd);                                                      \
+    perf_metrics_observe_since(id, start);                                     \
+    return ret;                                                                \
+  }
+
 int hap_http_session_not_authorized(httpd_req_t *req) {
   char buf[50];
   httpd_resp_set_status(req, "470 Connection Authorization Required");
@@ -119,6 +140,7 @@ static int hap_http_pair_setup_handler(httpd_req_t *req) {
        */
       ((hap_secure_session_t *)ctx)->conn_identifier = fd;
       hap_platform_httpd_set_sess_ctx(req, ctx, hap_free_session, true);
+      perf_metrics_inc(PERF_METRICS_HAP_SESSIONS_OPENED);
       httpd_sess_set_send_override(hap_priv.server, fd, hap_httpd_send);
       httpd_sess_set_recv_override(hap_priv.server, fd, hap_httpd_recv);
     }
@@ -132,10 +154,13 @@ static int hap_http_pair_setup_handler(httpd_req_t *req) {
   }
   return ret1;
 }
+
+HAP_METERED_HANDLER(hap_http_pair_setup_handler, PERF_METRICS_HAP_PAIR_SETUP)
+
 static struct httpd_uri hap_pair_setup = {
     .uri = "/pair-setup",
     .method = HTTP_POST,
-    .handler = hap_http_pair_setup_handler,
+    .handler = hap_http_pair_setup_handler_metered,
 };
 
 static int hap_http_pair_verify_handler(httpd_req_t *req) {
@@ -217,6 +242,7 @@ static int hap_http_pair_verify_handler(httpd_req_t *req) {
       }
 #endif
       hap_platform_httpd_set_sess_ctx(req, ctx, hap_free_session, true);
+      perf_metrics_inc(PERF_METRICS_HAP_SESSIONS_OPENED);
       httpd_sess_set_send_override(hap_priv.server, fd, hap_httpd_send);
       httpd_sess_set_recv_override(hap_priv.server, fd, hap_httpd_recv);
     }
@@ -233,304 +259,21 @@ static int hap_http_pair_verify_handler(httpd_req_t *req) {
   return ret1;
 }
 
+HAP_METERED_HANDLER(hap_http_pair_verify_handler, PERF_METRICS_HAP_PAIR_VERIFY)
+
 static struct httpd_uri hap_pair_verify = {
     .uri = "/pair-verify",
     .method = HTTP_POST,
-    .handler = hap_http_pair_verify_handler,
+    .handler = hap_http_pair_verify_handler_metered,
 };
 
-static int hap_add_char_val_json(hap_char_format_t format, char *key,
-                                 hap_val_t *val, json_gen_str_t *jptr) {
-  switch (format) {
-  case HAP_CHAR_FORMAT_BOOL: {
-    json_gen_obj_set_bool(jptr, key, val->b);
-    break;
-  }
-  case HAP_CHAR_FORMAT_UINT8:
-  case HAP_CHAR_FORMAT_UINT16:
-  case HAP_CHAR_FORMAT_UINT32:
-  case HAP_CHAR_FORMAT_INT: {
-    json_gen_obj_set_int(jptr, key, val->i);
-    break;
-  }
-  case HAP_CHAR_FORMAT_FLOAT: {
-    json_gen_obj_set_float(jptr, key, val->f);
-    break;
-  }
-  case HAP_CHAR_FORMAT_STRING: {
-    if (val->s) {
-      json_gen_obj_set_string(jptr, key, val->s);
-    } else {
-      json_gen_obj_set_null(jptr, key);
-    }
-    break;
-  }
-  case HAP_CHAR_FORMAT_DATA:
-  case HAP_CHAR_FORMAT_TLV8: {
-    if (val->d.buf) {
-      json_gen_obj_start_long_string(jptr, key, NULL);
-      uint8_t *buf = val->d.buf;
-      uint32_t buflen = val->d.buflen;
-      char tmp[100];
-      while (buflen) {
-        int tmp_len = sizeof(tmp);
-        if (buflen > 60) {
-          esp_mfi_base64_encode((char *)buf, 60, tmp, tmp_len, &tmp_len);
-          buflen -= 60;
-          buf += 60;
-        } else {
-          esp_mfi_base64_encode((char *)buf, buflen, tmp, tmp_len, &tmp_len);
-          buflen -= buflen;
-        }
-        tmp[tmp_len] = 0;
-        json_gen_add_to_long_string(jptr, tmp);
-      }
-      json_gen_end_long_string(jptr);
-    } else {
-      json_gen_obj_set_null(jptr, key);
-    }
-    break;
-  }
-  default:
-    break;
-  }
-  return HAP_SUCCESS;
-}
-
-static int hap_add_char_format_json(__hap_char_t *hc, json_gen_str_t *jptr) {
-  switch (hc->format) {
-  case HAP_CHAR_FORMAT_UINT8:
-    return json_gen_obj_set_string(jptr, "format", "uint8");
-  case HAP_CHAR_FORMAT_UINT16:
-    return json_gen_obj_set_string(jptr, "format", "uint16");
-  case HAP_CHAR_FORMAT_UINT32:
-    return json_gen_obj_set_string(jptr, "format", "uint32");
-  case HAP_CHAR_FORMAT_INT:
-    return json_gen_obj_set_string(jptr, "format", "int");
-  case HAP_CHAR_FORMAT_BOOL:
-    return json_gen_obj_set_string(jptr, "format", "bool");
-  case HAP_CHAR_FORMAT_STRING:
-    return json_gen_obj_set_string(jptr, "format", "string");
-  case HAP_CHAR_FORMAT_FLOAT:
-    return json_gen_obj_set_string(jptr, "format", "float");
-  case HAP_CHAR_FORMAT_DATA:
-    return json_gen_obj_set_string(jptr, "format", "data");
-  case HAP_CHAR_FORMAT_TLV8:
-    return json_gen_obj_set_string(jptr, "format", "tlv8");
-  default:
-    break;
-  }
-  return HAP_SUCCESS;
-}
-
-static int hap_add_char_type(__hap_char_t *hc, json_gen_str_t *jptr) {
-  return json_gen_obj_set_string(jptr, "type", (char *)hc->type_uuid);
-}
-
-static int hap_add_char_meta(__hap_char_t *hc, json_gen_str_t *jptr) {
-  hap_add_char_format_json(hc, jptr);
-
-  if (hc->constraint_flags & HAP_CHAR_MIN_FLAG)
-    hap_add_char_val_json(hc->format, "minValue", &hc->min, jptr);
-  if (hc->constraint_flags & HAP_CHAR_MAX_FLAG)
-    hap_add_char_val_json(hc->format, "maxValue", &hc->max, jptr);
-  if (hc->constraint_flags & HAP_CHAR_STEP_FLAG)
-    hap_add_char_val_json(hc->format, "minStep", &hc->step, jptr);
-
-  /* maxLen and maxDataLen are constraints for "string" and "data" format
-   * of characteristics, respectively. However, the constraints themselves
-   * are integers. So, we pass the format as HAP_CHAR_FORMAT_INT
-   */
-  if (hc->constraint_flags & HAP_CHAR_MAXLEN_FLAG)
-    hap_add_char_val_json(HAP_CHAR_FORMAT_INT, "maxLen", &hc->max, jptr);
-  if (hc->constraint_flags & HAP_CHAR_MAXDATALEN_FLAG)
-    hap_add_char_val_json(HAP_CHAR_FORMAT_INT, "maxDataLen", &hc->max, jptr);
-
-  if (hc->description)
-    json_gen_obj_set_string(jptr, "description", hc->description);
-  if (hc->unit)
-    json_gen_obj_set_string(jptr, "unit", hc->unit);
-
-  return HAP_SUCCESS;
-}
-
-static int hap_add_char_perms(__hap_char_t *hc, json_gen_str_t *jptr) {
-  json_gen_push_array(jptr, "perms");
-  if (hc->permission & HAP_CHAR_PERM_PR)
-    json_gen_arr_set_string(jptr, "pr");
-  if (hc->permission & HAP_CHAR_PERM_PW)
-    json_gen_arr_set_string(jptr, "pw");
-  if (hc->permission & HAP_CHAR_PERM_EV)
-    json_gen_arr_set_string(jptr, "ev");
-  if (hc->permission & HAP_CHAR_PERM_AA)
-    json_gen_arr_set_string(jptr, "aa");
-  if (hc->permission & HAP_CHAR_PERM_TW)
-    json_gen_arr_set_string(jptr, "tw");
-  if (hc->permission & HAP_CHAR_PERM_HD)
-    json_gen_arr_set_string(jptr, "hd");
-  if (hc->permission & HAP_CHAR_PERM_WR)
-    json_gen_arr_set_string(jptr, "wr");
-  json_gen_pop_array(jptr);
-  return HAP_SUCCESS;
-}
-
-static int hap_add_char_ev(__hap_char_t *hc, json_gen_str_t *jptr,
-                           uint8_t session_index) {
-  if (hap_char_is_ctrl_subscribed((hap_char_t *)hc, session_index)) {
-    return json_gen_obj_set_bool(jptr, "ev", true);
-  } else {
-    return json_gen_obj_set_bool(jptr, "ev", false);
-  }
-}
-
-static int hap_add_char_valid_vals(__hap_char_t *hc, json_gen_str_t *jptr) {
-  if (hc->valid_vals) {
-    json_gen_push_array(jptr, "valid-values");
-    int i;
-    for (i = 0; i < hc->valid_vals_cnt; i++) {
-      json_gen_arr_set_int(jptr, hc->valid_vals[i]);
-    }
-    json_gen_pop_array(jptr);
-  }
-  if (hc->valid_vals_range) {
-    json_gen_push_array(jptr, "valid-values-range");
-    json_gen_arr_set_int(jptr, hc->valid_vals_range[0]);
-    json_gen_arr_set_int(jptr, hc->valid_vals_range[1]);
-    json_gen_pop_array(jptr);
-  }
-  return HAP_SUCCESS;
-}
-
-static int hap_prepare_char_db(__hap_char_t *hc, json_gen_str_t *jptr,
-                               int session_index) {
-  json_gen_start_object(jptr);
-
-  json_gen_obj_set_int(jptr, "iid", hc->iid);
-
-  /* If the Update API has not been called from the service read routine,
-   * reset the owner controller value.
-   * Else, the controller will  miss the next notification.
-   */
-  if (!hc->update_called) {
-    hc->owner_ctrl = 0;
-  }
-  hc->update_called = false;
-
-  if (hc->permission & HAP_CHAR_PERM_PR) {
-    if (hc->permission & HAP_CHAR_PERM_SPECIAL_READ) {
-      json_gen_obj_set_null(jptr, "value");
-    } else if (hc->permission & HAP_CHAR_PERM_WR) {
-      /* TODO: Check what to do for bool/int/float types of control
-       * characteristics with "Write Response" permission.
-       * Ideally, a NULL should have been acceptable as it is independent
-       * of actual datatype, but HAT does not accept it for Wi-Fi
-       * configuration.
-       */
-      json_gen_obj_set_string(jptr, "value", "");
-    } else {
-      hap_add_char_val_json(hc->format, "value", &hc->val, jptr);
-    }
-  }
-  hap_add_char_type(hc, jptr);
-  hap_add_char_perms(hc, jptr);
-  hap_add_char_ev(hc, jptr, session_index);
-  hap_add_char_meta(hc, jptr);
-  hap_add_char_valid_vals(hc, jptr);
-
-  json_gen_end_object(jptr);
-
-  return HAP_SUCCESS;
+static esp_err_t hap_http_send_acc_db_chunk(const char *buf, size_t len,
+                                            void *priv) {
+  ESP_MFI_DEBUG_PLAIN("%.*s", (int)len, buf);
+  return httpd_resp_send_chunk((httpd_req_t *)priv, buf, len);
 }
 
-static int hap_prepare_serv_db(__hap_serv_t *hs, json_gen_str_t *jptr,
-                               int session_index) {
-  json_gen_start_object(jptr);
-  json_gen_obj_set_int(jptr, "iid", hs->iid);
-  json_gen_obj_set_string(jptr, "type", hs->type_uuid);
-  if (hs->hidden)
-    json_gen_obj_set_bool(jptr, "hidden", "true");
-  if (hs->primary)
-    json_gen_obj_set_bool(jptr, "primary", "true");
-  if (hs->linked_servs) {
-    hap_linked_serv_t *linked = hs->linked_servs;
-    json_gen_push_array(jptr, "linked");
-    while (linked) {
-      json_gen_arr_set_int(jptr, ((__hap_serv_t *)linked->hs)->iid);
-      linked = linked->next;
-    }
-    json_gen_pop_array(jptr);
-  }
-
-  json_gen_push_array(jptr, "characteristics");
-  int char_cnt = 0;
-  hap_char_t *hc;
-  for (hc = hap_serv_get_first_char((hap_serv_t *)hs); hc;
-       hc = hap_char_get_next(hc)) {
-    if (((__hap_char_t *)hc)->permission & HAP_CHAR_PERM_PR) {
-      char_cnt++;
-    }
-  }
-  if (char_cnt) {
-    hap_read_data_t *read_arr =
-        hap_platform_memory_calloc(char_cnt, sizeof(hap_read_data_t));
-    if (!read_arr) {
-      return HAP_FAIL;
-    }
-
-    hap_status_t *status_codes =
-        hap_platform_memory_calloc(char_cnt, sizeof(hap_status_t));
-    if (!status_codes) {
-      hap_platform_memory_free(read_arr);
-      return HAP_FAIL;
-    }
-
-    /* Create an array of characteristics to read, and then read them in one go
-     */
-    char_cnt = 0;
-    for (hc = hap_serv_get_first_char((hap_serv_t *)hs); hc;
-         hc = hap_char_get_next(hc)) {
-      if (((__hap_char_t *)hc)->permission & HAP_CHAR_PERM_PR) {
-        hap_char_set_owner_ctrl(hc, session_index);
-        ((__hap_char_t *)hc)->update_called = false;
-        read_arr[char_cnt].hc = hc;
-        status_codes[char_cnt] = HAP_STATUS_SUCCESS;
-        read_arr[char_cnt].status = &status_codes[char_cnt];
-        char_cnt++;
-      }
-    }
-
-    hs->bulk_read(&read_arr[0], char_cnt, hs->priv, NULL);
-    hap_platform_memory_free(read_arr);
-    hap_platform_memory_free(status_codes);
-  }
-  for (hc = hap_serv_get_first_char((hap_serv_t *)hs); hc;
-       hc = hap_char_get_next(hc)) {
-    hap_prepare_char_db((__hap_char_t *)hc, jptr, session_index);
-  }
-
-  json_gen_pop_array(jptr);
-  json_gen_end_object(jptr);
-  return HAP_SUCCESS;
-}
-
-static int hap_prepare_acc_db(__hap_acc_t *ha, json_gen_str_t *jptr,
-                              int session_index) {
-  json_gen_start_object(jptr);
-  json_gen_obj_set_int(jptr, "aid", ha->aid);
-  json_gen_push_array(jptr, "services");
-  hap_serv_t *hs;
-  for (hs = hap_acc_get_first_serv((hap_acc_t *)ha); hs;
-       hs = hap_serv_get_next(hs)) {
-    hap_prepare_serv_db((__hap_serv_t *)hs, jptr, session_index);
-  }
-  json_gen_pop_array(jptr);
-  json_gen_end_object(jptr);
-  return HAP_SUCCESS;
-}
-
-static int hap_prepare_json_database(char *buf, int bufsize,
-                                     json_gen_flush_cb_t flush_cb,
-                                     httpd_req_t *req) {
+static int hap_prepare_json_database(httpd_req_t *req) {
   if (!req) {
     return HAP_FAIL;
   }
@@ -539,19 +282,8 @@ static int hap_prepare_json_database(char *buf, int bufsize,
   if (!session) {
     return HAP_FAIL;
   }
-  json_gen_str_t jstr;
-  json_gen_str_start(&jstr, buf, bufsize, flush_cb, req);
-  json_gen_start_object(&jstr);
-  json_gen_push_array(&jstr, "accessories");
-  hap_acc_t *ha;
-  for (ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha)) {
-    hap_prepare_acc_db((__hap_acc_t *)ha, &jstr,
-                       hap_get_ctrl_session_index(session));
-  }
-  json_gen_pop_array(&jstr);
-  json_gen_end_object(&jstr);
-  json_gen_str_end(&jstr);
-  return HAP_SUCCESS;
+  return hap_acc_db_send(hap_get_ctrl_session_index(session),
+                         hap_http_send_acc_db_chunk, req);
 }
 
 static void hap_http_json_flush_chunk(char *data, void *priv) {
@@ -560,7 +292,6 @@ static void hap_http_json_flush_chunk(char *data, void *priv) {
 }
 
 static int hap_http_get_accessories(httpd_req_t *req) {
-  char buf[1000];
   ESP_MFI_DEBUG_PLAIN("Socket fd: %d; HTTP Request %s %s\n",
                       httpd_req_to_sockfd(req),
                       hap_platform_httpd_get_req_method(req),
@@ -574,7 +305,7 @@ static int hap_http_get_accessories(httpd_req_t *req) {
   ESP_MFI_DEBUG_PLAIN("Generating HTTP Response\n");
   /* Using chunked encoding since the response can be large, especially for
    * bridges */
-  hap_prepare_json_database(buf, sizeof(buf), hap_http_json_flush_chunk, req);
+  hap_prepare_json_database(req);
   /* This indicates the last chunk */
   httpd_resp_send_chunk(req, NULL, 0);
   ESP_MFI_DEBUG_PLAIN("\n");
@@ -582,10 +313,13 @@ static int hap_http_get_accessories(httpd_req_t *req) {
   hap_report_event(HAP_EVENT_GET_ACC_COMPLETED, NULL, 0);
   return HAP_SUCCESS;
 }
+
+HAP_METERED_HANDLER(hap_http_get_accessories, PERF_METRICS_HAP_ACCESSORIES)
+
 static struct httpd_uri hap_accessories = {
     .uri = "/accessories",
     .method = HTTP_GET,
-    .handler = hap_http_get_accessories,
+    .handler = hap_http_get_accessories_metered,
 };
 
 static void hap_set_char_report_status(bool *include_status,
@@ -619,382 +353,508 @@ static void hap_set_char_report_write_response(bool *include_status,
   json_gen_end_object(jstr);
 }
 
-static void remove_escape_char(char *data, uint32_t *buf_len) {
-  char *target_data = data;
-  uint32_t len = *buf_len;
-  while (len--) {
-    if (*data == '\\') {
-      data++;
-      (*buf_len)--;
-      len--;
-    }
-    *target_data++ = *data++;
-  }
+/* PUT /characteristics is parsed as it is received (see esp_hap_put_parser.h)
+ * and every characteristic object is handled as soon as it has been read.
+ * Writes are handed to the service write routine per run of consecutive
+ * characteristics of the same service, so neither the body nor a per-request
+ * write array is ever held.
+ */
+/* Writes collected for the service write routines before they are invoked.
+ * Writes held back for the pid of a timed write spill to the heap beyond this.
+ */
+#define HAP_PUT_RUN_MAX 8
+/* Successful writes tracked without allocating, in case a later error needs
+ * every characteristic to be reported
+ */
+#define HAP_PUT_DONE_STACK 16
+
+static int hap_put_recv(void *arg, char *buf, int len) {
+  return httpd_req_recv((httpd_req_t *)arg, buf, len);
 }
 
-static int hap_http_handle_set_char(jparse_ctx_t *jctx, char *outbuf,
-                                    int buf_size, httpd_req_t *req) {
-  int cnt = 0, char_cnt = 0, i;
-  bool include_status = false;
+typedef struct {
+  hap_secure_session_t *session;
+  json_gen_str_t jstr;
+  bool include_status;
+  /* A prepare preceded this write, or the request carries a pid */
+  bool req_tw;
+  bool valid_tw;
+  bool pid_seen;
   uint64_t pid;
-  bool valid_tw = false;
-  bool req_tw = false;
-  hap_secure_session_t *session =
-      (hap_secure_session_t *)hap_platform_httpd_get_sess_ctx(req);
-  if (!session)
-    return HAP_FAIL;
+  int64_t ttl;
+  int64_t prepare_time;
+  int64_t cur_time;
+  bool write_err;
+  /* Collected writes, on stack unless held back writes outgrew it */
+  hap_write_data_t *run;
+  hap_status_t *run_status;
+  int run_cnt;
+  int run_cap;
+  hap_write_data_t run_stack[HAP_PUT_RUN_MAX];
+  hap_status_t run_status_stack[HAP_PUT_RUN_MAX];
+  /* Characteristics written successfully while nothing needed reporting */
+  hap_char_t **done;
+  int done_cnt;
+  int done_cap;
+  hap_char_t *done_stack[HAP_PUT_DONE_STACK];
+} hap_put_ctx_t;
+
+static int hap_put_char_aid(hap_char_t *hc) {
+  return ((__hap_acc_t *)hap_serv_get_parent(hap_char_get_parent(hc)))->aid;
+}
 
-  int64_t cur_time = esp_timer_get_time() / 1000;
-  int64_t prepare_time = session->prepare_time;
-  if (prepare_time) {
-    /* If prepare time is non zero, it means that a prepare was received
-     * before this request, and so this write needs to be timed write
-     */
-    req_tw = true;
-    /* Reset prepare_time to 0, since a prepare is valid only for the immediate
-     * following write
-     */
-    session->prepare_time = 0;
-  }
-  if (json_obj_get_int64(jctx, "pid", (int64_t *)&pid) == OS_SUCCESS) {
-    /* If the pid value is present, this must be a timed write.
-     * However, if there was no preceding prepare, the check below will
-     * fail (as ttl will be 0) and appropriate error will be reported
-     * subsequently
-     */
-    req_tw = true;
-    if ((pid == session->pid) && ((cur_time - prepare_time) <= session->ttl)) {
-      valid_tw = true;
+/* Once anything has to be reported, every characteristic of the request is,
+ * including the ones already written successfully.
+ */
+static void hap_put_report_done(hap_put_ctx_t *ctx) {
+  for (int i = 0; i < ctx->done_cnt; i++) {
+    hap_set_char_report_status(&ctx->include_status, &ctx->jstr,
+                               hap_put_char_aid(ctx->done[i]),
+                               ((__hap_char_t *)ctx->done[i])->iid,
+                               HAP_STATUS_SUCCESS);
+  }
+  ctx->done_cnt = 0;
+}
+
+static void hap_put_report_status(hap_put_ctx_t *ctx, int aid, int iid,
+                                  int status) {
+  hap_put_report_done(ctx);
+  hap_set_char_report_status(&ctx->include_status, &ctx->jstr, aid, iid,
+                             status);
+}
+
+static void hap_put_add_done(hap_put_ctx_t *ctx, hap_char_t *hc) {
+  if (ctx->done_cnt == ctx->done_cap) {
+    hap_char_t **done =
+        hap_platform_memory_malloc(ctx->done_cap * 2 * sizeof(hap_char_t *));
+    if (!done) {
+      /* Reporting the status right away needs no memory */
+      hap_put_report_status(ctx, hap_put_char_aid(hc),
+                            ((__hap_char_t *)hc)->iid, HAP_STATUS_SUCCESS);
+      return;
     }
+    memcpy(done, ctx->done, ctx->done_cnt * sizeof(hap_char_t *));
+    if (ctx->done != ctx->done_stack)
+      hap_platform_memory_free(ctx->done);
+    ctx->done = done;
+    ctx->done_cap *= 2;
   }
-  /* Resetting the values so that the session is ready for next prepare or write
-   */
-  session->pid = 0;
-  session->ttl = 0;
+  ctx->done[ctx->done_cnt++] = hc;
+}
 
-  json_obj_get_array(jctx, "characteristics", &cnt);
-  if (cnt <= 0)
-    return HAP_FAIL;
+static void hap_put_free_write(hap_write_data_t *write) {
+  __hap_char_t *hc = (__hap_char_t *)write->hc;
+  if (hc->format == HAP_CHAR_FORMAT_STRING) {
+    if (write->val.s)
+      hap_platform_memory_free(write->val.s);
+  } else if ((hc->format == HAP_CHAR_FORMAT_DATA) ||
+             (hc->format == HAP_CHAR_FORMAT_TLV8)) {
+    if (write->val.d.buf)
+      hap_platform_memory_free(write->val.d.buf);
+  }
+  if (write->auth_data.data)
+    hap_platform_memory_free(write->auth_data.data);
+}
 
-  hap_write_data_t *write_arr =
-      hap_platform_memory_calloc(cnt, sizeof(hap_write_data_t));
-  hap_status_t *status_arr =
-      hap_platform_memory_calloc(cnt, sizeof(hap_status_t));
-  if (!write_arr || !status_arr)
-    goto set_char_end;
+/* Invokes a single write callback for all consecutive characteristics of the
+ * same service in the collected run, and reports the results if required.
+ * A run held back for the pid can mix services, so it is grouped first.
+ */
+static void hap_put_flush_run(hap_put_ctx_t *ctx) {
+  int i, hs_index = 0;
+  bool report = false;
 
-  json_gen_str_t jstr;
-  json_gen_str_start(&jstr, outbuf, buf_size, hap_http_json_flush_chunk, req);
-  /* Dummy get, so that the loop can start by leaving the previous
-   * object and getting newer one
-   */
-  json_arr_get_object(jctx, 0);
-  /* Loop through all characteristic objects {aid,iid,value}, handle
-   * errors if any, and if there are no errors, put the characteristic
-   * pointer and value in an array (with char_cnt)
-   */
-  for (i = 0; i < cnt; i++) {
-    /* Leave the previous object and get a newer one from the array */
-    json_arr_leave_object(jctx);
-    int aid = 0, iid = 0;
-    json_arr_get_object(jctx, i);
-    json_obj_get_int(jctx, "aid", &aid);
-    json_obj_get_int(jctx, "iid", &iid);
-    hap_acc_t *ha = hap_acc_get_by_aid(aid);
-    __hap_char_t *hc = (__hap_char_t *)hap_acc_get_char_by_iid(ha, iid);
-    if (!ha || !hc) {
-      hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                 HAP_STATUS_RES_ABSENT);
-      continue;
+  if (!ctx->run_cnt)
+    return;
+  if (ctx->req_tw && !ctx->valid_tw) {
+    /* These were held back for the pid, which never came or did not match */
+    for (i = 0; i < ctx->run_cnt; i++) {
+      hap_put_report_status(ctx, hap_put_char_aid(ctx->run[i].hc),
+                            ((__hap_char_t *)ctx->run[i].hc)->iid,
+                            HAP_STATUS_VAL_INVALID);
     }
+    goto flush_end;
+  }
 
-    /* Check if this write is just to enable/disable event notifications.
-     * This is valid even for read-only characteristics that support event
-     * notifications (like sensor readings), so we do not check the
-     * HAP_CHAR_PERM_PW here.
-     */
-    bool ev;
-    if (json_obj_get_bool(jctx, "ev", &ev) == HAP_SUCCESS) {
-      if (hc->permission & HAP_CHAR_PERM_EV) {
-        int index = hap_get_ctrl_session_index(session);
-        hap_char_manage_notification((hap_char_t *)hc, index, ev);
-        ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Events %s for aid=%d iid=%d",
-                      ev ? "Enabled" : "Disabled", aid, iid);
-      } else {
-        hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                   HAP_STATUS_NO_NOTIF);
-      }
+  if (ctx->req_tw)
+    hap_serv_group_writes(ctx->run, ctx->run_cnt);
+  int index = hap_get_ctrl_session_index(ctx->session);
+  for (i = 0; i < ctx->run_cnt; i++) {
+    hap_char_set_owner_ctrl(ctx->run[i].hc, index);
+    ctx->run_status[i] = HAP_STATUS_SUCCESS;
+    ctx->run[i].status = &ctx->run_status[i];
+  }
+  for (i = 1; i <= ctx->run_cnt; i++) {
+    if ((i < ctx->run_cnt) && (hap_char_get_parent(ctx->run[i].hc) ==
+                               hap_char_get_parent(ctx->run[hs_index].hc)))
       continue;
+    __hap_serv_t *hs =
+        (__hap_serv_t *)hap_char_get_parent(ctx->run[hs_index].hc);
+    if (hs->write_cb(&ctx->run[hs_index], i - hs_index, hs->priv,
+                     ctx->session) != HAP_SUCCESS)
+      ctx->write_err = true;
+    hs_index = i;
+  }
+
+  report = ctx->include_status || ctx->write_err;
+  for (i = 0; i < ctx->run_cnt; i++) {
+    if (ctx->run[i].write_response ||
+        (*ctx->run[i].status != HAP_STATUS_SUCCESS))
+      report = true;
+  }
+  if (report)
+    hap_put_report_done(ctx);
+  for (i = 0; i < ctx->run_cnt; i++) {
+    __hap_char_t *hc = (__hap_char_t *)ctx->run[i].hc;
+    if (!report) {
+      hap_put_add_done(ctx, ctx->run[i].hc);
+    } else if (ctx->run[i].write_response &&
+               (*ctx->run[i].status == HAP_STATUS_SUCCESS)) {
+      hap_set_char_report_write_response(&ctx->include_status, &ctx->jstr,
+                                         hap_put_char_aid(ctx->run[i].hc),
+                                         hc->iid, hc);
+    } else {
+      hap_set_char_report_status(&ctx->include_status, &ctx->jstr,
+                                 hap_put_char_aid(ctx->run[i].hc), hc->iid,
+                                 *ctx->run[i].status);
     }
+  }
 
-    /* If the previous request was a prepare, but the current
-     * one was not a valid timed write, report error.
-     */
-    if (req_tw == true && valid_tw == false) {
-      hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                 HAP_STATUS_VAL_INVALID);
-      continue;
-    }
+flush_end:
+  for (i = 0; i < ctx->run_cnt; i++)
+    hap_put_free_write(&ctx->run[i]);
+  ctx->run_cnt = 0;
+}
 
-    /* For characteristic that require a Mandatory Timed Write, return
-     * error if this write is not a valid timed write
-     */
-    if (hc->permission & HAP_CHAR_PERM_TW) {
-      if (valid_tw == false) {
-        hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                   HAP_STATUS_VAL_INVALID);
-        continue;
-      }
-    }
+/* Discards collected writes without invoking the write callbacks */
+static void hap_put_drop_run(hap_put_ctx_t *ctx) {
+  for (int i = 0; i < ctx->run_cnt; i++)
+    hap_put_free_write(&ctx->run[i]);
+  ctx->run_cnt = 0;
+}
 
-    /* Check if the characteristic has write permission */
-    if (!(hc->permission & HAP_CHAR_PERM_PW)) {
-      hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                 HAP_STATUS_WR_ON_RDONLY);
-      continue;
-    }
+static void hap_put_set_pid(hap_put_ctx_t *ctx, const char *prim) {
+  char *end;
+  uint64_t pid = strtoull(prim, &end, 10);
+  if (!*prim || *end)
+    return;
+  /* If the pid value is present, this must be a timed write.
+   * However, if there was no preceding prepare, the check below will
+   * fail (as ttl will be 0) and appropriate error will be reported
+   * subsequently
+   */
+  ctx->req_tw = true;
+  ctx->pid_seen = true;
+  ctx->valid_tw = (pid == ctx->pid) &&
+                  ((ctx->cur_time - ctx->prepare_time) <= ctx->ttl);
+}
 
-    /* Check if the characteristic needs Authorization Data.
-     * Actual authData value will be read later.
-     */
-    if (hc->permission & HAP_CHAR_PERM_AA) {
-      int tmp_len;
-      if (json_obj_get_strlen(jctx, "authData", &tmp_len) != HAP_SUCCESS) {
-        hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                   HAP_STATUS_INSUFFICIENT_AUTH);
-        continue;
-      }
-    }
-    /* If there is no write routine registered, there is no point of having
-     * this write request. Return an error.
-     */
-    if (!((__hap_serv_t *)(hap_char_get_parent((hap_char_t *)hc)))->write_cb) {
-      hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                 HAP_STATUS_VAL_INVALID);
-      continue;
+/* Writes held back for the pid cannot be flushed yet, so the run grows on the
+ * heap instead. Status pointers are only set up when the run is flushed, so
+ * moving the writes is safe.
+ */
+static bool hap_put_grow_run(hap_put_ctx_t *ctx) {
+  int cap = ctx->run_cap * 2;
+  hap_write_data_t *run = hap_platform_memory_malloc(
+      cap * (sizeof(hap_write_data_t) + sizeof(hap_status_t)));
+  if (!run)
+    return false;
+  memcpy(run, ctx->run, ctx->run_cnt * sizeof(hap_write_data_t));
+  if (ctx->run != ctx->run_stack)
+    hap_platform_memory_free(ctx->run);
+  ctx->run = run;
+  ctx->run_status = (hap_status_t *)(run + cap);
+  ctx->run_cap = cap;
+  return true;
+}
+
+/* Validates a characteristic object and, if there are no errors, adds it to
+ * the run of writes. Errors are reported right away.
+ */
+static void hap_put_handle_char(hap_put_ctx_t *ctx, hap_put_char_t *obj) {
+  int aid = obj->aid, iid = obj->iid;
+  __hap_char_t *hc = (__hap_char_t *)hap_get_char_by_aid_iid(aid, iid);
+  if (!hc) {
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_RES_ABSENT);
+    return;
+  }
+
+  /* Check if this write is just to enable/disable event notifications.
+   * This is valid even for read-only characteristics that support event
+   * notifications (like sensor readings), so we do not check the
+   * HAP_CHAR_PERM_PW here.
+   */
+  if (obj->has_ev) {
+    if (hc->permission & HAP_CHAR_PERM_EV) {
+      int index = hap_get_ctrl_session_index(ctx->session);
+      hap_char_manage_notification((hap_char_t *)hc, index, obj->ev);
+      ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Events %s for aid=%d iid=%d",
+                    obj->ev ? "Enabled" : "Disabled", aid, iid);
+    } else {
+      hap_put_report_status(ctx, aid, iid, HAP_STATUS_NO_NOTIF);
     }
+    return;
+  }
+
+  /* If the previous request was a prepare, but the current
+   * one was not a valid timed write, report error. If the pid is yet to
+   * come, the write is held back in the run until it does.
+   */
+  if (ctx->pid_seen && !ctx->valid_tw) {
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_VAL_INVALID);
+    return;
+  }
+
+  /* For characteristic that require a Mandatory Timed Write, return
+   * error if this write cannot be a valid timed write
+   */
+  if ((hc->permission & HAP_CHAR_PERM_TW) && !ctx->req_tw) {
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_VAL_INVALID);
+    return;
+  }
+
+  /* Check if the characteristic has write permission */
+  if (!(hc->permission & HAP_CHAR_PERM_PW)) {
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_WR_ON_RDONLY);
+    return;
+  }
+
+  /* Check if the characteristic needs Authorization Data. */
+  if ((hc->permission & HAP_CHAR_PERM_AA) && !obj->has_auth) {
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_INSUFFICIENT_AUTH);
+    return;
+  }
+  /* If there is no write routine registered, there is no point of having
+   * this write request. Return an error.
+   */
+  if (!((__hap_serv_t *)(hap_char_get_parent((hap_char_t *)hc)))->write_cb) {
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_VAL_INVALID);
+    return;
+  }
 
-    hap_auth_data_t auth_data = {
-        .data = NULL,
-        .len = 0,
-    };
-    hap_val_t val = {0};
-    int json_ret = HAP_FAIL;
+  hap_val_t val = {0};
+  int json_ret = HAP_FAIL;
+  if (!obj->has_value) {
+    /* Reported as an invalid value below */
+  } else if (!obj->value_is_str) {
     switch (hc->format) {
     case HAP_CHAR_FORMAT_BOOL:
-      json_ret = json_obj_get_bool(jctx, "value", &val.b);
+      json_ret = hap_put_prim_bool(obj->value_prim, &val.b);
       break;
     case HAP_CHAR_FORMAT_UINT8:
     case HAP_CHAR_FORMAT_UINT16:
     case HAP_CHAR_FORMAT_UINT32:
     case HAP_CHAR_FORMAT_INT:
-      json_ret = json_obj_get_int(jctx, "value", &val.i);
+      json_ret = hap_put_prim_int(obj->value_prim, &val.i);
       /* For some characteristics, like Target Lock State, which is an enum
        * (mapped to uint8), it was seen that controlling via Siri sends
        * true/false as values, instead of 1/0. This additional code is for
        * handling such cases.
        */
       if ((json_ret != HAP_SUCCESS) && (hc->format == HAP_CHAR_FORMAT_UINT8)) {
-        json_ret = json_obj_get_bool(jctx, "value", &val.b);
+        json_ret = hap_put_prim_bool(obj->value_prim, &val.b);
       }
       break;
     case HAP_CHAR_FORMAT_FLOAT:
-      json_ret = json_obj_get_float(jctx, "value", &val.f);
-      break;
-    case HAP_CHAR_FORMAT_STRING: {
-      int str_len = 0;
-      json_ret = json_obj_get_strlen(jctx, "value", &str_len);
-      if (json_ret == HAP_SUCCESS) {
-        /* Increment string length, for NULL termination byte */
-        str_len++;
-        val.s = hap_platform_memory_calloc(str_len, 1);
-        if (!val.s) {
-          hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                     HAP_STATUS_OO_RES);
-          continue;
-        }
-        json_obj_get_string(jctx, "value", val.s, str_len);
-      }
-      break;
-    }
-    case HAP_CHAR_FORMAT_DATA:
-    case HAP_CHAR_FORMAT_TLV8: {
-      int str_len = 0;
-      json_ret = json_obj_get_strlen(jctx, "value", &str_len);
-      if (json_ret == HAP_SUCCESS) {
-        val.d.buf = hap_platform_memory_calloc(1, str_len + 1);
-        if (!val.d.buf) {
-          hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                     HAP_STATUS_OO_RES);
-          continue;
-        }
-        val.d.buflen = str_len + 1;
-        json_obj_get_string(jctx, "value", (char *)val.d.buf, val.d.buflen);
-        remove_escape_char((char *)val.d.buf, &val.d.buflen);
-        if (esp_mfi_base64_decode((const char *)val.d.buf,
-                                  strlen((char *)val.d.buf), (char *)val.d.buf,
-                                  val.d.buflen, (int *)&val.d.buflen) != 0) {
-          hap_platform_memory_free(val.d.buf);
-          hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                     HAP_STATUS_VAL_INVALID);
-          continue;
-        }
-      }
+      json_ret = hap_put_prim_float(obj->value_prim, &val.f);
       break;
-    }
     default:
       json_ret = HAP_FAIL;
     }
-    if (json_ret != HAP_SUCCESS) {
-      hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                 HAP_STATUS_VAL_INVALID);
-      continue;
+  } else if (hc->format == HAP_CHAR_FORMAT_STRING) {
+    val.s = hap_put_str_detach(&obj->value_str);
+    if (!val.s) {
+      hap_put_report_status(ctx, aid, iid, HAP_STATUS_OO_RES);
+      return;
     }
-
-    /* Check if the value is within constraints */
-    if (hap_char_check_val_constraints(hc, &val) != HAP_SUCCESS) {
-      hap_set_char_report_status(&include_status, &jstr, aid, iid,
-                                 HAP_STATUS_VAL_INVALID);
-      continue;
+    json_ret = HAP_SUCCESS;
+  } else if ((hc->format == HAP_CHAR_FORMAT_DATA) ||
+             (hc->format == HAP_CHAR_FORMAT_TLV8)) {
+    int str_len = obj->value_str.len;
+    val.d.buf = (uint8_t *)hap_put_str_detach(&obj->value_str);
+    if (!val.d.buf) {
+      hap_put_report_status(ctx, aid, iid, HAP_STATUS_OO_RES);
+      return;
     }
-
-    if (json_obj_get_strlen(jctx, "authData", &auth_data.len) == HAP_SUCCESS) {
-      auth_data.data = hap_platform_memory_calloc(1, auth_data.len + 1);
-      json_obj_get_string(jctx, "authData", (char *)auth_data.data,
-                          auth_data.len + 1);
-      esp_mfi_base64_decode((const char *)auth_data.data, auth_data.len,
-                            (char *)auth_data.data, auth_data.len + 1,
-                            &auth_data.len);
+    if (esp_mfi_base64_decode((const char *)val.d.buf, str_len,
+                              (char *)val.d.buf, str_len + 1,
+                              (int *)&val.d.buflen) != 0) {
+      hap_platform_memory_free(val.d.buf);
+      hap_put_report_status(ctx, aid, iid, HAP_STATUS_VAL_INVALID);
+      return;
     }
-    bool remote = false;
-    json_obj_get_bool(jctx, "remote", &remote);
+    json_ret = HAP_SUCCESS;
+  }
+  if (json_ret != HAP_SUCCESS) {
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_VAL_INVALID);
+    return;
+  }
 
-    bool response = false;
-    if (hc->permission & HAP_CHAR_PERM_WR) {
-      json_obj_get_bool(jctx, "r", &response);
-    }
+  hap_write_data_t write = {
+      .hc = (hap_char_t *)hc,
+      .val = val,
+  };
+  /* Check if the value is within constraints */
+  if (hap_char_check_val_constraints(hc, &val) != HAP_SUCCESS) {
+    hap_put_free_write(&write);
+    hap_put_report_status(ctx, aid, iid, HAP_STATUS_VAL_INVALID);
+    return;
+  }
 
-    int index = hap_get_ctrl_session_index(session);
-    hap_char_set_owner_ctrl((hap_char_t *)hc, index);
-    /* No errors in the object data itself. Save the characteristic
-     * pointer and value, to be used later
-     */
-    write_arr[char_cnt].hc = (hap_char_t *)hc;
-    write_arr[char_cnt].val = val;
-    write_arr[char_cnt].auth_data = auth_data;
-    write_arr[char_cnt].remote = remote;
-    write_arr[char_cnt].write_response = response;
-    write_arr[char_cnt].status = &status_arr[char_cnt];
-    char_cnt++;
+  if (obj->has_auth) {
+    int auth_len = obj->auth.len;
+    write.auth_data.data = (uint8_t *)hap_put_str_detach(&obj->auth);
+    if (write.auth_data.data) {
+      esp_mfi_base64_decode((const char *)write.auth_data.data, auth_len,
+                            (char *)write.auth_data.data, auth_len + 1,
+                            &write.auth_data.len);
+    }
+  }
+  write.remote = obj->remote;
+  if (hc->permission & HAP_CHAR_PERM_WR) {
+    write.write_response = obj->response;
   }
-  if (!char_cnt)
-    goto set_char_end;
 
-  /* The logic here is to loop through all the saved characteristic
-   * pointers, and invoke a single write callback for all consecutive
-   * characteristics of the same service.
-   * The write callback will be invoked if the service changes or
-   * if the last characteristic in the array is reached
-   */
-  int hs_index = 0;
-  bool write_err = false;
-  bool write_response = false;
-  __hap_serv_t *hs = (__hap_serv_t *)hap_char_get_parent(write_arr[0].hc);
-  /* The counter here will go till char_cnt instead of char_cnt - 1.
-   * When i == char_cnt, it will mean that all elements in the array
-   * have been looped through.
-   * So, last iteration will invoke the write callback for the last
-   * set of characteritics.
+  /* A run holds consecutive characteristics of one service, unless writes
+   * are being held back for the pid of a timed write, in which case it is
+   * grouped per service when flushed.
    */
-  for (i = 0; i <= char_cnt; i++) {
-    /* Explicitly checking for i < char_cnt because this loop runs till
-     * char_cnt (because of logic mentioned above) which is actually
-     * outside the write_arr.
-     */
-    if (i < char_cnt) {
-      if (write_arr[i].write_response) {
-        write_response = true;
-      }
-    }
-    if ((i < char_cnt) &&
-        ((hap_serv_t *)hs == hap_char_get_parent(write_arr[i].hc)))
-      continue;
-    else {
-      /* Passing the pointers to the first elements of the array
-       * for a given service (indicated by hs_index).
-       * Number of elements of the array are indicated by
-       * i - hs_index
-       */
-      if (hs->write_cb(&write_arr[hs_index], i - hs_index, hs->priv,
-                       hap_platform_httpd_get_sess_ctx(req)) != HAP_SUCCESS)
-        write_err = true;
-      if (i < char_cnt) {
-        hs = (__hap_serv_t *)hap_char_get_parent(write_arr[i].hc);
-        hs_index = i;
-      }
+  bool hold = ctx->req_tw && !ctx->pid_seen;
+  if (hold) {
+    if (ctx->run_cnt == ctx->run_cap && !hap_put_grow_run(ctx)) {
+      hap_put_free_write(&write);
+      hap_put_report_status(ctx, aid, iid, HAP_STATUS_OO_RES);
+      return;
     }
+  } else if (ctx->run_cnt == ctx->run_cap ||
+             (ctx->run_cnt &&
+              hap_char_get_parent(ctx->run[ctx->run_cnt - 1].hc) !=
+                  hap_char_get_parent(write.hc))) {
+    hap_put_flush_run(ctx);
   }
-  if (write_err || include_status || write_response) {
-    for (i = 0; i < char_cnt; i++) {
-      /* TODO: The code to get aid looks complex. Simplify */
-      if (write_arr[i].write_response &&
-          (*write_arr[i].status == HAP_STATUS_SUCCESS)) {
-        hap_set_char_report_write_response(
-            &include_status, &jstr,
-            ((__hap_acc_t *)hap_serv_get_parent(
-                 hap_char_get_parent(write_arr[i].hc)))
-                ->aid,
-            ((__hap_char_t *)(write_arr[i].hc))->iid,
-            (__hap_char_t *)(write_arr[i].hc));
-        continue;
+  ctx->run[ctx->run_cnt++] = write;
+}
+
+static bool hap_put_read_chars(hap_put_reader_t *r, hap_put_ctx_t *ctx,
+                               int *char_cnt) {
+  hap_put_char_t obj;
+  bool ok = hap_put_expect(r, '[');
+
+  hap_put_str_init(&obj.value_str);
+  hap_put_str_init(&obj.auth);
+  if (ok && hap_put_skip_ws(r) != ']') {
+    do {
+      hap_put_char_reset(&obj);
+      ok = hap_put_read_char(r, &obj);
+      if (ok) {
+        hap_put_handle_char(ctx, &obj);
+        (*char_cnt)++;
       }
-      hap_set_char_report_status(&include_status, &jstr,
-                                 ((__hap_acc_t *)hap_serv_get_parent(
-                                      hap_char_get_parent(write_arr[i].hc)))
-                                     ->aid,
-                                 ((__hap_char_t *)(write_arr[i].hc))->iid,
-                                 *write_arr[i].status);
-    }
+    } while (ok && hap_put_expect(r, ','));
   }
+  hap_put_char_reset(&obj);
+  return ok && hap_put_expect(r, ']');
+}
 
+/* Returns HAP_SUCCESS if nothing needs to be reported, and HAP_FAIL if a
+ * chunked response has been generated or the request had no characteristics.
+ * malformed is set if the body could not be parsed and nothing was reported.
+ */
+static int hap_http_handle_set_char(httpd_req_t *req, char *outbuf,
+                                    int buf_size, bool *malformed) {
+  hap_put_reader_t r = {
+      .recv = hap_put_recv,
+      .recv_arg = req,
+  };
+  hap_put_ctx_t ctx = {0};
+  hap_put_str_t key;
+  int char_cnt = 0;
   int ret = HAP_SUCCESS;
-set_char_end:
-  if (include_status) {
-    json_gen_pop_array(&jstr);
-    json_gen_end_object(&jstr);
-    json_gen_str_end(&jstr);
-    ret = HAP_FAIL;
+
+  ctx.session = (hap_secure_session_t *)hap_platform_httpd_get_sess_ctx(req);
+  if (!ctx.session)
+    return HAP_FAIL;
+
+  ctx.cur_time = esp_timer_get_time() / 1000;
+  ctx.prepare_time = ctx.session->prepare_time;
+  if (ctx.prepare_time) {
+    /* If prepare time is non zero, it means that a prepare was received
+     * before this request, and so this write needs to be timed write
+     */
+    ctx.req_tw = true;
+    /* Reset prepare_time to 0, since a prepare is valid only for the immediate
+     * following write
+     */
+    ctx.session->prepare_time = 0;
   }
+  /* Resetting the values so that the session is ready for next prepare or write
+   */
+  ctx.pid = ctx.session->pid;
+  ctx.ttl = ctx.session->ttl;
+  ctx.session->pid = 0;
+  ctx.session->ttl = 0;
+  ctx.run = ctx.run_stack;
+  ctx.run_status = ctx.run_status_stack;
+  ctx.run_cap = HAP_PUT_RUN_MAX;
+  ctx.done = ctx.done_stack;
+  ctx.done_cap = HAP_PUT_DONE_STACK;
+  json_gen_str_start(&ctx.jstr, outbuf, buf_size, hap_http_json_flush_chunk,
+                     req);
 
-  if (write_arr) {
-    for (i = 0; i < char_cnt; i++) {
-      if (((__hap_char_t *)write_arr[i].hc)->format == HAP_CHAR_FORMAT_STRING) {
-        if (write_arr[i].val.s) {
-          hap_platform_memory_free(write_arr[i].val.s);
-        }
-      } else if ((((__hap_char_t *)write_arr[i].hc)->format ==
-                  HAP_CHAR_FORMAT_DATA) ||
-                 (((__hap_char_t *)write_arr[i].hc)->format ==
-                  HAP_CHAR_FORMAT_TLV8)) {
-        hap_platform_memory_free(write_arr[i].val.d.buf);
-      }
-      if (write_arr[i].auth_data.data) {
-        hap_platform_memory_free(write_arr[i].auth_data.data);
+  hap_put_str_init(&key);
+  bool ok = hap_put_expect(&r, '{');
+  if (ok && hap_put_skip_ws(&r) != '}') {
+    do {
+      hap_put_str_free(&key);
+      ok = hap_put_skip_ws(&r) == '"' && hap_put_read_str(&r, &key) &&
+           hap_put_expect(&r, ':');
+      if (!ok)
+        break;
+      int c = hap_put_skip_ws(&r);
+      if (!strcmp(key.buf, "characteristics") && c == '[') {
+        ok = hap_put_read_chars(&r, &ctx, &char_cnt);
+      } else if (!strcmp(key.buf, "pid") && c != '"' && c != '{' && c != '[') {
+        char prim[24];
+        ok = hap_put_read_prim(&r, prim, sizeof(prim));
+        if (ok)
+          hap_put_set_pid(&ctx, prim);
+      } else {
+        ok = hap_put_skip_value(&r);
       }
-    }
+    } while (ok && hap_put_expect(&r, ','));
+  }
+  ok = ok && hap_put_expect(&r, '}');
+  hap_put_str_free(&key);
+
+  if (ok) {
+    hap_put_flush_run(&ctx);
+  } else {
+    /* Writes already dispatched stand, but nothing more is written for a
+     * body that turned out to be malformed
+     */
+    ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Failed to parse HTTPD JSON Data");
+    hap_put_drop_run(&ctx);
+  }
+  if (ctx.run != ctx.run_stack)
+    hap_platform_memory_free(ctx.run);
+  if (ctx.done != ctx.done_stack)
+    hap_platform_memory_free(ctx.done);
+
+  if (!char_cnt)
+    ret = HAP_FAIL;
+  if (ctx.include_status) {
+    json_gen_pop_array(&ctx.jstr);
+    json_gen_end_object(&ctx.jstr);
+    json_gen_str_end(&ctx.jstr);
+    ret = HAP_FAIL;
   }
-  if (write_arr)
-    hap_platform_memory_free(write_arr);
-  if (status_arr)
-    hap_platform_memory_free(status_arr);
+  *malformed = !ok && !ctx.include_status;
   return ret;
 }
 
-static int hap_http_put_characteristics(httpd_req_t *req) {
-  char stack_inbuf[512] = {0};
+static int hap_http_put_characteristics_process(httpd_req_t *req) {
   char outbuf[512] = {0};
-  char *heap_inbuf = NULL;
-  char *inbuf = stack_inbuf;
+  bool malformed = false;
 
   ESP_MFI_DEBUG_PLAIN("Socket fd: %d; HTTP Request %s %s\n",
                       httpd_req_to_sockfd(req),
@@ -1006,46 +866,6 @@ static int hap_http_put_characteristics(httpd_req_t *req) {
     return hap_http_session_not_authorized(req);
   }
 
-  /* If received content is larger than the buffer on stack, allocate one from
-   * heap. This will mostly be required only in case of bridges, wherein there
-   * could be a request to control all/many accessories at once.
-   */
-  int content_len = hap_platform_httpd_get_content_len(req);
-  if (content_len > sizeof(stack_inbuf)) {
-    heap_inbuf = hap_platform_memory_calloc(
-        content_len + 1, 1); /* Allocating an extra byte for NULL termination */
-    if (!heap_inbuf) {
-      ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Failed to read HTTPD Data");
-      httpd_resp_set_status(req, HTTPD_500);
-      return httpd_resp_send(req, NULL, 0);
-    }
-    ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO,
-                  "Allocated buffer of size %d for the large PUT",
-                  content_len + 1)
-    inbuf = heap_inbuf;
-  }
-  int data_len = hap_httpd_get_data(req, inbuf, content_len);
-  if (data_len < 0) {
-    ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Failed to read HTTPD Data");
-    httpd_resp_set_status(req, HTTPD_500);
-    if (heap_inbuf) {
-      hap_platform_memory_free(heap_inbuf);
-      ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Freed allocated buffer for PUT");
-    }
-    return httpd_resp_send(req, NULL, 0);
-  }
-  ESP_MFI_DEBUG_PLAIN("Data Received: %s\n", inbuf);
-  jparse_ctx_t jctx;
-  if (json_parse_start(&jctx, inbuf, data_len) != HAP_SUCCESS) {
-    ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Failed to parse HTTPD JSON Data");
-    httpd_resp_set_status(req, HTTPD_500);
-    if (heap_inbuf) {
-      hap_platform_memory_free(heap_inbuf);
-      ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Freed allocated buffer for PUT");
-    }
-    return httpd_resp_send(req, NULL, 0);
-  }
-
   httpd_resp_set_type(req, "application/hap+json");
   /* Setting response type to indicate error.
    * This will be actually sent out only if there is some error
@@ -1053,8 +873,11 @@ static int hap_http_put_characteristics(httpd_req_t *req) {
    * Else, the response type will be set to 204
    */
   httpd_resp_set_status(req, HTTPD_207);
-  if (hap_http_handle_set_char(&jctx, outbuf, sizeof(outbuf), req) ==
-      HAP_SUCCESS) {
+  int ret = hap_http_handle_set_char(req, outbuf, sizeof(outbuf), &malformed);
+  if (malformed) {
+    httpd_resp_set_status(req, HTTPD_500);
+    httpd_resp_send(req, NULL, 0);
+  } else if (ret == HAP_SUCCESS) {
     snprintf(outbuf, sizeof(outbuf), "HTTP/1.1 %s\r\n\r\n", HTTPD_204);
     httpd_send(req, outbuf, strlen(outbuf));
   } else {
@@ -1065,31 +888,34 @@ static int hap_http_put_characteristics(httpd_req_t *req) {
     httpd_resp_send_chunk(req, NULL, 0);
     ESP_MFI_DEBUG_PLAIN("\n");
   }
-  json_parse_end(&jctx);
-
-  if (heap_inbuf) {
-    hap_platform_memory_free(heap_inbuf);
-    ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Freed allocated buffer for PUT");
-  }
 
   hap_report_event(HAP_EVENT_SET_CHAR_COMPLETED, NULL, 0);
   return HAP_SUCCESS;
 }
 
-static bool hap_get_bool_url_param(char *query_str, char *key) {
-  char val[6]; /* Max string will be "false" */
-  if (httpd_query_key_value(query_str, key, val, sizeof(val)) == HAP_SUCCESS) {
-    if (!strcmp(val, "true") || !strcmp(val, "1"))
-      return true;
-  }
-  return false;
+/* Covers the whole PUT, from reading the body to the application write callbacks */
+static int hap_http_put_characteristics(httpd_req_t *req) {
+  int64_t start = perf_trace_begin();
+  int64_t metrics_start = perf_metrics_begin();
+  int fd = httpd_req_to_sockfd(req);
+  hap_httpd_cork(fd);
+  int ret = hap_http_put_characteristics_process(req);
+  hap_httpd_uncork(fd);
+  perf_trace_end(PERF_TRACE_HAP_PUT, start,
+                 hap_platform_httpd_get_content_len(req));
+  perf_metrics_observe_since(PERF_METRICS_HAP_CHARS_PUT, metrics_start);
+  return ret;
 }
 
+/* Characteristics read without allocating, which covers typical requests */
+#define HAP_GET_CHAR_STACK_IDS 16
+
 static int hap_http_get_characteristics(httpd_req_t *req) {
   char outbuf[512];
-  char stack_val_buf[512] = {0};
-  char *heap_val_buf = NULL;
-  char *val = stack_val_buf;
+  hap_read_data_t stack_read_arr[HAP_GET_CHAR_STACK_IDS];
+  hap_status_t stack_status_codes[HAP_GET_CHAR_STACK_IDS];
+  hap_read_data_t *read_arr = stack_read_arr;
+  hap_status_t *status_codes = stack_status_codes;
 
   ESP_MFI_DEBUG_PLAIN("Socket fd: %d; HTTP Request %s %s\n",
                       httpd_req_to_sockfd(req),
@@ -1101,42 +927,25 @@ static int hap_http_get_characteristics(httpd_req_t *req) {
   if (!hap_is_req_secure(session)) {
     return hap_http_session_not_authorized(req);
   }
-  const char *uri = hap_platform_httpd_get_req_uri(req);
-  /* Allocate on heap, if URI is longer */
-  if (strlen(uri) > sizeof(stack_val_buf)) {
-    heap_val_buf = hap_platform_memory_calloc(
-        strlen(uri) + 1, 1); /* Allocating an extra byte for NULL termination */
-    if (!heap_val_buf) {
-      ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Failed to read URL");
-      httpd_resp_set_status(req, HTTPD_500);
-      return httpd_resp_send(req, NULL, 0);
-    }
-    ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO,
-                  "Allocated buffer of size %d for the large GET",
-                  strlen(uri) + 1)
-    val = heap_val_buf;
-  }
-  size_t url_query_str_len = httpd_req_get_url_query_len(req);
-  char *url_query_str = hap_platform_memory_calloc(1, url_query_str_len + 1);
-  if (!url_query_str) {
-    httpd_resp_set_status(req, HTTPD_400);
-    httpd_resp_set_type(req, "application/hap+json");
-    snprintf(outbuf, sizeof(outbuf), "{\"status\":-70409}");
-    httpd_resp_send(req, outbuf, strlen(outbuf));
-    goto get_char_return;
-  }
-  httpd_req_get_url_query_str(req, url_query_str, url_query_str_len + 1);
-  /* Check for all the optional URL query paramaters */
-  bool meta = hap_get_bool_url_param(url_query_str, "meta");
-  bool perms = hap_get_bool_url_param(url_query_str, "perms");
-  bool type = hap_get_bool_url_param(url_query_str, "type");
-  bool ev = hap_get_bool_url_param(url_query_str, "ev");
 
-  /* Check for the mandatory "id" URL query parameter.
-   * If not found, return success
+  /* Check for the mandatory "id" URL query parameter, and validate it while
+   * counting the characteristics, which decides the size of the read array.
    */
-  if (httpd_query_key_value(url_query_str, "id", val, strlen(uri) + 1) !=
+  hap_char_query_t query;
+  int char_cnt = 0;
+  int aid, iid;
+  const char *id_ptr;
+  bool id_valid = false;
+  if (hap_parse_char_query(hap_platform_httpd_get_req_uri(req), &query) ==
       HAP_SUCCESS) {
+    id_ptr = query.id;
+    id_valid = id_ptr < query.id_end;
+    while (id_valid && id_ptr < query.id_end) {
+      id_valid = hap_parse_char_id(&id_ptr, query.id_end, &aid, &iid);
+      char_cnt++;
+    }
+  }
+  if (!id_valid) {
     httpd_resp_set_status(req, HTTPD_400);
     httpd_resp_set_type(req, "application/hap+json");
     snprintf(outbuf, sizeof(outbuf), "{\"status\":-70409}");
@@ -1144,21 +953,6 @@ static int hap_http_get_characteristics(httpd_req_t *req) {
     goto get_char_return;
   }
 
-  /* Get the total count of characteristics in the request. This will be
-   * required to decide the size of the characteristic pointers' array
-   */
-  int char_cnt = 0;
-  char *val_ptr = val;
-  /* We do not do any error checking here and just assume that the id
-   * tag has a characteristic list which is a comma separated list
-   * of <aid>.<iid> elements
-   */
-  char *p = strsep(&val_ptr, ",");
-  while (p) {
-    char_cnt++;
-    p = strsep(&val_ptr, ",");
-  }
-
   /* Normally, it would have been fine to just go on parsing the
    * characteristics in the URL, fetch their values and prepare
    * the response. However, if there is error for any characteristic
@@ -1167,24 +961,16 @@ static int hap_http_get_characteristics(httpd_req_t *req) {
    * So, it is better to maintain a list of characteristics pointers,
    * read all the values, and only then create the response
    */
-  hap_read_data_t *read_arr =
-      hap_platform_memory_calloc(char_cnt, sizeof(hap_read_data_t));
-  if (!read_arr) {
-    httpd_resp_set_status(req, HTTPD_500);
-    httpd_resp_set_type(req, "application/hap+json");
-    snprintf(outbuf, sizeof(outbuf), "{\"status\":-70407}");
-    httpd_resp_send(req, outbuf, strlen(outbuf));
-    goto get_char_return;
-  }
-  hap_status_t *status_codes =
-      hap_platform_memory_calloc(char_cnt, sizeof(hap_status_t));
-  if (!status_codes) {
-    hap_platform_memory_free(read_arr);
-    httpd_resp_set_status(req, HTTPD_500);
-    httpd_resp_set_type(req, "application/hap+json");
-    snprintf(outbuf, sizeof(outbuf), "{\"status\":-70407}");
-    httpd_resp_send(req, outbuf, strlen(outbuf));
-    goto get_char_return;
+  if (char_cnt > HAP_GET_CHAR_STACK_IDS) {
+    read_arr = hap_platform_memory_calloc(char_cnt, sizeof(hap_read_data_t));
+    status_codes = hap_platform_memory_calloc(char_cnt, sizeof(hap_status_t));
+    if (!read_arr || !status_codes) {
+      httpd_resp_set_status(req, HTTPD_500);
+      httpd_resp_set_type(req, "application/hap+json");
+      snprintf(outbuf, sizeof(outbuf), "{\"status\":-70407}");
+      httpd_resp_send(req, outbuf, strlen(outbuf));
+      goto get_char_return;
+    }
   }
 
   ESP_MFI_DEBUG_PLAIN("Generating HTTP Response\n");
@@ -1196,23 +982,14 @@ static int hap_http_get_characteristics(httpd_req_t *req) {
   json_gen_str_start(&jstr, outbuf, sizeof(outbuf), hap_http_json_flush_chunk,
                      req);
 
-  /* Get the ids once again. Not checking for success since that
-   * would be redundant
+  /* Decode the AIDs and IIDs in the "id" field again, which has already been
+   * validated, and fetch the characteristic pointer for each
    */
-  httpd_query_key_value(url_query_str, "id", val, strlen(uri) + 1);
   char_cnt = 0;
-  int aid, iid;
-  val_ptr = val;
-  /* Parse the AIDs and IIDs in the "id" field and fetch the
-   * characteristic pointer for each
-   */
-  p = strsep(&val_ptr, ".");
-  while (p) {
-    aid = atoi(p);
-    p = strsep(&val_ptr, ",");
-    iid = atoi(p);
-    p = strsep(&val_ptr, ".");
-    hap_char_t *hc = hap_acc_get_char_by_iid(hap_acc_get_by_aid(aid), iid);
+  id_ptr = query.id;
+  while (id_ptr < query.id_end) {
+    hap_parse_char_id(&id_ptr, query.id_end, &aid, &iid);
+    hap_char_t *hc = hap_get_char_by_aid_iid(aid, iid);
     if (!hc) {
       hap_set_char_report_status(&include_status, &jstr, aid, iid,
                                  HAP_STATUS_RES_ABSENT);
@@ -1312,14 +1089,14 @@ static int hap_http_get_characteristics(httpd_req_t *req) {
     if (include_status || read_err) {
       json_gen_obj_set_int(&jstr, "status", *read_arr[i].status);
     }
-    if (type)
+    if (query.type)
       hap_add_char_type(hc, &jstr);
-    if (perms)
+    if (query.perms)
       hap_add_char_perms(hc, &jstr);
-    if (ev) {
+    if (query.ev) {
       hap_add_char_ev(hc, &jstr, hap_get_ctrl_session_index(session));
     }
-    if (meta)
+    if (query.meta)
       hap_add_char_meta(hc, &jstr);
     json_gen_end_object(&jstr);
   }
@@ -1328,29 +1105,25 @@ get_char_end:
   json_gen_end_object(&jstr);
   json_gen_str_end(&jstr);
 
-  hap_platform_memory_free(read_arr);
-  hap_platform_memory_free(status_codes);
-
   /* This indicates the last chunk */
   httpd_resp_send_chunk(req, NULL, 0);
   ESP_MFI_DEBUG_PLAIN("\n");
 get_char_return:
-  if (heap_val_buf) {
-    hap_platform_memory_free(heap_val_buf);
-    ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Freed allocated buffer for GET");
-  }
-
-  if (url_query_str) {
-    hap_platform_memory_free(url_query_str);
+  if (read_arr != stack_read_arr) {
+    hap_platform_memory_free(read_arr);
+    hap_platform_memory_free(status_codes);
   }
 
   hap_report_event(HAP_EVENT_GET_CHAR_COMPLETED, NULL, 0);
   return HAP_SUCCESS;
 }
+
+HAP_METERED_HANDLER(hap_http_get_characteristics, PERF_METRICS_HAP_CHARS_GET)
+
 static struct httpd_uri hap_characteristics_get = {
     .uri = "/characteristics",
     .method = HTTP_GET,
-    .handler = hap_http_get_characteristics,
+    .handler = hap_http_get_characteristics_metered,
 };
 static struct httpd_uri hap_characteristics_put = {
     .uri = "/characteristics",
@@ -1378,10 +1151,13 @@ static int hap_http_pairings_handler(httpd_req_t *req) {
   httpd_resp_set_type(req, "application/pairing+tlv8");
   return httpd_resp_send(req, (char *)buf, outlen);
 }
+
+HAP_METERED_HANDLER(hap_http_pairings_handler, PERF_METRICS_HAP_PAIRINGS)
+
 static struct httpd_uri hap_pairings = {
     .uri = "/pairings",
     .method = HTTP_POST,
-    .handler = hap_http_pairings_handler,
+    .handler = hap_http_pairings_handler_metered,
 };
 
 static int hap_http_post_identify(httpd_req_t *req) {
@@ -1405,10 +1181,12 @@ static int hap_http_post_identify(httpd_req_t *req) {
   return HAP_SUCCESS;
 }
 
+HAP_METERED_HANDLER(hap_http_post_identify, PERF_METRICS_HAP_IDENTIFY)
+
 static struct httpd_uri hap_identify = {
     .uri = "/identify",
     .method = HTTP_POST,
-    .handler = hap_http_post_identify,
+    .handler = hap_http_post_identify_metered,
 };
 
 static int hap_http_put_prepare(httpd_req_t *req) {
@@ -1455,118 +1233,19 @@ static int hap_http_put_prepare(httpd_req_t *req) {
   return HAP_SUCCESS;
 }
 
+HAP_METERED_HANDLER(hap_http_put_prepare, PERF_METRICS_HAP_PREPARE)
+
 static struct httpd_uri hap_prepare = {
     .uri = "/prepare",
     .method = HTTP_PUT,
-    .handler = hap_http_put_prepare,
+    .handler = hap_http_put_prepare_metered,
 };
 
-static void hap_send_notification(void *arg) {
-  int num_char = hap_priv.cfg.max_event_notif_chars;
-  hap_char_t *hc;
-  hap_char_t **char_arr =
-      hap_platform_memory_calloc(num_char, sizeof(hap_char_t *));
-
-  if (!char_arr) {
-    return;
-  }
-
-  int i, num_notif_chars;
-  for (i = 0; i < num_char; i++) {
-    hc = hap_get_pending_notif_char();
-    if (hc) {
-      char_arr[i] = hc;
-    } else {
-      break;
-    }
-  }
-  /* If no characteristic notifications are pending, free char_arr and exit */
-  if (i == 0) {
-    hap_platform_memory_free(char_arr);
-    return;
-  }
-  num_notif_chars = i;
-  hap_secure_session_t *session;
-  /* Flag to indicate if any controller was connected */
-  bool ctrl_connected = false;
-  char buf[250];
-  for (i = 0; i < HAP_MAX_SESSIONS; i++) {
-    session = hap_priv.sessions[i];
-    if (!session)
-      continue;
-    ctrl_connected = true;
-    int fd = session->conn_identifier;
-#define HTTPD_HDR_STR                                                          \
-  "EVENT/1.0 200 OK\r\n"                                                       \
-  "Content-Type: application/hap+json\r\n"                                     \
-  "Content-Length: %d\r\n"
-    char notif_json[1024];
-    json_gen_str_t jstr;
-    json_gen_str_start(&jstr, notif_json, sizeof(notif_json), NULL, NULL);
-    json_gen_start_object(&jstr);
-    json_gen_push_array(&jstr, "characteristics");
-
-    int j;
-    bool notif_to_send = false;
-    for (j = 0; j < num_notif_chars; j++) {
-      hc = char_arr[j];
-      __hap_char_t *_hc = (__hap_char_t *)hc;
-      /* If the controller is the owner, dont send notification to it */
-      if (hap_char_is_ctrl_owner(hc, i)) {
-        /* Since there can be only one owner, which we are anyways skipping,
-         * we can reset owner value to 0
-         */
-        _hc->owner_ctrl = 0;
-        continue;
-      }
-      if (!hap_char_is_ctrl_subscribed(hc, i))
-        continue;
-
-      json_gen_start_object(&jstr);
-      hap_acc_t *ha = hap_serv_get_parent(hap_char_get_parent(hc));
-      int aid = ((__hap_acc_t *)ha)->aid;
-      json_gen_obj_set_int(&jstr, "aid", aid);
-      json_gen_obj_set_int(&jstr, "iid", _hc->iid);
-      hap_add_char_val_json(_hc->format, "value", &_hc->val, &jstr);
-      json_gen_end_object(&jstr);
-      notif_to_send = true;
-    }
-    if (!notif_to_send) {
-      /* No notification required for this controller. Just continue */
-      continue;
-    }
-
-    json_gen_pop_array(&jstr);
-    json_gen_end_object(&jstr);
-    json_gen_str_end(&jstr);
-
-    snprintf(buf, sizeof(buf), HTTPD_HDR_STR, strlen(notif_json));
-    hap_httpd_send(hap_priv.server, fd, buf, strlen(buf), 0);
-    /* Space for sending additional headers based on set_header */
-    hap_httpd_send(hap_priv.server, fd, "\r\n", strlen("\r\n"), 0);
-    hap_httpd_send(hap_priv.server, fd, notif_json, strlen(notif_json), 0);
-    httpd_sess_update_lru_counter(hap_priv.server, fd);
-    ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Notification Sent");
-    ESP_MFI_DEBUG_PLAIN("Socket fd: %d; Event message: %s\n", fd, notif_json);
-  }
-  /* If no controller was connected and no disconnected event was sent,
-   * reannaounce mDNS. That will increment state number as required
-   * by HAP Spec R15.
-   */
-  if (!ctrl_connected && !hap_priv.disconnected_event_sent) {
-    hap_mdns_announce(false);
-    hap_priv.disconnected_event_sent = true;
-  }
-  hap_platform_memory_free(char_arr);
-}
-
 void hap_http_debug_enable() { http_debug = true; }
 
 void hap_http_debug_disable() { http_debug = false; }
 
-void hap_http_send_notif() {
-  httpd_queue_work(hap_priv.server, hap_send_notification, NULL);
-}
+bool hap_http_debug_enabled() { return http_debug; }
 
 static bool hap_http_registered;
 int hap_register_http_handlers() {
@@ -362,9 +362,15 @@ int hap_start(void)
          return ret;
     }
 
-    ret = hap_event_queue_init();
+    ret = hap_notif_init();
     if (ret != HAP_SUCCESS) {
-        ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Queue Initialisation for Event Notifications Failed");
+        ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Initialisation for Event Notifications Failed");
+        return ret;
+    }
+
+    ret = hap_http_notif_init();
+    if (ret != HAP_SUCCESS) {
+        ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Allocation for Event Notifications Failed");
         return ret;
     }
 
@@ -399,8 +405,9 @@ int hap_stop(void)
     hap_ip_services_stop();
     hap_mdns_deinit();
     hap_loop_stop();
-    hap_event_queue_deinit();
+    hap_notif_deinit();
     hap_httpd_stop();
+    hap_http_notif_deinit();
     hap_started = false;
     ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "HAP Stopped");
     return ret;
@@ -21,6 +21,8 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *
  */
+#include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -31,10 +33,12 @@
 #include <esp_mfi_debug.h>
 #include <hap.h>
 #include <esp_hap_database.h>
+#include <esp_hap_network_io.h>
 #include <esp_hap_pair_common.h>
 #include <esp_hap_pair_verify.h>
+#include <perf_metrics.h>
+#include <perf_trace.h>
 
-#define HAP_MAX_NW_FRAME_SIZE	1024 /* As per HAP Specifications */
 #define AUTH_TAG_LEN            16
 typedef struct {
 	uint8_t pkt_size[2];
@@ -46,14 +50,6 @@ typedef struct {
 	uint8_t poly_auth_tag[AUTH_TAG_LEN];
 } hap_encrypt_frame_t;
 
-typedef struct {
-	uint16_t pkt_size;
-	uint16_t bytes_read;
-	uint8_t data[HAP_MAX_NW_FRAME_SIZE + AUTH_TAG_LEN];
-	hap_secure_session_t *session;
-} hap_decrypt_frame_t;
-
-typedef int (*hap_decrypt_read_fn_t) (uint8_t *buf, int buf_size, void *context);
 static int min(int val1, int val2)
 {
 	if (val1 < val2)
@@ -63,7 +59,10 @@ static int min(int val1, int val2)
 static int hap_httpd_raw_recv(uint8_t *buf, int buf_size, void *context)
 {
 	int sock = *((int *)context);
-	return recv(sock, buf, buf_size, 0);
+	int64_t t0 = perf_trace_begin();
+	int ret = recv(sock, buf, buf_size, 0);
+	perf_trace_end(PERF_TRACE_SOCK_RECV, t0, ret);
+	return ret;
 }
 
 /* Frame format as per HAP Specifications:
@@ -105,48 +104,67 @@ static int hap_session_error(hap_secure_session_t *session)
 	return HAP_FAIL;
 }
 
+/* Read exactly len bytes */
+static int hap_read_full(uint8_t *buf, int len, hap_decrypt_read_fn_t read_fn, void *context)
+{
+	while (len) {
+		int num_bytes = read_fn(buf, len, context);
+		if (num_bytes <= 0)
+			return HAP_FAIL;
+		buf += num_bytes;
+		len -= num_bytes;
+	}
+	return HAP_SUCCESS;
+}
+
 int hap_decrypt_data(hap_decrypt_frame_t *frame, hap_secure_session_t *session,
 	void *buf, int buf_size, hap_decrypt_read_fn_t read_fn, void *context)
 {
 	if (!frame || !session)
 		return -1;
-	if (frame->session != session) {
-		memset(frame, 0, sizeof(hap_decrypt_frame_t));
-		frame->session = session;
-	}
 	if ((frame->pkt_size - frame->bytes_read) == 0) {
-		if (read_fn(frame->data, 2, context) < 2)
+		uint8_t aad[2]; /* Packet size is the AAD for AEAD */
+		if (hap_read_full(aad, sizeof(aad), read_fn, context) != HAP_SUCCESS)
+			return hap_session_error(session);
+		uint16_t pkt_size = get_u16_le(aad);
+		if (pkt_size > HAP_MAX_NW_FRAME_SIZE) {
+			ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Invalid frame size %d", pkt_size);
 			return hap_session_error(session);
-
-		frame->pkt_size = get_u16_le(frame->data);
-		frame->bytes_read = 0;
-		uint16_t bytes_to_read = frame->pkt_size + AUTH_TAG_LEN; /* +AUTH_TAG_LEN as the receivedd packet will also have the auth Tag */
-		while (bytes_to_read) {
-			int num_bytes = read_fn(&frame->data[frame->bytes_read],
-					bytes_to_read, context);
-			if (num_bytes <= 0)
-				return hap_session_error(session);
-			bytes_to_read -= num_bytes;
-			frame->bytes_read += num_bytes;
 		}
-		frame->bytes_read -= AUTH_TAG_LEN; /* -AUTH_TAG_LEN to get only the data length */
-		uint8_t aad[2];
+		/* If the caller can take the whole frame, the ciphertext is read and decrypted
+		 * in place in the caller's buffer and frame->data only holds the auth tag.
+		 * Otherwise the frame is decrypted in frame->data and handed out in slices.
+		 */
+		bool direct = (pkt_size <= buf_size);
+		uint8_t *data = direct ? (uint8_t *)buf : frame->data;
+		uint8_t *tag = direct ? frame->data : &frame->data[pkt_size];
+		if (hap_read_full(data, pkt_size, read_fn, context) != HAP_SUCCESS ||
+				hap_read_full(tag, AUTH_TAG_LEN, read_fn, context) != HAP_SUCCESS)
+			return hap_session_error(session);
         int ret;
-		put_u16_le(aad, frame->pkt_size); /* Packet size is the AAD for AEAD */
         uint8_t newnonce[12];
         memset(newnonce, 0, sizeof newnonce);
         memcpy(newnonce+4, session->decrypt_nonce, 8);
-        ret = crypto_aead_chacha20poly1305_ietf_decrypt_detached(frame->data, NULL, frame->data, frame->pkt_size,
-                    &frame->data[frame->bytes_read], aad, 2, newnonce, session->decrypt_key);
-        if (ret != 0) { 
+        int64_t t0 = perf_trace_begin();
+        ret = crypto_aead_chacha20poly1305_ietf_decrypt_detached(data, NULL, data, pkt_size,
+                    tag, aad, 2, newnonce, session->decrypt_key);
+        perf_trace_end(PERF_TRACE_HAP_DECRYPT, t0, pkt_size);
+        if (ret != 0) {
 			ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "AEAD decryption failure");
+			perf_metrics_inc(PERF_METRICS_HAP_DECRYPT_FAILURES);
 			return hap_session_error(session);
 		}
-		frame->bytes_read = 0;
 		/* Increment nonce after every frame */
 		int64_t int_nonce = get_u64_le(session->decrypt_nonce);
 		int_nonce++;
 		put_u64_le(session->decrypt_nonce, int_nonce);
+		if (direct) {
+			frame->pkt_size = 0;
+			frame->bytes_read = 0;
+			return pkt_size;
+		}
+		frame->pkt_size = pkt_size;
+		frame->bytes_read = 0;
 	}
 	int bytes = min(frame->pkt_size - frame->bytes_read, buf_size);
 	memcpy(buf, &frame->data[frame->bytes_read], bytes);
@@ -154,37 +172,179 @@ int hap_decrypt_data(hap_decrypt_frame_t *frame, hap_secure_session_t *session,
 	return bytes;
 }
 
+/* Up to this many sealed frames go out in a single sendmsg() */
+#define HAP_TX_MAX_FRAMES	2
+
+/* Outgoing frames are sealed into a fixed set of frame buffers that sendmsg() writes
+ * from directly. Whole frames are encrypted straight from the caller's buffer; only
+ * small writes to a corked socket are gathered in the open frame first, so that a
+ * response or event made of several writes leaves as one frame in one socket write.
+ * All HAP sends happen in the httpd task, hence a single writer.
+ */
+typedef struct {
+	int fd;				/* -1 when nothing is corked */
+	hap_secure_session_t *session;
+	int num_frames;			/* frames in use */
+	bool open;			/* last frame still takes plaintext */
+	int fill;			/* plaintext bytes in the open frame */
+	int wire_len[HAP_TX_MAX_FRAMES];	/* bytes on the wire of each sealed frame */
+	hap_encrypt_frame_t frames[HAP_TX_MAX_FRAMES];
+} hap_frame_writer_t;
+
+static hap_frame_writer_t hap_tx = { .fd = -1 };
+
+static int hap_sendmsg_all(int sockfd, struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = iovcnt,
+	};
+	while (msg.msg_iovlen) {
+		int sent = sendmsg(sockfd, &msg, 0);
+		if (sent <= 0)
+			return HAP_FAIL;
+		perf_metrics_inc(PERF_METRICS_HAP_SOCKET_WRITES);
+		/* Skip what was written, in case of a partial write */
+		while (msg.msg_iovlen && (size_t)sent >= msg.msg_iov->iov_len) {
+			sent -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen) {
+			msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + sent;
+			msg.msg_iov->iov_len -= sent;
+		}
+	}
+	return HAP_SUCCESS;
+}
+
+static void hap_tx_seal_open_frame(void)
+{
+	int last = hap_tx.num_frames - 1;
+	hap_encrypt_frame_t *frame = &hap_tx.frames[last];
+	if (hap_tx.fill == 0) {
+		hap_tx.num_frames--; /* nothing was written to it */
+	} else {
+		hap_tx.wire_len[last] = hap_encrypt_data(frame, hap_tx.session, frame->data, hap_tx.fill);
+	}
+	hap_tx.open = false;
+}
+
+/* Seal the open frame and send all frames with one scatter-gather write */
+static int hap_tx_flush(void)
+{
+	struct iovec iov[HAP_TX_MAX_FRAMES];
+	if (hap_tx.open)
+		hap_tx_seal_open_frame();
+	int iovcnt = hap_tx.num_frames;
+	for (int i = 0; i < iovcnt; i++) {
+		iov[i].iov_base = &hap_tx.frames[i];
+		iov[i].iov_len = hap_tx.wire_len[i];
+	}
+	hap_tx.num_frames = 0;
+	if (iovcnt == 0)
+		return HAP_SUCCESS;
+	perf_metrics_add(PERF_METRICS_HAP_FRAMES_SENT, iovcnt);
+	return hap_sendmsg_all(hap_tx.fd, iov, iovcnt);
+}
+
+/* Add plaintext to the writer. With last set no further writes follow before the
+ * flush, so a short tail can also be encrypted directly instead of being gathered.
+ */
+static int hap_tx_append(const uint8_t *buf, int len, bool last)
+{
+	while (len) {
+		if (!hap_tx.open || hap_tx.fill == HAP_MAX_NW_FRAME_SIZE) {
+			if (hap_tx.open)
+				hap_tx_seal_open_frame();
+			if (hap_tx.num_frames == HAP_TX_MAX_FRAMES && hap_tx_flush() != HAP_SUCCESS)
+				return HAP_FAIL;
+			hap_tx.num_frames++;
+			hap_tx.open = true;
+			hap_tx.fill = 0;
+		}
+		int cur = hap_tx.num_frames - 1;
+		hap_encrypt_frame_t *frame = &hap_tx.frames[cur];
+		if (hap_tx.fill == 0 && (len >= HAP_MAX_NW_FRAME_SIZE || last)) {
+			int n = min(len, HAP_MAX_NW_FRAME_SIZE);
+			hap_tx.wire_len[cur] = hap_encrypt_data(frame, hap_tx.session, (uint8_t *)buf, n);
+			hap_tx.open = false;
+			buf += n;
+			len -= n;
+			continue;
+		}
+		int n = min(len, HAP_MAX_NW_FRAME_SIZE - hap_tx.fill);
+		memcpy(&frame->data[hap_tx.fill], buf, n);
+		hap_tx.fill += n;
+		buf += n;
+		len -= n;
+	}
+	return HAP_SUCCESS;
+}
+
+void hap_httpd_cork(int sockfd)
+{
+	if (hap_tx.fd == sockfd)
+		return;
+	if (hap_tx.fd >= 0)
+		hap_httpd_uncork(hap_tx.fd);
+	hap_tx.fd = sockfd;
+	hap_tx.num_frames = 0;
+	hap_tx.open = false;
+}
+
+int hap_httpd_uncork(int sockfd)
+{
+	if (hap_tx.fd != sockfd)
+		return HAP_SUCCESS;
+	int ret = hap_tx_flush();
+	hap_tx.fd = -1;
+	if (ret != HAP_SUCCESS) {
+		/* The handler has already returned, so httpd will not see the error */
+		ESP_MFI_DEBUG(ESP_MFI_DEBUG_ERR, "Failed to flush frames on socket %d", sockfd);
+		httpd_sess_trigger_close(hap_priv.server, sockfd);
+	}
+	return ret;
+}
+
 int hap_httpd_send(httpd_handle_t hd, int sockfd, const char *buf, unsigned buf_len, int flags)
 {
 	hap_secure_session_t *session = httpd_sess_get_ctx(hap_priv.server, sockfd);
 	if (session && (session->state == STATE_VERIFIED)) {
-		uint8_t *buf_ptr = (uint8_t *)buf;
-		int tmp_buf_len = buf_len;
-		while (tmp_buf_len) {
-			hap_encrypt_frame_t encrypt_frame;
-			memset(&encrypt_frame, 0, sizeof(encrypt_frame));
-			int len = min(tmp_buf_len, HAP_MAX_NW_FRAME_SIZE);
-			int send_len = hap_encrypt_data(&encrypt_frame, session, buf_ptr, len);
-			if (send(sockfd, (uint8_t *)&encrypt_frame, send_len, flags) <= 0)
-				return HAP_FAIL;
-			tmp_buf_len -= len;
-			buf_ptr += len;
+		bool corked = (hap_tx.fd == sockfd);
+		if (!corked)
+			hap_httpd_cork(sockfd);
+		hap_tx.session = session;
+		int ret = hap_tx_append((const uint8_t *)buf, buf_len, !corked);
+		if (!corked && ret == HAP_SUCCESS) {
+			ret = hap_tx_flush();
+			hap_tx.fd = -1;
+		}
+		if (ret != HAP_SUCCESS) {
+			hap_tx.fd = -1;
+			return HAP_FAIL;
 		}
 		/* Return the total length at the end since this API expects so
 		 */
+		perf_metrics_add(PERF_METRICS_HAP_BYTES_SENT, buf_len);
 		return buf_len;
 	}
-	return send(sockfd, buf, buf_len, flags);
+	int ret = send(sockfd, buf, buf_len, flags);
+	if (ret > 0)
+		perf_metrics_add(PERF_METRICS_HAP_BYTES_SENT, ret);
+	return ret;
 }
 
 int hap_httpd_recv(httpd_handle_t hd, int sockfd, char *buf, unsigned buf_len, int flags)
 {
-	static hap_decrypt_frame_t decrypt_frame;
 	hap_secure_session_t *session = httpd_sess_get_ctx(hap_priv.server, sockfd);
 	if (session) {
 		if (session->state == STATE_VERIFIED) {
-			return hap_decrypt_data(&decrypt_frame, session, buf, buf_len,
+			int ret = hap_decrypt_data(&session->rx_frame, session, buf, buf_len,
 					hap_httpd_raw_recv, &sockfd);
+			if (ret > 0)
+				perf_metrics_add(PERF_METRICS_HAP_BYTES_RECEIVED, ret);
+			return ret;
 		} else {
 			/* If the session state is invalid, we return an error.
 			 * The errno is set here explicitly, so that even if the higher layers
@@ -195,5 +355,10 @@ int hap_httpd_recv(httpd_handle_t hd, int sockfd, char *buf, unsigned buf_len, i
 			return HAP_FAIL;
 		}
 	}
-	return recv(sockfd, buf, buf_len, sockfd);
+	int64_t t0 = perf_trace_begin();
+	int ret = recv(sockfd, buf, buf_len, sockfd);
+	perf_trace_end(PERF_TRACE_SOCK_RECV, t0, ret);
+	if (ret > 0)
+		perf_metrics_add(PERF_METRICS_HAP_BYTES_RECEIVED, ret);
+	return ret;
 }
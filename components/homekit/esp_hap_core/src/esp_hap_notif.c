@@ -0,0 +1,265 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on ESPRESSIF SYSTEMS products only, in
+ * which case, it is free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <esp_hap_acc.h>
+#include <esp_hap_acc_db.h>
+#include <esp_hap_char.h>
+#include <esp_hap_database.h>
+#include <esp_hap_ip_services.h>
+#include <esp_hap_main.h>
+#include <esp_hap_network_io.h>
+#include <esp_hap_serv.h>
+#include <esp_http_server.h>
+#include <esp_mfi_debug.h>
+#include <esp_timer.h>
+#include <hap_platform_httpd.h>
+#include <hap_platform_memory.h>
+#include <json_generator.h>
+#include <perf_metrics.h>
+#include <perf_trace.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ESP_MFI_DEBUG_ENABLE
+#define ESP_MFI_DEBUG_PLAIN(fmt, ...)                                          \
+  if (hap_http_debug_enabled()) {                                              \
+    printf("\e[1;35m" fmt "\e[0m", ##__VA_ARGS__);                             \
+  }
+#else /* ESP_MFI_DEBUG_ENABLE */
+#define ESP_MFI_DEBUG_PLAIN(fmt, ...)
+#endif /* ESP_MFI_DEBUG_ENABLE */
+
+#define HTTPD_HDR_STR                                                          \
+  "EVENT/1.0 200 OK\r\n"                                                       \
+  "Content-Type: application/hap+json\r\n"                                     \
+  "Content-Length: %d\r\n"                                                     \
+  "\r\n"
+/* Room reserved in front of the event body for the header above */
+#define HAP_NOTIF_HDR_MAX 96
+#define HAP_NOTIF_BODY_MAX 1024
+
+/* Buffers for hap_send_notification(), allocated once by
+ * hap_http_notif_init(), so that sending events does not touch the heap.
+ * Only used from the HTTP server task.
+ */
+static struct {
+  hap_char_t **chars;
+  /* Bitmask of the sessions that should be notified of each characteristic */
+  uint16_t *recipients;
+  int num_chars;
+  /* Header and body of an event message, back to back */
+  char *msg;
+} hap_notif_arena;
+
+int hap_http_notif_init() {
+  int num_chars = hap_priv.cfg.max_event_notif_chars;
+  hap_notif_arena.chars =
+      hap_platform_memory_calloc(num_chars, sizeof(hap_char_t *));
+  hap_notif_arena.recipients =
+      hap_platform_memory_calloc(num_chars, sizeof(uint16_t));
+  hap_notif_arena.msg =
+      hap_platform_memory_malloc(HAP_NOTIF_HDR_MAX + HAP_NOTIF_BODY_MAX);
+  if (!hap_notif_arena.chars || !hap_notif_arena.recipients ||
+      !hap_notif_arena.msg) {
+    hap_http_notif_deinit();
+    return HAP_FAIL;
+  }
+  hap_notif_arena.num_chars = num_chars;
+  return HAP_SUCCESS;
+}
+
+void hap_http_notif_deinit() {
+  hap_platform_memory_free(hap_notif_arena.chars);
+  hap_platform_memory_free(hap_notif_arena.recipients);
+  hap_platform_memory_free(hap_notif_arena.msg);
+  memset(&hap_notif_arena, 0, sizeof(hap_notif_arena));
+}
+
+static void hap_send_notification(void *arg) {
+  int num_char = hap_notif_arena.num_chars;
+  hap_char_t *hc = NULL;
+  hap_char_t **char_arr = hap_notif_arena.chars;
+  uint16_t *recipients = hap_notif_arena.recipients;
+
+  if (!num_char) {
+    return;
+  }
+
+  /* Sessions still within their minimum interval since the last event */
+  int64_t now = esp_timer_get_time();
+  int64_t min_interval = (int64_t)hap_priv.cfg.notif_min_interval_ms * 1000;
+  int64_t next_due = 0;
+  uint16_t connected = 0;
+  uint16_t limited = 0;
+  int i;
+  for (i = 0; i < HAP_MAX_SESSIONS; i++) {
+    hap_secure_session_t *session = hap_priv.sessions[i];
+    if (!session)
+      continue;
+    connected |= 1 << i;
+    int64_t due = session->last_event_time + min_interval;
+    if (session->last_event_time && due > now) {
+      limited |= 1 << i;
+      if (!next_due || due < next_due) {
+        next_due = due;
+      }
+    }
+  }
+
+  /* Pick the changed characteristics, and the ones with deferred sessions
+   * that are no longer limited
+   */
+  int num_notif_chars = 0;
+  bool held_back = false;
+  bool more = false;
+  while ((hc = hap_get_next_notif_char(hc))) {
+    __hap_char_t *_hc = (__hap_char_t *)hc;
+    if (!__atomic_load_n(&_hc->notif_dirty, __ATOMIC_ACQUIRE) &&
+        !(_hc->notif_deferred & ~limited)) {
+      held_back = true;
+      continue;
+    }
+    if (num_notif_chars == num_char) {
+      more = true;
+      break;
+    }
+    char_arr[num_notif_chars++] = hc;
+  }
+  /* If no characteristic notifications are due, just exit */
+  if (num_notif_chars == 0) {
+    if (held_back && next_due) {
+      hap_schedule_notif((next_due - now + 999) / 1000);
+    }
+    return;
+  }
+
+  /* Sessions that subscribed to the characteristics, except the one that
+   * caused the change, since it does not need to be notified.
+   * Limited sessions get the value in a later round.
+   */
+  uint16_t notify = 0;
+  uint16_t deferred = 0;
+  int j;
+  for (j = 0; j < num_notif_chars; j++) {
+    __hap_char_t *_hc = (__hap_char_t *)char_arr[j];
+    recipients[j] = _hc->notif_deferred;
+    if (__atomic_exchange_n(&_hc->notif_dirty, false, __ATOMIC_ACQ_REL)) {
+      recipients[j] |= ~_hc->owner_ctrl;
+      /* Since there can be only one owner, which we are anyways skipping,
+       * we can reset owner value to 0
+       */
+      if (_hc->owner_ctrl & connected) {
+        _hc->owner_ctrl = 0;
+      }
+    }
+    recipients[j] &= _hc->ev_ctrls & connected;
+    _hc->notif_deferred = recipients[j] & limited;
+    recipients[j] &= ~limited;
+    deferred |= _hc->notif_deferred;
+    notify |= recipients[j];
+  }
+  if (deferred) {
+    perf_metrics_add(PERF_METRICS_HAP_EVENTS_DEFERRED,
+                     __builtin_popcount(deferred));
+    held_back = true;
+  }
+
+  char *body = hap_notif_arena.msg + HAP_NOTIF_HDR_MAX;
+  uint16_t done = 0;
+  for (i = 0; i < HAP_MAX_SESSIONS; i++) {
+    if (!(notify & ~done & (1 << i)))
+      continue;
+
+    /* Sessions with the same subscriptions share the event body */
+    uint16_t group =
+        hap_notif_group(recipients, num_notif_chars, notify & ~done, i);
+    done |= group;
+
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, body, HAP_NOTIF_BODY_MAX, NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_push_array(&jstr, "characteristics");
+    for (j = 0; j < num_notif_chars; j++) {
+      if (!(recipients[j] & (1 << i)))
+        continue;
+      __hap_char_t *_hc = (__hap_char_t *)char_arr[j];
+      json_gen_start_object(&jstr);
+      hap_acc_t *ha = hap_serv_get_parent(hap_char_get_parent(char_arr[j]));
+      int aid = ((__hap_acc_t *)ha)->aid;
+      json_gen_obj_set_int(&jstr, "aid", aid);
+      json_gen_obj_set_int(&jstr, "iid", _hc->iid);
+      hap_add_char_val_json(_hc->format, "value", &_hc->val, &jstr);
+      json_gen_end_object(&jstr);
+    }
+    json_gen_pop_array(&jstr);
+    json_gen_end_object(&jstr);
+    /* The writer knows how much it wrote; end() clears its state */
+    int body_len = jstr.free_ptr - body;
+    json_gen_str_end(&jstr);
+    /* Render the header right in front of the body */
+    int hdr_len = snprintf(hap_notif_arena.msg, HAP_NOTIF_HDR_MAX,
+                           HTTPD_HDR_STR, body_len);
+    char *msg = memmove(body - hdr_len, hap_notif_arena.msg, hdr_len);
+    int msg_len = hdr_len + body_len;
+
+    int k;
+    for (k = i; k < HAP_MAX_SESSIONS; k++) {
+      if (!(group & (1 << k)))
+        continue;
+      int fd = hap_priv.sessions[k]->conn_identifier;
+      int64_t send_start = perf_trace_begin();
+      int64_t metrics_start = perf_metrics_begin();
+      /* The frames of the message leave in one segment */
+      hap_httpd_cork(fd);
+      hap_httpd_send(hap_priv.server, fd, msg, msg_len, 0);
+      hap_httpd_uncork(fd);
+      perf_trace_end(PERF_TRACE_NOTIFY_SEND, send_start, fd);
+      perf_metrics_observe_since(PERF_METRICS_HAP_NOTIFY_SEND, metrics_start);
+      httpd_sess_update_lru_counter(hap_priv.server, fd);
+      hap_priv.sessions[k]->last_event_time = now;
+      perf_metrics_inc(PERF_METRICS_HAP_EVENTS_SENT);
+      ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "Notification Sent");
+      ESP_MFI_DEBUG_PLAIN("Socket fd: %d; Event message: %s\n", fd, body);
+    }
+  }
+  /* If no controller was connected and no disconnected event was sent,
+   * reannaounce mDNS. That will increment state number as required
+   * by HAP Spec R15.
+   */
+  if (!connected && !hap_priv.disconnected_event_sent) {
+    hap_mdns_announce(false);
+    hap_priv.disconnected_event_sent = true;
+  }
+  if (more) {
+    hap_schedule_notif(0);
+  } else if (held_back && next_due) {
+    hap_schedule_notif((next_due - now + 999) / 1000);
+  }
+}
+
+void hap_http_send_notif() {
+  httpd_queue_work(hap_priv.server, hap_send_notification, NULL);
+}
@@ -38,6 +38,7 @@
 #include <hexdump.h>
 #include <esp_mfi_debug.h>
 #include <esp_mfi_rand.h>
+#include <perf_metrics.h>
 
 #define PAIR_VERIFY_ENCRYPT_SALT	"Pair-Verify-Encrypt-Salt"
 #define PAIR_VERIFY_ENCRYPT_INFO	"Pair-Verify-Encrypt-Info"
@@ -152,6 +153,7 @@ void hap_free_session(void *session)
 			/* Disable all characteristic notifications on this session */
 			hap_disable_all_char_notif(i);
 			hap_priv.sessions[i] = NULL;
+			perf_metrics_inc(PERF_METRICS_HAP_SESSIONS_CLOSED);
 			ESP_MFI_DEBUG(ESP_MFI_DEBUG_INFO, "HomeKit Session terminated");
 			break;
 		}
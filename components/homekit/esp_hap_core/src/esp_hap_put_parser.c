@@ -0,0 +1,271 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on ESPRESSIF SYSTEMS products only, in
+ * which case, it is free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include <esp_hap_put_parser.h>
+#include <hap.h>
+#include <hap_platform_memory.h>
+#include <stdlib.h>
+#include <string.h>
+
+void hap_put_str_free(hap_put_str_t *s) {
+  if (s->buf != s->local)
+    hap_platform_memory_free(s->buf);
+  hap_put_str_init(s);
+}
+
+bool hap_put_str_grow(hap_put_str_t *s) {
+  char *buf = hap_platform_memory_malloc(s->cap * 2);
+  if (!buf)
+    return false;
+  memcpy(buf, s->buf, s->len);
+  if (s->buf != s->local)
+    hap_platform_memory_free(s->buf);
+  s->buf = buf;
+  s->cap *= 2;
+  return true;
+}
+
+char *hap_put_str_detach(hap_put_str_t *s) {
+  char *buf = s->buf;
+  if (buf == s->local) {
+    buf = hap_platform_memory_malloc(s->len + 1);
+    if (buf)
+      memcpy(buf, s->local, s->len + 1);
+  }
+  hap_put_str_init(s);
+  return buf;
+}
+
+static int hap_put_hex(int c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/* Reads a JSON string, decoding its escapes. s may be NULL to skip it */
+bool hap_put_read_str(hap_put_reader_t *r, hap_put_str_t *s) {
+  if (hap_put_next(r) != '"')
+    return false;
+  while (true) {
+    int c = hap_put_next(r);
+    if (c < 0)
+      return false;
+    if (c == '"')
+      return true;
+    if (c == '\\') {
+      c = hap_put_next(r);
+      switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u': {
+        unsigned int cp = 0;
+        for (int i = 0; i < 4; i++) {
+          int h = hap_put_hex(hap_put_next(r));
+          if (h < 0)
+            return false;
+          cp = (cp << 4) | h;
+        }
+        if (!s)
+          continue;
+        /* Encoded as UTF-8. Surrogate pairs are not combined. */
+        bool ok;
+        if (cp < 0x80) {
+          ok = hap_put_str_push(s, cp);
+        } else if (cp < 0x800) {
+          ok = hap_put_str_push(s, 0xc0 | (cp >> 6)) &&
+               hap_put_str_push(s, 0x80 | (cp & 0x3f));
+        } else {
+          ok = hap_put_str_push(s, 0xe0 | (cp >> 12)) &&
+               hap_put_str_push(s, 0x80 | ((cp >> 6) & 0x3f)) &&
+               hap_put_str_push(s, 0x80 | (cp & 0x3f));
+        }
+        if (!ok)
+          return false;
+        continue;
+      }
+      default:
+        return false;
+      }
+    }
+    if (s && !hap_put_str_push(s, c))
+      return false;
+  }
+}
+
+/* Reads a number or a literal. A token too long for buf leaves it empty, so
+ * that it is treated as an invalid value rather than a malformed body.
+ */
+bool hap_put_read_prim(hap_put_reader_t *r, char *buf, int size) {
+  int len = 0, c;
+  while ((c = hap_put_peek(r)) >= 0 &&
+         ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+          (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.')) {
+    if (len < size - 1)
+      buf[len] = c;
+    len++;
+    r->pos++;
+  }
+  buf[len < size ? len : 0] = '\0';
+  return len > 0;
+}
+
+bool hap_put_skip_value(hap_put_reader_t *r) {
+  char prim[8];
+  int depth = 0;
+  do {
+    int c = hap_put_skip_ws(r);
+    if (c == '"') {
+      if (!hap_put_read_str(r, NULL))
+        return false;
+    } else if (c == '{' || c == '[') {
+      r->pos++;
+      depth++;
+    } else if (depth && (c == '}' || c == ']')) {
+      r->pos++;
+      depth--;
+    } else if (depth && (c == ',' || c == ':')) {
+      r->pos++;
+    } else if (!hap_put_read_prim(r, prim, sizeof(prim))) {
+      return false;
+    }
+  } while (depth);
+  return true;
+}
+
+int hap_put_prim_bool(const char *prim, bool *val) {
+  if (!strcmp(prim, "true")) {
+    *val = true;
+  } else if (!strcmp(prim, "false")) {
+    *val = false;
+  } else {
+    return HAP_FAIL;
+  }
+  return HAP_SUCCESS;
+}
+
+int hap_put_prim_int(const char *prim, int *val) {
+  char *end;
+  long v = strtol(prim, &end, 10);
+  if (!*prim || *end)
+    return HAP_FAIL;
+  *val = (int)v;
+  return HAP_SUCCESS;
+}
+
+int hap_put_prim_float(const char *prim, float *val) {
+  char *end;
+  float v = strtof(prim, &end);
+  if (!*prim || *end)
+    return HAP_FAIL;
+  *val = v;
+  return HAP_SUCCESS;
+}
+
+
+void hap_put_char_reset(hap_put_char_t *obj) {
+  hap_put_str_free(&obj->value_str);
+  hap_put_str_free(&obj->auth);
+  obj->aid = 0;
+  obj->iid = 0;
+  obj->has_value = false;
+  obj->value_is_str = false;
+  obj->value_prim[0] = '\0';
+  obj->has_ev = false;
+  obj->has_auth = false;
+  obj->remote = false;
+  obj->response = false;
+}
+
+bool hap_put_read_char(hap_put_reader_t *r, hap_put_char_t *obj) {
+  hap_put_str_t key;
+  char prim[24];
+  bool ok = hap_put_expect(r, '{');
+
+  hap_put_str_init(&key);
+  if (ok && hap_put_skip_ws(r) != '}') {
+    do {
+      hap_put_str_free(&key);
+      ok = hap_put_skip_ws(r) == '"' && hap_put_read_str(r, &key) &&
+           hap_put_expect(r, ':');
+      if (!ok)
+        break;
+      int c = hap_put_skip_ws(r);
+      if (!strcmp(key.buf, "value")) {
+        obj->has_value = true;
+        obj->value_is_str = (c == '"');
+        obj->value_prim[0] = '\0';
+        hap_put_str_free(&obj->value_str);
+        if (c == '"')
+          ok = hap_put_read_str(r, &obj->value_str);
+        else if (c == '{' || c == '[')
+          ok = hap_put_skip_value(r);
+        else
+          ok = hap_put_read_prim(r, obj->value_prim, sizeof(obj->value_prim));
+      } else if (!strcmp(key.buf, "authData") && c == '"') {
+        obj->has_auth = true;
+        hap_put_str_free(&obj->auth);
+        ok = hap_put_read_str(r, &obj->auth);
+      } else if (c == '"' || c == '{' || c == '[') {
+        ok = hap_put_skip_value(r);
+      } else if ((ok = hap_put_read_prim(r, prim, sizeof(prim)))) {
+        if (!strcmp(key.buf, "aid")) {
+          hap_put_prim_int(prim, &obj->aid);
+        } else if (!strcmp(key.buf, "iid")) {
+          hap_put_prim_int(prim, &obj->iid);
+        } else if (!strcmp(key.buf, "ev")) {
+          obj->has_ev = (hap_put_prim_bool(prim, &obj->ev) == HAP_SUCCESS);
+        } else if (!strcmp(key.buf, "remote")) {
+          hap_put_prim_bool(prim, &obj->remote);
+        } else if (!strcmp(key.buf, "r")) {
+          hap_put_prim_bool(prim, &obj->response);
+        }
+      }
+    } while (ok && hap_put_expect(r, ','));
+  }
+  hap_put_str_free(&key);
+  return ok && hap_put_expect(r, '}');
+}
+
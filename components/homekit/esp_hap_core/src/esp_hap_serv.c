@@ -327,3 +327,26 @@ void *hap_serv_get_priv(hap_serv_t *hs)
         return NULL;
     }
 }
+
+/* Moves the writes of each service up behind the first write to that service,
+ * keeping their order otherwise, so that writes collected out of order can be
+ * handed to each service write routine in a single call
+ */
+void hap_serv_group_writes(hap_write_data_t *writes, int cnt)
+{
+    int i, j;
+    for (i = 0; i < cnt; i++) {
+        hap_serv_t *hs = hap_char_get_parent(writes[i].hc);
+        for (j = i + 1; j < cnt; j++) {
+            if (hap_char_get_parent(writes[j].hc) != hs) {
+                continue;
+            }
+            if (j != i + 1) {
+                hap_write_data_t write = writes[j];
+                memmove(&writes[i + 2], &writes[i + 1], (j - i - 1) * sizeof(hap_write_data_t));
+                writes[i + 1] = write;
+            }
+            i++;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on ESPRESSIF SYSTEMS products only, in
+ * which case, it is free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef _HAP_ACC_DB_H_
+#define _HAP_ACC_DB_H_
+#include <esp_err.h>
+#include <esp_hap_char.h>
+#include <json_generator.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Characteristic members, shared with GET /characteristics and events */
+int hap_add_char_val_json(hap_char_format_t format, char *key, hap_val_t *val,
+                          json_gen_str_t *jptr);
+int hap_add_char_type(__hap_char_t *hc, json_gen_str_t *jptr);
+int hap_add_char_meta(__hap_char_t *hc, json_gen_str_t *jptr);
+int hap_add_char_perms(__hap_char_t *hc, json_gen_str_t *jptr);
+int hap_add_char_ev(__hap_char_t *hc, json_gen_str_t *jptr,
+                    uint8_t session_index);
+
+/* Sends a chunk of the accessory database. An error stops the response. */
+typedef esp_err_t (*hap_acc_db_send_t)(const char *buf, size_t len,
+                                       void *priv);
+
+/* Writes the accessory database (the GET /accessories body) for the
+ * controller of session_index, in chunks of up to 1024 bytes. The cached part
+ * is regenerated first if the accessory configuration changed.
+ * Not thread safe: only call from the httpd task.
+ */
+int hap_acc_db_send(int session_index, hap_acc_db_send_t send, void *priv);
+
+#endif /* _HAP_ACC_DB_H_ */
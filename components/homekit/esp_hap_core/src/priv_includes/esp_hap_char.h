@@ -81,6 +81,16 @@ typedef struct  {
     uint8_t *valid_vals;
     size_t valid_vals_cnt;
     bool update_called;
+    /* Bytes allocated for val.s, which is overwritten in place when it fits */
+    size_t str_cap;
+    /* Hash of the DATA/TLV8 value, to tell whether an update changed it */
+    uint32_t data_hash;
+    /* Private data set by the application with hap_char_set_priv() */
+    void *priv;
+    /* Set on a value change, cleared when the notification is prepared */
+    bool notif_dirty;
+    /* Sessions still owed the current value, held back by the rate limit */
+    uint16_t notif_deferred;
 } __hap_char_t;
 
 void hap_char_manage_notification(hap_char_t *hc, int index, bool ev);
@@ -89,9 +99,11 @@ void hap_char_set_owner_ctrl(hap_char_t *hc, int index);
 bool hap_char_is_ctrl_owner(hap_char_t *hc, int index);
 void hap_disable_all_char_notif(int index);
 int hap_char_check_val_constraints(__hap_char_t *_hc, hap_val_t *val);
-int hap_event_queue_init();
-int hap_event_queue_deinit();
-hap_char_t * hap_get_pending_notif_char();
+int hap_notif_init();
+int hap_notif_deinit();
+void hap_schedule_notif(uint32_t delay_ms);
+hap_char_t *hap_get_next_notif_char(hap_char_t *hc);
+uint16_t hap_notif_group(const uint16_t *recipients, int num_chars, uint16_t pending, int first);
 #ifdef __cplusplus
 }
 #endif
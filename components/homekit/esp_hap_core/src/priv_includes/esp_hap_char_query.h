@@ -0,0 +1,55 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on ESPRESSIF SYSTEMS products only, in
+ * which case, it is free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef _HAP_CHAR_QUERY_H_
+#define _HAP_CHAR_QUERY_H_
+#include <stdbool.h>
+
+/* Parsed query of GET /characteristics. The id list is not copied: it points
+ * into the request URI and is decoded in place.
+ */
+typedef struct {
+  const char *id;
+  const char *id_end;
+  bool meta;
+  bool perms;
+  bool type;
+  bool ev;
+} hap_char_query_t;
+
+/* Walks the query string of the URI once, picking up the "id" list and the
+ * optional meta/perms/type/ev flags. Returns HAP_FAIL if there is no id list.
+ */
+int hap_parse_char_query(const char *uri, hap_char_query_t *q);
+
+/* Decodes a positive decimal number of at most 9 digits, advancing *pos */
+bool hap_parse_char_id_num(const char **pos, const char *end, int *num);
+
+/* Decodes the next "<aid>.<iid>" element of the id list, advancing *pos past
+ * it and the following comma, if any.
+ */
+bool hap_parse_char_id(const char **pos, const char *end, int *aid, int *iid);
+
+#endif /* _HAP_CHAR_QUERY_H_ */
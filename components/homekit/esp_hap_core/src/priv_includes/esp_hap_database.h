@@ -48,6 +48,7 @@
 typedef struct {
     hap_acc_cfg_t primary_acc;
     uint32_t config_num;
+    uint32_t acc_db_gen; /* Bumped whenever accessories are added or removed */
     uint32_t cur_aid;
     uint8_t raw_acc_id[6];
 	char acc_id[HAP_ACC_ID_LEN];
@@ -34,4 +34,7 @@ int hap_ip_services_stop();
 int hap_mdns_announce(bool first);
 int hap_mdns_deannounce();
 void hap_http_send_notif();
+int hap_http_notif_init();
+void hap_http_notif_deinit();
+bool hap_http_debug_enabled();
 #endif /* _HAP_IP_SERVICES_H_ */
@@ -25,7 +25,23 @@
 #define _HAP_NETWORK_IO_H_
 #include <stdint.h>
 #include <hap_platform_httpd.h>
+#include <esp_hap_pair_common.h>
 int hap_httpd_send(httpd_handle_t hd, int sockfd, const char *buf, unsigned buf_len, int flags);
 int hap_httpd_recv(httpd_handle_t hd, int sockfd, char *buf, unsigned buf_len, int flags);
 
+/* Buffer the encrypted writes to sockfd until hap_httpd_uncork(), so that several
+ * small writes are sealed into as few HAP frames as possible and sent at once.
+ * Corking another socket flushes the current one first.
+ */
+void hap_httpd_cork(int sockfd);
+int hap_httpd_uncork(int sockfd);
+
+/* Reads up to buf_size bytes of the session's decrypted stream. read_fn supplies the
+ * raw bytes and may return fewer than asked for. A frame larger than buf_size stays
+ * in frame and is handed out by the following calls.
+ */
+typedef int (*hap_decrypt_read_fn_t) (uint8_t *buf, int buf_size, void *context);
+int hap_decrypt_data(hap_decrypt_frame_t *frame, hap_secure_session_t *session,
+	void *buf, int buf_size, hap_decrypt_read_fn_t read_fn, void *context);
+
 #endif /* _HAP_NETWORK_IO_H_ */
@@ -31,6 +31,7 @@
 #define CURVE_KEY_LEN		32
 #define ED_SIGN_LEN		64
 #define NONCE_LEN		8
+#define HAP_MAX_NW_FRAME_SIZE	1024 /* As per HAP Specifications */
 
 #define STATE_M0		0
 #define STATE_M1		1
@@ -92,6 +93,15 @@ typedef struct {
 	int curlen;
 } hap_tlv_data_t;
 
+/* Receive side of the record layer: the last frame read from the socket, decrypted
+ * in place, and how much of it has been handed to the HTTP parser so far
+ */
+typedef struct {
+	uint16_t pkt_size;
+	uint16_t bytes_read;
+	uint8_t data[HAP_MAX_NW_FRAME_SIZE + POLY_AUTHTAG_LEN];
+} hap_decrypt_frame_t;
+
 typedef struct {
 	uint8_t state;
 	uint8_t encrypt_key[ENCRYPT_KEY_LEN];
@@ -107,6 +117,12 @@ typedef struct {
 	 * Need to make this generic later.
 	 */
 	int conn_identifier;
+	/* Kept per session so that reads from several controllers can interleave
+	 * without discarding each other's partially consumed frames
+	 */
+	hap_decrypt_frame_t rx_frame;
+	/* When the last event notification was sent, for the rate limit */
+	int64_t last_event_time;
 } hap_secure_session_t;
 
 void hap_tlv_data_init(hap_tlv_data_t *tlv_data, uint8_t *buf, int buf_size);
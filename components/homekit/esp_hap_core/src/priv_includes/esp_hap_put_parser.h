@@ -0,0 +1,167 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2020 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on ESPRESSIF SYSTEMS products only, in
+ * which case, it is free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef _HAP_PUT_PARSER_H_
+#define _HAP_PUT_PARSER_H_
+#include <stdbool.h>
+
+/* Pull parser for the JSON body of PUT /characteristics. The body is pulled
+ * from a receive callback a small chunk at a time, and every characteristic
+ * object is returned as soon as its closing brace is seen, so the body is
+ * never held in full.
+ */
+#define HAP_PUT_RECV_CHUNK 128
+/* Strings up to this length (keys and most values) are parsed on stack */
+#define HAP_PUT_STR_LOCAL 32
+
+/* Receives up to len bytes of the body into buf. Returns the number of bytes
+ * received, or a value <= 0 at the end of the body or on error.
+ */
+typedef int (*hap_put_recv_t)(void *arg, char *buf, int len);
+
+typedef struct {
+  hap_put_recv_t recv;
+  void *recv_arg;
+  int pos;
+  int len;
+  bool eof;
+  char buf[HAP_PUT_RECV_CHUNK];
+} hap_put_reader_t;
+
+/* Returns the next byte of the body without consuming it, or -1 at its end */
+static inline int hap_put_peek(hap_put_reader_t *r) {
+  if (r->pos == r->len) {
+    int len = r->eof ? 0 : r->recv(r->recv_arg, r->buf, sizeof(r->buf));
+    if (len <= 0) {
+      r->eof = true;
+      return -1;
+    }
+    r->pos = 0;
+    r->len = len;
+  }
+  return (unsigned char)r->buf[r->pos];
+}
+
+static inline int hap_put_next(hap_put_reader_t *r) {
+  int c = hap_put_peek(r);
+  if (c >= 0)
+    r->pos++;
+  return c;
+}
+
+static inline int hap_put_skip_ws(hap_put_reader_t *r) {
+  int c;
+  while ((c = hap_put_peek(r)) == ' ' || c == '\t' || c == '\r' || c == '\n')
+    r->pos++;
+  return c;
+}
+
+static inline bool hap_put_expect(hap_put_reader_t *r, char ch) {
+  if (hap_put_skip_ws(r) != ch)
+    return false;
+  r->pos++;
+  return true;
+}
+
+typedef struct {
+  char *buf;
+  int len;
+  int cap;
+  char local[HAP_PUT_STR_LOCAL];
+} hap_put_str_t;
+
+static inline void hap_put_str_init(hap_put_str_t *s) {
+  s->buf = s->local;
+  s->len = 0;
+  s->cap = sizeof(s->local);
+  s->local[0] = '\0';
+}
+
+/* Doubles the capacity of the string, returns false if out of memory */
+bool hap_put_str_grow(hap_put_str_t *s);
+
+static inline bool hap_put_str_push(hap_put_str_t *s, char c) {
+  if (s->len + 1 >= s->cap && !hap_put_str_grow(s))
+    return false;
+  s->buf[s->len++] = c;
+  s->buf[s->len] = '\0';
+  return true;
+}
+
+void hap_put_str_free(hap_put_str_t *s);
+
+/* Hands the string over to the caller, to be freed with
+ * hap_platform_memory_free()
+ */
+char *hap_put_str_detach(hap_put_str_t *s);
+
+/* Reads a JSON string, decoding its escapes. s may be NULL to skip it */
+bool hap_put_read_str(hap_put_reader_t *r, hap_put_str_t *s);
+
+/* Reads a number or a literal. A token too long for buf leaves it empty, so
+ * that it is treated as an invalid value rather than a malformed body.
+ */
+bool hap_put_read_prim(hap_put_reader_t *r, char *buf, int size);
+
+/* Skips a value of any type, including nested objects and arrays */
+bool hap_put_skip_value(hap_put_reader_t *r);
+
+/* Convert a token read by hap_put_read_prim(), returning HAP_SUCCESS or
+ * HAP_FAIL
+ */
+int hap_put_prim_bool(const char *prim, bool *val);
+int hap_put_prim_int(const char *prim, int *val);
+int hap_put_prim_float(const char *prim, float *val);
+
+/* One characteristic object of the request. Keys can come in any order, so
+ * the value is kept as text until the characteristic, and so its format, is
+ * known.
+ */
+typedef struct {
+  int aid;
+  int iid;
+  bool has_value;
+  bool value_is_str;
+  char value_prim[24];
+  hap_put_str_t value_str;
+  bool has_ev;
+  bool ev;
+  bool has_auth;
+  hap_put_str_t auth;
+  bool remote;
+  bool response;
+} hap_put_char_t;
+
+/* Frees the strings of obj and clears it for the next object. Both strings
+ * must have been initialised with hap_put_str_init() before the first call.
+ */
+void hap_put_char_reset(hap_put_char_t *obj);
+
+/* Reads one characteristic object into a reset obj. Returns false if the body
+ * is malformed or out of memory.
+ */
+bool hap_put_read_char(hap_put_reader_t *r, hap_put_char_t *obj);
+
+#endif /* _HAP_PUT_PARSER_H_ */
@@ -73,6 +73,7 @@ hap_char_t *hap_serv_get_char_by_iid(hap_serv_t *hs, int32_t iid);
 hap_serv_t *hap_serv_create(char *type_uuid);
 void hap_serv_delete(hap_serv_t *hs);
 int hap_serv_add_char(hap_serv_t *hs, hap_char_t *hc);
+void hap_serv_group_writes(hap_write_data_t *writes, int cnt);
 #ifdef __cplusplus
 }
 #endif
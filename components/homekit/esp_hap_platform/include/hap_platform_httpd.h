@@ -130,6 +130,17 @@ int hap_platform_httpd_get_content_len(httpd_req_t *req);
  */
 httpd_handle_t *hap_platform_httpd_get_handle();
 
+/** Set the socket close callback
+ *
+ * If an application registers endpoints on the HomeKit HTTPD and keeps per-socket state,
+ * this API can be used to learn when a socket goes away, without using the session
+ * context (which belongs to HomeKit). The callback runs in the HTTPD task just before
+ * the socket is closed and must not close it itself.
+ *
+ * @param[in] cb Callback receiving the server handle and socket fd, or NULL to remove it.
+ */
+void hap_platform_httpd_set_close_cb(httpd_close_func_t cb);
+
 #ifdef __cplusplus
 }
 #endif
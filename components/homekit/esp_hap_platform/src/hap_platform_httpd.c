@@ -22,8 +22,26 @@
  *
  */
 #include <esp_http_server.h>
+#include <unistd.h>
+#include <hap_platform_httpd.h>
 
 httpd_handle_t *int_handle;
+static httpd_close_func_t close_cb;
+
+static void hap_platform_httpd_close_fn(httpd_handle_t hd, int sockfd)
+{
+    httpd_close_func_t cb = close_cb;
+    if (cb) {
+        cb(hd, sockfd);
+    }
+    close(sockfd);
+}
+
+void hap_platform_httpd_set_close_cb(httpd_close_func_t cb)
+{
+    close_cb = cb;
+}
+
 int hap_platform_httpd_start(httpd_handle_t *handle)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
@@ -38,6 +56,7 @@ int hap_platform_httpd_start(httpd_handle_t *handle)
     config.lru_purge_enable   = true;
     config.recv_wait_timeout  = 5;
     config.send_wait_timeout  = 5;
+    config.close_fn           = hap_platform_httpd_close_fn;
 
     esp_err_t err =  httpd_start(handle, &config);
     if (err == ESP_OK) {
@@ -0,0 +1,127 @@
+#include "esp_log.h"
+#include "fan_gpio.h"
+#include "homekit.h"
+#include "host_http.h"
+#include "nvs_flash.h"
+#include "web_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// 风扇 REST 接口的压测工具：1、4、8 个并发客户端各自用长连接循环发送请求，统计每秒请求数和
+// 延迟分位数。默认在进程内启动 start_http_server()（与 esp32fan_host 相同的处理函数和 httpd 配置），
+// 也可以用 --port 指向已经运行的 esp32fan_host。请求组合：十个里八个 /api/status，
+// 一个 /api/on?level=N，一个 /api/off。
+// 连接数超过 CONFIG_FAN_HTTP_MAX_OPEN_SOCKETS 时服务器按 LRU 关闭旧连接，客户端重新连接并计数。
+// 用法: fan_loadgen [--port 8080] [--seconds 3]
+
+typedef struct {
+  std::vector<double> lat_us;
+  uint64_t reconnects;
+  uint64_t errors;
+} client_stats_t;
+
+static const char *request_path(uint64_t i) {
+  static const char *levels[] = {"/api/on?level=1", "/api/on?level=2", "/api/on?level=3"};
+  switch (i % 10) {
+  case 4:
+    return levels[(i / 10) % 3];
+  case 9:
+    return "/api/off";
+  default:
+    return "/api/status";
+  }
+}
+
+static void run_client(int port, int id, std::chrono::steady_clock::time_point deadline,
+                       client_stats_t *stats) {
+  http_conn_t c = {-1, ""};
+  http_resp_t resp;
+  for (uint64_t i = id; std::chrono::steady_clock::now() < deadline; i++) {
+    if (c.fd < 0) {
+      if (!http_connect(&c, port)) {
+        stats->errors++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    if (!http_get(&c, request_path(i), &resp)) {
+      // 连接被服务器回收，重新连接后重发
+      http_close(&c);
+      stats->reconnects++;
+      continue;
+    }
+    stats->lat_us.push_back(
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    if (resp.status != 200) {
+      stats->errors++;
+    }
+  }
+  http_close(&c);
+}
+
+static void run_level(int port, int clients, double seconds) {
+  std::vector<client_stats_t> stats(clients);
+  std::vector<std::thread> threads;
+  auto t0 = std::chrono::steady_clock::now();
+  auto deadline = t0 + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(seconds));
+  for (int k = 0; k < clients; k++) {
+    threads.emplace_back(run_client, port, k, deadline, &stats[k]);
+  }
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  std::vector<double> lat;
+  uint64_t reconnects = 0, errors = 0;
+  for (const client_stats_t &s : stats) {
+    lat.insert(lat.end(), s.lat_us.begin(), s.lat_us.end());
+    reconnects += s.reconnects;
+    errors += s.errors;
+  }
+  std::sort(lat.begin(), lat.end());
+  auto pct = [&](double p) {
+    return lat.empty() ? 0.0 : lat[std::min(lat.size() - 1, (size_t)(lat.size() * p))];
+  };
+  printf("%7d %9zu %9.0f %8.0f %8.0f %8.0f %10llu %6llu\n", clients, lat.size(),
+         lat.size() / elapsed, pct(0.5), pct(0.99), lat.empty() ? 0.0 : lat.back(),
+         (unsigned long long)reconnects, (unsigned long long)errors);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [--port <port>] [--seconds <s>]\n", prog);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int port = 0;
+  double seconds = 3;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (!port) {
+    esp_log_level_set("*", ESP_LOG_WARN);
+    nvs_flash_init();
+    fan_gpio_init();
+    homekit_init();
+    start_http_server();
+    port = CONFIG_FAN_HTTP_PORT;
+    printf("in-process server on port %d, max %d open sockets\n", port,
+           CONFIG_FAN_HTTP_MAX_OPEN_SOCKETS);
+  }
+  printf("%7s %9s %9s %8s %8s %8s %10s %6s\n", "clients", "requests", "req/s", "p50 us",
+         "p99 us", "max us", "reconnects", "errors");
+  for (int clients : {1, 4, 8}) {
+    run_level(port, clients, seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,26 @@
+#include "esp_log.h"
+#include "fan_gpio.h"
+#include "homekit.h"
+#include <stddef.h>
+
+// 主机构建没有 HAP 协议栈：这里只保留 homekit.h 的接口，订阅风扇状态并打印
+// 固件中会推送给 HomeKit 的值，便于和网页/定时器路径的行为对照
+
+static const char *TAG = "homekit_host";
+
+extern "C" void homekit_fan_state_sync(bool on, int level) {
+  float speed = on ? level * 100.0f / 3 : 0.0f;
+  ESP_LOGI(TAG, "[HAP] Fan state sync: on=%d, level=%d, speed=%.2f%%", on, level, speed);
+}
+
+static void homekit_host_state_cb(const fan_state_t *state, void *arg) {
+  static bool last_on = false;
+  static int last_level = 0;
+  if (state->on != last_on || state->level != last_level) {
+    homekit_fan_state_sync(state->on, state->level);
+  }
+  last_on = state->on;
+  last_level = state->level;
+}
+
+extern "C" void homekit_init() { fan_state_subscribe(homekit_host_state_cb, NULL); }
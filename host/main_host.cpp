@@ -0,0 +1,60 @@
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "fan_gpio.h"
+#include "fan_store.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "homekit.h"
+#include "nvs_flash.h"
+#include "web_server.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 主机版入口，对应 main.cpp 的 app_main，去掉了 WiFi 配网和按钮。
+// 用法: esp32fan_host [--gpio-trace gpio.csv] [--nvs nvs.txt] [--debug]
+// Ctrl+C 相当于 esp_restart：执行关机回调（写入未提交的挡位、导出 GPIO 记录）后退出。
+
+static const char *TAG = "main_host";
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) { stop_requested = 1; }
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [--gpio-trace <file.csv>] [--nvs <file>] [--debug]\n", prog);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--gpio-trace") == 0 && i + 1 < argc) {
+      gpio_sim_set_trace_path(argv[++i]);
+    } else if (strcmp(argv[i], "--nvs") == 0 && i + 1 < argc) {
+      nvs_sim_set_path(argv[++i]);
+    } else if (strcmp(argv[i], "--debug") == 0) {
+      esp_log_level_set("*", ESP_LOG_DEBUG);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+  esp_register_shutdown_handler(gpio_sim_dump_trace); // 最后执行，记录里包含关机前的输出
+
+  nvs_flash_init();
+  fan_gpio_init();
+  homekit_init();
+  start_http_server();
+  ESP_LOGI(TAG, "fan simulator running, level=%d", getFanLevel());
+
+  while (!stop_requested) {
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+  }
+  ESP_LOGI(TAG, "stopping: %u GPIO transitions, %u NVS commits (%u merged)",
+           (unsigned)gpio_sim_transition_count(), (unsigned)fan_store_commit_count(),
+           (unsigned)fan_store_merge_count());
+  esp_restart();
+}
@@ -0,0 +1,181 @@
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include <atomic>
+#include <chrono>
+#include <malloc.h>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// 日志、esp_timer、Wi-Fi MAC、关机回调的主机实现
+
+static const auto sim_start = std::chrono::steady_clock::now();
+static esp_log_level_t log_level = ESP_LOG_INFO;
+static std::mutex log_lock;
+static std::mutex shutdown_lock;
+static std::vector<shutdown_handler_t> shutdown_handlers;
+
+int64_t esp_timer_get_time(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                               sim_start)
+      .count();
+}
+
+// 一次性定时器：到期时间向上取整到节拍，回调在模拟定时器服务线程中执行
+struct esp_timer {
+  TimerHandle_t timer;
+  esp_timer_cb_t cb;
+  void *arg;
+};
+
+static void esp_timer_sim_cb(TimerHandle_t t) {
+  esp_timer_handle_t timer = (esp_timer_handle_t)pvTimerGetTimerID(t);
+  timer->cb(timer->arg);
+}
+
+static TickType_t esp_timer_ticks(uint64_t timeout_us) {
+  uint64_t tick_us = 1000000 / configTICK_RATE_HZ;
+  uint64_t ticks = (timeout_us + tick_us - 1) / tick_us;
+  return ticks ? (TickType_t)ticks : 1;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle) {
+  if (!args || !args->callback || !out_handle) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  esp_timer_handle_t timer = new esp_timer{NULL, args->callback, args->arg};
+  timer->timer = xTimerCreate(args->name, 1, pdFALSE, timer, esp_timer_sim_cb);
+  *out_handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  if (xTimerIsTimerActive(timer->timer)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xTimerChangePeriod(timer->timer, esp_timer_ticks(timeout_us), 0);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us) {
+  if (!xTimerIsTimerActive(timer->timer)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xTimerChangePeriod(timer->timer, esp_timer_ticks(timeout_us), 0);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!xTimerIsTimerActive(timer->timer)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xTimerStop(timer->timer, 0);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  if (xTimerIsTimerActive(timer->timer)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xTimerDelete(timer->timer, 0);
+  delete timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_get_expiry_time(esp_timer_handle_t timer, uint64_t *expiry) {
+  if (!xTimerIsTimerActive(timer->timer)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  TickType_t ticks_left = xTimerGetExpiryTime(timer->timer) - xTaskGetTickCount();
+  *expiry = esp_timer_get_time() + (uint64_t)ticks_left * (1000000 / configTICK_RATE_HZ);
+  return ESP_OK;
+}
+
+void esp_rom_delay_us(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+int esp_rom_printf(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int len = vprintf(fmt, args);
+  va_end(args);
+  return len;
+}
+
+// 固定的本地管理地址，HAP 用它生成配件 ID
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]) {
+  const uint8_t sim_mac[6] = {0x02, 0x00, 0x00, 0xfa, 0x00, (uint8_t)(ifx == WIFI_IF_AP)};
+  memcpy(mac, sim_mac, sizeof(sim_mac));
+  return ESP_OK;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) { log_level = level; }
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+  if (level > log_level) {
+    return;
+  }
+  static const char letters[] = "NEWIDV";
+  va_list args;
+  va_start(args, format);
+  std::lock_guard<std::mutex> guard(log_lock);
+  fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg) {
+  return ESP_OK;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle) {
+  std::lock_guard<std::mutex> guard(shutdown_lock);
+  shutdown_handlers.push_back(handle);
+  return ESP_OK;
+}
+
+#define SIM_HEAP_SIZE (300 * 1024)
+
+static std::atomic<uint32_t> heap_min_free{SIM_HEAP_SIZE};
+
+uint32_t esp_get_free_heap_size(void) {
+  size_t used = mallinfo2().uordblks;
+  uint32_t free_size = used < SIM_HEAP_SIZE ? SIM_HEAP_SIZE - used : 0;
+  uint32_t min = heap_min_free.load();
+  while (free_size < min && !heap_min_free.compare_exchange_weak(min, free_size)) {
+  }
+  return free_size;
+}
+
+// 只反映调用 esp_get_free_heap_size 时观察到的最小值
+uint32_t esp_get_minimum_free_heap_size(void) {
+  esp_get_free_heap_size();
+  return heap_min_free.load();
+}
+
+void esp_restart(void) {
+  std::vector<shutdown_handler_t> handlers;
+  {
+    std::lock_guard<std::mutex> guard(shutdown_lock);
+    handlers.swap(shutdown_handlers);
+  }
+  // 与固件一致，后注册的先调用
+  for (auto it = handlers.rbegin(); it != handlers.rend(); ++it) {
+    (*it)();
+  }
+  fflush(stdout);
+  fflush(stderr);
+  _Exit(0);
+}
@@ -0,0 +1,305 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// FreeRTOS 模拟：任务、队列、互斥量、任务通知和软件定时器。
+// 优先级和栈大小被忽略；定时器回调和固件一样在同一个服务线程中串行执行。
+
+using sim_clock = std::chrono::steady_clock;
+
+static const sim_clock::time_point tick_origin = sim_clock::now();
+
+static sim_clock::time_point tick_to_time(TickType_t tick) {
+  return tick_origin + std::chrono::milliseconds((uint64_t)tick * 1000 / configTICK_RATE_HZ);
+}
+
+// 等待 ticks 个节拍对应的截止时间，portMAX_DELAY 表示一直等待
+template <typename Pred>
+static bool wait_ticks(std::condition_variable &cv, std::unique_lock<std::mutex> &lock,
+                       TickType_t ticks, Pred pred) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, pred);
+    return true;
+  }
+  auto deadline = sim_clock::now() + std::chrono::milliseconds((uint64_t)ticks * 1000 /
+                                                               configTICK_RATE_HZ);
+  return cv.wait_until(lock, deadline, pred);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(sim_clock::now() - tick_origin);
+  return (TickType_t)((uint64_t)ms.count() * configTICK_RATE_HZ / 1000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)ticks * 1000 /
+                                                        configTICK_RATE_HZ));
+}
+
+/* ---------------- 任务 ---------------- */
+
+struct sim_task {
+  std::string name;
+  std::mutex lock;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+  uint32_t stack_depth = 0;
+};
+
+static thread_local sim_task *current_task = NULL;
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *out) {
+  sim_task *task = new sim_task();
+  task->name = name ? name : "";
+  task->stack_depth = stack;
+  if (out) {
+    *out = task;
+  }
+  std::thread([task, fn, arg]() {
+    current_task = task;
+    fn(arg);
+  }).detach();
+  return pdPASS;
+}
+
+// 非 xTaskCreate 创建的线程（main、httpd、定时器服务）按需分配一个句柄，仅用于区分线程
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  if (!current_task) {
+    current_task = new sim_task();
+  }
+  return current_task;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return (task ? task : xTaskGetCurrentTaskHandle())->stack_depth;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // 只支持任务删除自身：线程在任务函数返回后结束，这里什么也不做
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  {
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notify++;
+  }
+  task->cv.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+  sim_task *task = current_task;
+  if (!task) {
+    return 0; // 非 xTaskCreate 创建的线程没有通知值
+  }
+  std::unique_lock<std::mutex> lock(task->lock);
+  wait_ticks(task->cv, lock, ticks, [task] { return task->notify > 0; });
+  uint32_t value = task->notify;
+  if (value > 0) {
+    task->notify = clear_on_exit ? 0 : value - 1;
+  }
+  return value;
+}
+
+/* ---------------- 队列 ---------------- */
+
+struct sim_queue {
+  size_t length;
+  size_t item_size;
+  std::deque<std::vector<uint8_t>> items;
+  std::mutex lock;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  sim_queue *q = new sim_queue();
+  q->length = length;
+  q->item_size = item_size;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!wait_ticks(q->not_full, lock, ticks, [q] { return q->items.size() < q->length; })) {
+    return pdFAIL;
+  }
+  const uint8_t *p = (const uint8_t *)item;
+  q->items.emplace_back(p, p + q->item_size);
+  lock.unlock();
+  q->not_empty.notify_one();
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *buf, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!wait_ticks(q->not_empty, lock, ticks, [q] { return !q->items.empty(); })) {
+    return pdFAIL;
+  }
+  memcpy(buf, q->items.front().data(), q->item_size);
+  q->items.pop_front();
+  lock.unlock();
+  q->not_full.notify_one();
+  return pdPASS;
+}
+
+/* ---------------- 互斥量 ---------------- */
+
+struct sim_semaphore {
+  std::mutex lock;
+  std::condition_variable cv;
+  bool taken = false;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return new sim_semaphore(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(sem->lock);
+  if (!wait_ticks(sem->cv, lock, ticks, [sem] { return !sem->taken; })) {
+    return pdFAIL;
+  }
+  sem->taken = true;
+  return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  {
+    std::lock_guard<std::mutex> guard(sem->lock);
+    sem->taken = false;
+  }
+  sem->cv.notify_one();
+  return pdPASS;
+}
+
+/* ---------------- 软件定时器 ---------------- */
+
+struct sim_timer {
+  std::string name;
+  TickType_t period;
+  bool auto_reload;
+  void *id;
+  TimerCallbackFunction_t cb;
+  bool active = false;
+  TickType_t expiry = 0;
+};
+
+// 服务线程是分离的，退出时仍在等待；这些对象故意不析构，否则 exit() 会卡在条件变量的析构里
+static std::mutex &timer_lock = *new std::mutex;
+static std::condition_variable &timer_cv = *new std::condition_variable;
+static std::vector<sim_timer *> &timers = *new std::vector<sim_timer *>;
+static bool timer_service_started = false;
+
+// 定时器服务线程：找出最早到期的定时器，到期后在锁外执行回调
+static void timer_service(void) {
+  std::unique_lock<std::mutex> lock(timer_lock);
+  while (true) {
+    sim_timer *next = NULL;
+    for (sim_timer *t : timers) {
+      if (t->active && (!next || (int32_t)(t->expiry - next->expiry) < 0)) {
+        next = t;
+      }
+    }
+    if (!next) {
+      timer_cv.wait(lock);
+      continue;
+    }
+    if ((int32_t)(xTaskGetTickCount() - next->expiry) < 0) {
+      timer_cv.wait_until(lock, tick_to_time(next->expiry));
+      continue;
+    }
+    if (next->auto_reload) {
+      next->expiry += next->period;
+    } else {
+      next->active = false;
+    }
+    TimerCallbackFunction_t cb = next->cb;
+    lock.unlock();
+    cb(next);
+    lock.lock();
+  }
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t cb) {
+  sim_timer *t = new sim_timer();
+  t->name = name ? name : "";
+  t->period = period;
+  t->auto_reload = auto_reload;
+  t->id = id;
+  t->cb = cb;
+  std::lock_guard<std::mutex> guard(timer_lock);
+  timers.push_back(t);
+  if (!timer_service_started) {
+    timer_service_started = true;
+    std::thread(timer_service).detach();
+  }
+  return t;
+}
+
+static BaseType_t timer_arm(TimerHandle_t t, TickType_t period) {
+  {
+    std::lock_guard<std::mutex> guard(timer_lock);
+    t->period = period;
+    t->expiry = xTaskGetTickCount() + period;
+    t->active = true;
+  }
+  timer_cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t t, TickType_t ticks) { return timer_arm(t, t->period); }
+
+BaseType_t xTimerChangePeriod(TimerHandle_t t, TickType_t period, TickType_t ticks) {
+  return timer_arm(t, period);
+}
+
+BaseType_t xTimerStop(TimerHandle_t t, TickType_t ticks) {
+  {
+    std::lock_guard<std::mutex> guard(timer_lock);
+    t->active = false;
+  }
+  timer_cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t t, TickType_t ticks) {
+  {
+    std::lock_guard<std::mutex> guard(timer_lock);
+    timers.erase(std::find(timers.begin(), timers.end(), t));
+  }
+  timer_cv.notify_all();
+  delete t;
+  return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t t) {
+  std::lock_guard<std::mutex> guard(timer_lock);
+  return t->active ? pdTRUE : pdFALSE;
+}
+
+TickType_t xTimerGetExpiryTime(TimerHandle_t t) {
+  std::lock_guard<std::mutex> guard(timer_lock);
+  return t->expiry;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t t) {
+  std::lock_guard<std::mutex> guard(timer_lock);
+  return t->id;
+}
+
+void vTimerSetTimerID(TimerHandle_t t, void *id) {
+  std::lock_guard<std::mutex> guard(timer_lock);
+  t->id = id;
+}
@@ -0,0 +1,106 @@
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/gpio_struct.h"
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// GPIO 模拟器：保存所有引脚的输出电平，每次电平变化记录时间戳
+
+typedef struct {
+  int64_t time_us;
+  int gpio;
+  int level;
+} gpio_sim_transition_t;
+
+static const char *TAG = "gpio_sim";
+
+gpio_dev_t GPIO = {{0, 1}, {0, 0}, {{1, 1}}, {{1, 0}}};
+
+static std::mutex gpio_lock;
+static uint64_t gpio_levels = 0;
+static uint64_t gpio_outputs = 0;
+static std::vector<gpio_sim_transition_t> gpio_trace;
+static std::string gpio_trace_path;
+
+// 调用时已持有锁
+static void gpio_sim_apply(uint64_t mask, int level) {
+  int64_t now = esp_timer_get_time();
+  uint64_t changed = level ? (mask & ~gpio_levels) : (mask & gpio_levels);
+  for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+    if (changed & (1ULL << pin)) {
+      gpio_trace.push_back({now, pin, level});
+      ESP_LOGD(TAG, "GPIO%d -> %d", pin, level);
+    }
+  }
+  if (level) {
+    gpio_levels |= mask;
+  } else {
+    gpio_levels &= ~mask;
+  }
+}
+
+esp_err_t gpio_config(const gpio_config_t *cfg) {
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  if (cfg->mode & GPIO_MODE_OUTPUT) {
+    gpio_outputs |= cfg->pin_bit_mask;
+  } else {
+    gpio_outputs &= ~cfg->pin_bit_mask;
+  }
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+  if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  gpio_sim_apply(1ULL << gpio_num, level ? 1 : 0);
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  return (gpio_levels >> gpio_num) & 1;
+}
+
+void gpio_sim_write_mask(int bank, uint32_t mask, int level) {
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  gpio_sim_apply((uint64_t)mask << (bank ? 32 : 0), level);
+}
+
+uint64_t gpio_sim_levels(void) {
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  return gpio_levels;
+}
+
+uint32_t gpio_sim_transition_count(void) {
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  return (uint32_t)gpio_trace.size();
+}
+
+void gpio_sim_set_trace_path(const char *path) {
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  gpio_trace_path = path ? path : "";
+}
+
+void gpio_sim_dump_trace(void) {
+  std::lock_guard<std::mutex> guard(gpio_lock);
+  if (gpio_trace_path.empty()) {
+    return;
+  }
+  FILE *f = fopen(gpio_trace_path.c_str(), "w");
+  if (!f) {
+    ESP_LOGE(TAG, "cannot write %s", gpio_trace_path.c_str());
+    return;
+  }
+  fprintf(f, "time_us,gpio,level\n");
+  for (const gpio_sim_transition_t &t : gpio_trace) {
+    fprintf(f, "%lld,%d,%d\n", (long long)t.time_us, t.gpio, t.level);
+  }
+  fclose(f);
+  ESP_LOGI(TAG, "%u transitions written to %s", (unsigned)gpio_trace.size(),
+           gpio_trace_path.c_str());
+}
@@ -0,0 +1,149 @@
+#include "hap_sim.h"
+#include <errno.h>
+#include <esp_hap_database.h>
+#include <esp_hap_ip_services.h>
+#include <esp_hap_keystore.h>
+#include <esp_hap_main.h>
+#include <esp_mfi_base64.h>
+#include <hap_platform_memory.h>
+#include <stdlib.h>
+
+// HAP 数据库层（配件、服务、特征）在主机上直接用固件源码构建。这里提供它依赖的其余部分：
+// 全局状态、内部事件、密钥存储、配置号、base64 编码，以及 main/homekit.cpp 调用的启动接口。
+// esp_hap_database.c 依赖 libsodium，不在主机上构建
+
+// 与 hap_database_init() 之后的状态一致：aid 1 留给主配件
+hap_priv_t hap_priv = {
+    .cur_aid = 1,
+    .cfg =
+        {
+            .max_event_notif_chars = 8,
+            .unique_param = UNIQUE_SSID,
+            .notif_coalesce_ms = 20,
+            .notif_min_interval_ms = 100,
+        },
+};
+
+static uint32_t notif_events;
+static void (*notif_handler)(void);
+static uint32_t heap_allocs;
+static uint32_t heap_fail_allocs;
+
+uint32_t hap_sim_notif_events(void) { return __atomic_load_n(&notif_events, __ATOMIC_ACQUIRE); }
+
+uint32_t hap_sim_heap_allocs(void) { return __atomic_load_n(&heap_allocs, __ATOMIC_ACQUIRE); }
+
+void hap_sim_set_notif_handler(void (*handler)(void)) { notif_handler = handler; }
+
+void hap_sim_fail_allocs(uint32_t count) {
+  __atomic_store_n(&heap_fail_allocs, count, __ATOMIC_RELEASE);
+}
+
+// 还有待注入的失败时消耗一次并返回 true
+static bool hap_sim_alloc_fails(void) {
+  uint32_t left = __atomic_load_n(&heap_fail_allocs, __ATOMIC_ACQUIRE);
+  while (left) {
+    if (__atomic_compare_exchange_n(&heap_fail_allocs, &left, left - 1, false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 固件中由 HAP 主循环处理；通知合并定时器在模拟定时器线程中调用
+int hap_send_event(hap_internal_event_t event) {
+  if (event == HAP_INTERNAL_EVENT_TRIGGER_NOTIF) {
+    __atomic_add_fetch(&notif_events, 1, __ATOMIC_ACQ_REL);
+    if (notif_handler) {
+      notif_handler();
+    }
+  }
+  return HAP_SUCCESS;
+}
+
+// 没有持久化：每次启动都按顺序分配 aid
+int hap_keystore_get(const char *name_space, const char *key, uint8_t *val, size_t *val_size) {
+  return HAP_FAIL;
+}
+
+int hap_keystore_set(const char *name_space, const char *key, const uint8_t *val,
+                     const size_t val_len) {
+  return HAP_SUCCESS;
+}
+
+int hap_get_next_aid() { return ++hap_priv.cur_aid; }
+
+// 固件中在 esp_hap_pair_verify.c，还会上报控制器断开事件；主机上只关闭会话的套接字
+void hap_close_session(hap_secure_session_t *session) {
+  if (session && hap_priv.server) {
+    httpd_sess_trigger_close(hap_priv.server, session->conn_identifier);
+  }
+}
+
+// 固件中在 esp_hap_ip_services.c：HTTP 调试输出和 mDNS 通告
+bool hap_http_debug_enabled() { return false; }
+
+int hap_mdns_announce(bool first) { return HAP_SUCCESS; }
+
+int hap_update_config_number() {
+  hap_priv.config_num++;
+  return HAP_SUCCESS;
+}
+
+// main/homekit.cpp 的启动流程：主机上不运行 HAP 主循环，也没有配对
+ESP_EVENT_DEFINE_BASE(HAP_EVENT);
+
+int hap_init(hap_transport_t method) { return HAP_SUCCESS; }
+
+int hap_start(void) { return HAP_SUCCESS; }
+
+void hap_set_setup_code(const char *setup_code) {}
+
+int hap_set_setup_id(const char *setup_id) { return HAP_SUCCESS; }
+
+int hap_get_paired_controller_count() { return 0; }
+
+// 与 esp_mfi_dummy.c 相同：非 MFi 版本不支持 Wi-Fi 重新配置服务
+esp_err_t hap_acc_add_wifi_transport_service(hap_acc_t *ha, uint32_t capabilities) {
+  return ESP_FAIL;
+}
+
+void *hap_platform_memory_malloc(size_t size) {
+  __atomic_add_fetch(&heap_allocs, 1, __ATOMIC_ACQ_REL);
+  return hap_sim_alloc_fails() ? NULL : malloc(size);
+}
+
+void *hap_platform_memory_calloc(size_t count, size_t size) {
+  __atomic_add_fetch(&heap_allocs, 1, __ATOMIC_ACQ_REL);
+  return hap_sim_alloc_fails() ? NULL : calloc(count, size);
+}
+
+void hap_platform_memory_free(void *ptr) { free(ptr); }
+
+// esp_mfi_base64.c 基于 mbedtls，主机上按 mbedtls_base64_encode() 的约定实现编码：
+// dest 要能放下结尾的 '\0'，out_len 不含 '\0'
+int esp_mfi_base64_encode(const char *src, int len, char *dest, int dest_len, int *out_len) {
+  static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  int need = (len + 2) / 3 * 4;
+  if (dest_len < need + 1) {
+    *out_len = need + 1;
+    return -EINVAL;
+  }
+  const uint8_t *in = (const uint8_t *)src;
+  char *out = dest;
+  for (int i = 0; i < len; i += 3) {
+    uint32_t v = in[i] << 16;
+    if (i + 1 < len)
+      v |= in[i + 1] << 8;
+    if (i + 2 < len)
+      v |= in[i + 2];
+    *out++ = table[(v >> 18) & 0x3f];
+    *out++ = table[(v >> 12) & 0x3f];
+    *out++ = i + 1 < len ? table[(v >> 6) & 0x3f] : '=';
+    *out++ = i + 2 < len ? table[v & 0x3f] : '=';
+  }
+  *out = '\0';
+  *out_len = need;
+  return 0;
+}
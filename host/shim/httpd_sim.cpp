@@ -0,0 +1,702 @@
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// esp_http_server 的主机实现。与固件一样只有一个服务线程：select 等待监听套接字、
+// 会话套接字和工作队列，依次执行请求处理函数和 httpd_queue_work 提交的函数。
+
+static const char *TAG = "httpd_sim";
+
+typedef struct {
+  int fd;
+  void *ctx;
+  httpd_free_ctx_fn_t free_ctx;
+  uint64_t lru;
+  bool closing;
+  std::string rbuf; // 已读取但还没处理的数据（请求体或下一个请求）
+} sim_session_t;
+
+typedef struct {
+  sim_session_t *sess;
+  std::string head;
+  size_t body_left;
+  const char *status;
+  const char *type;
+  std::vector<std::pair<const char *, const char *>> resp_hdrs;
+  bool chunked; // 已通过 httpd_resp_send_chunk 发出响应头
+} sim_req_aux_t;
+
+typedef struct {
+  httpd_config_t cfg;
+  int listen_fd;
+  int wake_fd[2];
+  std::vector<httpd_uri_t> handlers;
+  std::vector<sim_session_t *> sessions;
+  std::mutex work_lock;
+  std::deque<std::pair<httpd_work_fn_t, void *>> work;
+  uint64_t lru_counter;
+} sim_server_t;
+
+httpd_config_t httpd_sim_default_config(void) {
+  httpd_config_t config = {};
+  config.task_priority = 5;
+  config.stack_size = 4096;
+  config.core_id = 0x7fffffff;
+  config.server_port = 80;
+  config.ctrl_port = ESP_HTTPD_DEF_CTRL_PORT;
+  config.max_open_sockets = 7;
+  config.max_uri_handlers = 8;
+  config.max_resp_headers = 8;
+  config.backlog_conn = 5;
+  config.lru_purge_enable = false;
+  config.recv_wait_timeout = 5;
+  config.send_wait_timeout = 5;
+  config.keep_alive_idle = 5;
+  config.keep_alive_interval = 5;
+  config.keep_alive_count = 3;
+  return config;
+}
+
+static sim_server_t *to_server(httpd_handle_t hd) { return (sim_server_t *)hd; }
+
+static sim_session_t *find_session(sim_server_t *srv, int fd) {
+  for (sim_session_t *s : srv->sessions) {
+    if (s->fd == fd) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static void wake_server(sim_server_t *srv) {
+  char c = 0;
+  (void)!write(srv->wake_fd[1], &c, 1);
+}
+
+static void session_close(sim_server_t *srv, sim_session_t *s) {
+  if (s->ctx) {
+    if (s->free_ctx) {
+      s->free_ctx(s->ctx);
+    } else {
+      free(s->ctx);
+    }
+  }
+  if (srv->cfg.close_fn) {
+    srv->cfg.close_fn(srv, s->fd);
+  } else {
+    close(s->fd);
+  }
+  delete s;
+}
+
+/* ---------------- 发送 ---------------- */
+
+static std::atomic<uint64_t> send_calls;
+
+uint64_t httpd_sim_send_count(void) { return send_calls.load(); }
+
+static std::atomic<uint64_t> handler_cpu_ns;
+
+uint64_t httpd_sim_handler_cpu_ns(void) { return handler_cpu_ns.load(); }
+
+static int sock_send_all(int fd, const char *buf, size_t len, int flags) {
+  size_t sent = 0;
+  while (sent < len) {
+    send_calls++;
+    ssize_t ret = send(fd, buf + sent, len - sent, flags | MSG_NOSIGNAL);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTPD_SOCK_ERR_TIMEOUT
+                                                       : HTTPD_SOCK_ERR_FAIL;
+    }
+    sent += ret;
+  }
+  return (int)sent;
+}
+
+int httpd_socket_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags) {
+  send_calls++;
+  ssize_t ret = send(sockfd, buf, buf_len, flags | MSG_NOSIGNAL);
+  if (ret < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTPD_SOCK_ERR_TIMEOUT
+                                                     : HTTPD_SOCK_ERR_FAIL;
+  }
+  return (int)ret;
+}
+
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len) {
+  sim_req_aux_t *aux = (sim_req_aux_t *)r->aux;
+  return sock_send_all(aux->sess->fd, buf, buf_len, 0);
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+  ((sim_req_aux_t *)r->aux)->status = status;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+  ((sim_req_aux_t *)r->aux)->type = type;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value) {
+  sim_req_aux_t *aux = (sim_req_aux_t *)r->aux;
+  if (aux->resp_hdrs.size() >= to_server(r->handle)->cfg.max_resp_headers) {
+    return ESP_ERR_HTTPD_RESP_HDR;
+  }
+  aux->resp_hdrs.emplace_back(field, value);
+  return ESP_OK;
+}
+
+// length 为 NULL 时使用分块传输编码
+static std::string resp_head(sim_req_aux_t *aux, const ssize_t *length) {
+  std::string head = "HTTP/1.1 ";
+  head += aux->status;
+  head += "\r\nContent-Type: ";
+  head += aux->type;
+  if (length) {
+    head += "\r\nContent-Length: " + std::to_string(*length) + "\r\n";
+  } else {
+    head += "\r\nTransfer-Encoding: chunked\r\n";
+  }
+  for (const auto &h : aux->resp_hdrs) {
+    head += h.first;
+    head += ": ";
+    head += h.second;
+    head += "\r\n";
+  }
+  head += "\r\n";
+  return head;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+  sim_req_aux_t *aux = (sim_req_aux_t *)r->aux;
+  if (buf_len == HTTPD_RESP_USE_STRLEN) {
+    buf_len = buf ? strlen(buf) : 0;
+  }
+  std::string head = resp_head(aux, &buf_len);
+  if (sock_send_all(aux->sess->fd, head.data(), head.size(), 0) < 0 ||
+      (buf_len > 0 && sock_send_all(aux->sess->fd, buf, buf_len, 0) < 0)) {
+    return ESP_ERR_HTTPD_RESP_SEND;
+  }
+  return ESP_OK;
+}
+
+// 第一次调用时发送响应头；buf_len 为 0 表示结束
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+  sim_req_aux_t *aux = (sim_req_aux_t *)r->aux;
+  if (buf_len == HTTPD_RESP_USE_STRLEN) {
+    buf_len = buf ? strlen(buf) : 0;
+  }
+  std::string out;
+  if (!aux->chunked) {
+    out = resp_head(aux, NULL);
+    aux->chunked = true;
+  }
+  char size[sizeof(size_t) * 2 + 3]; // 十六进制长度 + CRLF
+  snprintf(size, sizeof(size), "%zx\r\n", (size_t)buf_len);
+  out += size;
+  out.append(buf ? buf : "", buf_len);
+  out += "\r\n";
+  if (sock_send_all(aux->sess->fd, out.data(), out.size(), 0) < 0) {
+    return ESP_ERR_HTTPD_RESP_SEND;
+  }
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str) {
+  return httpd_resp_send(r, str, str ? strlen(str) : 0);
+}
+
+esp_err_t httpd_resp_send_404(httpd_req_t *r) {
+  httpd_resp_set_status(r, HTTPD_404);
+  httpd_resp_set_type(r, HTTPD_TYPE_TEXT);
+  return httpd_resp_sendstr(r, "Nothing matches the given URI");
+}
+
+/* ---------------- 请求 ---------------- */
+
+int httpd_req_to_sockfd(httpd_req_t *r) { return ((sim_req_aux_t *)r->aux)->sess->fd; }
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len) {
+  sim_req_aux_t *aux = (sim_req_aux_t *)r->aux;
+  size_t want = buf_len < aux->body_left ? buf_len : aux->body_left;
+  if (want == 0) {
+    return 0;
+  }
+  std::string &rbuf = aux->sess->rbuf;
+  if (!rbuf.empty()) {
+    size_t n = want < rbuf.size() ? want : rbuf.size();
+    memcpy(buf, rbuf.data(), n);
+    rbuf.erase(0, n);
+    aux->body_left -= n;
+    return (int)n;
+  }
+  ssize_t ret = recv(aux->sess->fd, buf, want, 0);
+  if (ret < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTPD_SOCK_ERR_TIMEOUT
+                                                     : HTTPD_SOCK_ERR_FAIL;
+  }
+  if (ret == 0) {
+    return HTTPD_SOCK_ERR_FAIL;
+  }
+  aux->body_left -= ret;
+  return (int)ret;
+}
+
+// 在请求头中查找字段，返回值的起始位置和长度
+static bool find_header(const std::string &head, const char *field, const char **val,
+                        size_t *len) {
+  size_t flen = strlen(field);
+  size_t pos = head.find("\r\n");
+  while (pos != std::string::npos && pos + 2 < head.size()) {
+    size_t line = pos + 2;
+    size_t end = head.find("\r\n", line);
+    if (end == std::string::npos) {
+      end = head.size();
+    }
+    if (end - line > flen && head[line + flen] == ':' &&
+        strncasecmp(head.c_str() + line, field, flen) == 0) {
+      size_t v = line + flen + 1;
+      while (v < end && head[v] == ' ') {
+        v++;
+      }
+      *val = head.c_str() + v;
+      *len = end - v;
+      return true;
+    }
+    pos = end;
+  }
+  return false;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field) {
+  const char *val;
+  size_t len;
+  return find_header(((sim_req_aux_t *)r->aux)->head, field, &val, &len) ? len : 0;
+}
+
+static esp_err_t copy_trunc(char *dst, size_t dst_size, const char *src, size_t len) {
+  if (dst_size == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  size_t n = len < dst_size - 1 ? len : dst_size - 1;
+  memcpy(dst, src, n);
+  dst[n] = '\0';
+  return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val,
+                                      size_t val_size) {
+  const char *v;
+  size_t len;
+  if (!find_header(((sim_req_aux_t *)r->aux)->head, field, &v, &len)) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return copy_trunc(val, val_size, v, len);
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len) {
+  const char *q = strchr(r->uri, '?');
+  if (!q) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  q++;
+  return copy_trunc(buf, buf_len, q, strcspn(q, "#"));
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
+  size_t klen = strlen(key);
+  for (const char *p = qry; p && *p;) {
+    const char *end = p + strcspn(p, "&");
+    if ((size_t)(end - p) > klen && p[klen] == '=' && strncmp(p, key, klen) == 0) {
+      return copy_trunc(val, val_size, p + klen + 1, end - p - klen - 1);
+    }
+    p = *end ? end + 1 : end;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+/* ---------------- URI 匹配和注册 ---------------- */
+
+// 与 IDF 相同：结尾的 * 匹配任意后缀，结尾的 ? 表示前一个字符可有可无
+bool httpd_uri_match_wildcard(const char *tpl, const char *uri, size_t len) {
+  size_t tpl_len = strlen(tpl);
+  if (tpl_len == 0) {
+    return len == 0;
+  }
+  bool asterisk = tpl[tpl_len - 1] == '*';
+  bool quest = (!asterisk && tpl[tpl_len - 1] == '?') ||
+               (asterisk && tpl_len >= 2 && tpl[tpl_len - 2] == '?');
+  size_t exact = tpl_len - (asterisk ? 1 : 0) - (quest ? 1 : 0);
+  if (len < exact) {
+    return quest && len == exact - 1 && strncmp(tpl, uri, len) == 0;
+  }
+  if (strncmp(tpl, uri, exact) != 0) {
+    return false;
+  }
+  return len == exact || asterisk;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+  sim_server_t *srv = to_server(handle);
+  for (const httpd_uri_t &h : srv->handlers) {
+    if (h.method == uri_handler->method && strcmp(h.uri, uri_handler->uri) == 0) {
+      return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+  }
+  if (srv->handlers.size() >= srv->cfg.max_uri_handlers) {
+    ESP_LOGW(TAG, "no slots left for registering handler %s", uri_handler->uri);
+    return ESP_ERR_HTTPD_HANDLERS_FULL;
+  }
+  srv->handlers.push_back(*uri_handler);
+  return ESP_OK;
+}
+
+/* ---------------- 会话 ---------------- */
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg) {
+  sim_server_t *srv = to_server(handle);
+  {
+    std::lock_guard<std::mutex> guard(srv->work_lock);
+    srv->work.emplace_back(work, arg);
+  }
+  wake_server(srv);
+  return ESP_OK;
+}
+
+typedef struct {
+  sim_server_t *srv;
+  int fd;
+} sim_close_work_t;
+
+static void trigger_close_work(void *arg) {
+  sim_close_work_t *work = (sim_close_work_t *)arg;
+  sim_session_t *s = find_session(work->srv, work->fd);
+  if (s) {
+    s->closing = true;
+  }
+  delete work;
+}
+
+// 与固件一致，关闭请求通过工作队列交给服务线程执行
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+  sim_close_work_t *work = new sim_close_work_t{to_server(handle), sockfd};
+  return httpd_queue_work(handle, trigger_close_work, work);
+}
+
+esp_err_t httpd_sess_update_lru_counter(httpd_handle_t handle, int sockfd) {
+  sim_server_t *srv = to_server(handle);
+  sim_session_t *s = find_session(srv, sockfd);
+  if (!s) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  s->lru = ++srv->lru_counter;
+  return ESP_OK;
+}
+
+// 与固件一样只能在服务线程中调用（请求处理函数或 httpd_queue_work 提交的函数）
+void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd) {
+  sim_session_t *s = find_session(to_server(handle), sockfd);
+  return s ? s->ctx : NULL;
+}
+
+void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free_ctx_fn_t free_fn) {
+  sim_session_t *s = find_session(to_server(handle), sockfd);
+  if (s) {
+    s->ctx = ctx;
+    s->free_ctx = free_fn;
+  }
+}
+
+// 与 httpd_sess_get_ctx 相同，只在服务线程中调用
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds) {
+  sim_server_t *srv = to_server(handle);
+  size_t n = 0;
+  for (sim_session_t *s : srv->sessions) {
+    if (n == *fds) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    client_fds[n++] = s->fd;
+  }
+  *fds = n;
+  return ESP_OK;
+}
+
+static void set_sock_timeout(int fd, int opt, int sec) {
+  struct timeval tv = {.tv_sec = sec, .tv_usec = 0};
+  setsockopt(fd, SOL_SOCKET, opt, &tv, sizeof(tv));
+}
+
+static void accept_session(sim_server_t *srv) {
+  int fd = accept(srv->listen_fd, NULL, NULL);
+  if (fd < 0) {
+    return;
+  }
+  if (srv->sessions.size() >= srv->cfg.max_open_sockets) {
+    sim_session_t *oldest = NULL;
+    for (sim_session_t *s : srv->sessions) {
+      if (!oldest || s->lru < oldest->lru) {
+        oldest = s;
+      }
+    }
+    if (!srv->cfg.lru_purge_enable || !oldest) {
+      ESP_LOGW(TAG, "error in accept (too many sessions), fd=%d", fd);
+      close(fd);
+      return;
+    }
+    ESP_LOGD(TAG, "LRU purge fd=%d", oldest->fd);
+    srv->sessions.erase(std::find(srv->sessions.begin(), srv->sessions.end(), oldest));
+    session_close(srv, oldest);
+  }
+  set_sock_timeout(fd, SO_RCVTIMEO, srv->cfg.recv_wait_timeout);
+  set_sock_timeout(fd, SO_SNDTIMEO, srv->cfg.send_wait_timeout);
+  if (srv->cfg.keep_alive_enable) {
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &srv->cfg.keep_alive_idle, sizeof(int));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &srv->cfg.keep_alive_interval, sizeof(int));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &srv->cfg.keep_alive_count, sizeof(int));
+  }
+  sim_session_t *s = new sim_session_t();
+  s->fd = fd;
+  s->ctx = NULL;
+  s->free_ctx = NULL;
+  s->lru = ++srv->lru_counter;
+  s->closing = false;
+  srv->sessions.push_back(s);
+}
+
+static int parse_method(const char *m, size_t len) {
+  static const struct {
+    const char *name;
+    int method;
+  } methods[] = {{"GET", HTTP_GET},   {"POST", HTTP_POST},       {"PUT", HTTP_PUT},
+                 {"HEAD", HTTP_HEAD}, {"OPTIONS", HTTP_OPTIONS}, {"DELETE", HTTP_DELETE}};
+  for (const auto &entry : methods) {
+    if (strlen(entry.name) == len && strncmp(entry.name, m, len) == 0) {
+      return entry.method;
+    }
+  }
+  return -1;
+}
+
+static void send_error(sim_session_t *s, const char *status) {
+  std::string resp = std::string("HTTP/1.1 ") + status +
+                     "\r\nContent-Type: text/plain\r\nContent-Length: 0\r\n\r\n";
+  sock_send_all(s->fd, resp.data(), resp.size(), 0);
+}
+
+// 处理缓冲区中的一个完整请求；返回 false 表示请求还不完整
+static bool process_request(sim_server_t *srv, sim_session_t *s) {
+  size_t head_end = s->rbuf.find("\r\n\r\n");
+  if (head_end == std::string::npos) {
+    if (s->rbuf.size() > HTTPD_MAX_REQ_HDR_LEN) {
+      send_error(s, "431 Request Header Fields Too Large");
+      s->closing = true;
+    }
+    return false;
+  }
+  sim_req_aux_t aux;
+  aux.sess = s;
+  aux.head = s->rbuf.substr(0, head_end);
+  aux.status = HTTPD_200;
+  aux.type = HTTPD_TYPE_TEXT;
+  aux.chunked = false;
+  s->rbuf.erase(0, head_end + 4);
+
+  httpd_req_t req = {};
+  req.handle = srv;
+  req.aux = &aux;
+  req.sess_ctx = s->ctx;
+  req.free_ctx = s->free_ctx;
+  size_t sp1 = aux.head.find(' ');
+  size_t sp2 = sp1 == std::string::npos ? sp1 : aux.head.find(' ', sp1 + 1);
+  size_t line_end = aux.head.find("\r\n");
+  if (sp2 == std::string::npos || (line_end != std::string::npos && sp2 > line_end)) {
+    send_error(s, "400 Bad Request");
+    s->closing = true;
+    return true;
+  }
+  req.method = parse_method(aux.head.c_str(), sp1);
+  size_t uri_len = sp2 - sp1 - 1;
+  if (uri_len > HTTPD_MAX_URI_LEN) {
+    send_error(s, "414 URI Too Long");
+    s->closing = true;
+    return true;
+  }
+  memcpy((char *)req.uri, aux.head.c_str() + sp1 + 1, uri_len);
+  char value[32];
+  if (httpd_req_get_hdr_value_str(&req, "Content-Length", value, sizeof(value)) == ESP_OK) {
+    req.content_len = strtoul(value, NULL, 10);
+  }
+  aux.body_left = req.content_len;
+
+  size_t path_len = strcspn(req.uri, "?");
+  const httpd_uri_t *handler = NULL;
+  bool uri_found = false;
+  for (const httpd_uri_t &h : srv->handlers) {
+    bool match = srv->cfg.uri_match_fn ? srv->cfg.uri_match_fn(h.uri, req.uri, path_len)
+                                       : strlen(h.uri) == path_len &&
+                                             strncmp(h.uri, req.uri, path_len) == 0;
+    if (match) {
+      uri_found = true;
+      if ((int)h.method == req.method) {
+        handler = &h;
+        break;
+      }
+    }
+  }
+  s->lru = ++srv->lru_counter;
+  if (!handler) {
+    send_error(s, uri_found ? "405 Method Not Allowed" : "404 Not Found");
+    s->closing = true;
+    return true;
+  }
+  req.user_ctx = handler->user_ctx;
+  struct timespec cpu0, cpu1;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+  esp_err_t ret = handler->handler(&req);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+  handler_cpu_ns += (cpu1.tv_sec - cpu0.tv_sec) * 1000000000LL + (cpu1.tv_nsec - cpu0.tv_nsec);
+  if (ret != ESP_OK) {
+    s->closing = true; // 与固件一致，处理函数返回错误时关闭连接
+  }
+  s->ctx = req.sess_ctx;
+  s->free_ctx = req.free_ctx;
+  // 丢弃处理函数没有读取的请求体，保持连接上的下一个请求对齐
+  char discard[256];
+  while (!s->closing && aux.body_left > 0) {
+    if (httpd_req_recv(&req, discard, sizeof(discard)) <= 0) {
+      s->closing = true;
+    }
+  }
+  if (httpd_req_get_hdr_value_str(&req, "Connection", value, sizeof(value)) == ESP_OK &&
+      strcasecmp(value, "close") == 0) {
+    s->closing = true;
+  }
+  return true;
+}
+
+static void read_session(sim_server_t *srv, sim_session_t *s) {
+  char buf[1024];
+  ssize_t ret = recv(s->fd, buf, sizeof(buf), 0);
+  if (ret <= 0) {
+    s->closing = true;
+    return;
+  }
+  s->rbuf.append(buf, ret);
+  while (!s->closing && !s->rbuf.empty() && process_request(srv, s)) {
+  }
+}
+
+static void run_work(sim_server_t *srv) {
+  char drain[64];
+  while (read(srv->wake_fd[0], drain, sizeof(drain)) > 0) {
+  }
+  std::deque<std::pair<httpd_work_fn_t, void *>> work;
+  {
+    std::lock_guard<std::mutex> guard(srv->work_lock);
+    work.swap(srv->work);
+  }
+  for (auto &w : work) {
+    w.first(w.second);
+  }
+}
+
+static void server_thread(sim_server_t *srv) {
+  while (true) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(srv->listen_fd, &fds);
+    FD_SET(srv->wake_fd[0], &fds);
+    int max_fd = srv->listen_fd > srv->wake_fd[0] ? srv->listen_fd : srv->wake_fd[0];
+    for (sim_session_t *s : srv->sessions) {
+      FD_SET(s->fd, &fds);
+      max_fd = s->fd > max_fd ? s->fd : max_fd;
+    }
+    if (select(max_fd + 1, &fds, NULL, NULL, NULL) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ESP_LOGE(TAG, "select failed: %s", strerror(errno));
+      return;
+    }
+    if (FD_ISSET(srv->wake_fd[0], &fds)) {
+      run_work(srv);
+    }
+    for (sim_session_t *s : srv->sessions) {
+      if (!s->closing && FD_ISSET(s->fd, &fds)) {
+        read_session(srv, s);
+      }
+    }
+    for (size_t i = 0; i < srv->sessions.size();) {
+      sim_session_t *s = srv->sessions[i];
+      if (s->closing) {
+        srv->sessions.erase(srv->sessions.begin() + i);
+        session_close(srv, s);
+      } else {
+        i++;
+      }
+    }
+    if (FD_ISSET(srv->listen_fd, &fds)) {
+      accept_session(srv);
+    }
+  }
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(config->server_port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, config->backlog_conn) < 0) {
+    ESP_LOGE(TAG, "bind/listen on port %d failed: %s", config->server_port, strerror(errno));
+    close(fd);
+    return ESP_FAIL;
+  }
+  sim_server_t *srv = new sim_server_t();
+  srv->cfg = *config;
+  srv->listen_fd = fd;
+  srv->lru_counter = 0;
+  if (pipe(srv->wake_fd) < 0) {
+    close(fd);
+    delete srv;
+    return ESP_FAIL;
+  }
+  fcntl(srv->wake_fd[0], F_SETFL, O_NONBLOCK);
+  fcntl(srv->wake_fd[1], F_SETFL, O_NONBLOCK);
+  std::thread(server_thread, srv).detach();
+  ESP_LOGI(TAG, "Started server on port %d", config->server_port);
+  *handle = srv;
+  return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+  return ESP_ERR_INVALID_STATE; // 主机构建中服务器随进程退出
+}
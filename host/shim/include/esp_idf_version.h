@@ -0,0 +1,5 @@
+#pragma once
+
+// 与 ESP_IDF_VERSION_VAL 比较的代码按固件使用的 v5.4.1 编译
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(5, 4, 1)
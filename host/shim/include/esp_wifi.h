@@ -0,0 +1,19 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 主机上没有 Wi-Fi，只提供 HAP 读取设备 MAC 所需的部分
+typedef enum {
+  WIFI_IF_STA,
+  WIFI_IF_AP,
+} wifi_interface_t;
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]);
+
+#ifdef __cplusplus
+}
+#endif
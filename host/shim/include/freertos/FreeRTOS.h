@@ -0,0 +1,24 @@
+#pragma once
+#include "sdkconfig.h"
+#include <stdint.h>
+
+// 主机构建的 FreeRTOS 模拟：任务是 std::thread，节拍由单调时钟换算，定时器由一个服务线程执行
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs)                                                                   \
+  ((TickType_t)(((uint64_t)(xTimeInMs) * (uint64_t)configTICK_RATE_HZ) / (uint64_t)1000U))
+#define tskIDLE_PRIORITY ((UBaseType_t)0U)
+#define portNUM_PROCESSORS 1
+
+static inline BaseType_t xPortGetCoreID(void) { return 0; }
+static inline BaseType_t xPortInIsrContext(void) { return pdFALSE; } // 主机上没有中断上下文
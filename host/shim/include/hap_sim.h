@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// shim/hap_sim.c 替代 HAP 核心中未在主机上构建的部分，并记录测试关心的计数
+uint32_t hap_sim_notif_events(void); // 收到的 HAP_INTERNAL_EVENT_TRIGGER_NOTIF 次数
+uint32_t hap_sim_heap_allocs(void);  // hap_platform_memory_malloc/calloc 的调用次数
+void hap_sim_fail_allocs(uint32_t count); // 之后 count 次 malloc/calloc 返回 NULL
+// 收到 HAP_INTERNAL_EVENT_TRIGGER_NOTIF 时调用 handler（固件中 HAP 主循环调用 hap_http_send_notif）
+void hap_sim_set_notif_handler(void (*handler)(void));
+
+#ifdef __cplusplus
+}
+#endif
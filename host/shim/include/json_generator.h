@@ -0,0 +1,49 @@
+#pragma once
+#include <stdbool.h>
+
+// 主机构建使用的 json_generator（espressif/json_generator 的子集），固件中由组件管理器提供。
+// 输出写入调用方的缓冲区，写满时交给 flush 回调（缓冲区内容以 '\0' 结尾），
+// json_gen_str_end() 再回调一次剩余部分。字符串不做转义，与上游一致。
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_FLOAT_PRECISION 5
+
+typedef void (*json_gen_flush_cb_t)(char *buf, void *priv);
+
+typedef struct {
+  char *buf;
+  int buf_size;
+  json_gen_flush_cb_t flush_cb;
+  void *priv;
+  bool comma_req;
+  char *free_ptr;
+} json_gen_str_t;
+
+int json_gen_str_start(json_gen_str_t *jstr, char *buf, int buf_size, json_gen_flush_cb_t flush_cb,
+                       void *priv);
+int json_gen_str_end(json_gen_str_t *jstr);
+
+int json_gen_start_object(json_gen_str_t *jstr);
+int json_gen_end_object(json_gen_str_t *jstr);
+int json_gen_push_array(json_gen_str_t *jstr, const char *name);
+int json_gen_pop_array(json_gen_str_t *jstr);
+
+int json_gen_obj_set_bool(json_gen_str_t *jstr, const char *name, bool val);
+int json_gen_obj_set_int(json_gen_str_t *jstr, const char *name, int val);
+int json_gen_obj_set_float(json_gen_str_t *jstr, const char *name, float val);
+int json_gen_obj_set_string(json_gen_str_t *jstr, const char *name, const char *val);
+int json_gen_obj_set_null(json_gen_str_t *jstr, const char *name);
+
+int json_gen_arr_set_int(json_gen_str_t *jstr, int val);
+int json_gen_arr_set_string(json_gen_str_t *jstr, const char *val);
+
+int json_gen_obj_start_long_string(json_gen_str_t *jstr, const char *name, const char *val);
+int json_gen_add_to_long_string(json_gen_str_t *jstr, const char *val);
+int json_gen_end_long_string(json_gen_str_t *jstr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// 主机构建使用的 json_parser（espressif/json_parser 的子集），固件中由组件管理器提供。
+// 词法结构与 jsmn 相同：每个值一个 token，记录起止位置、子元素个数和父 token。
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OS_SUCCESS 0
+#define OS_FAIL -1
+
+typedef enum {
+  JSMN_UNDEFINED = 0,
+  JSMN_OBJECT = 1,
+  JSMN_ARRAY = 2,
+  JSMN_STRING = 3,
+  JSMN_PRIMITIVE = 4,
+} json_tok_type_t;
+
+typedef struct {
+  json_tok_type_t type;
+  int start;
+  int end;
+  int size;
+  int parent;
+} json_tok_t;
+
+typedef struct {
+  json_tok_t *toks;
+  char *js;
+  json_tok_t *cur;
+  int num_tokens;
+} jparse_ctx_t;
+
+int json_parse_start(jparse_ctx_t *jctx, const char *js, int len);
+int json_parse_end(jparse_ctx_t *jctx);
+
+int json_obj_get_array(jparse_ctx_t *jctx, const char *name, int *num_elem);
+int json_obj_leave_array(jparse_ctx_t *jctx);
+int json_obj_get_object(jparse_ctx_t *jctx, const char *name);
+int json_obj_leave_object(jparse_ctx_t *jctx);
+int json_obj_get_bool(jparse_ctx_t *jctx, const char *name, bool *val);
+int json_obj_get_int(jparse_ctx_t *jctx, const char *name, int *val);
+int json_obj_get_string(jparse_ctx_t *jctx, const char *name, char *val, int size);
+int json_obj_get_strlen(jparse_ctx_t *jctx, const char *name, int *strlen);
+
+int json_arr_get_object(jparse_ctx_t *jctx, uint32_t index);
+int json_arr_leave_object(jparse_ctx_t *jctx);
+int json_arr_get_int(jparse_ctx_t *jctx, uint32_t index, int *val);
+int json_arr_get_string(jparse_ctx_t *jctx, uint32_t index, char *val, int size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+
+// 只有类型定义，主机上不做 mDNS 广播
+typedef struct {
+  const char *key;
+  const char *value;
+} mdns_txt_item_t;
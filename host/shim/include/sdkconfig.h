@@ -0,0 +1,44 @@
+#pragma once
+// 主机构建使用的配置，取值与 main/Kconfig.projbuild 和 sdkconfig 的默认值一致，
+// 可以在 cmake 时通过 -DCMAKE_CXX_FLAGS=-DCONFIG_xxx=yyy 覆盖
+
+#ifndef CONFIG_FREERTOS_HZ
+#define CONFIG_FREERTOS_HZ 100
+#endif
+
+#ifndef CONFIG_FAN_NVS_COMMIT_DELAY_MS
+#define CONFIG_FAN_NVS_COMMIT_DELAY_MS 3000
+#endif
+#ifndef CONFIG_FAN_RELAY_DEAD_TIME_MS
+#define CONFIG_FAN_RELAY_DEAD_TIME_MS 20
+#endif
+#ifndef CONFIG_FAN_HTTP_PORT
+#define CONFIG_FAN_HTTP_PORT 8080
+#endif
+#ifndef CONFIG_FAN_HTTP_MAX_OPEN_SOCKETS
+#define CONFIG_FAN_HTTP_MAX_OPEN_SOCKETS 5
+#endif
+#ifndef CONFIG_FAN_HTTP_STACK_SIZE
+#define CONFIG_FAN_HTTP_STACK_SIZE 6144
+#endif
+#ifndef CONFIG_FAN_HTTP_SSE_MAX_CLIENTS
+#define CONFIG_FAN_HTTP_SSE_MAX_CLIENTS 3
+#endif
+#define CONFIG_FAN_HTTP_LRU_PURGE 1
+#define CONFIG_FAN_HTTP_KEEP_ALIVE 1
+
+#define CONFIG_HTTPD_MAX_REQ_HDR_LEN 512
+#define CONFIG_HTTPD_MAX_URI_LEN 512
+
+#ifndef CONFIG_PERF_TRACE_ENABLE
+#define CONFIG_PERF_TRACE_ENABLE 1
+#endif
+#ifndef CONFIG_PERF_TRACE_RING_SIZE
+#define CONFIG_PERF_TRACE_RING_SIZE 256
+#endif
+#ifndef CONFIG_PERF_METRICS_ENABLE
+#define CONFIG_PERF_METRICS_ENABLE 1
+#endif
+#ifndef CONFIG_PERF_METRICS_MAX_TASKS
+#define CONFIG_PERF_METRICS_MAX_TASKS 8
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+#include "driver/gpio.h"
+#include <stdint.h>
+
+// 主机构建中的 GPIO 寄存器：对 w1ts/w1tc 的写入转交给 GPIO 模拟器记录
+#ifdef __cplusplus
+struct gpio_sim_w1_reg_t {
+  int bank;
+  int level;
+  gpio_sim_w1_reg_t &operator=(uint32_t mask) {
+    gpio_sim_write_mask(bank, mask, level);
+    return *this;
+  }
+};
+
+typedef struct {
+  gpio_sim_w1_reg_t out_w1ts;
+  gpio_sim_w1_reg_t out_w1tc;
+  struct {
+    gpio_sim_w1_reg_t val;
+  } out1_w1ts;
+  struct {
+    gpio_sim_w1_reg_t val;
+  } out1_w1tc;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+#endif
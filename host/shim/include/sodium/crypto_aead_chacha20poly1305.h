@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+
+// 主机上链接系统的 libsodium 运行库（不要求安装开发头文件）。这里只声明 HAP 记录层和测试
+// 用到的接口，原型与 libsodium 相同。
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define crypto_aead_chacha20poly1305_ietf_KEYBYTES 32U
+#define crypto_aead_chacha20poly1305_ietf_NPUBBYTES 12U
+#define crypto_aead_chacha20poly1305_ietf_ABYTES 16U
+
+int sodium_init(void);
+
+int crypto_aead_chacha20poly1305_ietf_encrypt_detached(
+    unsigned char *c, unsigned char *mac, unsigned long long *maclen_p, const unsigned char *m,
+    unsigned long long mlen, const unsigned char *ad, unsigned long long adlen,
+    const unsigned char *nsec, const unsigned char *npub, const unsigned char *k);
+
+int crypto_aead_chacha20poly1305_ietf_decrypt_detached(
+    unsigned char *m, unsigned char *nsec, const unsigned char *c, unsigned long long clen,
+    const unsigned char *mac, const unsigned char *ad, unsigned long long adlen,
+    const unsigned char *npub, const unsigned char *k);
+
+#ifdef __cplusplus
+}
+#endif
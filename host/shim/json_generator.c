@@ -0,0 +1,153 @@
+#include "json_generator.h"
+#include <stdio.h>
+#include <string.h>
+
+// 主机构建用的 json_generator 子集，逗号和 flush 的处理与上游相同：
+// 每个成员/元素前按需加逗号，对象或数组开始后清除，结束后置位。
+
+static int add_to_str(json_gen_str_t *jstr, const char *str) {
+  if (!str) {
+    return 0;
+  }
+  size_t len = strlen(str);
+  while (1) {
+    size_t room = jstr->buf_size - (jstr->free_ptr - jstr->buf) - 1;
+    size_t n = len < room ? len : room;
+    memcpy(jstr->free_ptr, str, n);
+    jstr->free_ptr += n;
+    *jstr->free_ptr = '\0';
+    str += n;
+    len -= n;
+    if (!len) {
+      return 0;
+    }
+    // 缓冲区已满：没有 flush 回调时输出被截断
+    if (!jstr->flush_cb) {
+      return -1;
+    }
+    jstr->flush_cb(jstr->buf, jstr->priv);
+    jstr->free_ptr = jstr->buf;
+    *jstr->free_ptr = '\0';
+  }
+}
+
+static void add_comma(json_gen_str_t *jstr) {
+  if (jstr->comma_req) {
+    add_to_str(jstr, ",");
+  }
+}
+
+static void add_name(json_gen_str_t *jstr, const char *name) {
+  add_comma(jstr);
+  add_to_str(jstr, "\"");
+  add_to_str(jstr, name);
+  add_to_str(jstr, "\":");
+}
+
+int json_gen_str_start(json_gen_str_t *jstr, char *buf, int buf_size, json_gen_flush_cb_t flush_cb,
+                       void *priv) {
+  memset(jstr, 0, sizeof(*jstr));
+  jstr->buf = buf;
+  jstr->buf_size = buf_size;
+  jstr->flush_cb = flush_cb;
+  jstr->priv = priv;
+  jstr->free_ptr = buf;
+  return 0;
+}
+
+int json_gen_str_end(json_gen_str_t *jstr) {
+  if (jstr->flush_cb) {
+    jstr->flush_cb(jstr->buf, jstr->priv);
+  }
+  memset(jstr, 0, sizeof(*jstr));
+  return 0;
+}
+
+int json_gen_start_object(json_gen_str_t *jstr) {
+  add_comma(jstr);
+  jstr->comma_req = false;
+  return add_to_str(jstr, "{");
+}
+
+int json_gen_end_object(json_gen_str_t *jstr) {
+  jstr->comma_req = true;
+  return add_to_str(jstr, "}");
+}
+
+int json_gen_push_array(json_gen_str_t *jstr, const char *name) {
+  add_name(jstr, name);
+  jstr->comma_req = false;
+  return add_to_str(jstr, "[");
+}
+
+int json_gen_pop_array(json_gen_str_t *jstr) {
+  jstr->comma_req = true;
+  return add_to_str(jstr, "]");
+}
+
+static int set_obj_value(json_gen_str_t *jstr, const char *name, const char *val) {
+  add_name(jstr, name);
+  jstr->comma_req = true;
+  return add_to_str(jstr, val);
+}
+
+static int set_arr_value(json_gen_str_t *jstr, const char *val) {
+  add_comma(jstr);
+  jstr->comma_req = true;
+  return add_to_str(jstr, val);
+}
+
+int json_gen_obj_set_bool(json_gen_str_t *jstr, const char *name, bool val) {
+  return set_obj_value(jstr, name, val ? "true" : "false");
+}
+
+int json_gen_obj_set_int(json_gen_str_t *jstr, const char *name, int val) {
+  char str[16];
+  snprintf(str, sizeof(str), "%d", val);
+  return set_obj_value(jstr, name, str);
+}
+
+int json_gen_obj_set_float(json_gen_str_t *jstr, const char *name, float val) {
+  char str[32];
+  snprintf(str, sizeof(str), "%.*f", JSON_FLOAT_PRECISION, val);
+  return set_obj_value(jstr, name, str);
+}
+
+int json_gen_obj_set_string(json_gen_str_t *jstr, const char *name, const char *val) {
+  add_name(jstr, name);
+  jstr->comma_req = true;
+  add_to_str(jstr, "\"");
+  add_to_str(jstr, val);
+  return add_to_str(jstr, "\"");
+}
+
+int json_gen_obj_set_null(json_gen_str_t *jstr, const char *name) {
+  return set_obj_value(jstr, name, "null");
+}
+
+int json_gen_arr_set_int(json_gen_str_t *jstr, int val) {
+  char str[16];
+  snprintf(str, sizeof(str), "%d", val);
+  return set_arr_value(jstr, str);
+}
+
+int json_gen_arr_set_string(json_gen_str_t *jstr, const char *val) {
+  add_comma(jstr);
+  jstr->comma_req = true;
+  add_to_str(jstr, "\"");
+  add_to_str(jstr, val);
+  return add_to_str(jstr, "\"");
+}
+
+int json_gen_obj_start_long_string(json_gen_str_t *jstr, const char *name, const char *val) {
+  add_name(jstr, name);
+  jstr->comma_req = true;
+  add_to_str(jstr, "\"");
+  return add_to_str(jstr, val);
+}
+
+int json_gen_add_to_long_string(json_gen_str_t *jstr, const char *val) {
+  return add_to_str(jstr, val);
+}
+
+int json_gen_end_long_string(json_gen_str_t *jstr) { return add_to_str(jstr, "\""); }
@@ -0,0 +1,345 @@
+#include "json_parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 主机构建用的 json_parser 子集。词法分析按 jsmn（带父节点链接）的规则生成 token：
+// 对象的键是字符串 token，值的父节点是键；数组元素的父节点是数组。
+
+typedef struct {
+  unsigned int pos;
+  int toknext;
+  int toksuper;
+} json_lexer_t;
+
+static json_tok_t *alloc_token(json_lexer_t *lex, json_tok_t *toks, int num) {
+  if (lex->toknext >= num) {
+    return NULL;
+  }
+  json_tok_t *tok = &toks[lex->toknext++];
+  tok->start = tok->end = -1;
+  tok->size = 0;
+  tok->parent = -1;
+  return tok;
+}
+
+static int parse_primitive(json_lexer_t *lex, const char *js, int len, json_tok_t *toks,
+                           int num) {
+  int start = lex->pos;
+  for (; (int)lex->pos < len; lex->pos++) {
+    char c = js[lex->pos];
+    if (c == ',' || c == ']' || c == '}' || c == ' ' || c == '\t' || c == '\r' || c == '\n' ||
+        c == ':') {
+      break;
+    }
+    if (c < 32 || c >= 127) {
+      return -1;
+    }
+  }
+  if (toks) {
+    json_tok_t *tok = alloc_token(lex, toks, num);
+    if (!tok) {
+      return -1;
+    }
+    tok->type = JSMN_PRIMITIVE;
+    tok->start = start;
+    tok->end = lex->pos;
+    tok->parent = lex->toksuper;
+  } else {
+    lex->toknext++;
+  }
+  lex->pos--;
+  return 0;
+}
+
+static int parse_string(json_lexer_t *lex, const char *js, int len, json_tok_t *toks, int num) {
+  int start = lex->pos;
+  for (lex->pos++; (int)lex->pos < len; lex->pos++) {
+    char c = js[lex->pos];
+    if (c == '"') {
+      if (toks) {
+        json_tok_t *tok = alloc_token(lex, toks, num);
+        if (!tok) {
+          return -1;
+        }
+        tok->type = JSMN_STRING;
+        tok->start = start + 1;
+        tok->end = lex->pos;
+        tok->parent = lex->toksuper;
+      } else {
+        lex->toknext++;
+      }
+      return 0;
+    }
+    if (c == '\\' && (int)lex->pos + 1 < len) {
+      lex->pos++;
+    }
+  }
+  return -1;
+}
+
+// toks 为 NULL 时只统计 token 数量
+static int json_lex(const char *js, int len, json_tok_t *toks, int num) {
+  json_lexer_t lex = {0, 0, -1};
+  int depth = 0;
+  for (; (int)lex.pos < len && js[lex.pos]; lex.pos++) {
+    char c = js[lex.pos];
+    switch (c) {
+    case '{':
+    case '[': {
+      depth++;
+      if (!toks) {
+        lex.toknext++;
+        break;
+      }
+      json_tok_t *tok = alloc_token(&lex, toks, num);
+      if (!tok) {
+        return -1;
+      }
+      if (lex.toksuper != -1) {
+        toks[lex.toksuper].size++;
+        tok->parent = lex.toksuper;
+      }
+      tok->type = c == '{' ? JSMN_OBJECT : JSMN_ARRAY;
+      tok->start = lex.pos;
+      lex.toksuper = lex.toknext - 1;
+      break;
+    }
+    case '}':
+    case ']': {
+      if (--depth < 0) {
+        return -1;
+      }
+      if (!toks) {
+        break;
+      }
+      json_tok_type_t type = c == '}' ? JSMN_OBJECT : JSMN_ARRAY;
+      json_tok_t *tok = &toks[lex.toknext - 1];
+      while (!(tok->start != -1 && tok->end == -1 && tok->type != JSMN_STRING &&
+               tok->type != JSMN_PRIMITIVE)) {
+        if (tok->parent == -1) {
+          return -1;
+        }
+        tok = &toks[tok->parent];
+      }
+      if (tok->type != type) {
+        return -1;
+      }
+      tok->end = lex.pos + 1;
+      lex.toksuper = tok->parent;
+      break;
+    }
+    case '"':
+      if (parse_string(&lex, js, len, toks, num) < 0) {
+        return -1;
+      }
+      if (toks && lex.toksuper != -1) {
+        toks[lex.toksuper].size++;
+      }
+      break;
+    case '\t':
+    case '\r':
+    case '\n':
+    case ' ':
+      break;
+    case ':':
+      if (toks) {
+        lex.toksuper = lex.toknext - 1;
+      }
+      break;
+    case ',':
+      if (toks && lex.toksuper != -1 && toks[lex.toksuper].type != JSMN_ARRAY &&
+          toks[lex.toksuper].type != JSMN_OBJECT) {
+        lex.toksuper = toks[lex.toksuper].parent;
+      }
+      break;
+    default:
+      if (parse_primitive(&lex, js, len, toks, num) < 0) {
+        return -1;
+      }
+      if (toks && lex.toksuper != -1) {
+        toks[lex.toksuper].size++;
+      }
+      break;
+    }
+  }
+  return depth == 0 ? lex.toknext : -1;
+}
+
+int json_parse_start(jparse_ctx_t *jctx, const char *js, int len) {
+  memset(jctx, 0, sizeof(*jctx));
+  int num = json_lex(js, len, NULL, 0);
+  if (num <= 0) {
+    return OS_FAIL;
+  }
+  jctx->toks = (json_tok_t *)calloc(num, sizeof(json_tok_t));
+  if (!jctx->toks) {
+    return OS_FAIL;
+  }
+  if (json_lex(js, len, jctx->toks, num) != num) {
+    free(jctx->toks);
+    jctx->toks = NULL;
+    return OS_FAIL;
+  }
+  jctx->js = (char *)js;
+  jctx->num_tokens = num;
+  jctx->cur = jctx->toks;
+  return OS_SUCCESS;
+}
+
+int json_parse_end(jparse_ctx_t *jctx) {
+  free(jctx->toks);
+  memset(jctx, 0, sizeof(*jctx));
+  return OS_SUCCESS;
+}
+
+static int tok_index(jparse_ctx_t *jctx, json_tok_t *tok) { return (int)(tok - jctx->toks); }
+
+static bool tok_equals(jparse_ctx_t *jctx, json_tok_t *tok, const char *s) {
+  int len = tok->end - tok->start;
+  return tok->type == JSMN_STRING && (int)strlen(s) == len &&
+         strncmp(jctx->js + tok->start, s, len) == 0;
+}
+
+// 当前对象中键 name 对应的值
+static json_tok_t *obj_get_value(jparse_ctx_t *jctx, const char *name) {
+  if (!jctx->cur || jctx->cur->type != JSMN_OBJECT) {
+    return NULL;
+  }
+  int parent = tok_index(jctx, jctx->cur);
+  for (int i = parent + 1; i < jctx->num_tokens - 1; i++) {
+    json_tok_t *tok = &jctx->toks[i];
+    if (tok->start >= jctx->cur->end) {
+      break;
+    }
+    if (tok->parent == parent && tok_equals(jctx, tok, name)) {
+      return &jctx->toks[i + 1];
+    }
+  }
+  return NULL;
+}
+
+// 当前数组中第 index 个元素
+static json_tok_t *arr_get_value(jparse_ctx_t *jctx, uint32_t index) {
+  if (!jctx->cur || jctx->cur->type != JSMN_ARRAY || index >= (uint32_t)jctx->cur->size) {
+    return NULL;
+  }
+  int parent = tok_index(jctx, jctx->cur);
+  uint32_t n = 0;
+  for (int i = parent + 1; i < jctx->num_tokens; i++) {
+    if (jctx->toks[i].parent == parent && n++ == index) {
+      return &jctx->toks[i];
+    }
+  }
+  return NULL;
+}
+
+static int leave(jparse_ctx_t *jctx) {
+  if (!jctx->cur || jctx->cur->parent < 0) {
+    return OS_FAIL;
+  }
+  jctx->cur = &jctx->toks[jctx->cur->parent];
+  if (jctx->cur->type == JSMN_STRING && jctx->cur->parent >= 0) {
+    jctx->cur = &jctx->toks[jctx->cur->parent]; // 跳过键，回到所在对象
+  }
+  return OS_SUCCESS;
+}
+
+static int tok_get_int(jparse_ctx_t *jctx, json_tok_t *tok, int *val) {
+  if (!tok || tok->type != JSMN_PRIMITIVE) {
+    return OS_FAIL;
+  }
+  char *end;
+  long v = strtol(jctx->js + tok->start, &end, 10);
+  if (end != jctx->js + tok->end) {
+    return OS_FAIL;
+  }
+  *val = (int)v;
+  return OS_SUCCESS;
+}
+
+static int tok_get_string(jparse_ctx_t *jctx, json_tok_t *tok, char *val, int size) {
+  if (!tok || tok->type != JSMN_STRING) {
+    return OS_FAIL;
+  }
+  int len = tok->end - tok->start;
+  if (len > size - 1) {
+    return OS_FAIL;
+  }
+  memcpy(val, jctx->js + tok->start, len);
+  val[len] = '\0';
+  return OS_SUCCESS;
+}
+
+int json_obj_get_array(jparse_ctx_t *jctx, const char *name, int *num_elem) {
+  json_tok_t *tok = obj_get_value(jctx, name);
+  if (!tok || tok->type != JSMN_ARRAY) {
+    return OS_FAIL;
+  }
+  jctx->cur = tok;
+  *num_elem = tok->size;
+  return OS_SUCCESS;
+}
+
+int json_obj_leave_array(jparse_ctx_t *jctx) { return leave(jctx); }
+
+int json_obj_get_object(jparse_ctx_t *jctx, const char *name) {
+  json_tok_t *tok = obj_get_value(jctx, name);
+  if (!tok || tok->type != JSMN_OBJECT) {
+    return OS_FAIL;
+  }
+  jctx->cur = tok;
+  return OS_SUCCESS;
+}
+
+int json_obj_leave_object(jparse_ctx_t *jctx) { return leave(jctx); }
+
+int json_obj_get_bool(jparse_ctx_t *jctx, const char *name, bool *val) {
+  json_tok_t *tok = obj_get_value(jctx, name);
+  if (!tok || tok->type != JSMN_PRIMITIVE) {
+    return OS_FAIL;
+  }
+  if (strncmp(jctx->js + tok->start, "true", 4) == 0) {
+    *val = true;
+  } else if (strncmp(jctx->js + tok->start, "false", 5) == 0) {
+    *val = false;
+  } else {
+    return OS_FAIL;
+  }
+  return OS_SUCCESS;
+}
+
+int json_obj_get_int(jparse_ctx_t *jctx, const char *name, int *val) {
+  return tok_get_int(jctx, obj_get_value(jctx, name), val);
+}
+
+int json_obj_get_string(jparse_ctx_t *jctx, const char *name, char *val, int size) {
+  return tok_get_string(jctx, obj_get_value(jctx, name), val, size);
+}
+
+int json_obj_get_strlen(jparse_ctx_t *jctx, const char *name, int *strlen) {
+  json_tok_t *tok = obj_get_value(jctx, name);
+  if (!tok || tok->type != JSMN_STRING) {
+    return OS_FAIL;
+  }
+  *strlen = tok->end - tok->start;
+  return OS_SUCCESS;
+}
+
+int json_arr_get_object(jparse_ctx_t *jctx, uint32_t index) {
+  json_tok_t *tok = arr_get_value(jctx, index);
+  if (!tok || tok->type != JSMN_OBJECT) {
+    return OS_FAIL;
+  }
+  jctx->cur = tok;
+  return OS_SUCCESS;
+}
+
+int json_arr_leave_object(jparse_ctx_t *jctx) { return leave(jctx); }
+
+int json_arr_get_int(jparse_ctx_t *jctx, uint32_t index, int *val) {
+  return tok_get_int(jctx, arr_get_value(jctx, index), val);
+}
+
+int json_arr_get_string(jparse_ctx_t *jctx, uint32_t index, char *val, int size) {
+  return tok_get_string(jctx, arr_get_value(jctx, index), val, size);
+}
@@ -0,0 +1,128 @@
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+
+// NVS 模拟器：键为 "命名空间/键名"，只支持 i32。设置了持久化文件时每次 commit 整体重写文件，
+// 下次启动时由 nvs_flash_init 读回，用于验证挡位在重启后能恢复。
+
+static const char *TAG = "nvs_sim";
+
+typedef struct {
+  std::string ns;
+  bool writable;
+} nvs_sim_handle_t;
+
+static std::mutex nvs_lock;
+static bool nvs_ready = false;
+static std::map<std::string, int32_t> nvs_values;
+static std::map<nvs_handle_t, nvs_sim_handle_t> nvs_handles;
+static nvs_handle_t nvs_next_handle = 1;
+static uint32_t nvs_commits = 0;
+static uint32_t nvs_commit_failures = 0;
+static std::string nvs_path;
+
+void nvs_sim_set_path(const char *path) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  nvs_path = path ? path : "";
+}
+
+uint32_t nvs_sim_commit_count(void) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  return nvs_commits;
+}
+
+void nvs_sim_fail_commits(uint32_t count) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  nvs_commit_failures = count;
+}
+
+esp_err_t nvs_flash_init(void) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  nvs_ready = true;
+  FILE *f = nvs_path.empty() ? NULL : fopen(nvs_path.c_str(), "r");
+  if (f) {
+    char key[64];
+    int value;
+    while (fscanf(f, "%63s %d", key, &value) == 2) {
+      nvs_values[key] = value;
+    }
+    fclose(f);
+    ESP_LOGI(TAG, "loaded %u keys from %s", (unsigned)nvs_values.size(), nvs_path.c_str());
+  }
+  return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  nvs_values.clear();
+  if (!nvs_path.empty()) {
+    remove(nvs_path.c_str());
+  }
+  return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  if (!nvs_ready) {
+    return ESP_ERR_NVS_NOT_INITIALIZED;
+  }
+  *out_handle = nvs_next_handle++;
+  nvs_handles[*out_handle] = {name, open_mode == NVS_READWRITE};
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  auto h = nvs_handles.find(handle);
+  if (h == nvs_handles.end()) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  auto it = nvs_values.find(h->second.ns + "/" + key);
+  if (it == nvs_values.end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  *out_value = it->second;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  auto h = nvs_handles.find(handle);
+  if (h == nvs_handles.end()) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  if (!h->second.writable) {
+    return ESP_ERR_NVS_READ_ONLY;
+  }
+  nvs_values[h->second.ns + "/" + key] = value;
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  if (nvs_handles.find(handle) == nvs_handles.end()) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  if (nvs_commit_failures) {
+    nvs_commit_failures--;
+    return ESP_FAIL;
+  }
+  nvs_commits++;
+  FILE *f = nvs_path.empty() ? NULL : fopen(nvs_path.c_str(), "w");
+  if (f) {
+    for (const auto &kv : nvs_values) {
+      fprintf(f, "%s %d\n", kv.first.c_str(), (int)kv.second);
+    }
+    fclose(f);
+  }
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+  std::lock_guard<std::mutex> guard(nvs_lock);
+  nvs_handles.erase(handle);
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "host_test.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <functional>
+#include <future>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+extern "C" {
+#include "byte_convert.h"
+#include "esp_hap_database.h"
+#include "esp_hap_pair_common.h"
+#include "esp_http_server.h"
+#include "perf_metrics.h"
+#include "sodium/crypto_aead_chacha20poly1305.h"
+}
+
+// 主机上的 HAP 会话：httpd_sim 服务端上直接标记为已验证的会话（跳过配对），客户端一侧按 HAP
+// 帧格式解析并用会话密钥解密。服务端的发送都要在服务线程中进行，用 hap_test_on_server() 提交。
+
+typedef struct {
+  int fd;                      // 客户端套接字
+  hap_secure_session_t *sess;  // 服务端的会话
+  uint64_t nonce;              // 下一帧的 nonce 计数
+  std::vector<uint8_t> rbuf;   // 已收到但还没解析的字节
+  uint64_t frames;             // 收到的帧数
+  uint64_t wire_bytes;         // 收到的密文字节数（含长度和 tag）
+} hap_test_client_t;
+
+static void hap_test_free_ctx(void *ctx) {} // 会话由测试持有
+
+static httpd_handle_t hap_test_start_server(int port) {
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.server_port = port;
+  config.ctrl_port = port + 1;
+  config.max_open_sockets = HAP_MAX_SESSIONS + 1;
+  httpd_handle_t server = NULL;
+  CHECK(httpd_start(&server, &config) == ESP_OK);
+  hap_priv.server = server;
+  return server;
+}
+
+// 在服务线程中执行 fn 并等待它返回
+static void hap_test_on_server(std::function<void()> fn) {
+  std::promise<void> done;
+  std::pair<std::function<void()> *, std::promise<void> *> work(&fn, &done);
+  httpd_queue_work(
+      hap_priv.server,
+      [](void *arg) {
+        auto *w = (std::pair<std::function<void()> *, std::promise<void> *> *)arg;
+        (*w->first)();
+        w->second->set_value();
+      },
+      &work);
+  done.get_future().wait();
+}
+
+// 连接 count 个客户端，并在服务端为每个连接建立已验证的会话，放入 hap_priv.sessions
+static std::vector<hap_test_client_t> hap_test_connect(int port, int count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<hap_test_client_t> clients;
+  std::vector<int> known;
+  for (int i = 0; i < count; i++) {
+    hap_test_client_t c = {};
+    c.fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(connect(c.fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    int on = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    // 等服务端接受连接，新出现的套接字就是这个客户端的
+    int server_fd = -1;
+    for (int tries = 0; server_fd < 0 && tries < 500; tries++) {
+      hap_test_on_server([&] {
+        int fds[HAP_MAX_SESSIONS + 1];
+        size_t n = sizeof(fds) / sizeof(fds[0]);
+        httpd_get_client_list(hap_priv.server, &n, fds);
+        for (size_t k = 0; k < n; k++) {
+          if (std::find(known.begin(), known.end(), fds[k]) == known.end()) {
+            server_fd = fds[k];
+          }
+        }
+      });
+      if (server_fd < 0) {
+        usleep(1000);
+      }
+    }
+    CHECK(server_fd >= 0);
+    known.push_back(server_fd);
+    c.sess = (hap_secure_session_t *)calloc(1, sizeof(hap_secure_session_t));
+    c.sess->state = STATE_VERIFIED;
+    c.sess->conn_identifier = server_fd;
+    for (uint8_t &b : c.sess->encrypt_key) {
+      b = rng();
+    }
+    for (uint8_t &b : c.sess->decrypt_key) {
+      b = rng();
+    }
+    hap_test_on_server([&] {
+      httpd_sess_set_ctx(hap_priv.server, server_fd, c.sess, hap_test_free_ctx);
+      hap_priv.sessions[i] = c.sess;
+    });
+    clients.push_back(c);
+  }
+  return clients;
+}
+
+// 读出下一帧并解密到 plain，连接关闭或出错返回 false
+static bool hap_test_read_frame(hap_test_client_t *c, std::string *plain) {
+  while (true) {
+    if (c->rbuf.size() >= 2) {
+      size_t len = get_u16_le(c->rbuf.data());
+      size_t wire = 2 + len + crypto_aead_chacha20poly1305_ietf_ABYTES;
+      if (c->rbuf.size() >= wire) {
+        uint8_t nonce[crypto_aead_chacha20poly1305_ietf_NPUBBYTES] = {0};
+        put_u64_le(nonce + 4, c->nonce++);
+        plain->resize(len);
+        int ret = crypto_aead_chacha20poly1305_ietf_decrypt_detached(
+            (uint8_t *)plain->data(), NULL, &c->rbuf[2], len, &c->rbuf[2 + len], c->rbuf.data(), 2,
+            nonce, c->sess->encrypt_key);
+        c->rbuf.erase(c->rbuf.begin(), c->rbuf.begin() + wire);
+        c->frames++;
+        c->wire_bytes += wire;
+        return ret == 0;
+      }
+    }
+    uint8_t buf[16384];
+    ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      return false;
+    }
+    c->rbuf.insert(c->rbuf.end(), buf, buf + n);
+  }
+}
+
+// perf_metrics 文本导出中某个计数器的当前值
+static uint64_t hap_test_metric(const char *name) {
+  std::string text;
+  perf_metrics_export(
+      [](const char *buf, size_t len, void *ctx) {
+        ((std::string *)ctx)->append(buf, len);
+        return 0;
+      },
+      &text);
+  std::string key = std::string("\n") + name + " ";
+  size_t at = text.find(key);
+  return at == std::string::npos ? 0 : strtoull(text.c_str() + at + key.size(), NULL, 10);
+}
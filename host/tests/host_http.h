@@ -0,0 +1,168 @@
+#pragma once
+#include "host_test.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// 主机测试用的 HTTP/1.1 客户端：在一个长连接上依次发送请求并读完整个响应
+// （Content-Length 或分块传输编码），记录收到的字节数，供基准和回放测试使用。
+// 服务端先发响应头再发响应体，开着 Nagle 时响应体要等响应头的确认；客户端每次读完都立即确认
+// （TCP_QUICKACK），否则本机回环上每个请求都会多出约 40 ms 的延迟确认，掩盖被测的差别
+
+typedef std::vector<std::pair<std::string, std::string>> http_headers_t;
+
+typedef struct {
+  int status;
+  std::map<std::string, std::string> headers; // 名字统一为小写
+  std::string body;
+  size_t wire_bytes; // 响应头和响应体在连接上的字节数
+} http_resp_t;
+
+typedef struct {
+  int fd;
+  std::string rbuf; // 已收到但还不属于当前响应的字节
+} http_conn_t;
+
+static bool http_connect(http_conn_t *c, int port) {
+  c->rbuf.clear();
+  c->fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(c->fd);
+    c->fd = -1;
+    return false;
+  }
+  int on = 1;
+  setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return true;
+}
+
+static void http_close(http_conn_t *c) {
+  if (c->fd >= 0) {
+    close(c->fd);
+    c->fd = -1;
+  }
+}
+
+// 至少读到 n 字节，连接关闭返回 false
+static bool http_fill(http_conn_t *c, size_t n) {
+  while (c->rbuf.size() < n) {
+    char buf[4096];
+    ssize_t ret = recv(c->fd, buf, sizeof(buf), 0);
+    if (ret <= 0) {
+      return false;
+    }
+    c->rbuf.append(buf, ret);
+    int on = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+  }
+  return true;
+}
+
+// 读到 delim 为止（含 delim），返回之前的内容
+static bool http_read_until(http_conn_t *c, const char *delim, size_t *consumed, std::string *out) {
+  size_t at;
+  while ((at = c->rbuf.find(delim)) == std::string::npos) {
+    if (!http_fill(c, c->rbuf.size() + 1)) {
+      return false;
+    }
+  }
+  out->assign(c->rbuf, 0, at);
+  c->rbuf.erase(0, at + strlen(delim));
+  *consumed += at + strlen(delim);
+  return true;
+}
+
+static bool http_read_response(http_conn_t *c, bool head_only, http_resp_t *resp) {
+  std::string head;
+  resp->wire_bytes = 0;
+  resp->headers.clear();
+  resp->body.clear();
+  if (!http_read_until(c, "\r\n\r\n", &resp->wire_bytes, &head) ||
+      sscanf(head.c_str(), "HTTP/1.1 %d", &resp->status) != 1) {
+    return false;
+  }
+  for (size_t at = head.find("\r\n"); at != std::string::npos;) {
+    size_t end = head.find("\r\n", at + 2);
+    std::string line = head.substr(at + 2, end == std::string::npos ? end : end - at - 2);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+      std::string name = line.substr(0, colon);
+      for (char &ch : name) {
+        ch = tolower(ch);
+      }
+      size_t value = line.find_first_not_of(' ', colon + 1);
+      resp->headers[name] = value == std::string::npos ? "" : line.substr(value);
+    }
+    at = end;
+  }
+  if (head_only || resp->status == 304) {
+    return true;
+  }
+  if (resp->headers.count("content-length")) {
+    size_t len = strtoul(resp->headers["content-length"].c_str(), NULL, 10);
+    if (!http_fill(c, len)) {
+      return false;
+    }
+    resp->body.assign(c->rbuf, 0, len);
+    c->rbuf.erase(0, len);
+    resp->wire_bytes += len;
+    return true;
+  }
+  // 分块传输：<十六进制长度>\r\n<数据>\r\n ... 0\r\n\r\n
+  while (true) {
+    std::string size;
+    if (!http_read_until(c, "\r\n", &resp->wire_bytes, &size)) {
+      return false;
+    }
+    size_t len = strtoul(size.c_str(), NULL, 16);
+    if (!http_fill(c, len + 2)) {
+      return false;
+    }
+    resp->body.append(c->rbuf, 0, len);
+    c->rbuf.erase(0, len + 2);
+    resp->wire_bytes += len + 2;
+    if (len == 0) {
+      return true;
+    }
+  }
+}
+
+// 发送一个请求并读完响应，失败返回 false
+static bool http_request(http_conn_t *c, const char *method, const std::string &path,
+                         const http_headers_t &headers, const std::string &body,
+                         http_resp_t *resp) {
+  std::string req = std::string(method) + " " + path + " HTTP/1.1\r\nHost: localhost\r\n";
+  for (const auto &h : headers) {
+    req += h.first + ": " + h.second + "\r\n";
+  }
+  if (!body.empty()) {
+    req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+  }
+  req += "\r\n";
+  req += body;
+  for (size_t sent = 0; sent < req.size();) {
+    ssize_t ret = send(c->fd, req.data() + sent, req.size() - sent, MSG_NOSIGNAL);
+    if (ret <= 0) {
+      return false;
+    }
+    sent += ret;
+  }
+  return http_read_response(c, strcmp(method, "HEAD") == 0, resp);
+}
+
+static bool http_get(http_conn_t *c, const std::string &path, http_resp_t *resp,
+                     const http_headers_t &headers = {}) {
+  return http_request(c, "GET", path, headers, "", resp);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// 主机测试的最小断言工具：失败时打印位置并以非 0 退出，由 ctest 判定结果
+
+#define CHECK(cond)                                                                                \
+  do {                                                                                             \
+    if (!(cond)) {                                                                                 \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                     \
+      exit(1);                                                                                     \
+    }                                                                                              \
+  } while (0)
+
+// 轮询等待条件成立，超时返回 false
+#define WAIT_UNTIL(cond, timeout_ms)                                                               \
+  ({                                                                                               \
+    int waited_ = 0;                                                                               \
+    while (!(cond) && waited_ < (timeout_ms)) {                                                    \
+      vTaskDelay(pdMS_TO_TICKS(10));                                                               \
+      waited_ += 10;                                                                               \
+    }                                                                                              \
+    (bool)(cond);                                                                                  \
+  })
@@ -0,0 +1,127 @@
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "fan_gpio.h"
+#include "host_test.h"
+#include "nvs_flash.h"
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// 状态机并发压力测试：多个线程同时修改开关、挡位和定时器（相当于 HomeKit、HTTP、批量接口并发），
+// 检查订阅者串行收到通知、任何时刻最多一个挡位继电器接通，且结束时输出和通知都停在最新状态。
+// 建议同时用 -DFAN_HOST_SANITIZE=thread 构建运行。
+
+#define STRESS_THREADS 4
+#define STRESS_ITERATIONS 2000
+#define RELAY_MASK ((1ULL << GPIO_NUM_16) | (1ULL << GPIO_NUM_33) | (1ULL << GPIO_NUM_32))
+
+static std::atomic<int> in_callback{0};
+static std::atomic<uint32_t> callbacks{0};
+static std::mutex last_lock;
+static fan_state_t last_state; // 订阅者（如 HomeKit）最后看到的状态
+
+static void stress_state_cb(const fan_state_t *state, void *arg) {
+  CHECK(in_callback.fetch_add(1) == 0); // 通知必须串行
+  uint64_t relays = gpio_sim_levels() & RELAY_MASK;
+  CHECK((relays & (relays - 1)) == 0); // 不能同时接通两个挡位
+  {
+    std::lock_guard<std::mutex> lock(last_lock);
+    last_state = *state;
+  }
+  callbacks.fetch_add(1);
+  in_callback.fetch_sub(1);
+}
+
+static void stress_thread(unsigned seed) {
+  std::mt19937 rng(seed);
+  for (int i = 0; i < STRESS_ITERATIONS; i++) {
+    bool on = rng() & 1;
+    int level = 1 + rng() % 3;
+    switch (rng() % 5) {
+    case 0:
+      change_fan_state(on);
+      break;
+    case 1:
+      change_fan_state(on, level);
+      break;
+    case 2: {
+      fan_batch_t batch = {.on = on ? 1 : 0, .level = level, .timer_sec = -1};
+      fan_apply_batch(&batch);
+      break;
+    }
+    case 3:
+      CHECK(set_fan_timer(60 + rng() % 600)); // 足够长，压力测试期间不会到期
+      break;
+    default:
+      cancel_fan_timer();
+      break;
+    }
+  }
+}
+
+static uint64_t expected_relays(const fan_state_t *st) {
+  if (!st->on) {
+    return 0;
+  }
+  return st->level == 1 ? 1ULL << GPIO_NUM_32 : st->level == 2 ? 1ULL << GPIO_NUM_33
+                                                                : 1ULL << GPIO_NUM_16;
+}
+
+// 两个线程同时重新设置定时器，最后生效的那个必须按时关机
+static void test_timer_race(void) {
+  change_fan_state(true, 2);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 2; i++) {
+    threads.emplace_back([] {
+      for (int j = 0; j < 200; j++) {
+        CHECK(set_fan_timer(1));
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  CHECK(fan_timer_running());
+  CHECK(WAIT_UNTIL(!fan_get_state().on, 2000));
+  CHECK(!fan_timer_running());
+
+  fan_batch_t batch = {.on = 1, .level = 0, .timer_sec = FAN_TIMER_MAX_SEC + 1};
+  CHECK(!fan_apply_batch(&batch));
+  batch.timer_sec = FAN_TIMER_MAX_SEC; // 换算成节拍时不能溢出
+  CHECK(fan_apply_batch(&batch));
+  CHECK(fan_timer_left() > FAN_TIMER_MAX_SEC - 5);
+  cancel_fan_timer();
+}
+
+int main(void) {
+  esp_log_level_set("*", ESP_LOG_WARN);
+  nvs_flash_init();
+  fan_gpio_init();
+  CHECK(fan_state_subscribe(stress_state_cb, NULL));
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < STRESS_THREADS; i++) {
+    threads.emplace_back(stress_thread, i + 1);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  // 所有修改返回后，最后一次通知和继电器输出都对应最新的状态字
+  fan_state_t st = fan_get_state();
+  CHECK(WAIT_UNTIL((gpio_sim_levels() & RELAY_MASK) == expected_relays(&st), 1000));
+  {
+    std::lock_guard<std::mutex> lock(last_lock);
+    CHECK(last_state.version == st.version);
+    CHECK(last_state.on == st.on);
+    CHECK(last_state.level == st.level);
+    CHECK(last_state.timer_gen == st.timer_gen);
+  }
+  CHECK(callbacks.load() > 0);
+  cancel_fan_timer();
+  test_timer_race();
+  printf("test_fan_state: ok, %u notifications\n", (unsigned)callbacks.load());
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include "fan_store.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "host_test.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+// fan_store 的写入合并、提交失败重试和恢复出厂时的丢弃。
+// 以 CONFIG_FAN_NVS_COMMIT_DELAY_MS=50 编译，合并窗口足够短。
+
+static int32_t nvs_level(void) {
+  nvs_handle_t handle;
+  int32_t level = -1;
+  if (nvs_open("fan_cfg", NVS_READONLY, &handle) == ESP_OK) {
+    nvs_get_i32(handle, "fan_level", &level);
+    nvs_close(handle);
+  }
+  return level;
+}
+
+// 窗口内的多次修改只提交一次，写入的是最后一次的挡位
+static void test_coalesce(void) {
+  uint32_t commits = nvs_sim_commit_count();
+  uint32_t merged = fan_store_merge_count();
+  fan_store_save_level(1);
+  fan_store_save_level(3);
+  fan_store_save_level(1);
+  fan_store_save_level(3);
+  CHECK(WAIT_UNTIL(nvs_level() == 3, 1000));
+  vTaskDelay(pdMS_TO_TICKS(200)); // 确认没有多余的提交
+  CHECK(nvs_sim_commit_count() == commits + 1);
+  CHECK(fan_store_merge_count() == merged + 3);
+
+  // 与已保存的挡位相同时不提交
+  fan_store_save_level(3);
+  vTaskDelay(pdMS_TO_TICKS(200));
+  CHECK(nvs_sim_commit_count() == commits + 1);
+
+  // 连续 1000 次修改跨过多个合并窗口：每个窗口最多提交一次，最后的挡位落盘
+  commits = nvs_sim_commit_count();
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < 1000; i++) {
+    fan_store_save_level(i % 3 + 1);
+    esp_rom_delay_us(200);
+  }
+  int64_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+  CHECK(WAIT_UNTIL(nvs_level() == 1, 1000)); // 999 % 3 + 1
+  vTaskDelay(pdMS_TO_TICKS(200));
+  uint32_t saved = nvs_sim_commit_count() - commits;
+  uint32_t bound = (uint32_t)(elapsed_ms / CONFIG_FAN_NVS_COMMIT_DELAY_MS) + 2;
+  printf("test_coalesce: 1000 saves in %lld ms, %u commits (bound %u)\n", (long long)elapsed_ms,
+         (unsigned)saved, (unsigned)bound);
+  CHECK(saved >= 1 && saved <= bound);
+}
+
+// 提交失败后保留修改，由后台任务重试
+static void test_commit_retry(void) {
+  uint32_t commits = fan_store_commit_count();
+  nvs_sim_fail_commits(2);
+  fan_store_save_level(2);
+  CHECK(WAIT_UNTIL(fan_store_commit_count() == commits + 1, 2000));
+  CHECK(nvs_level() == 2);
+}
+
+// 丢弃之后，关机时的 flush 不会把挡位写回擦除后的 NVS
+static void test_discard(void) {
+  uint32_t commits = nvs_sim_commit_count();
+  fan_store_save_level(1);
+  fan_store_discard();
+  nvs_flash_erase();
+  fan_store_flush();
+  vTaskDelay(pdMS_TO_TICKS(200));
+  CHECK(nvs_sim_commit_count() == commits);
+  CHECK(nvs_level() == -1);
+  fan_store_save_level(3);
+  fan_store_flush();
+  CHECK(nvs_level() == -1);
+}
+
+int main(void) {
+  nvs_flash_init();
+  CHECK(fan_store_load_level(2) == 2);
+  test_coalesce();
+  test_commit_retry();
+  test_discard();
+  printf("test_fan_store: ok\n");
+  return 0;
+}
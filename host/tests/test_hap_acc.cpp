@@ -0,0 +1,180 @@
+#include "hap_sim.h"
+#include "host_test.h"
+#include <chrono>
+#include <random>
+#include <vector>
+extern "C" {
+#include "esp_hap_acc.h"
+#include "esp_hap_char.h"
+#include "esp_hap_database.h"
+#include "esp_hap_serv.h"
+#include "hap.h"
+#include "hap_apple_chars.h"
+}
+
+// aid/iid 查找：排序索引与逐个遍历配件/服务/特征链表的结果一致性、索引分配失败时的退化，
+// 暂存写入按服务归组，以及 100 个配件、每个 20 个特征（信息服务 6 个 + 自定义服务 14 个）时
+// 两种查找方式的基准。
+
+#define NUM_ACCS 100
+#define CHARS_PER_SERV 14
+
+typedef struct {
+  int aid;
+  int iid;
+  hap_char_t *hc;
+} char_ref_t;
+
+static int identify(hap_acc_t *ha) { return HAP_SUCCESS; }
+
+static hap_acc_t *make_acc(int n) {
+  char name[16];
+  snprintf(name, sizeof(name), "Fan %d", n);
+  hap_acc_cfg_t cfg = {};
+  cfg.name = name;
+  cfg.model = (char *)"ESP32-FAN";
+  cfg.manufacturer = (char *)"Espressif";
+  cfg.serial_num = (char *)"001122334455";
+  cfg.fw_rev = (char *)"1.0.0";
+  cfg.cid = HAP_CID_FAN;
+  cfg.identify_routine = identify;
+  hap_acc_t *ha = hap_acc_create(&cfg);
+  CHECK(ha);
+  hap_serv_t *hs = hap_serv_create((char *)"B7");
+  CHECK(hs);
+  for (int i = 0; i < CHARS_PER_SERV; i++) {
+    CHECK(hap_serv_add_char(hs, hap_char_int_create((char *)"29", HAP_CHAR_PERM_PR, i)) == 0);
+  }
+  CHECK(hap_acc_add_serv(ha, hs) == 0);
+  return ha;
+}
+
+// 不经过索引，按固件原来的方式遍历链表，列出所有特征
+static std::vector<char_ref_t> list_chars(void) {
+  std::vector<char_ref_t> refs;
+  for (hap_acc_t *ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha)) {
+    for (hap_serv_t *hs = hap_acc_get_first_serv(ha); hs; hs = hap_serv_get_next(hs)) {
+      for (hap_char_t *hc = hap_serv_get_first_char(hs); hc; hc = hap_char_get_next(hc)) {
+        refs.push_back({(int)hap_acc_get_aid(ha), (int)hap_char_get_iid(hc), hc});
+      }
+    }
+  }
+  return refs;
+}
+
+static void check_all(const std::vector<char_ref_t> &refs) {
+  for (const char_ref_t &r : refs) {
+    CHECK(hap_get_char_by_aid_iid(r.aid, r.iid) == r.hc);
+  }
+}
+
+// 等待 pid 时暂存的写入可能交错属于多个服务，分发前按服务归组，组内和组间都保持原有先后
+static void test_group_writes(void) {
+  hap_serv_t *servs[3];
+  hap_char_t *chars[3][3];
+  for (int s = 0; s < 3; s++) {
+    servs[s] = hap_serv_create((char *)"B7");
+    CHECK(servs[s]);
+    for (int c = 0; c < 3; c++) {
+      chars[s][c] = hap_char_int_create((char *)"29", HAP_CHAR_PERM_PR, c);
+      CHECK(hap_serv_add_char(servs[s], chars[s][c]) == 0);
+    }
+  }
+  const int order[][2] = {{0, 0}, {1, 0}, {0, 1}, {2, 0}, {1, 1}, {0, 2}, {2, 1}};
+  const int grouped[][2] = {{0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 1}, {2, 0}, {2, 1}};
+  const int cnt = sizeof(order) / sizeof(order[0]);
+  hap_write_data_t writes[cnt] = {};
+  for (int i = 0; i < cnt; i++) {
+    writes[i].hc = chars[order[i][0]][order[i][1]];
+  }
+  hap_serv_group_writes(writes, cnt);
+  for (int i = 0; i < cnt; i++) {
+    CHECK(writes[i].hc == chars[grouped[i][0]][grouped[i][1]]);
+  }
+  // 已经按服务连续的写入不变
+  hap_serv_group_writes(writes, cnt);
+  for (int i = 0; i < cnt; i++) {
+    CHECK(writes[i].hc == chars[grouped[i][0]][grouped[i][1]]);
+  }
+  for (hap_serv_t *hs : servs) {
+    hap_serv_delete(hs);
+  }
+}
+
+static void bench(const std::vector<char_ref_t> &refs) {
+  std::mt19937 rng(7);
+  std::vector<char_ref_t> ids(4096);
+  for (char_ref_t &id : ids) {
+    id = refs[rng() % refs.size()];
+  }
+  const int lookups = 1000000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < lookups; i++) {
+    const char_ref_t &id = ids[i % ids.size()];
+    CHECK(hap_get_char_by_aid_iid(id.aid, id.iid) == id.hc);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < lookups / 10; i++) {
+    const char_ref_t &id = ids[i % ids.size()];
+    CHECK(hap_acc_get_char_by_iid(hap_acc_get_by_aid(id.aid), id.iid) == id.hc);
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  double index_ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups;
+  double walk_ns = std::chrono::duration<double, std::nano>(t2 - t1).count() / (lookups / 10);
+  printf("bench_hap_acc: %zu chars in %d accessories: index %.1f ns/lookup, list walk %.1f "
+         "ns/lookup\n",
+         refs.size(), NUM_ACCS, index_ns, walk_ns);
+}
+
+int main(void) {
+  hap_add_accessory(make_acc(0));
+  std::vector<hap_acc_t *> bridged;
+  for (int n = 1; n < NUM_ACCS; n++) {
+    bridged.push_back(make_acc(n));
+    hap_add_bridged_accessory(bridged.back(), 0);
+  }
+  std::vector<char_ref_t> refs = list_chars();
+  CHECK(refs.size() >= (size_t)NUM_ACCS * 20);
+  check_all(refs);
+
+  // 不存在的 aid/iid
+  CHECK(!hap_get_char_by_aid_iid(1, 9999));
+  CHECK(!hap_get_char_by_aid_iid(NUM_ACCS + 1, 2));
+  CHECK(!hap_get_char_by_aid_iid(0, 0));
+  CHECK(!hap_get_char_by_aid_iid(-1, -1));
+
+  // 移除配件后索引随 acc_db_gen 重建，被移除的特征不再能查到
+  hap_acc_t *removed = bridged[10];
+  int removed_aid = hap_acc_get_aid(removed);
+  hap_remove_bridged_accessory(removed);
+  for (const char_ref_t &r : refs) {
+    if (r.aid == removed_aid) {
+      CHECK(!hap_get_char_by_aid_iid(r.aid, r.iid));
+    } else {
+      CHECK(hap_get_char_by_aid_iid(r.aid, r.iid) == r.hc);
+    }
+  }
+  // 重新加入时追加到链表末尾，不能带着原来的 next 形成环
+  hap_add_bridged_accessory(removed, removed_aid);
+  CHECK(list_chars().size() == refs.size());
+  check_all(refs);
+
+  // 索引分配失败：本代次内按链表查找，不在每次查找时重试分配；配件变化后重新建立
+  hap_remove_bridged_accessory(removed);
+  hap_add_bridged_accessory(removed, removed_aid);
+  hap_sim_fail_allocs(1);
+  CHECK(hap_get_char_by_aid_iid(refs[0].aid, refs[0].iid) == refs[0].hc);
+  uint32_t allocs = hap_sim_heap_allocs();
+  check_all(refs);
+  CHECK(!hap_get_char_by_aid_iid(1, 9999));
+  CHECK(hap_sim_heap_allocs() == allocs);
+  hap_remove_bridged_accessory(removed);
+  hap_add_bridged_accessory(removed, removed_aid);
+  check_all(refs);
+  CHECK(hap_sim_heap_allocs() == allocs + 1);
+
+  test_group_writes();
+  bench(refs);
+  printf("test_hap_acc: ok\n");
+  return 0;
+}
@@ -0,0 +1,358 @@
+#include "host_test.h"
+#include "hap_sim.h"
+#include <chrono>
+#include <string.h>
+#include <string>
+#include <vector>
+extern "C" {
+#include "esp_hap_acc.h"
+#include "esp_hap_acc_db.h"
+#include "esp_hap_char.h"
+#include "esp_hap_database.h"
+#include "esp_hap_serv.h"
+#include "hap.h"
+#include "hap_apple_chars.h"
+#include "hap_apple_servs.h"
+#include "json_parser.h"
+}
+
+// GET /accessories 的响应体：网桥带 50 个与 main/homekit.cpp 相同结构的风扇配件时，
+// - 缓存 + 拼接输出的 JSON 能解析，且每个特征的 iid、type、value、ev 与数据库一致；
+// - 值更新后下次请求立即生效且不重建缓存，增删配件后重建；
+// - 与固件原来每次请求完整生成 JSON 的方式（移植在下面）输出长度相同，并比较两者的耗时。
+
+#define NUM_ACCS 50
+#define SESSION 0
+
+static int identify(hap_acc_t *ha) { return HAP_SUCCESS; }
+
+static hap_acc_t *make_fan(int n) {
+  char name[16];
+  snprintf(name, sizeof(name), "Fan %d", n);
+  hap_acc_cfg_t cfg = {};
+  cfg.name = name;
+  cfg.model = (char *)"ESP32FAN";
+  cfg.manufacturer = (char *)"Espressif";
+  cfg.serial_num = (char *)"20240524";
+  cfg.fw_rev = (char *)"1.0";
+  cfg.pv = (char *)"1.1.0";
+  cfg.cid = HAP_CID_FAN;
+  cfg.identify_routine = identify;
+  hap_acc_t *ha = hap_acc_create(&cfg);
+  CHECK(ha);
+  CHECK(hap_acc_add_product_data(ha, (uint8_t *)"ESP32FAN", 8) == HAP_SUCCESS);
+  hap_serv_t *hs = hap_serv_fan_create(n & 1);
+  hap_char_t *speed = hap_char_rotation_speed_create(33.0f * (n % 4));
+  hap_char_float_set_constraints(speed, 0.0f, 100.0f, 33.0f);
+  CHECK(hap_serv_add_char(hs, speed) == 0);
+  CHECK(hap_serv_add_char(hs, hap_char_name_create(name)) == 0);
+  CHECK(hap_serv_add_char(hs, hap_char_rotation_direction_create(n & 1)) == 0);
+  CHECK(hap_acc_add_serv(ha, hs) == 0);
+  return ha;
+}
+
+typedef struct {
+  std::string body;
+  int chunks;
+} resp_t;
+
+static esp_err_t collect(const char *buf, size_t len, void *priv) {
+  resp_t *resp = (resp_t *)priv;
+  resp->body.append(buf, len);
+  resp->chunks++;
+  return ESP_OK;
+}
+
+// 基准中代替 httpd_resp_send_chunk()，只统计字节数
+static esp_err_t discard(const char *buf, size_t len, void *priv) {
+  *(size_t *)priv += len;
+  return ESP_OK;
+}
+
+static resp_t get_accessories(void) {
+  resp_t resp = {};
+  CHECK(hap_acc_db_send(SESSION, collect, &resp) == HAP_SUCCESS);
+  return resp;
+}
+
+// 固件原来的 hap_prepare_json_database()：每次请求完整生成，json_gen 缓冲区满一次发一个 chunk
+typedef struct {
+  hap_acc_db_send_t send;
+  void *priv;
+} full_out_t;
+
+static void full_flush(char *data, void *priv) {
+  full_out_t *out = (full_out_t *)priv;
+  out->send(data, strlen(data), out->priv);
+}
+
+static void full_char(__hap_char_t *hc, json_gen_str_t *jptr) {
+  json_gen_start_object(jptr);
+  json_gen_obj_set_int(jptr, "iid", hc->iid);
+  if (!hc->update_called) {
+    hc->owner_ctrl = 0;
+  }
+  hc->update_called = false;
+  if (hc->permission & HAP_CHAR_PERM_PR) {
+    if (hc->permission & HAP_CHAR_PERM_SPECIAL_READ) {
+      json_gen_obj_set_null(jptr, "value");
+    } else if (hc->permission & HAP_CHAR_PERM_WR) {
+      json_gen_obj_set_string(jptr, "value", "");
+    } else {
+      hap_add_char_val_json(hc->format, (char *)"value", &hc->val, jptr);
+    }
+  }
+  hap_add_char_type(hc, jptr);
+  hap_add_char_perms(hc, jptr);
+  hap_add_char_ev(hc, jptr, SESSION);
+  hap_add_char_meta(hc, jptr);
+  if (hc->valid_vals) {
+    json_gen_push_array(jptr, "valid-values");
+    for (int i = 0; i < hc->valid_vals_cnt; i++) {
+      json_gen_arr_set_int(jptr, hc->valid_vals[i]);
+    }
+    json_gen_pop_array(jptr);
+  }
+  if (hc->valid_vals_range) {
+    json_gen_push_array(jptr, "valid-values-range");
+    json_gen_arr_set_int(jptr, hc->valid_vals_range[0]);
+    json_gen_arr_set_int(jptr, hc->valid_vals_range[1]);
+    json_gen_pop_array(jptr);
+  }
+  json_gen_end_object(jptr);
+}
+
+static void full_serv(__hap_serv_t *hs, json_gen_str_t *jptr) {
+  json_gen_start_object(jptr);
+  json_gen_obj_set_int(jptr, "iid", hs->iid);
+  json_gen_obj_set_string(jptr, "type", hs->type_uuid);
+  if (hs->hidden)
+    json_gen_obj_set_bool(jptr, "hidden", true);
+  if (hs->primary)
+    json_gen_obj_set_bool(jptr, "primary", true);
+  json_gen_push_array(jptr, "characteristics");
+  std::vector<hap_read_data_t> read_arr;
+  std::vector<hap_status_t> status_codes;
+  for (hap_char_t *hc = hap_serv_get_first_char((hap_serv_t *)hs); hc; hc = hap_char_get_next(hc)) {
+    if (((__hap_char_t *)hc)->permission & HAP_CHAR_PERM_PR) {
+      hap_char_set_owner_ctrl(hc, SESSION);
+      ((__hap_char_t *)hc)->update_called = false;
+      read_arr.push_back({});
+      read_arr.back().hc = hc;
+    }
+  }
+  status_codes.assign(read_arr.size(), HAP_STATUS_SUCCESS);
+  for (size_t i = 0; i < read_arr.size(); i++) {
+    read_arr[i].status = &status_codes[i];
+  }
+  if (!read_arr.empty()) {
+    hs->bulk_read(read_arr.data(), read_arr.size(), hs->priv, NULL);
+  }
+  for (hap_char_t *hc = hap_serv_get_first_char((hap_serv_t *)hs); hc; hc = hap_char_get_next(hc)) {
+    full_char((__hap_char_t *)hc, jptr);
+  }
+  json_gen_pop_array(jptr);
+  json_gen_end_object(jptr);
+}
+
+static void full_send(hap_acc_db_send_t send, void *priv) {
+  char buf[1000];
+  full_out_t out = {send, priv};
+  json_gen_str_t jstr;
+  json_gen_str_start(&jstr, buf, sizeof(buf), full_flush, &out);
+  json_gen_start_object(&jstr);
+  json_gen_push_array(&jstr, "accessories");
+  for (hap_acc_t *ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha)) {
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_int(&jstr, "aid", hap_acc_get_aid(ha));
+    json_gen_push_array(&jstr, "services");
+    for (hap_serv_t *hs = hap_acc_get_first_serv(ha); hs; hs = hap_serv_get_next(hs)) {
+      full_serv((__hap_serv_t *)hs, &jstr);
+    }
+    json_gen_pop_array(&jstr);
+    json_gen_end_object(&jstr);
+  }
+  json_gen_pop_array(&jstr);
+  json_gen_end_object(&jstr);
+  json_gen_str_end(&jstr);
+}
+
+static void check_char(jparse_ctx_t *jctx, __hap_char_t *hc) {
+  int iid;
+  CHECK(json_obj_get_int(jctx, "iid", &iid) == OS_SUCCESS && iid == (int)hc->iid);
+  char str[64];
+  CHECK(json_obj_get_string(jctx, "type", str, sizeof(str)) == OS_SUCCESS);
+  CHECK(strcmp(str, hc->type_uuid) == 0);
+  bool ev;
+  CHECK(json_obj_get_bool(jctx, "ev", &ev) == OS_SUCCESS);
+  CHECK(ev == hap_char_is_ctrl_subscribed((hap_char_t *)hc, SESSION));
+  if (!(hc->permission & HAP_CHAR_PERM_PR) || (hc->permission & HAP_CHAR_PERM_WR)) {
+    return;
+  }
+  switch (hc->format) {
+  case HAP_CHAR_FORMAT_BOOL: {
+    bool b;
+    CHECK(json_obj_get_bool(jctx, "value", &b) == OS_SUCCESS && b == hc->val.b);
+    break;
+  }
+  case HAP_CHAR_FORMAT_UINT8:
+  case HAP_CHAR_FORMAT_UINT16:
+  case HAP_CHAR_FORMAT_UINT32:
+  case HAP_CHAR_FORMAT_INT: {
+    int i;
+    CHECK(json_obj_get_int(jctx, "value", &i) == OS_SUCCESS && i == hc->val.i);
+    break;
+  }
+  case HAP_CHAR_FORMAT_STRING:
+    CHECK(json_obj_get_string(jctx, "value", str, sizeof(str)) == OS_SUCCESS);
+    CHECK(strcmp(str, hc->val.s) == 0);
+    break;
+  case HAP_CHAR_FORMAT_DATA: {
+    int len;
+    CHECK(json_obj_get_strlen(jctx, "value", &len) == OS_SUCCESS && len > 0);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// 按数据库逐层核对解析结果，返回特征总数
+static int check_body(const std::string &body) {
+  jparse_ctx_t jctx;
+  CHECK(json_parse_start(&jctx, body.c_str(), body.size()) == OS_SUCCESS);
+  int num_accs;
+  CHECK(json_obj_get_array(&jctx, "accessories", &num_accs) == OS_SUCCESS);
+  int a = 0, num_chars = 0;
+  for (hap_acc_t *ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha), a++) {
+    CHECK(a < num_accs);
+    CHECK(json_arr_get_object(&jctx, a) == OS_SUCCESS);
+    int aid, num_servs;
+    CHECK(json_obj_get_int(&jctx, "aid", &aid) == OS_SUCCESS && aid == (int)hap_acc_get_aid(ha));
+    CHECK(json_obj_get_array(&jctx, "services", &num_servs) == OS_SUCCESS);
+    int s = 0;
+    for (hap_serv_t *hs = hap_acc_get_first_serv(ha); hs; hs = hap_serv_get_next(hs), s++) {
+      CHECK(s < num_servs);
+      CHECK(json_arr_get_object(&jctx, s) == OS_SUCCESS);
+      int iid, cnt;
+      CHECK(json_obj_get_int(&jctx, "iid", &iid) == OS_SUCCESS);
+      CHECK(iid == (int)((__hap_serv_t *)hs)->iid);
+      CHECK(json_obj_get_array(&jctx, "characteristics", &cnt) == OS_SUCCESS);
+      int c = 0;
+      for (hap_char_t *hc = hap_serv_get_first_char(hs); hc; hc = hap_char_get_next(hc), c++) {
+        CHECK(c < cnt);
+        CHECK(json_arr_get_object(&jctx, c) == OS_SUCCESS);
+        check_char(&jctx, (__hap_char_t *)hc);
+        json_arr_leave_object(&jctx);
+      }
+      CHECK(c == cnt);
+      num_chars += c;
+      json_obj_leave_array(&jctx);
+      json_arr_leave_object(&jctx);
+    }
+    CHECK(s == num_servs);
+    json_obj_leave_array(&jctx);
+    json_arr_leave_object(&jctx);
+  }
+  CHECK(a == num_accs);
+  json_parse_end(&jctx);
+  return num_chars;
+}
+
+// 每次请求的堆分配只来自按服务的批量读取（读数组和状态数组各一次）
+static uint32_t count_read_servs(void) {
+  uint32_t servs = 0;
+  for (hap_acc_t *ha = hap_get_first_acc(); ha; ha = hap_acc_get_next(ha)) {
+    for (hap_serv_t *hs = hap_acc_get_first_serv(ha); hs; hs = hap_serv_get_next(hs)) {
+      for (hap_char_t *hc = hap_serv_get_first_char(hs); hc; hc = hap_char_get_next(hc)) {
+        if (((__hap_char_t *)hc)->permission & HAP_CHAR_PERM_PR) {
+          servs++;
+          break;
+        }
+      }
+    }
+  }
+  return servs;
+}
+
+static double time_us(void (*fn)(size_t *), int iters, size_t *bytes) {
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; i++) {
+    fn(bytes);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(t1 - t0).count() / iters;
+}
+
+static void bench(void) {
+  const int iters = 2000;
+  size_t cached_bytes = 0, full_bytes = 0, cold_bytes = 0;
+  double cached = time_us([](size_t *n) { hap_acc_db_send(SESSION, discard, n); }, iters,
+                          &cached_bytes);
+  double full = time_us([](size_t *n) { full_send(discard, n); }, iters, &full_bytes);
+  // 配置变化后的第一次请求：两遍生成缓存，再输出
+  double cold = time_us(
+      [](size_t *n) {
+        hap_priv.acc_db_gen++;
+        hap_acc_db_send(SESSION, discard, n);
+      },
+      iters / 10, &cold_bytes);
+  CHECK(cached_bytes == full_bytes);
+  printf("bench_hap_acc_db: %d accessories, %zu bytes: cached %.1f us/request, full %.1f "
+         "us/request, cache rebuild + request %.1f us\n",
+         NUM_ACCS, cached_bytes / iters, cached, full, cold);
+}
+
+int main(void) {
+  hap_set_debug_level(HAP_DEBUG_LEVEL_WARN);
+  hap_add_accessory(make_fan(0));
+  std::vector<hap_acc_t *> bridged;
+  for (int n = 1; n < NUM_ACCS; n++) {
+    bridged.push_back(make_fan(n));
+    hap_add_bridged_accessory(bridged.back(), 0);
+  }
+  // 控制器订阅了部分风扇的 On
+  for (int n = 0; n < NUM_ACCS - 1; n += 3) {
+    hap_serv_t *hs = hap_acc_get_serv_by_uuid(bridged[n], HAP_SERV_UUID_FAN);
+    hap_char_manage_notification(hap_serv_get_char_by_uuid(hs, HAP_CHAR_UUID_ON), SESSION, true);
+  }
+
+  resp_t first = get_accessories();
+  int num_chars = check_body(first.body);
+  CHECK(num_chars >= NUM_ACCS * 10);
+  // 1024 字节一个 chunk，只有最后一个不满
+  CHECK(first.chunks == (int)(first.body.size() + 1023) / 1024);
+
+  resp_t full = {};
+  full_send(collect, &full);
+  CHECK(full.body.size() == first.body.size());
+  // 产品数据（data 格式）按 base64 输出
+  CHECK(first.body.find("\"value\":\"RVNQMzJGQU4=\"") != std::string::npos);
+
+  // 缓存命中：值的变化直接反映在下一次响应中
+  hap_serv_t *fan = hap_acc_get_serv_by_uuid(bridged[7], HAP_SERV_UUID_FAN);
+  hap_char_t *speed = hap_serv_get_char_by_uuid(fan, HAP_CHAR_UUID_ROTATION_SPEED);
+  hap_char_t *on = hap_serv_get_char_by_uuid(fan, HAP_CHAR_UUID_ON);
+  hap_val_t val = {.b = true};
+  CHECK(hap_char_update_val(on, &val) == HAP_SUCCESS);
+  val.f = 66.0f;
+  CHECK(hap_char_update_val(speed, &val) == HAP_SUCCESS);
+  uint32_t allocs = hap_sim_heap_allocs();
+  resp_t second = get_accessories();
+  CHECK(hap_sim_heap_allocs() - allocs == 2 * count_read_servs());
+  CHECK(check_body(second.body) == num_chars);
+  CHECK(second.body.find("\"value\":66.00000") != std::string::npos);
+
+  // 移除和重新加入配件都会重建缓存
+  int aid = hap_acc_get_aid(bridged[20]);
+  hap_remove_bridged_accessory(bridged[20]);
+  resp_t removed = get_accessories();
+  CHECK(check_body(removed.body) < num_chars);
+  CHECK(removed.body.find("\"aid\":" + std::to_string(aid) + ",") == std::string::npos);
+  hap_add_bridged_accessory(bridged[20], aid);
+  CHECK(check_body(get_accessories().body) == num_chars);
+
+  bench();
+  printf("test_hap_acc_db: ok (%zu bytes, %d chunks)\n", first.body.size(), first.chunks);
+  return 0;
+}
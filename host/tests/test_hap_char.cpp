@@ -0,0 +1,129 @@
+#include "host_test.h"
+#include "hap_sim.h"
+#include <chrono>
+#include <string.h>
+#include <string>
+extern "C" {
+#include "esp_hap_char.h"
+#include "hap.h"
+}
+
+// hap_char_update_val()：字符串原地更新、DATA 按内容哈希去重，以及 10 万次字符串更新的
+// 堆分配次数和耗时。没有调用 hap_notif_init()，每个排队的事件都直接计入 hap_sim_notif_events()
+
+static hap_val_t str_val(const char *s) {
+  hap_val_t v;
+  v.s = (char *)s;
+  return v;
+}
+
+static void test_string(void) {
+  hap_char_t *hc = hap_char_string_create((char *)"23", HAP_CHAR_PERM_PR | HAP_CHAR_PERM_EV,
+                                          (char *)"Fan");
+  CHECK(hc);
+  hap_val_t v = str_val("Fan");
+  uint32_t events = hap_sim_notif_events();
+  uint32_t allocs = hap_sim_heap_allocs();
+
+  // 相同的值：不分配，不通知
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events && hap_sim_heap_allocs() == allocs);
+
+  // 更短的值原地覆盖，更长的值才重新分配（按 16 字节取整）
+  v = str_val("Fa");
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events + 1 && hap_sim_heap_allocs() == allocs);
+  CHECK(!strcmp(hap_char_get_val(hc)->s, "Fa"));
+  v = str_val("Living room fan");
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_heap_allocs() == allocs + 1);
+  v = str_val("Bedroom fan");
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_heap_allocs() == allocs + 1);
+  CHECK(!strcmp(hap_char_get_val(hc)->s, "Bedroom fan"));
+  CHECK(hap_sim_notif_events() == events + 3);
+
+  // 清空后再设置
+  v = str_val(NULL);
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(!hap_char_get_val(hc)->s);
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events + 4);
+  v = str_val("Fan");
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(!strcmp(hap_char_get_val(hc)->s, "Fan"));
+  CHECK(hap_sim_notif_events() == events + 5);
+
+  // 超过 64 KiB 的字符串：容量不能截断，否则会被当成放不下而重新分配
+  std::string big(70000, 'a');
+  v = str_val(big.c_str());
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  allocs = hap_sim_heap_allocs();
+  big.assign(69000, 'b');
+  v = str_val(big.c_str());
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_heap_allocs() == allocs);
+  CHECK(strlen(hap_char_get_val(hc)->s) == 69000);
+  hap_char_delete(hc);
+}
+
+static void test_data(void) {
+  uint8_t a[4] = {1, 2, 3, 4};
+  uint8_t b[4] = {1, 2, 3, 4};
+  hap_data_val_t d = {a, sizeof(a)};
+  hap_char_t *hc = hap_char_data_create((char *)"E3", HAP_CHAR_PERM_PR | HAP_CHAR_PERM_EV, &d);
+  CHECK(hc);
+  uint32_t events = hap_sim_notif_events();
+  hap_val_t v;
+
+  // 另一个缓冲区，内容相同：不通知
+  v.d = {b, sizeof(b)};
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events);
+  CHECK(hap_char_get_val(hc)->d.buf == b);
+
+  // 应用原地修改了缓冲区：和上次内容的哈希比较，能发现变化
+  b[2] = 9;
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events + 1);
+
+  // 长度变化
+  v.d = {b, 3};
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events + 2);
+  hap_char_delete(hc);
+}
+
+// 固件中字符串特征周期性更新（例如状态文本）。原来每次更新都 free + strdup，
+// 这里统计 10 万次更新的分配次数，并和每次都分配的次数对比
+static void bench_string(void) {
+  static const char *values[] = {"idle", "speed 1", "speed 2", "speed 3, timer 00:59:59",
+                                 "speed 3, timer 01:00:00 remaining"};
+  hap_char_t *hc = hap_char_string_create((char *)"23", HAP_CHAR_PERM_PR | HAP_CHAR_PERM_EV,
+                                          (char *)"idle");
+  const int updates = 100000;
+  uint32_t allocs = hap_sim_heap_allocs();
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < updates; i++) {
+    hap_val_t v = str_val(values[(i + 1) % 5]);
+    CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0)
+                  .count() /
+              updates;
+  uint32_t used = hap_sim_heap_allocs() - allocs;
+  // 缓冲区只在第一次遇到更长的值时增长：5 -> 16 -> 32 -> 48 字节
+  CHECK(used == 3);
+  printf("bench_hap_char: %d string updates: %u heap allocations (%d before), %.1f ns/update\n",
+         updates, used, updates, ns);
+  hap_char_delete(hc);
+}
+
+int main(void) {
+  hap_set_debug_level(HAP_DEBUG_LEVEL_WARN);
+  test_string();
+  test_data();
+  bench_string();
+  printf("test_hap_char: ok\n");
+  return 0;
+}
@@ -0,0 +1,178 @@
+#include "host_test.h"
+#include <chrono>
+#include <random>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+extern "C" {
+#include "esp_hap_char_query.h"
+#include "hap.h"
+}
+
+// GET /characteristics 查询串解析器的单元测试、变异模糊测试和 1/20/100 个 id 的解析基准。
+
+typedef std::vector<std::pair<int, int>> ids_t;
+
+// 和 esp_hap_ip_services.c 中的处理流程相同：先解析查询串，再逐个解码 id 列表
+static bool parse_uri(const char *uri, hap_char_query_t *q, ids_t *ids) {
+  if (hap_parse_char_query(uri, q) != HAP_SUCCESS)
+    return false;
+  const char *p = q->id;
+  if (p >= q->id_end)
+    return false;
+  while (p < q->id_end) {
+    int aid, iid;
+    if (!hap_parse_char_id(&p, q->id_end, &aid, &iid))
+      return false;
+    // id 列表必须位于 URI 内部，并且每次都要前进
+    CHECK(p > q->id && p <= uri + strlen(uri));
+    if (ids)
+      ids->push_back({aid, iid});
+  }
+  return true;
+}
+
+static void test_valid(void) {
+  hap_char_query_t q;
+  ids_t ids;
+  CHECK(parse_uri("/characteristics?id=1.10", &q, &ids));
+  CHECK(ids == ids_t({{1, 10}}));
+  CHECK(!q.meta && !q.perms && !q.type && !q.ev);
+
+  ids.clear();
+  CHECK(parse_uri("/characteristics?meta=1&id=1.10,2.11,123456789.987654321&perms=true&type=0&ev=1",
+                  &q, &ids));
+  CHECK(ids == ids_t({{1, 10}, {2, 11}, {123456789, 987654321}}));
+  CHECK(q.meta && q.perms && !q.type && q.ev);
+
+  // 未知参数、空参数和重复的 id 参数：以最后一个 id 为准
+  ids.clear();
+  CHECK(parse_uri("/characteristics?foo=bar&&id=9.9&x&id=3.4", &q, &ids));
+  CHECK(ids == ids_t({{3, 4}}));
+
+  // "true"/"1" 以外的值都视为 false
+  CHECK(parse_uri("/characteristics?id=1.1&meta=TRUE&perms=10&type=truex&ev=", &q, NULL));
+  CHECK(!q.meta && !q.perms && !q.type && !q.ev);
+}
+
+static void test_invalid(void) {
+  const char *bad[] = {
+      "/characteristics",
+      "/characteristics?",
+      "/characteristics?meta=1",
+      "/characteristics?id=",
+      "/characteristics?id",
+      "/characteristics?id=1",
+      "/characteristics?id=1.",
+      "/characteristics?id=.1",
+      "/characteristics?id=1.1,",
+      "/characteristics?id=1.1,,2.2",
+      "/characteristics?id=1.1;2.2",
+      "/characteristics?id=-1.1",
+      "/characteristics?id=1.1.1",
+      "/characteristics?id=1234567890.1",
+      "/characteristics?id=1.1234567890",
+      "/characteristics?id=1.1 ",
+      "/characteristics?id=a.b",
+  };
+  hap_char_query_t q;
+  for (const char *uri : bad) {
+    if (parse_uri(uri, &q, NULL)) {
+      printf("accepted: %s\n", uri);
+      CHECK(false);
+    }
+  }
+  CHECK(hap_parse_char_query(NULL, &q) == HAP_FAIL);
+}
+
+// 变异模糊测试：随机替换、插入、删除、截断字符。每个变异串都复制到刚好大小的堆缓冲中，
+// 配合 -DFAN_HOST_SANITIZE=address,undefined 运行可发现越过字符串末尾的读取
+static void test_fuzz(void) {
+  const std::string seeds[] = {
+      "/characteristics?id=1.10,1.11,2.12&meta=1&perms=1&type=1&ev=1",
+      "/characteristics?ev=true&id=123456789.1",
+      "/characteristics?x=&&id=1.1,2.2,3.3,4.4,5.5",
+  };
+  const char alphabet[] = "0123456789.,&=?idmetapersvyx1";
+  std::mt19937 rng(4321);
+  int accepted = 0;
+  for (int iter = 0; iter < 100000; iter++) {
+    std::string s = seeds[rng() % 3];
+    int edits = 1 + rng() % 6;
+    for (int e = 0; e < edits && !s.empty(); e++) {
+      size_t pos = rng() % s.size();
+      char c = rng() % 4 ? alphabet[rng() % (sizeof(alphabet) - 1)] : (char)(1 + rng() % 255);
+      switch (rng() % 4) {
+      case 0:
+        s[pos] = c;
+        break;
+      case 1:
+        s.insert(s.begin() + pos, c);
+        break;
+      case 2:
+        s.erase(pos, 1 + rng() % 4);
+        break;
+      default:
+        s.resize(pos);
+        break;
+      }
+    }
+    std::vector<char> exact(s.begin(), s.end());
+    exact.push_back('\0');
+    hap_char_query_t q;
+    ids_t ids;
+    if (parse_uri(exact.data(), &q, &ids)) {
+      accepted++;
+      for (auto &id : ids)
+        CHECK(id.first >= 0 && id.first <= 999999999 && id.second >= 0 &&
+              id.second <= 999999999);
+    }
+  }
+  printf("test_hap_char_query: fuzz accepted %d of 100000 mutated URIs\n", accepted);
+}
+
+static std::string make_uri(int n) {
+  std::string s = "/characteristics?id=";
+  for (int i = 0; i < n; i++) {
+    char item[32];
+    snprintf(item, sizeof(item), "%s%d.%d", i ? "," : "", 1 + i / 20, 10 + i);
+    s += item;
+  }
+  return s + "&meta=1&perms=1&type=1&ev=1";
+}
+
+// 固件每个请求解码两遍 id 列表（计数一遍、读取一遍），这里同样计两遍
+static void bench(void) {
+  for (int n : {1, 20, 100}) {
+    std::string uri = make_uri(n);
+    int iterations = 2000000 / n;
+    long sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      hap_char_query_t q;
+      CHECK(hap_parse_char_query(uri.c_str(), &q) == HAP_SUCCESS);
+      for (int pass = 0; pass < 2; pass++) {
+        const char *p = q.id;
+        int aid, iid;
+        while (p < q.id_end && hap_parse_char_id(&p, q.id_end, &aid, &iid))
+          sum += aid + iid;
+      }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0)
+                    .count() /
+                iterations;
+    CHECK(sum > 0);
+    printf("bench_hap_char_query: %3d ids, %4zu bytes: %8.0f ns/query, %5.1f ns/id\n", n,
+           uri.size(), ns, ns / n);
+  }
+}
+
+int main(void) {
+  test_valid();
+  test_invalid();
+  test_fuzz();
+  bench();
+  printf("test_hap_char_query: ok\n");
+  return 0;
+}
@@ -0,0 +1,224 @@
+#include "hap_test_session.h"
+#include <chrono>
+#include <thread>
+extern "C" {
+#include "esp_hap_network_io.h"
+}
+
+// HAP 记录层。接收端：8 个会话各自的加密流交错读取，每次读取只返回随机的一小段，
+// 调用方缓冲区有时放得下整帧（直接解密到调用方），有时放不下（留在会话的 rx_frame 中分段取走）。
+// 每个会话解出的明文必须逐字节一致；篡改的帧使会话失效。
+// 发送端：64/256/1024 字节的写入逐次发送与 cork 合并发送的吞吐、帧数和套接字写入次数。
+
+#define NUM_SESSIONS 8
+#define STREAM_BYTES 64 * 1024
+
+typedef struct {
+  std::vector<uint8_t> wire;
+  size_t pos;
+  std::mt19937 *rng;
+  int max_chunk;
+} wire_reader_t;
+
+// 模拟套接字：每次最多返回 max_chunk 字节，读完返回 0
+static int wire_read(uint8_t *buf, int buf_size, void *context) {
+  wire_reader_t *r = (wire_reader_t *)context;
+  size_t left = r->wire.size() - r->pos;
+  size_t n = std::min<size_t>({(size_t)buf_size, left, (size_t)(1 + (*r->rng)() % r->max_chunk)});
+  memcpy(buf, &r->wire[r->pos], n);
+  r->pos += n;
+  return (int)n;
+}
+
+// 按 HAP 帧格式加密：<2 字节小端长度，作为 AAD><密文><16 字节 tag>，nonce 为 4 字节 0 加 8 字节计数
+static void seal_frame(std::vector<uint8_t> &wire, const uint8_t *key, uint64_t counter,
+                       const uint8_t *plain, int len) {
+  uint8_t nonce[crypto_aead_chacha20poly1305_ietf_NPUBBYTES] = {0};
+  put_u64_le(nonce + 4, counter);
+  size_t at = wire.size();
+  wire.resize(at + 2 + len + crypto_aead_chacha20poly1305_ietf_ABYTES);
+  put_u16_le(&wire[at], len);
+  unsigned long long tag_len;
+  crypto_aead_chacha20poly1305_ietf_encrypt_detached(&wire[at + 2], &wire[at + 2 + len], &tag_len,
+                                                     plain, len, &wire[at], 2, NULL, nonce, key);
+}
+
+typedef struct {
+  hap_secure_session_t session;
+  wire_reader_t reader;
+  std::vector<uint8_t> plain;
+  std::vector<uint8_t> out;
+  int frames;
+} test_session_t;
+
+static void make_stream(test_session_t *ts, std::mt19937 &rng) {
+  memset(&ts->session, 0, sizeof(ts->session));
+  ts->session.state = STATE_VERIFIED;
+  for (uint8_t &b : ts->session.decrypt_key) {
+    b = rng();
+  }
+  ts->plain.resize(STREAM_BYTES);
+  for (uint8_t &b : ts->plain) {
+    b = rng();
+  }
+  ts->reader = {{}, 0, &rng, 1 + (int)(rng() % 200)};
+  ts->frames = 0;
+  for (size_t at = 0; at < ts->plain.size();) {
+    int len = std::min<size_t>(1 + rng() % HAP_MAX_NW_FRAME_SIZE, ts->plain.size() - at);
+    seal_frame(ts->reader.wire, ts->session.decrypt_key, ts->frames++, &ts->plain[at], len);
+    at += len;
+  }
+}
+
+static void test_interleaved(void) {
+  std::mt19937 rng(15);
+  static test_session_t sessions[NUM_SESSIONS];
+  for (test_session_t &ts : sessions) {
+    make_stream(&ts, rng);
+  }
+  int calls = 0, partial = 0;
+  while (true) {
+    std::vector<test_session_t *> pending;
+    for (test_session_t &ts : sessions) {
+      if (ts.out.size() < ts.plain.size()) {
+        pending.push_back(&ts);
+      }
+    }
+    if (pending.empty()) {
+      break;
+    }
+    test_session_t *ts = pending[rng() % pending.size()];
+    // 小缓冲区走分段取出，大缓冲区走直接解密
+    static const int sizes[] = {1, 7, 64, 100, 512, 1023, 1024, 1500};
+    uint8_t buf[1500];
+    int size = sizes[rng() % (sizeof(sizes) / sizeof(sizes[0]))];
+    bool mid_frame = ts->session.rx_frame.bytes_read != ts->session.rx_frame.pkt_size;
+    int n =
+        hap_decrypt_data(&ts->session.rx_frame, &ts->session, buf, size, wire_read, &ts->reader);
+    CHECK(n > 0 && n <= size);
+    ts->out.insert(ts->out.end(), buf, buf + n);
+    calls++;
+    partial += mid_frame;
+  }
+  for (test_session_t &ts : sessions) {
+    CHECK(ts.out == ts.plain);
+    CHECK(ts.reader.pos == ts.reader.wire.size());
+    CHECK(get_u64_le(ts.session.decrypt_nonce) == (uint64_t)ts.frames);
+    CHECK(ts.session.state == STATE_VERIFIED);
+  }
+  printf("test_interleaved: %d sessions, %d reads, %d from a partly consumed frame\n",
+         NUM_SESSIONS, calls, partial);
+}
+
+// 改动密文或长度超过帧上限：解密失败，会话标记为无效
+static void test_tampered(void) {
+  std::mt19937 rng(16);
+  static test_session_t ts;
+  make_stream(&ts, rng);
+  ts.reader.wire[2 + 10] ^= 1;
+  uint8_t buf[1500];
+  CHECK(hap_decrypt_data(&ts.session.rx_frame, &ts.session, buf, sizeof(buf), wire_read,
+                         &ts.reader) < 0);
+  CHECK(ts.session.state == STATE_INVALID);
+
+  make_stream(&ts, rng);
+  put_u16_le(&ts.reader.wire[0], HAP_MAX_NW_FRAME_SIZE + 1);
+  CHECK(hap_decrypt_data(&ts.session.rx_frame, &ts.session, buf, sizeof(buf), wire_read,
+                         &ts.reader) < 0);
+  CHECK(ts.session.state == STATE_INVALID);
+
+  // 读到第一帧的 tag 中间连接就断开
+  make_stream(&ts, rng);
+  ts.reader.wire.resize(2 + get_u16_le(&ts.reader.wire[0]) + 8);
+  CHECK(hap_decrypt_data(&ts.session.rx_frame, &ts.session, buf, sizeof(buf), wire_read,
+                         &ts.reader) < 0);
+  CHECK(ts.session.state == STATE_INVALID);
+}
+
+#define BENCH_PORT 18015
+#define BENCH_BYTES (4 * 1024 * 1024)
+#define BENCH_MSG_BYTES 4096 // cork 时每条消息（一次响应或事件）的大小
+
+static uint8_t bench_byte(uint64_t i) { return (uint8_t)(i * 31 + 7); }
+
+// 服务线程按 write_size 写出 BENCH_BYTES 字节，corked 时每 BENCH_MSG_BYTES 字节 cork/uncork 一次；
+// 客户端解密并逐字节核对。端到端吞吐包含客户端解密，发送端 CPU 只计服务线程的加密和 sendmsg
+static void bench_writer_case(hap_test_client_t *c, int write_size, bool corked) {
+  uint64_t frames0 = c->frames, wire0 = c->wire_bytes;
+  uint64_t writes0 = hap_test_metric("hap_tx_socket_writes_total");
+  bool ok = true;
+  std::thread reader([&] {
+    std::string plain;
+    for (uint64_t got = 0; got < BENCH_BYTES && ok;) {
+      ok = hap_test_read_frame(c, &plain);
+      for (size_t i = 0; ok && i < plain.size(); i++) {
+        ok = (uint8_t)plain[i] == bench_byte(got + i);
+      }
+      got += plain.size();
+    }
+  });
+  auto t0 = std::chrono::steady_clock::now();
+  double send_cpu = 0;
+  hap_test_on_server([&] {
+    struct timespec cpu0, cpu1;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+    std::vector<uint8_t> buf(BENCH_MSG_BYTES);
+    int fd = c->sess->conn_identifier;
+    for (uint64_t at = 0; at < BENCH_BYTES; at += BENCH_MSG_BYTES) {
+      for (int i = 0; i < BENCH_MSG_BYTES; i++) {
+        buf[i] = bench_byte(at + i);
+      }
+      if (corked) {
+        hap_httpd_cork(fd);
+      }
+      for (int i = 0; i < BENCH_MSG_BYTES; i += write_size) {
+        CHECK(hap_httpd_send(hap_priv.server, fd, (const char *)&buf[i], write_size, 0) ==
+              write_size);
+      }
+      if (corked) {
+        CHECK(hap_httpd_uncork(fd) == HAP_SUCCESS);
+      }
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+    send_cpu = (cpu1.tv_sec - cpu0.tv_sec) + (cpu1.tv_nsec - cpu0.tv_nsec) / 1e9;
+  });
+  reader.join();
+  auto t1 = std::chrono::steady_clock::now();
+  CHECK(ok);
+
+  uint64_t writes = BENCH_BYTES / write_size, msgs = BENCH_BYTES / BENCH_MSG_BYTES;
+  uint64_t frames = c->frames - frames0;
+  uint64_t sock_writes = hap_test_metric("hap_tx_socket_writes_total") - writes0;
+  double sec = std::chrono::duration<double>(t1 - t0).count();
+  printf("bench_writer: %4d B writes, %-8s %6.1f MB/s end to end, %6.1f MB/s of sender CPU, "
+         "%6llu frames, %6llu socket writes, wire/plain %.3f\n",
+         write_size, corked ? "corked" : "uncorked", BENCH_BYTES / sec / 1e6,
+         BENCH_BYTES / send_cpu / 1e6, (unsigned long long)frames, (unsigned long long)sock_writes,
+         (double)(c->wire_bytes - wire0) / BENCH_BYTES);
+  if (corked) {
+    // 每条消息装满 1024 字节的帧，每次 sendmsg 带 2 帧
+    uint64_t msg_frames = BENCH_MSG_BYTES / HAP_MAX_NW_FRAME_SIZE;
+    CHECK(frames == msgs * msg_frames);
+    CHECK(sock_writes == msgs * ((msg_frames + 1) / 2));
+  } else {
+    CHECK(frames == writes && sock_writes == writes);
+  }
+}
+
+static void bench_writer(void) {
+  hap_test_start_server(BENCH_PORT);
+  std::vector<hap_test_client_t> clients = hap_test_connect(BENCH_PORT, 1, 17);
+  for (int size : {64, 256, 1024}) {
+    bench_writer_case(&clients[0], size, false);
+    bench_writer_case(&clients[0], size, true);
+  }
+}
+
+int main(void) {
+  CHECK(sodium_init() >= 0);
+  test_interleaved();
+  test_tampered();
+  bench_writer();
+  printf("test_hap_network_io: ok\n");
+  return 0;
+}
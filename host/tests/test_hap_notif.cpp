@@ -0,0 +1,184 @@
+#include "host_test.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "hap_sim.h"
+#include <chrono>
+#include <random>
+#include <string.h>
+extern "C" {
+#include "esp_hap_char.h"
+#include "hap.h"
+}
+
+// 事件通知：
+// - 按订阅集合分组：hap_notif_group() 与逐对比较的结果一致性，以及 16 个会话时一次通知
+//   （分组 + 生成事件体）的基准。这里用 snprintf 生成与 hap_send_notification() 相同结构的
+//   事件体，只比较分组的效果；加密发送的完整路径见 test_hap_notif_send.cpp。
+// - 从 hap_char_update_val() 到合并定时器触发、再到 hap_get_next_notif_char() 取出待通知特征，
+//   10000 次更新不分配堆内存。
+
+#define NUM_SESSIONS 16
+#define NUM_CHARS 8
+
+// 会话 a 和 b 收到的特征集合是否相同
+static bool same_chars(const uint16_t *recipients, int num_chars, int a, int b) {
+  for (int j = 0; j < num_chars; j++) {
+    if (((recipients[j] >> a) ^ (recipients[j] >> b)) & 1)
+      return false;
+  }
+  return true;
+}
+
+static void test_group(void) {
+  std::mt19937 rng(99);
+  for (int iter = 0; iter < 100000; iter++) {
+    uint16_t recipients[NUM_CHARS];
+    int num_chars = 1 + rng() % NUM_CHARS;
+    // 订阅集合只从几种里选，保证经常出现相同的会话
+    uint16_t patterns[4];
+    for (uint16_t &p : patterns)
+      p = rng();
+    for (int j = 0; j < num_chars; j++)
+      recipients[j] = rng() % 4 ? patterns[rng() % 4] : (uint16_t)rng();
+    uint16_t pending = rng();
+    if (!pending)
+      continue;
+    int first = __builtin_ctz(pending);
+    uint16_t expected = 0;
+    for (int k = 0; k < NUM_SESSIONS; k++) {
+      if ((pending & (1 << k)) && same_chars(recipients, num_chars, first, k))
+        expected |= 1 << k;
+    }
+    CHECK(hap_notif_group(recipients, num_chars, pending, first) == expected);
+  }
+  // 没有特征时所有待发送的会话都在同一组
+  CHECK(hap_notif_group(NULL, 0, 0xf0f0, 4) == 0xf0f0);
+}
+
+// 一次通知的工作量：按组（或按会话）生成事件体，返回生成的事件体个数
+static int flush(const uint16_t *recipients, bool grouped, char *body, size_t body_size) {
+  uint16_t notify = 0;
+  for (int j = 0; j < NUM_CHARS; j++)
+    notify |= recipients[j];
+  uint16_t done = 0;
+  int bodies = 0;
+  for (int i = 0; i < NUM_SESSIONS; i++) {
+    if (!(notify & ~done & (1 << i)))
+      continue;
+    done |= grouped ? hap_notif_group(recipients, NUM_CHARS, notify & ~done, i) : 1 << i;
+    int len = snprintf(body, body_size, "{\"characteristics\":[");
+    for (int j = 0; j < NUM_CHARS; j++) {
+      if (!(recipients[j] & (1 << i)))
+        continue;
+      len += snprintf(body + len, body_size - len, "%s{\"aid\":%d,\"iid\":%d,\"value\":%d}",
+                      body[len - 1] == '[' ? "" : ",", 1 + j / 4, 10 + j, j * 7);
+    }
+    snprintf(body + len, body_size - len, "]}");
+    bodies++;
+  }
+  return bodies;
+}
+
+static void bench(void) {
+  struct {
+    const char *name;
+    uint16_t recipients[NUM_CHARS];
+  } cases[] = {
+      // 所有会话订阅全部特征
+      {"all same", {0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff}},
+      // 四类控制器，各订阅两个特征
+      {"4 groups", {0x000f, 0x000f, 0x00f0, 0x00f0, 0x0f00, 0x0f00, 0xf000, 0xf000}},
+      // 每个会话的订阅集合都不同
+      {"distinct", {0xaaaa, 0xcccc, 0xf0f0, 0xff00, 0x5555, 0x3333, 0x0f0f, 0x00ff}},
+  };
+  char body[1024];
+  const int flushes = 200000;
+  for (auto &c : cases) {
+    double ns[2];
+    int bodies[2];
+    for (int grouped = 0; grouped < 2; grouped++) {
+      auto t0 = std::chrono::steady_clock::now();
+      for (int n = 0; n < flushes; n++)
+        bodies[grouped] = flush(c.recipients, grouped, body, sizeof(body));
+      ns[grouped] =
+          std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() /
+          flushes;
+    }
+    printf("bench_hap_notif: %d sessions, %-8s: grouped %2d bodies %6.0f ns/flush, per session "
+           "%2d bodies %6.0f ns/flush\n",
+           NUM_SESSIONS, c.name, bodies[1], ns[1], bodies[0], ns[0]);
+  }
+}
+
+static int identify(hap_acc_t *ha) { return HAP_SUCCESS; }
+
+static void test_update_no_alloc(void) {
+  hap_acc_cfg_t cfg = {};
+  cfg.name = (char *)"Fan";
+  cfg.model = (char *)"ESP32-FAN";
+  cfg.manufacturer = (char *)"Espressif";
+  cfg.serial_num = (char *)"001122334455";
+  cfg.fw_rev = (char *)"1.0.0";
+  cfg.cid = HAP_CID_FAN;
+  cfg.identify_routine = identify;
+  hap_acc_t *ha = hap_acc_create(&cfg);
+  hap_serv_t *hs = hap_serv_create((char *)"B7");
+  hap_char_t *chars[NUM_CHARS];
+  for (int j = 0; j < NUM_CHARS; j++) {
+    chars[j] = hap_char_int_create((char *)"29", HAP_CHAR_PERM_PR | HAP_CHAR_PERM_EV, 0);
+    CHECK(hap_serv_add_char(hs, chars[j]) == 0);
+  }
+  CHECK(hap_acc_add_serv(ha, hs) == 0);
+  hap_add_accessory(ha);
+  CHECK(hap_notif_init() == HAP_SUCCESS);
+
+  // 10000 次更新分布在 8 个特征上：每个合并窗口最多通知一次，不分配内存
+  uint32_t allocs = hap_sim_heap_allocs();
+  uint32_t events = hap_sim_notif_events();
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < 10000; i++) {
+    hap_val_t v;
+    v.i = i + 1;
+    CHECK(hap_char_update_val(chars[i % NUM_CHARS], &v) == HAP_SUCCESS);
+  }
+  int64_t elapsed_ms = (esp_timer_get_time() - start) / 1000;
+  CHECK(WAIT_UNTIL(hap_sim_notif_events() > events, 1000));
+  vTaskDelay(pdMS_TO_TICKS(100));
+  CHECK(hap_sim_notif_events() - events <= elapsed_ms / 20 + 1);
+
+  // 通知任务取出全部 8 个待通知特征，值是最后一次更新的值
+  int pending = 0;
+  for (hap_char_t *hc = hap_get_next_notif_char(NULL); hc; hc = hap_get_next_notif_char(hc)) {
+    __hap_char_t *_hc = (__hap_char_t *)hc;
+    CHECK(_hc->val.i > 10000 - NUM_CHARS);
+    _hc->notif_dirty = false;
+    pending++;
+  }
+  CHECK(pending == NUM_CHARS);
+  CHECK(hap_sim_heap_allocs() == allocs);
+
+  // 持续更新不能无限推迟通知：每个合并窗口（20 ms）至少通知一次
+  events = hap_sim_notif_events();
+  start = esp_timer_get_time();
+  int n = 0;
+  while (esp_timer_get_time() - start < 300 * 1000) {
+    hap_val_t v;
+    v.i = ++n;
+    CHECK(hap_char_update_val(chars[0], &v) == HAP_SUCCESS);
+    esp_rom_delay_us(1000);
+  }
+  CHECK(hap_sim_notif_events() - events >= 5);
+  CHECK(hap_sim_heap_allocs() == allocs);
+  printf("test_hap_notif: %d updates in 300 ms gave %u notifications\n", n,
+         hap_sim_notif_events() - events);
+  hap_notif_deinit();
+}
+
+int main(void) {
+  hap_set_debug_level(HAP_DEBUG_LEVEL_WARN);
+  test_group();
+  test_update_no_alloc();
+  bench();
+  printf("test_hap_notif: ok\n");
+  return 0;
+}
@@ -0,0 +1,227 @@
+#include "hap_sim.h"
+#include "hap_test_session.h"
+#include <map>
+#include <thread>
+extern "C" {
+#include "esp_hap_char.h"
+#include "esp_hap_ip_services.h"
+#include "esp_hap_network_io.h"
+#include "hap.h"
+}
+
+// 事件通知的发送路径：hap_char_update_val() 触发 hap_send_notification()，在服务线程中用预先分配的
+// 缓冲区生成事件体，加密后发给订阅的会话。10000 次通知不分配堆内存，客户端解密出的每条事件
+// 只含订阅的特征，值与更新顺序一致。
+// 每条事件在连接上的开销：现在整条消息 cork 成一帧、一次写入；对比原来的三次 hap_httpd_send
+// （响应头、空行、事件体）各自加密成帧并单独写入。
+
+#define PORT 18022
+#define NUM_CLIENTS 4
+#define NUM_CHARS 8
+#define NUM_UPDATES 10000
+
+// 客户端 k 订阅的特征：两个订阅全部，一个订阅偶数号，一个订阅前一半
+static bool subscribed(int k, int j) {
+  switch (k) {
+  case 2:
+    return j % 2 == 0;
+  case 3:
+    return j < NUM_CHARS / 2;
+  default:
+    return true;
+  }
+}
+
+typedef struct {
+  hap_test_client_t *c;
+  int index;
+  uint64_t target; // 应收到的事件数
+  uint64_t events;
+  std::map<int, int> last; // iid -> 最后收到的值
+  bool ok;
+} event_reader_t;
+
+// 从解密后的字节流中取出 EVENT 消息，检查每条事件体中的特征和值
+static void read_events(event_reader_t *r, const int *iids) {
+  std::string text, plain;
+  r->ok = true;
+  while (r->ok && r->events < r->target) {
+    size_t end = text.find("\r\n\r\n");
+    const char *len_hdr = "Content-Length: ";
+    size_t at = text.find(len_hdr);
+    if (end != std::string::npos && at != std::string::npos && at < end) {
+      size_t body_len = strtoul(text.c_str() + at + strlen(len_hdr), NULL, 10);
+      if (text.size() >= end + 4 + body_len) {
+        std::string body = text.substr(end + 4, body_len);
+        r->ok = text.compare(0, 17, "EVENT/1.0 200 OK\r") == 0 && body.back() == '}';
+        int iid, value, n = 0;
+        for (const char *p = body.c_str(); (p = strstr(p, "\"iid\":")); p++, n++) {
+          r->ok = r->ok && sscanf(p, "\"iid\":%d,\"value\":%d", &iid, &value) == 2;
+          int j = std::find(iids, iids + NUM_CHARS, iid) - iids;
+          r->ok = r->ok && j < NUM_CHARS && subscribed(r->index, j) && value > r->last[iid];
+          r->last[iid] = value;
+        }
+        // 每次更新之后都等通知发出，一条事件只有一个特征
+        r->ok = r->ok && n == 1;
+        r->events++;
+        text.erase(0, end + 4 + body_len);
+        continue;
+      }
+    }
+    r->ok = r->ok && hap_test_read_frame(r->c, &plain);
+    text += plain;
+  }
+}
+
+// 读出一条完整的事件消息，返回用到的帧数
+static int read_event(hap_test_client_t *c, std::string *msg) {
+  std::string plain;
+  int frames = 0;
+  msg->clear();
+  size_t end;
+  while ((end = msg->find("\r\n\r\n")) == std::string::npos ||
+         msg->size() < end + 4 + strtoul(strstr(msg->c_str(), "Content-Length: ") + 16, NULL, 10)) {
+    CHECK(hap_test_read_frame(c, &plain));
+    *msg += plain;
+    frames++;
+  }
+  return frames;
+}
+
+#define TCP_IP_HDR_BYTES 40 // IPv4 + TCP 头，不含选项
+
+static void bench_event_wire(hap_test_client_t *c, hap_char_t *hc) {
+  hap_val_t v;
+  v.i = -1;
+  uint64_t writes0 = hap_test_metric("hap_tx_socket_writes_total");
+  uint64_t wire0 = c->wire_bytes;
+  CHECK(hap_char_update_val(hc, &v) == HAP_SUCCESS);
+  hap_test_on_server([] {});
+  std::string msg;
+  int frames = read_event(c, &msg);
+  uint64_t writes = hap_test_metric("hap_tx_socket_writes_total") - writes0;
+  uint64_t wire = c->wire_bytes - wire0;
+
+  // 原来的写法：响应头、空行和事件体分三次发送
+  size_t hdr_end = msg.find("\r\n\r\n") + 2;
+  writes0 = hap_test_metric("hap_tx_socket_writes_total");
+  wire0 = c->wire_bytes;
+  int fd = c->sess->conn_identifier;
+  hap_test_on_server([&] {
+    hap_httpd_send(hap_priv.server, fd, msg.data(), hdr_end, 0);
+    hap_httpd_send(hap_priv.server, fd, "\r\n", 2, 0);
+    hap_httpd_send(hap_priv.server, fd, msg.data() + hdr_end + 2, msg.size() - hdr_end - 2, 0);
+  });
+  std::string old_msg;
+  int old_frames = read_event(c, &old_msg);
+  uint64_t old_writes = hap_test_metric("hap_tx_socket_writes_total") - writes0;
+  uint64_t old_wire = c->wire_bytes - wire0;
+
+  CHECK(old_msg == msg);
+  CHECK(frames == 1 && writes == 1);
+  CHECK(old_frames == 3 && old_writes == 3);
+  CHECK(old_wire == wire + 2 * (2 + crypto_aead_chacha20poly1305_ietf_ABYTES));
+  printf("bench_event_wire: %zu B event; 3 writes: %d frames, %llu socket writes, %llu B HAP "
+         "(%llu B with TCP/IPv4 headers); corked: %d frame, %llu socket write, %llu B HAP "
+         "(%llu B)\n",
+         msg.size(), old_frames, (unsigned long long)old_writes, (unsigned long long)old_wire,
+         (unsigned long long)(old_wire + old_writes * TCP_IP_HDR_BYTES), frames,
+         (unsigned long long)writes, (unsigned long long)wire,
+         (unsigned long long)(wire + writes * TCP_IP_HDR_BYTES));
+}
+
+static int identify(hap_acc_t *ha) { return HAP_SUCCESS; }
+
+static void test_send_no_alloc(void) {
+  hap_acc_cfg_t cfg = {};
+  cfg.name = (char *)"Fan";
+  cfg.model = (char *)"ESP32-FAN";
+  cfg.manufacturer = (char *)"Espressif";
+  cfg.serial_num = (char *)"001122334455";
+  cfg.fw_rev = (char *)"1.0.0";
+  cfg.cid = HAP_CID_FAN;
+  cfg.identify_routine = identify;
+  hap_acc_t *ha = hap_acc_create(&cfg);
+  hap_serv_t *hs = hap_serv_create((char *)"B7");
+  hap_char_t *chars[NUM_CHARS];
+  int iids[NUM_CHARS];
+  for (int j = 0; j < NUM_CHARS; j++) {
+    chars[j] = hap_char_int_create((char *)"29", HAP_CHAR_PERM_PR | HAP_CHAR_PERM_EV, 0);
+    CHECK(hap_serv_add_char(hs, chars[j]) == 0);
+  }
+  CHECK(hap_acc_add_serv(ha, hs) == 0);
+  hap_add_accessory(ha);
+  for (int j = 0; j < NUM_CHARS; j++) {
+    iids[j] = hap_char_get_iid(chars[j]);
+  }
+
+  // 每次更新立即通知，不限制会话的通知间隔
+  hap_priv.cfg.notif_coalesce_ms = 0;
+  hap_priv.cfg.notif_min_interval_ms = 0;
+  CHECK(hap_notif_init() == HAP_SUCCESS);
+  CHECK(hap_http_notif_init() == HAP_SUCCESS);
+  hap_sim_set_notif_handler(hap_http_send_notif);
+
+  hap_test_start_server(PORT);
+  std::vector<hap_test_client_t> clients = hap_test_connect(PORT, NUM_CLIENTS, 22);
+  static event_reader_t readers[NUM_CLIENTS];
+  std::vector<std::thread> threads;
+  uint64_t total = 0;
+  for (int k = 0; k < NUM_CLIENTS; k++) {
+    readers[k].c = &clients[k];
+    readers[k].index = k;
+    readers[k].target = 0;
+    for (int j = 0; j < NUM_CHARS; j++) {
+      hap_char_manage_notification(chars[j], k, subscribed(k, j));
+      readers[k].target += subscribed(k, j) * (NUM_UPDATES / NUM_CHARS);
+    }
+    total += readers[k].target;
+    threads.emplace_back(read_events, &readers[k], iids);
+  }
+
+  uint64_t sent0 = hap_test_metric("hap_events_sent_total");
+  uint32_t allocs = hap_sim_heap_allocs();
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_UPDATES; i++) {
+    int j = i % NUM_CHARS;
+    hap_val_t v;
+    v.i = i + 1;
+    CHECK(hap_char_update_val(chars[j], &v) == HAP_SUCCESS);
+    // 工作队列按顺序执行：这里返回时这次更新的通知已经发出
+    hap_test_on_server([] {});
+  }
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  CHECK(hap_sim_heap_allocs() == allocs);
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  for (int k = 0; k < NUM_CLIENTS; k++) {
+    CHECK(readers[k].ok && readers[k].events == readers[k].target);
+    // 最后收到的值就是每个订阅特征最后一次更新的值
+    for (int j = 0; j < NUM_CHARS; j++) {
+      CHECK(subscribed(k, j) ? readers[k].last[iids[j]] == NUM_UPDATES - NUM_CHARS + j + 1
+                             : readers[k].last.count(iids[j]) == 0);
+    }
+  }
+  CHECK(hap_test_metric("hap_events_sent_total") - sent0 == total);
+  printf("test_send_no_alloc: %d updates sent %llu events to %d sessions in %.2f s, no heap "
+         "allocations\n",
+         NUM_UPDATES, (unsigned long long)total, NUM_CLIENTS, sec);
+
+  // 只有客户端 0 订阅
+  for (int k = 1; k < NUM_CLIENTS; k++) {
+    hap_char_manage_notification(chars[0], k, false);
+  }
+  bench_event_wire(&clients[0], chars[0]);
+  hap_sim_set_notif_handler(NULL);
+  hap_http_notif_deinit();
+  hap_notif_deinit();
+}
+
+int main(void) {
+  CHECK(sodium_init() >= 0);
+  hap_set_debug_level(HAP_DEBUG_LEVEL_WARN);
+  test_send_no_alloc();
+  printf("test_hap_notif_send: ok\n");
+  return 0;
+}
@@ -0,0 +1,247 @@
+#include "host_test.h"
+#include <chrono>
+#include <random>
+#include <string.h>
+#include <string>
+#include <vector>
+extern "C" {
+#include "esp_hap_put_parser.h"
+#include "hap.h"
+}
+
+// PUT /characteristics 流式解析器的单元测试、变异模糊测试和 1/20/200 个写操作的解析基准。
+// 解析器从回调按块读取请求体，这里用内存缓冲模拟 httpd_req_recv，块大小可调。
+
+typedef struct {
+  const char *data;
+  int len;
+  int pos;
+  int chunk; // 每次最多返回的字节数，模拟 TCP 分段
+} body_t;
+
+static int body_recv(void *arg, char *buf, int len) {
+  body_t *b = (body_t *)arg;
+  int n = b->len - b->pos;
+  if (n > len)
+    n = len;
+  if (n > b->chunk)
+    n = b->chunk;
+  memcpy(buf, b->data + b->pos, n);
+  b->pos += n;
+  return n;
+}
+
+typedef struct {
+  body_t body;
+  hap_put_reader_t r;
+} reader_t;
+
+static void reader_init(reader_t *rd, const std::string &s, int chunk) {
+  rd->body = {s.data(), (int)s.size(), 0, chunk};
+  memset(&rd->r, 0, sizeof(rd->r));
+  rd->r.recv = body_recv;
+  rd->r.recv_arg = &rd->body;
+}
+
+// 解析出的对象：标量字段直接复制，字符串另存一份（hap_put_str_t 可能指向自身的栈缓冲）
+typedef struct {
+  hap_put_char_t c;
+  std::string value;
+  std::string auth;
+} parsed_t;
+
+// 和 esp_hap_ip_services.c 中的处理流程相同：{"characteristics":[...], "pid":...}
+static bool parse_body(const std::string &s, int chunk, std::vector<parsed_t> *out) {
+  reader_t rd;
+  reader_init(&rd, s, chunk);
+  hap_put_reader_t *r = &rd.r;
+  hap_put_str_t key;
+  hap_put_char_t obj;
+  hap_put_str_init(&key);
+  hap_put_str_init(&obj.value_str);
+  hap_put_str_init(&obj.auth);
+  bool ok = hap_put_expect(r, '{');
+  if (ok && hap_put_skip_ws(r) != '}') {
+    do {
+      hap_put_str_free(&key);
+      ok = hap_put_skip_ws(r) == '"' && hap_put_read_str(r, &key) && hap_put_expect(r, ':');
+      if (!ok)
+        break;
+      int c = hap_put_skip_ws(r);
+      if (!strcmp(key.buf, "characteristics") && c == '[') {
+        ok = hap_put_expect(r, '[');
+        if (ok && hap_put_skip_ws(r) != ']') {
+          do {
+            hap_put_char_reset(&obj);
+            ok = hap_put_read_char(r, &obj);
+            if (ok && out) {
+              parsed_t p = {obj, std::string(obj.value_str.buf, obj.value_str.len),
+                            std::string(obj.auth.buf, obj.auth.len)};
+              hap_put_str_init(&p.c.value_str);
+              hap_put_str_init(&p.c.auth);
+              out->push_back(p);
+            }
+          } while (ok && hap_put_expect(r, ','));
+        }
+        ok = ok && hap_put_expect(r, ']');
+      } else {
+        ok = hap_put_skip_value(r);
+      }
+    } while (ok && hap_put_expect(r, ','));
+  }
+  ok = ok && hap_put_expect(r, '}');
+  hap_put_str_free(&key);
+  hap_put_char_reset(&obj);
+  return ok;
+}
+
+static void test_fields(void) {
+  const std::string body =
+      "{ \"characteristics\" : [ {\"aid\":1,\"iid\":10,\"value\":true},"
+      "{\"iid\":11,\"aid\":2,\"value\":-42,\"r\":true,\"remote\":true},"
+      "{\"aid\":1,\"iid\":12,\"value\":\"a\\\"b\\\\c\\u00e9\\u4e2d\\n\"},"
+      "{\"aid\":1,\"iid\":13,\"ev\":false,\"unknown\":{\"x\":[1,{\"y\":\"]}\"}]}},"
+      "{\"aid\":1,\"iid\":14,\"value\":1.5e2,\"authData\":\"QUJD\"},"
+      "{\"aid\":1,\"iid\":15,\"value\":[1,2]},"
+      "{\"aid\":1,\"iid\":16,\"value\":1234567890123456789012345678901234567890}],"
+      "\"pid\":7}";
+  for (int chunk : {1, 3, 128}) {
+    std::vector<parsed_t> v;
+    CHECK(parse_body(body, chunk, &v));
+    CHECK(v.size() == 7);
+    bool b;
+    int i;
+    float f;
+    CHECK(v[0].c.aid == 1 && v[0].c.iid == 10 && v[0].c.has_value && !v[0].c.value_is_str);
+    CHECK(hap_put_prim_bool(v[0].c.value_prim, &b) == HAP_SUCCESS && b);
+    CHECK(v[1].c.aid == 2 && v[1].c.iid == 11 && v[1].c.response && v[1].c.remote);
+    CHECK(hap_put_prim_int(v[1].c.value_prim, &i) == HAP_SUCCESS && i == -42);
+    CHECK(v[2].c.value_is_str && v[2].value == "a\"b\\c\xc3\xa9\xe4\xb8\xad\n");
+    CHECK(!v[3].c.has_value && v[3].c.has_ev && !v[3].c.ev);
+    CHECK(hap_put_prim_float(v[4].c.value_prim, &f) == HAP_SUCCESS && f == 150.0f);
+    CHECK(v[4].c.has_auth && v[4].auth == "QUJD");
+    // 对象/数组值和过长的数字都当作非法值，而不是请求体格式错误
+    CHECK(v[5].c.has_value && v[5].c.value_prim[0] == '\0');
+    CHECK(v[6].c.has_value && v[6].c.value_prim[0] == '\0');
+  }
+}
+
+static void test_long_string(void) {
+  std::string value(1000, 'x');
+  value[500] = 'y';
+  std::string body = "{\"characteristics\":[{\"aid\":1,\"iid\":2,\"value\":\"" + value + "\"}]}";
+  std::vector<parsed_t> v;
+  CHECK(parse_body(body, 7, &v));
+  CHECK(v.size() == 1 && v[0].value == value);
+  // 超过栈缓冲的字符串在堆上增长，转交时直接交出缓冲
+  hap_put_str_t str;
+  hap_put_str_init(&str);
+  for (char c : value)
+    CHECK(hap_put_str_push(&str, c));
+  char *buf = str.buf;
+  char *detached = hap_put_str_detach(&str);
+  CHECK(detached == buf && detached == value && str.buf == str.local);
+  free(detached);
+}
+
+static void test_malformed(void) {
+  const char *bad[] = {
+      "",
+      "{",
+      "[]",
+      "{\"characteristics\":[{\"aid\":1,}]}",
+      "{\"characteristics\":[{\"aid\":1]}",
+      "{\"characteristics\":[{\"aid\":1},]}",
+      "{\"characteristics\":[{\"value\":\"unterminated}]}",
+      "{\"characteristics\":[{\"value\":\"\\x\"}]}",
+      "{\"characteristics\":[{\"value\":\"\\u12g4\"}]}",
+      "{\"characteristics\":[{aid:1}]}",
+      "{\"characteristics\":[{\"aid\":1}]",
+      "{\"characteristics\":[{\"aid\":1}]}}",
+  };
+  for (const char *b : bad) {
+    std::string body(b);
+    bool ok = parse_body(body, 5, NULL);
+    // 最后一个多了右括号：解析器只读到对象结束，多余的内容由调用者忽略
+    if (body == "{\"characteristics\":[{\"aid\":1}]}}")
+      CHECK(ok);
+    else
+      CHECK(!ok);
+  }
+}
+
+// 变异模糊测试：对种子请求体随机替换、插入、删除、截断字节，并随机分块输入。
+// 只要求不崩溃、不越界（配合 -DFAN_HOST_SANITIZE=address,undefined 运行），不检查结果
+static void test_fuzz(void) {
+  const std::string seeds[] = {
+      "{\"characteristics\":[{\"aid\":1,\"iid\":10,\"value\":true,\"r\":true}],\"pid\":1}",
+      "{\"characteristics\":[{\"aid\":1,\"iid\":12,\"value\":\"ab\\u00e9\\\"\",\"authData\":\"QQ==\"}]}",
+      "{\"x\":{\"y\":[1,2,{\"z\":null}]},\"characteristics\":[{\"aid\":1,\"iid\":2,\"ev\":true}]}",
+  };
+  const char alphabet[] = "{}[]\":,\\u0123456789abcdefxyz \t\r\n-+.e";
+  std::mt19937 rng(12345);
+  int accepted = 0;
+  for (int iter = 0; iter < 50000; iter++) {
+    std::string s = seeds[rng() % 3];
+    int edits = 1 + rng() % 6;
+    for (int e = 0; e < edits && !s.empty(); e++) {
+      size_t pos = rng() % s.size();
+      char c = rng() % 4 ? alphabet[rng() % (sizeof(alphabet) - 1)] : (char)(rng() & 0xff);
+      switch (rng() % 4) {
+      case 0:
+        s[pos] = c;
+        break;
+      case 1:
+        s.insert(s.begin() + pos, c);
+        break;
+      case 2:
+        s.erase(pos, 1 + rng() % 4);
+        break;
+      default:
+        s.resize(pos);
+        break;
+      }
+    }
+    std::vector<parsed_t> v;
+    accepted += parse_body(s, 1 + rng() % 40, &v);
+  }
+  printf("test_hap_put_parser: fuzz accepted %d of 50000 mutated bodies\n", accepted);
+}
+
+static std::string make_body(int n) {
+  std::string s = "{\"characteristics\":[";
+  for (int i = 0; i < n; i++) {
+    char item[96];
+    snprintf(item, sizeof(item), "%s{\"aid\":1,\"iid\":%d,\"value\":%d}", i ? "," : "", 10 + i,
+             i % 2);
+    s += item;
+  }
+  return s + "]}";
+}
+
+// 请求体分成 1/20/200 个写操作，按 128 字节分块（和固件的接收块大小一致）
+static void bench(void) {
+  for (int n : {1, 20, 200}) {
+    std::string body = make_body(n);
+    int iterations = 200000 / n;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      CHECK(parse_body(body, HAP_PUT_RECV_CHUNK, NULL));
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0)
+                    .count() /
+                iterations;
+    printf("bench_hap_put_parser: %3d writes, %5zu bytes: %9.0f ns/body, %6.1f ns/write\n", n,
+           body.size(), ns, ns / n);
+  }
+}
+
+int main(void) {
+  test_fields();
+  test_long_string();
+  test_malformed();
+  test_fuzz();
+  bench();
+  printf("test_hap_put_parser: ok\n");
+  return 0;
+}
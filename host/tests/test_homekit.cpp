@@ -0,0 +1,165 @@
+#include "esp_log.h"
+#include "fan_gpio.h"
+#include "hap_sim.h"
+#include "homekit.h"
+#include "host_test.h"
+#include "nvs_flash.h"
+#include <chrono>
+#include <string.h>
+extern "C" {
+#include "esp_hap_char.h"
+#include "esp_hap_serv.h"
+#include "hap.h"
+#include "hap_apple_chars.h"
+#include "hap_apple_servs.h"
+}
+
+// main/homekit.cpp 在主机 HAP 数据库上运行：写回调按特征角色分派、只有写入方订阅时不排队通知，
+// 以及写回调和分派方式的微基准。没有调用 hap_notif_init()，每个排队的事件都直接计入
+// hap_sim_notif_events()
+
+static hap_serv_t *fan_serv;
+static hap_char_t *on_char;
+static hap_char_t *speed_char;
+static hap_char_t *name_char;
+
+static hap_write_data_t make_write(hap_char_t *hc, hap_status_t *status) {
+  hap_write_data_t w = {};
+  w.hc = hc;
+  w.remote = true;
+  w.status = status;
+  *status = HAP_STATUS_SUCCESS;
+  return w;
+}
+
+static int serv_write(hap_write_data_t *writes, int count) {
+  __hap_serv_t *_hs = (__hap_serv_t *)fan_serv;
+  return _hs->write_cb(writes, count, _hs->priv, NULL);
+}
+
+static void test_write(void) {
+  hap_status_t status[3];
+  hap_write_data_t writes[3] = {make_write(on_char, &status[0]),
+                                make_write(speed_char, &status[1]),
+                                make_write(name_char, &status[2])};
+  writes[0].val.b = true;
+  writes[1].val.f = 66.0f;
+  CHECK(serv_write(writes, 2) == HAP_SUCCESS);
+  CHECK(status[0] == HAP_STATUS_SUCCESS && status[1] == HAP_STATUS_SUCCESS);
+  CHECK(get_fan_isON() && getFanLevel() == 2);
+  CHECK(hap_char_get_val(speed_char)->f == 66.0f && hap_char_get_val(on_char)->b);
+
+  // 只写风速
+  writes[1].val.f = 100.0f;
+  CHECK(serv_write(&writes[1], 1) == HAP_SUCCESS);
+  CHECK(get_fan_isON() && getFanLevel() == 3);
+
+  // 没有角色的特征（Name）
+  writes[2].val.s = (char *)"x";
+  CHECK(serv_write(&writes[2], 1) == HAP_SUCCESS);
+  CHECK(status[2] == HAP_STATUS_RES_ABSENT);
+
+  // 关闭
+  writes[0].val.b = false;
+  CHECK(serv_write(writes, 1) == HAP_SUCCESS);
+  CHECK(!get_fan_isON());
+  CHECK(!hap_char_get_val(on_char)->b && hap_char_get_val(speed_char)->f == 0.0f);
+}
+
+static void test_owner_only(void) {
+  hap_val_t v;
+  uint32_t events = hap_sim_notif_events();
+
+  // 没有订阅者：仍然排队，断开连接时的 mDNS 重新广播依赖这个事件
+  v.b = !hap_char_get_val(on_char)->b;
+  CHECK(hap_char_update_val(on_char, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events + 1);
+
+  // 只有写入方订阅：不排队，写入方标记被清除
+  hap_char_manage_notification(on_char, 0, true);
+  hap_char_set_owner_ctrl(on_char, 0);
+  v.b = !v.b;
+  CHECK(hap_char_update_val(on_char, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events + 1);
+  CHECK(!hap_char_is_ctrl_owner(on_char, 0));
+
+  // 还有其他订阅者：排队
+  hap_char_manage_notification(on_char, 1, true);
+  hap_char_set_owner_ctrl(on_char, 0);
+  v.b = !v.b;
+  CHECK(hap_char_update_val(on_char, &v) == HAP_SUCCESS);
+  CHECK(hap_sim_notif_events() == events + 2);
+
+  hap_char_manage_notification(on_char, 0, false);
+  hap_char_manage_notification(on_char, 1, false);
+}
+
+// 原来的分派方式：逐个比较特征类型 UUID
+static int uuid_role(hap_char_t *hc) {
+  const char *type = hap_char_get_type_uuid(hc);
+  if (!strcmp(type, HAP_CHAR_UUID_ON))
+    return 1;
+  if (!strcmp(type, HAP_CHAR_UUID_ROTATION_SPEED))
+    return 2;
+  return 0;
+}
+
+static int tag_role(hap_char_t *hc) { return (int)(intptr_t)hap_char_get_priv(hc); }
+
+static double bench_dispatch(int (*role)(hap_char_t *), hap_char_t *const *chars, int n) {
+  const int iterations = 10000000;
+  int sum = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++)
+    sum += role(chars[i % n]);
+  double ns =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() /
+      iterations;
+  CHECK(sum > 0);
+  return ns;
+}
+
+static void bench(void) {
+  hap_char_t *chars[3] = {on_char, speed_char, name_char};
+  printf("bench_homekit: dispatch: role tag %.2f ns/char, UUID strcmp %.2f ns/char\n",
+         bench_dispatch(tag_role, chars, 3), bench_dispatch(uuid_role, chars, 3));
+
+  // 完整的写回调（On + RotationSpeed），状态不变，只同步一次特征值
+  hap_status_t status[2];
+  hap_write_data_t writes[2] = {make_write(on_char, &status[0]), make_write(speed_char, &status[1])};
+  writes[0].val.b = true;
+  writes[1].val.f = 33.0f;
+  CHECK(serv_write(writes, 2) == HAP_SUCCESS);
+  const int iterations = 200000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++)
+    serv_write(writes, 2);
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0)
+                  .count() /
+              iterations;
+  CHECK(get_fan_isON() && getFanLevel() == 1);
+  printf("bench_homekit: fan_serv_write (On + RotationSpeed, unchanged): %.0f ns/call\n", ns);
+}
+
+int main(void) {
+  esp_log_level_set("*", ESP_LOG_WARN);
+  hap_set_debug_level(HAP_DEBUG_LEVEL_WARN);
+  nvs_flash_init();
+  fan_gpio_init();
+  homekit_init();
+
+  hap_acc_t *acc = hap_get_first_acc();
+  CHECK(acc);
+  fan_serv = hap_acc_get_serv_by_uuid(acc, (char *)HAP_SERV_UUID_FAN);
+  CHECK(fan_serv);
+  on_char = hap_serv_get_char_by_uuid(fan_serv, HAP_CHAR_UUID_ON);
+  speed_char = hap_serv_get_char_by_uuid(fan_serv, HAP_CHAR_UUID_ROTATION_SPEED);
+  name_char = hap_serv_get_char_by_uuid(fan_serv, HAP_CHAR_UUID_NAME);
+  CHECK(on_char && speed_char && name_char);
+
+  test_write();
+  test_owner_only();
+  bench();
+  printf("test_homekit: ok\n");
+  return 0;
+}
@@ -0,0 +1,184 @@
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "fan_gpio.h"
+#include "homekit.h"
+#include "host_http.h"
+#include "nvs_flash.h"
+#include "web_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+// 风扇 REST 接口。批量操作：同一组操作用一次 POST /api/batch 和逐个 GET 请求（每个请求新建
+// 连接，或共用一个长连接）完成，比较整组的延迟和状态通知次数（每次通知对应一次 HomeKit 同步）。
+// /api/status：带当前 ETag 的 304、缓存的 200 和每次重新生成（请求之间改变风扇状态）三种情况下
+// 处理函数的 CPU 时间（httpd_sim 在处理函数前后取线程 CPU 时间，含发送响应的系统调用）；
+// 重新生成时每个请求的耗时还包含测试线程中的挡位切换。
+
+#define REPS 200
+#define STATUS_REQUESTS 20000
+
+static std::atomic<uint32_t> state_notifications;
+
+static void count_state_cb(const fan_state_t *state, void *arg) { state_notifications++; }
+
+typedef struct {
+  const char *name;
+  std::vector<std::string> singles; // 逐个请求的地址
+  std::string batch;                // 同样操作的批量请求体
+} op_sequence_t;
+
+typedef struct {
+  double p50_us;
+  double p99_us;
+  double notifications; // 每组操作的状态通知次数
+} seq_stats_t;
+
+static double percentile(std::vector<double> v, double p) {
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(v.size() * p))];
+}
+
+// 每组之间把风扇恢复为关闭且没有定时器，不计时
+static void reset_fan(http_conn_t *c) {
+  http_resp_t resp;
+  CHECK(http_request(c, "POST", "/api/batch", {{"Content-Type", "application/json"}},
+                     "[{\"op\":\"off\"},{\"op\":\"cancel_timer\"}]", &resp));
+  CHECK(resp.status == 200);
+}
+
+// mode 0: 一次批量请求；1: 逐个请求，每个新建连接；2: 逐个请求，共用长连接
+static seq_stats_t run_sequence(const op_sequence_t *seq, int mode) {
+  http_conn_t ctl, c;
+  CHECK(http_connect(&ctl, CONFIG_FAN_HTTP_PORT));
+  std::vector<double> lat;
+  uint32_t notifications = 0;
+  http_resp_t resp;
+  for (int i = 0; i < REPS; i++) {
+    reset_fan(&ctl);
+    uint32_t n0 = state_notifications.load();
+    auto t0 = std::chrono::steady_clock::now();
+    if (mode == 0) {
+      CHECK(http_connect(&c, CONFIG_FAN_HTTP_PORT));
+      CHECK(http_request(&c, "POST", "/api/batch", {{"Content-Type", "application/json"}},
+                         seq->batch, &resp));
+      CHECK(resp.status == 200 && resp.body.find("\"result\":true") == 1);
+      http_close(&c);
+    } else {
+      if (mode == 2) {
+        CHECK(http_connect(&c, CONFIG_FAN_HTTP_PORT));
+      }
+      for (const std::string &url : seq->singles) {
+        if (mode == 1) {
+          CHECK(http_connect(&c, CONFIG_FAN_HTTP_PORT));
+        }
+        CHECK(http_get(&c, url, &resp));
+        CHECK(resp.status == 200);
+        if (mode == 1) {
+          http_close(&c);
+        }
+      }
+      if (mode == 2) {
+        http_close(&c);
+      }
+    }
+    lat.push_back(
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    notifications += state_notifications.load() - n0;
+  }
+  http_close(&ctl);
+  return {percentile(lat, 0.5), percentile(lat, 0.99), (double)notifications / REPS};
+}
+
+static void bench_batch(void) {
+  const op_sequence_t seqs[] = {
+      {"on level 3, timer 1800 s",
+       {"/api/on?level=3", "/api/timer_off?seconds=1800"},
+       "[{\"op\":\"on\",\"level\":3},{\"op\":\"timer\",\"seconds\":1800}]"},
+      {"on 1, level 2, level 3, timer 600 s, timer 1800 s",
+       {"/api/on?level=1", "/api/on?level=2", "/api/on?level=3", "/api/timer_off?seconds=600",
+        "/api/timer_off?seconds=1800"},
+       "[{\"op\":\"on\",\"level\":1},{\"op\":\"level\",\"level\":2},{\"op\":\"level\",\"level\":3},"
+       "{\"op\":\"timer\",\"seconds\":600},{\"op\":\"timer\",\"seconds\":1800}]"},
+  };
+  const char *modes[] = {"1 batch request", "N requests, new connections",
+                         "N requests, keep-alive"};
+  for (const op_sequence_t &seq : seqs) {
+    seq_stats_t stats[3];
+    for (int mode = 0; mode < 3; mode++) {
+      stats[mode] = run_sequence(&seq, mode);
+      // 结果相同：风扇开在 3 挡，定时器剩余 1800 秒
+      fan_state_t st = fan_get_state();
+      CHECK(st.on && st.level == 3 && fan_timer_running() && fan_timer_left() > 1790);
+      printf("bench_batch: %-50s %zu ops, %-28s p50 %6.0f us, p99 %6.0f us, %.1f state "
+             "notifications\n",
+             seq.name, seq.singles.size(), modes[mode], stats[mode].p50_us, stats[mode].p99_us,
+             stats[mode].notifications);
+    }
+    // 批量请求只做一次状态转换
+    CHECK(stats[0].notifications == 1);
+    CHECK(stats[1].notifications == seq.singles.size());
+  }
+}
+
+// mode 0: 带当前 ETag 的 304；1: 状态不变，缓存的 200；2: 每次请求前改变挡位，重新生成
+static void bench_status_case(http_conn_t *c, int mode) {
+  static const char *names[] = {"304, If-None-Match current", "200 from the cache",
+                                "200, re-rendered"};
+  http_resp_t resp;
+  CHECK(http_get(c, "/api/status", &resp));
+  std::string etag = resp.headers["etag"];
+  uint64_t cpu0 = httpd_sim_handler_cpu_ns();
+  auto t0 = std::chrono::steady_clock::now();
+  size_t bytes = 0;
+  for (int i = 0; i < STATUS_REQUESTS; i++) {
+    if (mode == 2) {
+      CHECK(change_fan_state(true, 1 + i % 3));
+    }
+    CHECK(http_get(c, "/api/status", &resp, {{"If-None-Match", mode == 0 ? etag : "\"x\""}}));
+    bytes += resp.wire_bytes;
+    CHECK(resp.status == (mode == 0 ? 304 : 200));
+    // 挡位每次都变，ETag 跟着变
+    CHECK((resp.headers["etag"] == etag) == (mode != 2));
+    if (mode == 2) {
+      etag = resp.headers["etag"];
+    }
+    if (mode == 2) {
+      char body[96];
+      snprintf(body, sizeof(body), "{\"status\":1,\"timer_left\":0,\"last_fan_level\":%d}",
+               1 + i % 3);
+      CHECK(resp.body == body);
+    }
+  }
+  double cpu_ns = (double)(httpd_sim_handler_cpu_ns() - cpu0) / STATUS_REQUESTS;
+  double lat_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0)
+                      .count() /
+                  STATUS_REQUESTS;
+  printf("bench_status: %-28s %6.0f ns handler CPU, %5.1f us per request, %4zu B per response\n",
+         names[mode], cpu_ns, lat_us, bytes / STATUS_REQUESTS);
+}
+
+static void bench_status(void) {
+  http_conn_t c;
+  CHECK(http_connect(&c, CONFIG_FAN_HTTP_PORT));
+  http_resp_t resp;
+  CHECK(http_request(&c, "POST", "/api/batch", {{"Content-Type", "application/json"}},
+                     "[{\"op\":\"on\",\"level\":2},{\"op\":\"cancel_timer\"}]", &resp));
+  for (int mode = 0; mode < 3; mode++) {
+    bench_status_case(&c, mode);
+  }
+  http_close(&c);
+}
+
+int main(void) {
+  esp_log_level_set("*", ESP_LOG_WARN);
+  nvs_flash_init();
+  fan_gpio_init();
+  homekit_init();
+  start_http_server();
+  CHECK(fan_state_subscribe(count_state_cb, NULL));
+  bench_batch();
+  bench_status();
+  printf("test_web_api: ok\n");
+  return 0;
+}
@@ -0,0 +1,271 @@
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "fan_gpio.h"
+#include "homekit.h"
+#include "host_http.h"
+#include "nvs_flash.h"
+#include "web_assets.h"
+#include "web_server.h"
+#include <algorithm>
+#include <chrono>
+#include <regex>
+
+// 网页资源的发送：固件内置资源一次 httpd_resp_send 发出，对比原来从 SPIFFS 逐 256 字节
+// httpd_resp_send_chunk 的做法。原来的处理函数在这里按原样重建（去掉每次请求的 INFO 日志），
+// 直接读取 main/html 下的源文件，挂在另一个端口上。对每个资源统计首字节到末字节的时间（TTLB，
+// 客户端发出请求到读完响应，取中位数）和服务端 send() 调用次数。
+// send() 次数是 httpd_sim 的：响应头一次、响应体一次；固件的 httpd 会把自定义头分开发送。
+// 缓存：按浏览器的方式回放一次冷加载和两种热加载（不带校验和版本号的旧行为、带 If-None-Match
+// 且 ?v= 资源直接用缓存），检查 304 和 immutable，统计请求数和字节数。
+
+#define BASELINE_PORT (CONFIG_FAN_HTTP_PORT + 100)
+#define REPS 100
+
+static const char *TAG = "test_web_assets";
+
+// 原来的 static_file_handler（index_html_handler 相同，只是固定打开 index.html）
+static esp_err_t baseline_file_handler(httpd_req_t *req) {
+  char filepath[1024] = FAN_HTML_DIR;
+  strncat(filepath, strcmp(req->uri, "/") == 0 ? "/index.html" : req->uri,
+          sizeof(filepath) - strlen(filepath) - 1);
+  FILE *f = fopen(filepath, "r");
+  if (!f) {
+    ESP_LOGW(TAG, "File not found: %s", filepath);
+    httpd_resp_send_404(req);
+    return ESP_FAIL;
+  }
+  char buf[256];
+  size_t read_bytes;
+  if (strstr(filepath, ".html"))
+    httpd_resp_set_type(req, "text/html");
+  else if (strstr(filepath, ".js"))
+    httpd_resp_set_type(req, "application/javascript");
+  else if (strstr(filepath, ".css"))
+    httpd_resp_set_type(req, "text/css");
+  else if (strstr(filepath, ".json"))
+    httpd_resp_set_type(req, "application/json");
+  else
+    httpd_resp_set_type(req, "text/plain");
+  while ((read_bytes = fread(buf, 1, sizeof(buf), f)) > 0) {
+    httpd_resp_send_chunk(req, buf, read_bytes);
+  }
+  fclose(f);
+  httpd_resp_send_chunk(req, NULL, 0);
+  return ESP_OK;
+}
+
+static void start_baseline_server(void) {
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.server_port = BASELINE_PORT;
+  config.ctrl_port = BASELINE_PORT + 1;
+  config.uri_match_fn = httpd_uri_match_wildcard;
+  httpd_handle_t server = NULL;
+  CHECK(httpd_start(&server, &config) == ESP_OK);
+  httpd_uri_t file_uri = {
+      .uri = "/*", .method = HTTP_GET, .handler = baseline_file_handler, .user_ctx = NULL};
+  CHECK(httpd_register_uri_handler(server, &file_uri) == ESP_OK);
+}
+
+static std::string read_file(const std::string &path) {
+  std::string data;
+  FILE *f = fopen(path.c_str(), "rb");
+  CHECK(f);
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data.append(buf, n);
+  }
+  fclose(f);
+  return data;
+}
+
+typedef struct {
+  double ttlb_us;  // 中位数
+  uint64_t sends;  // 每个响应的 send() 次数
+  size_t wire;     // 每个响应在连接上的字节数
+  std::string body;
+} asset_run_t;
+
+static asset_run_t fetch(int port, const char *uri, const http_headers_t &headers) {
+  http_conn_t c;
+  CHECK(http_connect(&c, port));
+  asset_run_t run = {};
+  std::vector<double> ttlb;
+  http_resp_t resp;
+  for (int i = 0; i < REPS; i++) {
+    uint64_t sends0 = httpd_sim_send_count();
+    auto t0 = std::chrono::steady_clock::now();
+    CHECK(http_get(&c, uri, &resp, headers));
+    ttlb.push_back(
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    CHECK(resp.status == 200);
+    run.sends = httpd_sim_send_count() - sends0;
+  }
+  http_close(&c);
+  std::sort(ttlb.begin(), ttlb.end());
+  run.ttlb_us = ttlb[REPS / 2];
+  run.wire = resp.wire_bytes;
+  run.body = resp.body;
+  return run;
+}
+
+static void bench_assets(void) {
+  printf("%-26s %8s | %-28s | %-28s | %s\n", "asset", "bytes", "SPIFFS, 256 B chunks",
+         "flash, identity", "flash, gzip/br");
+  double total[3] = {0};
+  uint64_t sends[3] = {0};
+  for (size_t i = 0; i < web_assets_count; i++) {
+    const web_asset_t *asset = &web_assets[i];
+    std::string file = read_file(std::string(FAN_HTML_DIR) + asset->uri);
+    asset_run_t before = fetch(BASELINE_PORT, asset->uri, {});
+    asset_run_t after = fetch(CONFIG_FAN_HTTP_PORT, asset->uri, {});
+    asset_run_t after_enc =
+        fetch(CONFIG_FAN_HTTP_PORT, asset->uri, {{"Accept-Encoding", "gzip, deflate, br"}});
+    CHECK(before.body == file);
+    CHECK(after.body == std::string((const char *)asset->data, asset->len));
+    // 原来：响应头和第一块一起，之后每 256 字节一次，最后是结束块
+    CHECK(before.sends == (file.size() + 255) / 256 + 1);
+    CHECK(after.sends == 2 && after_enc.sends == 2);
+    printf("%-26s %8zu | %6.0f us %3llu sends %6zu B | %6.0f us %3llu sends %6zu B | "
+           "%6.0f us %3llu sends %6zu B\n",
+           asset->uri, file.size(), before.ttlb_us, (unsigned long long)before.sends, before.wire,
+           after.ttlb_us, (unsigned long long)after.sends, after.wire, after_enc.ttlb_us,
+           (unsigned long long)after_enc.sends, after_enc.wire);
+    asset_run_t *runs[] = {&before, &after, &after_enc};
+    for (int k = 0; k < 3; k++) {
+      total[k] += runs[k]->ttlb_us;
+      sends[k] += runs[k]->sends;
+    }
+  }
+  printf("%-35s | %6.0f us %3llu sends %8s | %6.0f us %3llu sends %8s | %6.0f us %3llu sends\n",
+         "all assets, one request each", total[0], (unsigned long long)sends[0], "", total[1],
+         (unsigned long long)sends[1], "", total[2], (unsigned long long)sends[2]);
+}
+
+#define BROWSER_ACCEPT_ENCODING "gzip, deflate, br"
+
+typedef struct {
+  std::string etag;
+  bool immutable;
+} cache_entry_t;
+
+typedef struct {
+  int requests;
+  size_t bytes;
+} load_stats_t;
+
+// 页面引用的本地资源，与发出的 index.html 中的地址一致（带 ?v=）
+static std::vector<std::string> page_refs(const std::string &html) {
+  std::vector<std::string> refs;
+  std::regex ref_re("(src|href)=\"(/[^\"]+)\"");
+  for (std::sregex_iterator it(html.begin(), html.end(), ref_re), end; it != end; ++it) {
+    refs.push_back((*it)[2]);
+  }
+  return refs;
+}
+
+static std::string strip_version(const std::string &uri) { return uri.substr(0, uri.find('?')); }
+
+// 按浏览器的方式加载一次页面：cache 为空时是冷加载；validate 为 false 时模拟原来没有校验和
+// 缓存头的服务器，每次都重新下载去掉 ?v= 的地址
+static load_stats_t load_page(http_conn_t *c, std::map<std::string, cache_entry_t> *cache,
+                              bool validate) {
+  load_stats_t stats = {};
+  http_resp_t resp;
+  std::vector<std::string> urls = {"/"};
+  for (size_t i = 0; i < urls.size(); i++) {
+    std::string url = validate ? urls[i] : strip_version(urls[i]);
+    http_headers_t headers = {{"Accept-Encoding", BROWSER_ACCEPT_ENCODING}};
+    auto cached = cache->find(url);
+    if (validate && cached != cache->end()) {
+      if (cached->second.immutable) {
+        continue; // 直接使用缓存，不发请求
+      }
+      headers.push_back({"If-None-Match", cached->second.etag});
+    }
+    CHECK(http_get(c, url, &resp, headers));
+    stats.requests++;
+    stats.bytes += resp.wire_bytes;
+    CHECK(resp.headers.count("etag"));
+    if (cached != cache->end() && validate) {
+      // 带着当前 ETag 重新验证：304，没有响应体
+      CHECK(resp.status == 304 && resp.body.empty() && resp.headers["etag"] == cached->second.etag);
+    } else {
+      CHECK(resp.status == 200);
+    }
+    bool versioned = url.find("?v=") != std::string::npos;
+    bool immutable = resp.headers["cache-control"] == "public, max-age=31536000, immutable";
+    CHECK(immutable == versioned);
+    CHECK(immutable || resp.headers["cache-control"] == "no-cache");
+    (*cache)[url] = {resp.headers["etag"], immutable};
+    if (url == "/") {
+      const web_asset_t *index = NULL;
+      for (size_t k = 0; k < web_assets_count; k++) {
+        if (strcmp(web_assets[k].uri, "/index.html") == 0) {
+          index = &web_assets[k];
+        }
+      }
+      CHECK(index);
+      std::vector<std::string> refs =
+          page_refs(std::string((const char *)index->data, index->len));
+      urls.insert(urls.end(), refs.begin(), refs.end());
+    }
+  }
+  return stats;
+}
+
+static void test_replay(void) {
+  http_conn_t c;
+  CHECK(http_connect(&c, CONFIG_FAN_HTTP_PORT));
+  std::map<std::string, cache_entry_t> cache;
+  load_stats_t cold = load_page(&c, &cache, true);
+  size_t num_refs = cache.size() - 1;
+  CHECK(num_refs > 0);
+  std::map<std::string, cache_entry_t> old_cache;
+  load_stats_t old_warm = load_page(&c, &old_cache, false);
+  load_stats_t warm = load_page(&c, &cache, true);
+  CHECK(cold.requests == (int)num_refs + 1 && old_warm.requests == cold.requests);
+  // 热加载只重新验证页面本身，其余资源的地址都带版本号
+  CHECK(warm.requests == 1);
+
+  // 不带 ?v= 或版本号不对的地址每次协商，ETag 对上时 304
+  const web_asset_t *asset = &web_assets[0];
+  http_resp_t resp;
+  for (std::string url : {std::string(asset->uri), std::string(asset->uri) + "?v=0"}) {
+    CHECK(http_get(&c, url, &resp));
+    CHECK(resp.status == 200 && resp.headers["cache-control"] == "no-cache");
+    std::string etag = resp.headers["etag"];
+    CHECK(http_get(&c, url, &resp, {{"If-None-Match", "\"x\", " + etag}}));
+    CHECK(resp.status == 304 && resp.body.empty());
+  }
+  // 压缩版本的 ETag 不能用来验证未压缩的表示
+  for (size_t i = 0; i < web_assets_count; i++) {
+    if (!web_assets[i].gz) {
+      continue;
+    }
+    CHECK(http_get(&c, web_assets[i].uri, &resp, {{"Accept-Encoding", "gzip"}}));
+    CHECK(resp.headers["content-encoding"] == "gzip");
+    CHECK(http_get(&c, web_assets[i].uri, &resp, {{"If-None-Match", resp.headers["etag"]}}));
+    CHECK(resp.status == 200 && resp.body.size() == web_assets[i].len);
+    break;
+  }
+  http_close(&c);
+
+  printf("test_replay: cold load %d requests %zu B; warm load without validators %d requests "
+         "%zu B; warm load with ETag and ?v= %d requests %zu B (saved %d requests, %zu B)\n",
+         cold.requests, cold.bytes, old_warm.requests, old_warm.bytes, warm.requests, warm.bytes,
+         old_warm.requests - warm.requests, old_warm.bytes - warm.bytes);
+}
+
+int main(void) {
+  esp_log_level_set("*", ESP_LOG_WARN);
+  nvs_flash_init();
+  fan_gpio_init();
+  homekit_init();
+  start_http_server();
+  start_baseline_server();
+  test_replay();
+  bench_assets();
+  printf("test_web_assets: ok\n");
+  return 0;
+}
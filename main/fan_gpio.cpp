@@ -1,12 +1,19 @@
 #include "fan_gpio.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "fan_store.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
-#include "nvs.h"
-#include "nvs_flash.h"
+#include "perf_metrics.h"
+#include "perf_trace.h"
+#include "sdkconfig.h"
+#include "soc/gpio_struct.h"
+#include <atomic>
 #include <stdbool.h>
 
 #define LED_GPIO GPIO_NUM_23
@@ -16,11 +23,47 @@
 // GPIO定义：LED常亮，风扇开关（高电平=开，低电平=关）
 // 注意：GPIO_NUM_16, GPIO_NUM_33, GPIO_NUM_32 需要根据实际硬件连接调整
 
-static bool fan_is_on_cache = false;
-static int fan_level_cache = 1; // 1 低速 2 中速 3 高速
+// 风扇状态字：bit0 开关，bit1-2 挡位，bit3-31 定时器代数。
+// 所有状态修改都通过 CAS 完成，HomeKit/HTTP/定时器可以并发调用。
+#define FAN_STATE_ON_BIT 0x1u
+#define FAN_STATE_LEVEL_SHIFT 1
+#define FAN_STATE_LEVEL_MASK (0x3u << FAN_STATE_LEVEL_SHIFT)
+#define FAN_STATE_OUTPUT_MASK (FAN_STATE_ON_BIT | FAN_STATE_LEVEL_MASK)
+#define FAN_STATE_GEN_SHIFT 3
+
+static std::atomic<uint32_t> fan_state_word{1u << FAN_STATE_LEVEL_SHIFT}; // 关，1 低速
+// 同一时刻只有一个线程负责把状态字同步到GPIO并通知订阅者，其他线程只提交状态
+static std::atomic<bool> fan_state_applying{false};
+static uint32_t fan_state_applied = 1u << FAN_STATE_LEVEL_SHIFT;
+
+static struct {
+  fan_state_cb_t cb;
+  void *arg;
+} fan_state_subs[FAN_STATE_MAX_SUBSCRIBERS];
+static std::atomic<int> fan_state_sub_count{0};
+
 static TimerHandle_t fan_off_timer = NULL;
+static std::atomic<TickType_t> fan_timer_deadline{0};
+static std::atomic<uint32_t> fan_timer_armed_gen{UINT32_MAX}; // 运行中定时器的代数
+// 设置/取消定时器时，发布新代数和配置 FreeRTOS 定时器在同一把锁内完成
+static SemaphoreHandle_t fan_timer_lock = NULL;
 static QueueHandle_t led_blink_queue = NULL;
 
+static inline bool state_on(uint32_t s) { return s & FAN_STATE_ON_BIT; }
+static inline int state_level(uint32_t s) {
+  return (s & FAN_STATE_LEVEL_MASK) >> FAN_STATE_LEVEL_SHIFT;
+}
+static inline uint32_t state_gen(uint32_t s) { return s >> FAN_STATE_GEN_SHIFT; }
+static inline uint32_t state_make(bool on, int level, uint32_t gen) {
+  return (on ? FAN_STATE_ON_BIT : 0) | ((uint32_t)level << FAN_STATE_LEVEL_SHIFT) |
+         (gen << FAN_STATE_GEN_SHIFT);
+}
+static inline fan_state_t state_unpack(uint32_t s) {
+  fan_state_t st = {
+      .on = state_on(s), .level = state_level(s), .timer_gen = state_gen(s), .version = s};
+  return st;
+}
+
 // 异步LED闪烁任务
 static void led_blink_task(void *arg) {
   int times;
@@ -40,21 +83,159 @@ static void led_blink_task(void *arg) {
   }
 }
 
-#define FAN_NVS_NAMESPACE "fan_cfg"
-#define FAN_NVS_KEY_LEVEL "fan_level"
+int getFanLevel() { return state_level(fan_state_word.load()); }
+
+bool get_fan_isON(void) { return state_on(fan_state_word.load()); }
+
+fan_state_t fan_get_state(void) { return state_unpack(fan_state_word.load()); }
 
-extern "C" void homekit_fan_state_sync(bool on, int level);
+bool fan_state_subscribe(fan_state_cb_t cb, void *arg) {
+  int idx = fan_state_sub_count.load();
+  if (!cb || idx >= FAN_STATE_MAX_SUBSCRIBERS) {
+    return false;
+  }
+  // 订阅只在初始化阶段进行，写好槽位后再发布数量
+  fan_state_subs[idx].cb = cb;
+  fan_state_subs[idx].arg = arg;
+  fan_state_sub_count.store(idx + 1, std::memory_order_release);
+  return true;
+}
+
+// 继电器由专门的任务驱动：状态机只发布目标引脚掩码，死区等待不会阻塞 HomeKit/HTTP/定时器服务任务。
+// fan_relay_mask 是当前输出，只由继电器任务修改
+static uint64_t fan_relay_mask = 0;
+static std::atomic<uint64_t> fan_relay_target{0};
+static TaskHandle_t fan_relay_task_handle = NULL;
 
-int getFanLevel() { return fan_level_cache; }
+// 切换耗时直方图（us）：<100, <1000, <10000, <100000, 其余
+#define FAN_SWITCH_HIST_BUCKETS 5
+static std::atomic<uint32_t> fan_switch_hist[FAN_SWITCH_HIST_BUCKETS];
+static std::atomic<int32_t> fan_switch_last_us{0};
 
-static void changeFanLevel(int level) {
-  nvs_handle_t handle;
-  if (nvs_open(FAN_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
-    nvs_set_i32(handle, FAN_NVS_KEY_LEVEL, level);
-    nvs_commit(handle);
-    nvs_close(handle);
+static uint64_t fan_relay_target_mask(uint32_t s) {
+  if (!state_on(s)) {
+    return 0;
+  }
+  switch (state_level(s)) {
+  case 1:
+    return 1ULL << LOW_ON;
+  case 2:
+    return 1ULL << MIDDLE_ON;
+  case 3:
+  default:
+    return 1ULL << HEIGHT_ON;
   }
-  fan_level_cache = level; // 更新缓存
+}
+
+// 直接写 GPIO 输出置位/清零寄存器，同一组内的引脚一次写完
+static inline void fan_relay_set_pins(uint64_t mask) {
+  if ((uint32_t)mask)
+    GPIO.out_w1ts = (uint32_t)mask;
+  if (mask >> 32)
+    GPIO.out1_w1ts.val = (uint32_t)(mask >> 32);
+}
+
+static inline void fan_relay_clear_pins(uint64_t mask) {
+  if ((uint32_t)mask)
+    GPIO.out_w1tc = (uint32_t)mask;
+  if (mask >> 32)
+    GPIO.out1_w1tc.val = (uint32_t)(mask >> 32);
+}
+
+static void fan_switch_record(int64_t us) {
+  int bucket = us < 100 ? 0 : us < 1000 ? 1 : us < 10000 ? 2 : us < 100000 ? 3 : 4;
+  fan_switch_hist[bucket].fetch_add(1, std::memory_order_relaxed);
+  fan_switch_last_us.store((int32_t)us, std::memory_order_relaxed);
+}
+
+// 只改变需要变化的引脚；先断开旧挡位，距上次断开满死区时间后才接通新挡位。
+// 等待期间目标再次变化时按最新目标重新计算，任何时刻最多接通一个挡位
+static void fan_relay_task(void *arg) {
+  int64_t cleared_at = INT64_MIN / 2;
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int64_t t0 = esp_timer_get_time();
+    uint64_t target;
+    bool changed = false;
+    while ((target = fan_relay_target.load()) != fan_relay_mask) {
+      changed = true;
+      uint64_t to_clear = fan_relay_mask & ~target;
+      uint64_t to_set = target & ~fan_relay_mask;
+      if (to_clear) {
+        fan_relay_clear_pins(to_clear);
+        fan_relay_mask &= ~to_clear;
+        cleared_at = esp_timer_get_time();
+      }
+      if (to_set) {
+        int64_t wait_us = cleared_at + CONFIG_FAN_RELAY_DEAD_TIME_MS * 1000LL - esp_timer_get_time();
+        if (wait_us > 0) {
+          TickType_t ticks = pdMS_TO_TICKS((wait_us + 999) / 1000);
+          if (ticks > 0) {
+            vTaskDelay(ticks);
+          } else {
+            esp_rom_delay_us((uint32_t)wait_us);
+          }
+          continue; // 等待后重新读取目标
+        }
+        fan_relay_set_pins(to_set);
+        fan_relay_mask |= to_set;
+      }
+    }
+    if (changed) {
+      fan_switch_record(esp_timer_get_time() - t0);
+      perf_trace_end(PERF_TRACE_GPIO_WRITE, t0, (uint32_t)(target | (target >> 32)));
+    }
+  }
+}
+
+static void fan_write_outputs(uint32_t s) {
+  fan_relay_target.store(fan_relay_target_mask(s));
+  if (fan_relay_task_handle) {
+    xTaskNotifyGive(fan_relay_task_handle);
+  }
+}
+
+// 把最新状态字同步到GPIO/NVS并通知订阅者。抢不到执行权的线程直接返回，
+// 由当前执行者在退出前重新检查状态字，保证输出和通知总是以最新状态结束。
+static void fan_state_apply(void) {
+  uint32_t applied;
+  do {
+    if (fan_state_applying.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+    uint32_t s;
+    while ((s = fan_state_word.load()) != fan_state_applied) {
+      uint32_t prev = fan_state_applied;
+      if ((s ^ prev) & FAN_STATE_OUTPUT_MASK) {
+        fan_write_outputs(s);
+      }
+      if (state_level(s) != state_level(prev)) {
+        fan_store_save_level(state_level(s)); // 延迟写入NVS，合并短时间内的多次修改
+      }
+      fan_state_applied = s;
+      fan_state_t st = state_unpack(s);
+      int n = fan_state_sub_count.load(std::memory_order_acquire);
+      for (int i = 0; i < n; i++) {
+        fan_state_subs[i].cb(&st, fan_state_subs[i].arg);
+      }
+    }
+    // fan_state_applied 只能在持有执行权时读取，释放之后由下一个执行者修改
+    applied = fan_state_applied;
+    fan_state_applying.store(false, std::memory_order_release);
+  } while (fan_state_word.load() != applied);
+}
+
+static void fan_off_timer_cb(TimerHandle_t xTimer);
+
+// LED 订阅者：开关或挡位变化时闪两下
+static void led_state_cb(const fan_state_t *state, void *arg) {
+  static bool last_on = false;
+  static int last_level = 0;
+  if (state->on != last_on || (state->on && state->level != last_level)) {
+    blink_led(2);
+  }
+  last_on = state->on;
+  last_level = state->level;
 }
 
 void fan_gpio_led_on(void) {
@@ -66,18 +247,13 @@ void fan_gpio_led_off(void) {
 }
 
 void fan_gpio_init(void) {
-  nvs_handle_t handle;
-  int32_t level = 1;
   gpio_config_t io_conf = {.pin_bit_mask = (1ULL << LED_GPIO) | (1ULL << HEIGHT_ON) |
                                            (1ULL << MIDDLE_ON) | (1ULL << LOW_ON),
                            .mode = GPIO_MODE_OUTPUT,
                            .pull_up_en = GPIO_PULLUP_DISABLE,
                            .pull_down_en = GPIO_PULLDOWN_DISABLE,
                            .intr_type = GPIO_INTR_DISABLE};
-  if (nvs_open(FAN_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
-    nvs_get_i32(handle, FAN_NVS_KEY_LEVEL, &level);
-    nvs_close(handle);
-  }
+  int level = fan_store_load_level(1);
   if (level < 1 || level > 3) {
     level = 3;
   }
@@ -86,13 +262,27 @@ void fan_gpio_init(void) {
   gpio_set_level(HEIGHT_ON, 0); // 默认风扇关（高电平=开，低电平=关）
   gpio_set_level(MIDDLE_ON, 0);
   gpio_set_level(LOW_ON, 0);
-  fan_is_on_cache = false;
-  fan_level_cache = level;
+  fan_relay_mask = 0;
+  fan_relay_target.store(0);
+  fan_state_applied = state_make(false, level, 0);
+  fan_state_word.store(fan_state_applied);
 
   // 初始化异步LED闪烁队列和任务
   if (!led_blink_queue) {
     led_blink_queue = xQueueCreate(4, sizeof(int));
-    xTaskCreate(led_blink_task, "led_blink_task", 2048, NULL, 5, NULL);
+    TaskHandle_t led_task = NULL;
+    xTaskCreate(led_blink_task, "led_blink_task", 2048, NULL, 5, &led_task);
+    perf_metrics_watch_task("led_blink_task", led_task);
+    fan_state_subscribe(led_state_cb, NULL);
+  }
+  if (!fan_relay_task_handle) {
+    xTaskCreate(fan_relay_task, "fan_relay_task", 2048, NULL, 6, &fan_relay_task_handle);
+    perf_metrics_watch_task("fan_relay_task", fan_relay_task_handle);
+  }
+  // 关机定时器只创建一次，之后通过修改周期重新启动
+  if (!fan_off_timer) {
+    fan_off_timer = xTimerCreate("fan_off_timer", 1, pdFALSE, NULL, fan_off_timer_cb);
+    fan_timer_lock = xSemaphoreCreateMutex();
   }
 }
 
@@ -102,84 +292,147 @@ void blink_led(int times) {
   }
 }
 
-void change_fan_state(bool on) { change_fan_state(on, fan_level_cache); }
+// 一次状态转换结束：记录 trace 和 /metrics 直方图，arg 为新的状态字
+static void fan_state_change_done(int64_t t0, uint32_t next) {
+  perf_trace_end(PERF_TRACE_CHANGE_FAN_STATE, t0, next);
+  perf_metrics_observe_since(PERF_METRICS_FAN_STATE_CHANGE, t0);
+}
+
+bool change_fan_state(bool on) {
+  int64_t t0 = esp_timer_get_time();
+  uint32_t cur = fan_state_word.load();
+  uint32_t next;
+  do {
+    next = state_make(on, state_level(cur), state_gen(cur));
+  } while (next != cur && !fan_state_word.compare_exchange_weak(cur, next));
+  fan_state_apply();
+  fan_state_change_done(t0, next);
+  return next != cur;
+}
 
-void change_fan_state(bool on, int level) {
+bool change_fan_state(bool on, int level) {
   const char *TAG = "fan_gpio";
-  TickType_t t0 = xTaskGetTickCount();
+  int64_t t0 = esp_timer_get_time();
   ESP_LOGI(TAG, "change_fan_state: start, on=%d, level=%d", on, level);
   // level: 1=low, 2=middle, 3=high
   if (level < 1 || level > 3) {
     ESP_LOGE("fan_gpio", "Invalid fan speed level: %d", level);
-    return;
+    return false;
   }
 
-  ESP_LOGI(TAG, "change_fan_state: set level=%d (1=low,2=middle,3=high)", level);
-  // 关闭所有挡位
-  gpio_set_level(HEIGHT_ON, 0);
-  gpio_set_level(MIDDLE_ON, 0);
-  gpio_set_level(LOW_ON, 0);
-  if (on) {
-    fan_is_on_cache = true;
-    changeFanLevel(level);
-    switch (level) {
-    case 1:
-      gpio_set_level(LOW_ON, 1);
-      break;
-    case 2:
-      gpio_set_level(MIDDLE_ON, 1);
-      break;
-    case 3:
-    default:
-      gpio_set_level(HEIGHT_ON, 1);
-      break;
-    }
-  } else {
-    fan_is_on_cache = false;
+  uint32_t cur = fan_state_word.load();
+  uint32_t next;
+  do {
+    // 关机时保留上次挡位，开机时更新挡位
+    next = state_make(on, on ? level : state_level(cur), state_gen(cur));
+  } while (next != cur && !fan_state_word.compare_exchange_weak(cur, next));
+  if (next == cur) {
+    return false; // 状态未变化，不动继电器也不闪灯
   }
-  blink_led(2);
-  TickType_t t1 = xTaskGetTickCount();
-  ESP_LOGI(TAG, "change_fan_state: end, elapsed=%d ms", (int)((t1 - t0) * portTICK_PERIOD_MS));
+  ESP_LOGI(TAG, "change_fan_state: set level=%d (1=low,2=middle,3=high)", level);
+  fan_state_apply();
+  fan_state_change_done(t0, next);
+  ESP_LOGI(TAG,
+           "change_fan_state: end, elapsed=%d us, switch=%d us, "
+           "hist(<100us/<1ms/<10ms/<100ms/more)=%u/%u/%u/%u/%u",
+           (int)(esp_timer_get_time() - t0), (int)fan_switch_last_us.load(),
+           (unsigned)fan_switch_hist[0].load(), (unsigned)fan_switch_hist[1].load(),
+           (unsigned)fan_switch_hist[2].load(), (unsigned)fan_switch_hist[3].load(),
+           (unsigned)fan_switch_hist[4].load());
+  return true;
 }
 
-void set_fan_timer(int seconds) {
-  if (fan_off_timer) {
-    xTimerStop(fan_off_timer, 0);
-    xTimerDelete(fan_off_timer, 0);
-    fan_off_timer = NULL;
-  }
-  if (seconds <= 0)
+static void fan_off_timer_cb(TimerHandle_t xTimer) {
+  uint32_t gen = (uint32_t)(uintptr_t)pvTimerGetTimerID(xTimer);
+  // 截止时间还没到说明定时器刚被重新设置，这是旧的回调
+  if ((int32_t)(xTaskGetTickCount() - fan_timer_deadline.load()) < 0) {
     return;
-  fan_off_timer = xTimerCreate("fan_off_timer", pdMS_TO_TICKS(seconds * 1000), pdFALSE, NULL,
-                               [](TimerHandle_t xTimer) {
-                                 change_fan_state(false);
-                                 homekit_fan_state_sync(false, 0); // 定时关闭后同步HomeKit
-                               });
-  if (fan_off_timer) {
-    xTimerStart(fan_off_timer, 0);
   }
+  uint32_t cur = fan_state_word.load();
+  uint32_t next;
+  do {
+    if (state_gen(cur) != gen) {
+      return; // 定时器已被取消或重新设置
+    }
+    next = state_make(false, state_level(cur), gen + 1);
+  } while (!fan_state_word.compare_exchange_weak(cur, next));
+  int64_t t0 = esp_timer_get_time();
+  fan_state_apply(); // 定时关闭后通知订阅者（含HomeKit）
+  fan_state_change_done(t0, next);
 }
 
-void cancel_fan_timer() {
-  if (fan_off_timer) {
+bool fan_apply_batch(const fan_batch_t *batch) {
+  const char *TAG = "fan_gpio";
+  if (batch->level != 0 && (batch->level < 1 || batch->level > 3)) {
+    return false;
+  }
+  if (batch->timer_sec > FAN_TIMER_MAX_SEC) {
+    return false;
+  }
+  int64_t t0 = esp_timer_get_time();
+  TickType_t period =
+      batch->timer_sec > 0 ? (TickType_t)((uint64_t)batch->timer_sec * configTICK_RATE_HZ) : 0;
+  // 两个批次并发设置定时器时，若发布代数和启动定时器交错，定时器可能带着旧代数启动，
+  // 到期时被当成已取消而不关机；所以修改定时器的批次串行执行
+  bool timer_op = batch->timer_sec >= 0 && fan_timer_lock;
+  if (timer_op) {
+    xSemaphoreTake(fan_timer_lock, portMAX_DELAY);
+  }
+  TickType_t deadline = xTaskGetTickCount() + period;
+  uint32_t cur = fan_state_word.load();
+  uint32_t next;
+  do {
+    bool on = batch->on < 0 ? state_on(cur) : batch->on != 0;
+    int level = batch->level ? batch->level : state_level(cur);
+    // 设置或取消定时器都会递增代数，使已经排队的旧定时器回调失效
+    uint32_t gen = state_gen(cur) + (batch->timer_sec >= 0 ? 1 : 0);
+    next = state_make(on, level, gen);
+    if (batch->timer_sec > 0) {
+      // 截止时间在发布新代数之前写好，订阅者读到新状态时就能算出剩余时间
+      fan_timer_deadline.store(deadline);
+      fan_timer_armed_gen.store(state_gen(next));
+    }
+  } while (next != cur && !fan_state_word.compare_exchange_weak(cur, next));
+  bool armed = true;
+  if (fan_off_timer && batch->timer_sec > 0) {
+    vTimerSetTimerID(fan_off_timer, (void *)(uintptr_t)state_gen(next));
+    // 同时会启动定时器；命令队列满时失败，不能让状态显示一个不会到期的定时器
+    if (xTimerChangePeriod(fan_off_timer, period, pdMS_TO_TICKS(100)) != pdPASS) {
+      ESP_LOGE(TAG, "fan_apply_batch: failed to start off timer (%d s)", batch->timer_sec);
+      fan_timer_armed_gen.store(UINT32_MAX);
+      armed = false;
+    }
+  } else if (fan_off_timer && batch->timer_sec == 0) {
     xTimerStop(fan_off_timer, 0);
-    xTimerDelete(fan_off_timer, 0);
-    fan_off_timer = NULL;
   }
+  if (timer_op) {
+    xSemaphoreGive(fan_timer_lock);
+  }
+  fan_state_apply();
+  fan_state_change_done(t0, next);
+  return armed;
+}
+
+bool set_fan_timer(int seconds) {
+  fan_batch_t batch = {.on = -1, .level = 0, .timer_sec = seconds > 0 ? seconds : 0};
+  return fan_apply_batch(&batch);
 }
 
-bool get_fan_isON(void) { return fan_is_on_cache; }
+void cancel_fan_timer() {
+  fan_batch_t batch = {.on = -1, .level = 0, .timer_sec = 0};
+  fan_apply_batch(&batch);
+}
 
+// 定时器状态由状态字中的代数和截止时间推算，不需要查询 FreeRTOS 定时器
 bool fan_timer_running() {
-  return fan_off_timer != NULL && xTimerIsTimerActive(fan_off_timer) != pdFALSE;
+  return state_gen(fan_state_word.load()) == fan_timer_armed_gen.load();
 }
 
 int fan_timer_left() {
-  if (fan_off_timer && xTimerIsTimerActive(fan_off_timer) != pdFALSE) {
-    TickType_t ticks = xTimerGetExpiryTime(fan_off_timer) - xTaskGetTickCount();
-    if ((int)ticks < 0)
-      return 0;
-    return ticks / configTICK_RATE_HZ;
-  }
-  return 0;
+  if (!fan_timer_running())
+    return 0;
+  int32_t ticks = (int32_t)(fan_timer_deadline.load() - xTaskGetTickCount());
+  if (ticks < 0)
+    return 0;
+  return ticks / configTICK_RATE_HZ;
 }
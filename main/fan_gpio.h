@@ -1,13 +1,40 @@
 #pragma once
+#include <stdint.h>
+
+typedef struct {
+  bool on;
+  int level;          // 1 2 3
+  uint32_t timer_gen; // 定时器代数，设置/取消/到期时递增
+  uint32_t version;   // 状态字，任一字段变化都会改变，可用作缓存版本号
+} fan_state_t;
+
+// 批量操作，一次状态转换同时修改开关/挡位/定时器
+typedef struct {
+  int on;        // -1 不变，0 关，1 开
+  int level;     // 0 不变，1 2 3
+  int timer_sec; // -1 不变，0 取消，>0 设置关机倒计时
+} fan_batch_t;
+
+#define FAN_STATE_MAX_SUBSCRIBERS 6
+#define FAN_TIMER_MAX_SEC (7 * 24 * 3600) // 关机倒计时上限
+
+// 状态变化订阅回调，由状态机串行调用，参数为最新状态
+typedef void (*fan_state_cb_t)(const fan_state_t *state, void *arg);
+
 void fan_gpio_init(void);                  // 初始化LED/继电器GPIO
-void change_fan_state(bool on);            // 控制风扇并闪灯
-void change_fan_state(bool on, int level); // 控制风扇并闪灯 level 1 2 3
+bool change_fan_state(bool on);            // 控制风扇并闪灯，状态有变化时返回 true
+bool change_fan_state(bool on, int level); // 控制风扇并闪灯 level 1 2 3
 int getFanLevel(void);                     // 获取上次风扇挡位 1 2 3
 bool get_fan_isON(void);                   // 获取风扇状态
 void fan_gpio_led_on(void);                // LED常亮
 void fan_gpio_led_off(void);               // LED熄灭
+fan_state_t fan_get_state(void);           // 获取当前状态快照
+// 订阅状态变化（HomeKit/HTTP/LED），最多 FAN_STATE_MAX_SUBSCRIBERS 个
+bool fan_state_subscribe(fan_state_cb_t cb, void *arg);
 void blink_led(int times);
-void set_fan_timer(int seconds);
+// 批量修改，只通知订阅者一次；参数非法或定时器启动失败返回 false
+bool fan_apply_batch(const fan_batch_t *batch);
+bool set_fan_timer(int seconds); // 定时器启动失败返回 false
 bool fan_timer_running();
 int fan_timer_left();
 void cancel_fan_timer();
@@ -0,0 +1,123 @@
+#include "fan_store.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "perf_metrics.h"
+#include "sdkconfig.h"
+#include <atomic>
+
+#define FAN_NVS_NAMESPACE "fan_cfg"
+#define FAN_NVS_KEY_LEVEL "fan_level"
+
+static const char *TAG = "fan_store";
+
+// 内存中的最新挡位，以及 NVS 中已经保存的挡位
+static std::atomic<int> pending_level{0};
+static int committed_level = 0;
+static std::atomic<bool> dirty{false};
+static std::atomic<bool> discarded{false};
+static std::atomic<uint32_t> commit_count{0};
+static std::atomic<uint32_t> merge_count{0};
+static TaskHandle_t store_task = NULL;
+static SemaphoreHandle_t flush_lock = NULL;
+
+// 后台写入任务：收到第一次修改后等待合并窗口，再统一提交
+static void fan_store_task(void *arg) {
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (CONFIG_FAN_NVS_COMMIT_DELAY_MS > 0) {
+      vTaskDelay(pdMS_TO_TICKS(CONFIG_FAN_NVS_COMMIT_DELAY_MS));
+    }
+    fan_store_flush();
+  }
+}
+
+// esp_restart 前写入未提交的挡位。掉电复位无法在复位前安全写 flash，
+// 丢失的最多是合并窗口内的最后一次修改。
+static void fan_store_shutdown_handler(void) { fan_store_flush(); }
+
+int fan_store_load_level(int def_level) {
+  nvs_handle_t handle;
+  int32_t level = def_level;
+  if (nvs_open(FAN_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+    nvs_get_i32(handle, FAN_NVS_KEY_LEVEL, &level);
+    nvs_close(handle);
+  }
+  committed_level = level;
+  pending_level.store(level);
+  if (!store_task) {
+    flush_lock = xSemaphoreCreateMutex();
+    xTaskCreate(fan_store_task, "fan_store_task", 2048, NULL, 3, &store_task);
+    perf_metrics_watch_task("fan_store_task", store_task);
+    esp_register_shutdown_handler(fan_store_shutdown_handler);
+  }
+  return level;
+}
+
+void fan_store_save_level(int level) {
+  if (discarded.load()) {
+    return;
+  }
+  pending_level.store(level);
+  if (dirty.exchange(true)) {
+    merge_count.fetch_add(1, std::memory_order_relaxed); // 窗口内已有待写入的修改
+    return;
+  }
+  if (store_task) {
+    xTaskNotifyGive(store_task);
+  }
+}
+
+void fan_store_flush(void) {
+  if (!flush_lock || xSemaphoreTake(flush_lock, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return;
+  }
+  // 先清除标记再读取挡位，之后的修改会重新唤醒后台任务
+  dirty.store(false);
+  int level = pending_level.load();
+  if (level != committed_level && !discarded.load()) {
+    int64_t t0 = perf_metrics_begin();
+    nvs_handle_t handle;
+    bool ok = false;
+    if (nvs_open(FAN_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+      if (nvs_set_i32(handle, FAN_NVS_KEY_LEVEL, level) == ESP_OK &&
+          nvs_commit(handle) == ESP_OK) {
+        ok = true;
+        committed_level = level;
+        uint32_t commits = commit_count.fetch_add(1, std::memory_order_relaxed) + 1;
+        ESP_LOGI(TAG, "commit level=%d, commits=%u, merged=%u", level, (unsigned)commits,
+                 (unsigned)merge_count.load(std::memory_order_relaxed));
+      }
+      nvs_close(handle);
+    }
+    if (ok) {
+      perf_metrics_observe_since(PERF_METRICS_NVS_COMMIT, t0);
+    } else {
+      perf_metrics_inc(PERF_METRICS_NVS_COMMIT_FAILURES);
+      // 提交失败时恢复标记，合并窗口后由后台任务重试
+      if (!dirty.exchange(true) && store_task) {
+        xTaskNotifyGive(store_task);
+      }
+    }
+  }
+  xSemaphoreGive(flush_lock);
+}
+
+void fan_store_discard(void) {
+  // 拿到锁说明没有正在进行的写入，之后的保存和提交都被忽略
+  if (flush_lock) {
+    xSemaphoreTake(flush_lock, portMAX_DELAY);
+  }
+  discarded.store(true);
+  dirty.store(false);
+  if (flush_lock) {
+    xSemaphoreGive(flush_lock);
+  }
+}
+
+uint32_t fan_store_commit_count(void) { return commit_count.load(std::memory_order_relaxed); }
+
+uint32_t fan_store_merge_count(void) { return merge_count.load(std::memory_order_relaxed); }
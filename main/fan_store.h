@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+int fan_store_load_level(int def_level); // 从NVS读取挡位并启动后台写入任务
+void fan_store_save_level(int level);    // 更新挡位，合并窗口结束后由后台任务写入NVS
+void fan_store_flush(void);              // 立即写入未提交的挡位（重启前调用）
+void fan_store_discard(void);            // 丢弃未提交的挡位并停止写入（擦除 NVS 前调用）
+uint32_t fan_store_commit_count(void);   // NVS 实际提交次数
+uint32_t fan_store_merge_count(void);    // 被合并掉的挡位修改次数
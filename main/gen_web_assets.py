@@ -0,0 +1,188 @@
+import gzip
+import hashlib
+import json
+import os
+import re
+import sys
+
+try:
+    import brotli  # 可选，没有安装时只生成 gzip
+except ImportError:
+    brotli = None
+
+# 编译期把 html 目录打包成 C 数组，常量数组位于 flash，运行时直接从映射地址发送。
+# 每个文件先做保守的压缩空白处理，再生成 gzip/brotli 版本，运行时按 Accept-Encoding 选择。
+# 每个文件的内容哈希用作 ETag，html 中引用的资源地址带上哈希，便于浏览器长期缓存。
+# 用法: gen_web_assets.py <html目录> <输出.c文件> [manifest.json]
+
+MIME_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+# 只对这些类型去掉缩进和空行；js 不做处理，避免破坏模板字符串
+MINIFY_EXTS = (".html", ".css", ".svg", ".json")
+
+# 压缩后至少要省下 10% 才保留对应版本，否则直接发原文件
+MIN_SAVING = 0.9
+
+# 内容哈希长度，用作 ETag 和资源地址上的版本号
+HASH_LEN = 16
+
+
+def minify(name, data):
+    ext = os.path.splitext(name)[1].lower()
+    if ext not in MINIFY_EXTS or ".min." in name:
+        return data
+    text = data.decode("utf-8")
+    if ext == ".css":
+        text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    lines = [line.strip() for line in text.splitlines()]
+    return "\n".join(line for line in lines if line).encode("utf-8")
+
+
+def compress(data):
+    gz = gzip.compress(data, compresslevel=9, mtime=0)
+    if len(gz) > len(data) * MIN_SAVING:
+        gz = None
+    br = None
+    if brotli is not None:
+        br = brotli.compress(data, quality=11)
+        if len(br) > len(data) * MIN_SAVING:
+            br = None
+    return gz, br
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:HASH_LEN]
+
+
+def fingerprint(data, hashes):
+    # 给 html 中引用的本地资源加上 ?v=<内容哈希>，内容变化时地址随之变化，可以长期缓存
+    def repl(m):
+        uri = m.group(2)
+        if uri not in hashes:
+            return m.group(0)
+        return '%s="%s?v=%s"' % (m.group(1), uri, hashes[uri])
+
+    text = data.decode("utf-8")
+    return re.sub(r'(src|href)="(/[^"?#]+)"', repl, text).encode("utf-8")
+
+
+def collect(html_dir):
+    assets = []
+    for root, _, files in os.walk(html_dir):
+        for name in files:
+            path = os.path.join(root, name)
+            uri = "/" + os.path.relpath(path, html_dir).replace(os.sep, "/")
+            ext = os.path.splitext(name)[1].lower()
+            with open(path, "rb") as f:
+                src = f.read()
+            assets.append({
+                "uri": uri,
+                "ext": ext,
+                "type": MIME_TYPES.get(ext, "text/plain"),
+                "src_len": len(src),
+                "data": minify(name, src),
+            })
+    # 先计算被引用资源的哈希，再改写 html 中的引用地址
+    hashes = {a["uri"]: content_hash(a["data"]) for a in assets if a["ext"] != ".html"}
+    for a in assets:
+        if a["ext"] == ".html":
+            a["data"] = fingerprint(a["data"], hashes)
+        a["hash"] = content_hash(a["data"])
+        a["gz"], a["br"] = compress(a["data"])
+    # 按 uri 排序，运行时用二分查找
+    assets.sort(key=lambda a: a["uri"])
+    return assets
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def c_array(out, name, data):
+    out.append("static const uint8_t %s[%d] = {" % (name, max(len(data), 1)))
+    out.append(c_bytes(data))
+    out.append("};")
+
+
+def c_ref(name, data):
+    if data is None:
+        return "NULL, 0"
+    return "%s, %d" % (name, len(data))
+
+
+def sha256(data):
+    return hashlib.sha256(data).hexdigest() if data is not None else None
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        print("用法: gen_web_assets.py <html目录> <输出.c文件> [manifest.json]")
+        sys.exit(1)
+    html_dir, out_path = sys.argv[1], sys.argv[2]
+    assets = collect(html_dir)
+
+    out = ["// 由 gen_web_assets.py 自动生成，请勿修改", '#include "web_assets.h"', ""]
+    for i, a in enumerate(assets):
+        out.append("// %s" % a["uri"])
+        c_array(out, "asset_%d" % i, a["data"])
+        if a["gz"] is not None:
+            c_array(out, "asset_%d_gz" % i, a["gz"])
+        if a["br"] is not None:
+            c_array(out, "asset_%d_br" % i, a["br"])
+        out.append("")
+    out.append("const web_asset_t web_assets[] = {")
+    for i, a in enumerate(assets):
+        out.append('    {"%s", "%s", "%s", %s, %s, %s},' %
+                   (a["uri"], a["type"], a["hash"], c_ref("asset_%d" % i, a["data"]),
+                    c_ref("asset_%d_gz" % i, a["gz"]), c_ref("asset_%d_br" % i, a["br"])))
+    out.append("};")
+    out.append("const size_t web_assets_count = %d;" % len(assets))
+    out.append("")
+
+    with open(out_path, "w") as f:
+        f.write("\n".join(out))
+
+    if len(sys.argv) == 4:
+        manifest = []
+        for a in assets:
+            manifest.append({
+                "uri": a["uri"],
+                "type": a["type"],
+                "source_size": a["src_len"],
+                "size": len(a["data"]),
+                "etag": a["hash"],
+                "sha256": sha256(a["data"]),
+                "gzip_size": len(a["gz"]) if a["gz"] is not None else None,
+                "gzip_sha256": sha256(a["gz"]),
+                "br_size": len(a["br"]) if a["br"] is not None else None,
+                "br_sha256": sha256(a["br"]),
+            })
+        with open(sys.argv[3], "w") as f:
+            json.dump(manifest, f, indent=2)
+
+    total_src = 0
+    total_wire = 0
+    for a in assets:
+        wire = min(len(v) for v in (a["data"], a["gz"], a["br"]) if v is not None)
+        total_src += a["src_len"]
+        total_wire += wire
+        print("[web_assets] %-28s 原始 %7d  压缩后 %7d  比例 %5.1f%%  节省 %7d 字节" %
+              (a["uri"], a["src_len"], wire, wire * 100.0 / max(a["src_len"], 1),
+               a["src_len"] - wire))
+    print("[web_assets] 共 %d 个文件, 原始 %d 字节, 传输 %d 字节, brotli %s" %
+          (len(assets), total_src, total_wire, "启用" if brotli is not None else "未安装"))
+
+
+if __name__ == "__main__":
+    main()
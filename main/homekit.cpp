@@ -1,6 +1,7 @@
 #include "esp_log.h"
 #include "fan_gpio.h"
-#include <cstring>
+#include "perf_trace.h"
+#include <cstdint>
 extern "C" {
 #include "hap.h"
 #include "hap_apple_chars.h"
@@ -80,46 +81,76 @@ static int fan_identify(hap_acc_t *ha) {
   return HAP_SUCCESS;
 }
 
+// 特征角色在注册时写入特征私有数据，写回调按角色分派，不再逐个比较 UUID
+enum fan_char_role_t {
+  FAN_CHAR_ROLE_NONE = 0,
+  FAN_CHAR_ROLE_ON,
+  FAN_CHAR_ROLE_SPEED,
+};
+
+static fan_char_role_t fan_char_role(hap_char_t *hc) {
+  return (fan_char_role_t)(intptr_t)hap_char_get_priv(hc);
+}
+
 // HomeKit Fan 服务写回调
 static int fan_serv_write(hap_write_data_t *write_data, int count, void *serv_priv,
                           void *write_priv) {
+  int64_t t0 = perf_trace_begin();
   bool on_updated = false;
   bool on = get_fan_isON();
   float speed = 100.0f;
   for (int i = 0; i < count; i++) {
     ESP_LOGI(TAG, "[HAP] Write data[%d]: hc=%p, val.b=%d, val.f=%.2f, remote=%d", i,
              write_data[i].hc, write_data[i].val.b, write_data[i].val.f, write_data[i].remote);
-    const char *uuid = hap_char_get_type_uuid(write_data[i].hc);
-    if (strcmp(uuid, HAP_CHAR_UUID_ON) == 0) {
+    switch (fan_char_role(write_data[i].hc)) {
+    case FAN_CHAR_ROLE_ON:
       on = write_data[i].val.b;
       on_updated = true;
-    } else if (strcmp(uuid, HAP_CHAR_UUID_ROTATION_SPEED) == 0) {
+      break;
+    case FAN_CHAR_ROLE_SPEED:
       speed = write_data[i].val.f;
+      break;
+    default:
+      *write_data[i].status = HAP_STATUS_RES_ABSENT;
+      break;
     }
   }
   ESP_LOGI(TAG, "[HAP] Fan write: on=%d, speed=%.2f%%", on, speed);
-  int level = 3;
-  if (on_updated && !on) {
-    change_fan_state(false);
-    homekit_fan_state_sync(false, level); // 正确：同步关机
-    return HAP_SUCCESS;
-  }
-  if (speed == 0) {
-    change_fan_state(false);
-    homekit_fan_state_sync(false, level); // 正确：同步关机
+  // On 和 RotationSpeed 合并为一次状态转换。状态变化会通过订阅回调同步到 HomeKit，
+  // 刚写入的值不会再通知回写入方；状态未变时手动同步一次，把风速对齐到挡位
+  if ((on_updated && !on) || speed == 0) {
+    if (!change_fan_state(false)) {
+      homekit_fan_state_sync(false, getFanLevel());
+    }
+    perf_trace_end(PERF_TRACE_FAN_SERV_WRITE, t0, count);
     return HAP_SUCCESS;
   }
+  int level = 3;
   if (speed < 34)
     level = 1;
   else if (speed < 67)
     level = 2;
   else
     level = 3;
-  change_fan_state(true, level);
-  homekit_fan_state_sync(true, level); // 同步到 HomeKit
+  if (!change_fan_state(true, level)) {
+    homekit_fan_state_sync(true, level);
+  }
+  perf_trace_end(PERF_TRACE_FAN_SERV_WRITE, t0, count);
   return HAP_SUCCESS;
 }
 
+// 风扇状态订阅回调：任何来源（HomeKit/HTTP/定时器）的状态变化都同步到 HomeKit
+static void homekit_fan_state_cb(const fan_state_t *state, void *arg) {
+  static bool last_on = false;
+  static int last_level = 0;
+  if (state->on == last_on && state->level == last_level) {
+    return; // 只有定时器变化，HomeKit 无需更新
+  }
+  last_on = state->on;
+  last_level = state->level;
+  homekit_fan_state_sync(state->on, state->level);
+}
+
 extern "C" void homekit_init() {
   hap_acc_cfg_t cfg = {.name = (char *)"风扇控制器",
                        .model = (char *)"ESP32FAN",
@@ -145,6 +176,10 @@ extern "C" void homekit_init() {
   fan_on_char = hap_serv_get_char_by_uuid(fan_serv, HAP_CHAR_UUID_ON);
   if (fan_speed_char) {
     hap_char_float_set_constraints(fan_speed_char, 0.0f, 100.0f, 33.0f); // 三挡
+    hap_char_set_priv(fan_speed_char, (void *)(intptr_t)FAN_CHAR_ROLE_SPEED);
+  }
+  if (fan_on_char) {
+    hap_char_set_priv(fan_on_char, (void *)(intptr_t)FAN_CHAR_ROLE_ON);
   }
 
   // 注册写回调
@@ -154,6 +189,7 @@ extern "C" void homekit_init() {
   hap_set_setup_code("111-11-111");
   ESP_LOGI(TAG, "HomeKit 配对码: 111-11-111");
   hap_set_setup_id("7G9X");
+  fan_state_subscribe(homekit_fan_state_cb, NULL);
   hap_init(HAP_TRANSPORT_WIFI);
   esp_event_handler_register(HAP_EVENT, ESP_EVENT_ANY_ID, &fan_hap_event_handler, NULL);
   hap_start();
@@ -114,29 +114,73 @@ setTimerBtn.addEventListener("click", () => {
 
 timerOff.addEventListener("click", cancelTimer);
 
+let timerLeft = 0;
+let timerDeadline = 0;
+
+function renderTimer() {
+  timerLeft = Math.max(0, Math.round((timerDeadline - Date.now()) / 1000));
+  // 显示关闭倒计时
+  if (timerLeft > 0) {
+    const duration = dayjs.duration(timerLeft, "seconds");
+    const timeStr = duration.format("HH:mm:ss");
+    timerOff.style.visibility = "visible";
+    timerOff.textContent = `取消倒计时：${timeStr}`;
+  } else {
+    timerOff.style.visibility = "hidden";
+  }
+}
+
+function applyStatus({ status, timer_left, last_fan_level }) {
+  fanOn = status === 1;
+  fanLevel = last_fan_level || 1;
+  checkedLevel();
+  changeAnimation(fanOn);
+  timerDeadline = Date.now() + (typeof timer_left === "number" ? timer_left : 0) * 1000;
+  renderTimer();
+}
+
+// 倒计时在本地每秒刷新，状态变化由服务器推送
+setInterval(() => {
+  if (timerLeft > 0) renderTimer();
+}, 1000);
+
 async function updateStatus() {
   try {
     const response = await fetch(`/api/status`);
-    const { status, timer_left, last_fan_level } = await response.json();
-    fanOn = status === 1;
-    fanLevel = last_fan_level || 1;
-    checkedLevel();
-    changeAnimation(fanOn);
-
-    // 显示关闭倒计时
-    if (typeof timer_left === "number" && timer_left > 0) {
-      const duration = dayjs.duration(timer_left, "seconds");
-      const timeStr = duration.format("HH:mm:ss");
-      timerOff.style.visibility = "visible";
-      timerOff.textContent = `取消倒计时：${timeStr}`;
-    } else {
-      timerOff.style.visibility = "hidden";
-    }
+    applyStatus(await response.json());
   } catch (error) {
     console.error("Error fetching status:", error);
   }
-  await sleep(5000); // 每5秒更新一次状态
-  updateStatus();
 }
 
-updateStatus();
+// 推送不可用时每5秒轮询一次状态，直到 until 时刻
+async function pollStatus(until) {
+  do {
+    await updateStatus();
+    await sleep(5000);
+  } while (Date.now() < until);
+}
+
+function subscribeStatus() {
+  if (!window.EventSource) {
+    // 不支持 SSE 的浏览器一直轮询
+    pollStatus(Infinity);
+    return;
+  }
+  const events = new EventSource("/api/events");
+  events.addEventListener("state", (event) => {
+    applyStatus(JSON.parse(event.data));
+  });
+  events.onerror = () => {
+    if (events.readyState !== EventSource.CLOSED) {
+      console.error("Status stream disconnected, retrying");
+      return;
+    }
+    // 推送连接数已满（503）等情况浏览器不会自动重连：先轮询，30秒后再尝试订阅
+    console.error("Status stream closed, polling /api/status");
+    events.close();
+    pollStatus(Date.now() + 30000).then(subscribeStatus);
+  };
+}
+
+subscribeStatus();
@@ -19,6 +19,7 @@ extern "C" {
 }
 #include "esp_log.h"
 #include "fan_gpio.h" // 新增，所有GPIO操作通过此接口
+#include "fan_store.h"
 #include "homekit.h"
 #include "web_server.h"
 
@@ -32,17 +33,14 @@ static const char *TAG = "main";
 // 恢复出厂回调
 void IRAM_ATTR button_factory_reset_cb(void *arg) {
   ESP_LOGW(TAG, "[Button] Long press detected, erasing NVS and restarting...");
+  fan_store_discard(); // 否则关机回调会把未提交的挡位写回擦除后的 NVS
   nvs_flash_erase();
   vTaskDelay(10 / portTICK_PERIOD_MS);
   esp_restart();
 }
 
 extern "C" void app_main() {
-  // 初始化GPIO（LED/继电器）全部交由fan_gpio_init实现
-  fan_gpio_init();
-  fan_gpio_led_on(); // 上电即常亮
-
-  // NVS 初始化，确保 WiFi 可用
+  // NVS 初始化，确保 WiFi 可用，且 fan_gpio_init 能读到上次保存的挡位
   esp_err_t ret = nvs_flash_init();
   // 不再注册fan_gpio回调
   // register_fan_state_callback(homekit_fan_state_cb); // 删除
@@ -52,6 +50,10 @@ extern "C" void app_main() {
     nvs_flash_init();
   }
 
+  // 初始化GPIO（LED/继电器）全部交由fan_gpio_init实现
+  fan_gpio_init();
+  fan_gpio_led_on(); // 上电即常亮
+
   // WiFi 配网
   app_wifi_init();
   esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 编译期由 gen_web_assets.py 从 html 目录生成，数据常驻 flash
+typedef struct {
+  const char *uri;     // 例如 /js/index.js
+  const char *type;    // Content-Type
+  const char *hash;    // 内容哈希，用作 ETag 和 ?v= 版本号
+  const uint8_t *data; // 文件内容（已去除多余空白）
+  size_t len;          // 文件长度
+  const uint8_t *gz;   // gzip 版本，压缩收益不足时为 NULL
+  size_t gz_len;       // gzip 版本长度
+  const uint8_t *br;   // brotli 版本，未安装 brotli 模块时为 NULL
+  size_t br_len;       // brotli 版本长度
+} web_asset_t;
+
+extern const web_asset_t web_assets[]; // 按 uri 排序
+extern const size_t web_assets_count;
+
+#ifdef __cplusplus
+}
+#endif
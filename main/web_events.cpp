@@ -0,0 +1,198 @@
+#include "web_events.h"
+#include "esp_log.h"
+#include "fan_gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "perf_trace.h"
+#include "sdkconfig.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef CONFIG_FAN_HTTP_SHARED_SERVER
+#include "hap_platform_httpd.h"
+#endif
+
+// Server-Sent Events 推送：风扇状态变化时只序列化一次，再发给所有订阅的连接。
+// 订阅者列表只在 httpd 任务中访问（请求处理、httpd_queue_work、连接关闭回调），无需加锁。
+// 订阅者按套接字记录，不使用 sess_ctx：共享 HAP 服务器时 sess_ctx 属于 HomeKit 安全会话。
+
+#define SSE_MAX_CLIENTS CONFIG_FAN_HTTP_SSE_MAX_CLIENTS
+#define SSE_BACKLOG_SIZE 512 // 每个连接最多积压的未发送字节，超出则断开
+#define SSE_HEARTBEAT_MS 15000
+
+static const char *TAG = "web_events";
+
+typedef struct {
+  int fd; // -1 表示空闲
+  bool closing;
+  size_t pending_len;
+  char pending[SSE_BACKLOG_SIZE];
+} sse_client_t;
+
+static sse_client_t sse_clients[SSE_MAX_CLIENTS];
+static httpd_handle_t sse_server = NULL;
+static TimerHandle_t sse_heartbeat_timer = NULL;
+static std::atomic<bool> sse_broadcast_queued{false};
+
+static int sse_render_state(char *buf, size_t size) {
+  fan_state_t st = fan_get_state();
+  return snprintf(buf, size,
+                  "event: state\ndata: {\"status\":%d,\"timer_left\":%d,\"last_fan_level\":%d}\n\n",
+                  st.on, fan_timer_left(), st.level);
+}
+
+// 先发送积压数据，再发送新数据；发不完的部分进入积压缓冲，缓冲不够则断开该连接
+static void sse_client_send(sse_client_t *c, const char *buf, size_t len) {
+  if (c->fd < 0 || c->closing) {
+    return;
+  }
+  if (c->pending_len > 0) {
+    int ret = httpd_socket_send(sse_server, c->fd, c->pending, c->pending_len, MSG_DONTWAIT);
+    if (ret > 0) {
+      httpd_sess_update_lru_counter(sse_server, c->fd);
+      memmove(c->pending, c->pending + ret, c->pending_len - ret);
+      c->pending_len -= ret;
+    } else if (ret != HTTPD_SOCK_ERR_TIMEOUT) {
+      goto drop;
+    }
+  }
+  if (len > 0 && c->pending_len == 0) {
+    int ret = httpd_socket_send(sse_server, c->fd, buf, len, MSG_DONTWAIT);
+    if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+      ret = 0;
+    } else if (ret < 0) {
+      goto drop;
+    }
+    if (ret > 0) {
+      // 推送成功的连接算作活跃，LRU 优先回收空闲的普通连接
+      httpd_sess_update_lru_counter(sse_server, c->fd);
+    }
+    buf += ret;
+    len -= ret;
+  }
+  if (len > 0) {
+    if (c->pending_len + len > sizeof(c->pending)) {
+      ESP_LOGW(TAG, "client fd=%d backlog full, closing", c->fd);
+      goto drop;
+    }
+    memcpy(c->pending + c->pending_len, buf, len);
+    c->pending_len += len;
+  }
+  return;
+drop:
+  c->closing = true;
+  httpd_sess_trigger_close(sse_server, c->fd);
+}
+
+static void sse_broadcast(const char *buf, size_t len) {
+  for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+    sse_client_send(&sse_clients[i], buf, len);
+  }
+}
+
+static void sse_broadcast_work(void *arg) {
+  sse_broadcast_queued.store(false);
+  int64_t t0 = perf_trace_begin();
+  char buf[128];
+  int len = sse_render_state(buf, sizeof(buf));
+  sse_broadcast(buf, len);
+  perf_trace_end(PERF_TRACE_SSE_SEND, t0, len);
+}
+
+static void sse_heartbeat_work(void *arg) {
+  static const char ping[] = ": ping\n\n";
+  sse_broadcast(ping, sizeof(ping) - 1);
+}
+
+// 风扇状态订阅回调，可能在任意任务中执行，只负责把推送交给 httpd 任务
+static void sse_fan_state_cb(const fan_state_t *state, void *arg) {
+  if (sse_server && !sse_broadcast_queued.exchange(true)) {
+    if (httpd_queue_work(sse_server, sse_broadcast_work, NULL) != ESP_OK) {
+      sse_broadcast_queued.store(false);
+    }
+  }
+}
+
+static void sse_heartbeat_cb(TimerHandle_t xTimer) {
+  httpd_queue_work(sse_server, sse_heartbeat_work, NULL);
+}
+
+// 连接关闭时移除订阅者，由 httpd 任务在关闭套接字之前调用
+static void sse_sock_closed(httpd_handle_t hd, int fd) {
+  for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+    if (sse_clients[i].fd == fd) {
+      ESP_LOGI(TAG, "client fd=%d unsubscribed", fd);
+      sse_clients[i].fd = -1;
+      sse_clients[i].pending_len = 0;
+    }
+  }
+}
+
+#ifndef CONFIG_FAN_HTTP_SHARED_SERVER
+void web_events_close_fn(httpd_handle_t hd, int fd) {
+  sse_sock_closed(hd, fd);
+  close(fd);
+}
+#endif
+
+esp_err_t web_events_handler(httpd_req_t *req) {
+  // 已有会话上下文的连接是 HomeKit 配对/加密会话，不能改成事件流
+  if (req->sess_ctx) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"session busy\"}");
+    return ESP_OK;
+  }
+  int fd = httpd_req_to_sockfd(req);
+  sse_client_t *slot = NULL;
+  for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+    if (sse_clients[i].fd == fd) {
+      slot = &sse_clients[i]; // 同一连接重复订阅，复用原来的槽位
+      break;
+    }
+    if (!slot && sse_clients[i].fd < 0) {
+      slot = &sse_clients[i];
+    }
+  }
+  if (!slot) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"too many event clients\"}");
+    return ESP_OK;
+  }
+  // 直接写响应头，不带 Content-Length，之后通过 httpd_socket_send 持续推送
+  static const char hdr[] = "HTTP/1.1 200 OK\r\n"
+                            "Content-Type: text/event-stream\r\n"
+                            "Cache-Control: no-cache\r\n"
+                            "Access-Control-Allow-Origin: *\r\n"
+                            "Connection: keep-alive\r\n\r\n"
+                            "retry: 3000\n\n";
+  if (httpd_send(req, hdr, sizeof(hdr) - 1) < 0) {
+    return ESP_FAIL;
+  }
+  slot->fd = fd;
+  slot->closing = false;
+  slot->pending_len = 0;
+  char buf[128];
+  int len = sse_render_state(buf, sizeof(buf));
+  sse_client_send(slot, buf, len);
+  ESP_LOGI(TAG, "client fd=%d subscribed", fd);
+  return ESP_OK;
+}
+
+void web_events_init(httpd_handle_t server) {
+  for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+    sse_clients[i].fd = -1;
+  }
+  sse_server = server;
+#ifdef CONFIG_FAN_HTTP_SHARED_SERVER
+  // HAP 服务器已经启动，通过平台层的关闭回调得知连接断开
+  hap_platform_httpd_set_close_cb(sse_sock_closed);
+#endif
+  fan_state_subscribe(sse_fan_state_cb, NULL);
+  sse_heartbeat_timer = xTimerCreate("sse_heartbeat", pdMS_TO_TICKS(SSE_HEARTBEAT_MS), pdTRUE,
+                                     NULL, sse_heartbeat_cb);
+  if (sse_heartbeat_timer) {
+    xTimerStart(sse_heartbeat_timer, 0);
+  }
+}
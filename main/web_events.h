@@ -0,0 +1,6 @@
+#pragma once
+#include "esp_http_server.h"
+void web_events_init(httpd_handle_t server);    // 注册风扇状态订阅和心跳定时器
+esp_err_t web_events_handler(httpd_req_t *req); // GET /api/events，SSE 长连接
+// 独立服务器的 close_fn：移除该连接上的订阅者并关闭套接字。共享 HAP 服务器时不使用
+void web_events_close_fn(httpd_handle_t hd, int fd);
@@ -1,9 +1,18 @@
 #include "driver/gpio.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
-#include "esp_spiffs.h"
+#include "esp_timer.h"
 #include "fan_gpio.h"
 #include "homekit.h"
+#include "json_parser.h"
+#include "perf_metrics.h"
+#include "perf_trace.h"
+#include "sdkconfig.h"
+#include "web_assets.h"
+#include "web_events.h"
+#ifdef CONFIG_FAN_HTTP_SHARED_SERVER
+#include "hap_platform_httpd.h"
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,8 +33,28 @@ static void set_cors_headers(httpd_req_t *req) {
 }
 
 static const char *TAG = "web_server";
+
+// 请求处理耗时计入 /metrics 中对应 handler 的直方图
+struct api_metrics_scope {
+  perf_metrics_histogram_t hist;
+  int64_t t0 = perf_metrics_begin();
+  explicit api_metrics_scope(perf_metrics_histogram_t h) : hist(h) {}
+  ~api_metrics_scope() { perf_metrics_observe_since(hist, t0); }
+};
+
+// 控制类 API 额外记录 perf_trace 的 http_api 阶段，arg 为连接 fd，便于与同连接的其他阶段对应
+struct api_trace_scope : api_metrics_scope {
+  httpd_req_t *req;
+  int64_t trace_t0 = perf_trace_begin();
+  api_trace_scope(httpd_req_t *r, perf_metrics_histogram_t h) : api_metrics_scope(h), req(r) {}
+  ~api_trace_scope() {
+    perf_trace_end(PERF_TRACE_HTTP_API, trace_t0, (uint32_t)httpd_req_to_sockfd(req));
+  }
+};
+
 // /api/on 处理函数
 static esp_err_t api_on_handler(httpd_req_t *req) {
+  api_trace_scope trace(req, PERF_METRICS_HTTP_API_ON);
   char query[64] = {0};
   int level = getFanLevel(); // 如果没有level参数，使用上次风速
   // 获取 GET 参数 level
@@ -39,15 +68,14 @@ static esp_err_t api_on_handler(httpd_req_t *req) {
   }
   set_cors_headers(req);
   change_fan_state(true, level);
-  homekit_fan_state_sync(true, level);
   httpd_resp_sendstr(req, "{\"result\":true,\"status\":1}");
   return ESP_OK;
 }
 // /api/off 处理函数
 static esp_err_t api_off_handler(httpd_req_t *req) {
+  api_trace_scope trace(req, PERF_METRICS_HTTP_API_OFF);
   set_cors_headers(req);
   change_fan_state(false);
-  homekit_fan_state_sync(false, getFanLevel());
   httpd_resp_sendstr(req, "{\"result\":true,\"status\":0}");
   return ESP_OK;
 }
@@ -56,6 +84,7 @@ extern bool fan_timer_running();
 extern int fan_timer_left();
 
 static esp_err_t api_timer_off_handler(httpd_req_t *req) {
+  api_trace_scope trace(req, PERF_METRICS_HTTP_API_TIMER_OFF);
   set_cors_headers(req);
   char query[64] = {0};
   int timer_sec = 0;
@@ -66,14 +95,17 @@ static esp_err_t api_timer_off_handler(httpd_req_t *req) {
       timer_sec = atoi(seconds_str);
     }
   }
-  if (timer_sec <= 0) {
+  if (timer_sec <= 0 || timer_sec > FAN_TIMER_MAX_SEC) {
     httpd_resp_set_status(req, "400 Bad Request");
     httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"invalid timer\"}");
     return ESP_OK;
   }
-  // 新的请求直接取消老的定时器并设置新的
-  cancel_fan_timer();
-  set_fan_timer(timer_sec);
+  // 新的请求直接替换老的定时器，set_fan_timer 会换掉定时器代次，不需要先取消
+  if (!set_fan_timer(timer_sec)) {
+    httpd_resp_set_status(req, "500 Internal Server Error");
+    httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"timer failed\"}");
+    return ESP_OK;
+  }
   char resp[64];
   snprintf(resp, sizeof(resp), "{\"result\":true,\"timer\":%d}", timer_sec);
   httpd_resp_sendstr(req, resp);
@@ -82,6 +114,7 @@ static esp_err_t api_timer_off_handler(httpd_req_t *req) {
 
 // /api/cancel_timer 处理函数
 static esp_err_t api_cancel_timer_handler(httpd_req_t *req) {
+  api_trace_scope trace(req, PERF_METRICS_HTTP_API_CANCEL_TIMER);
   set_cors_headers(req);
   if (!fan_timer_running()) {
     httpd_resp_set_status(req, "409 Conflict");
@@ -93,86 +126,409 @@ static esp_err_t api_cancel_timer_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
-// /api/status 处理函数
-static esp_err_t api_status_handler(httpd_req_t *req) {
+static const web_asset_t *find_web_asset(const char *uri, size_t uri_len) {
+  size_t lo = 0, hi = web_assets_count;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int cmp = strncmp(web_assets[mid].uri, uri, uri_len);
+    if (cmp == 0 && web_assets[mid].uri[uri_len] != '\0')
+      cmp = 1;
+    if (cmp == 0)
+      return &web_assets[mid];
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return NULL;
+}
+
+#define BATCH_MAX_BODY 512
+#define BATCH_MAX_OPS 16
+
+// POST /api/batch 批量操作，例如
+// [{"op":"on","level":3},{"op":"timer","seconds":1800}]
+// 支持 on/off/level/timer/cancel_timer，所有操作合并成一次状态转换，HomeKit 只同步一次；
+// 任一操作非法时整批不生效
+static esp_err_t api_batch_handler(httpd_req_t *req) {
+  api_trace_scope trace(req, PERF_METRICS_HTTP_API_BATCH);
   set_cors_headers(req);
-  int last_fan_level = getFanLevel();
-  int isON = get_fan_isON();
-  int timer_left = fan_timer_left();
-  char resp[128];
-  int len = snprintf(resp, sizeof(resp), "{\"status\":%d,\"timer_left\":%d,\"last_fan_level\":%d}",
-                     isON, timer_left, last_fan_level);
-  ESP_LOGI(TAG, "/api/status called, status=%d, timer_left=%d, last_fan_level=%d, resp=%.*s", isON,
-           timer_left, last_fan_level, len, resp);
-  httpd_resp_sendstr(req, resp);
+  int64_t t0 = esp_timer_get_time();
+  char body[BATCH_MAX_BODY + 1];
+  if (req->content_len <= 0 || req->content_len > BATCH_MAX_BODY) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"invalid body\"}");
+    return ESP_OK;
+  }
+  int received = 0;
+  while (received < (int)req->content_len) {
+    int ret = httpd_req_recv(req, body + received, req->content_len - received);
+    if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+      continue;
+    if (ret <= 0)
+      return ESP_FAIL;
+    received += ret;
+  }
+  body[received] = '\0';
+
+  jparse_ctx_t jctx;
+  int64_t parse_t0 = perf_trace_begin();
+  int parse_ret = json_parse_start(&jctx, body, received);
+  perf_trace_end(PERF_TRACE_JSON_PARSE, parse_t0, received);
+  if (parse_ret != 0) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"invalid json\"}");
+    return ESP_OK;
+  }
+  // 根必须是数组，且每个元素都是对象；超过上限或混入其他值时整批拒绝，不做部分处理
+  int num_ops = jctx.cur->type == JSMN_ARRAY ? jctx.cur->size : 0;
+  if (num_ops > BATCH_MAX_OPS) {
+    json_parse_end(&jctx);
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"too many ops\"}");
+    return ESP_OK;
+  }
+  fan_batch_t batch = {.on = -1, .level = 0, .timer_sec = -1};
+  const char *errors[BATCH_MAX_OPS];
+  int count = 0;
+  bool ok = true;
+  for (; count < num_ops; count++) {
+    if (json_arr_get_object(&jctx, count) != 0) {
+      json_parse_end(&jctx);
+      httpd_resp_set_status(req, "400 Bad Request");
+      httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"invalid op\"}");
+      return ESP_OK;
+    }
+    char op[16] = {0};
+    int val = 0;
+    const char *err = NULL;
+    json_obj_get_string(&jctx, "op", op, sizeof(op));
+    if (strcmp(op, "on") == 0) {
+      batch.on = 1;
+      if (json_obj_get_int(&jctx, "level", &val) == 0) {
+        if (val < 1 || val > 3)
+          err = "invalid level";
+        else
+          batch.level = val;
+      }
+    } else if (strcmp(op, "off") == 0) {
+      batch.on = 0;
+    } else if (strcmp(op, "level") == 0) {
+      if (json_obj_get_int(&jctx, "level", &val) != 0 || val < 1 || val > 3)
+        err = "invalid level";
+      else
+        batch.level = val;
+    } else if (strcmp(op, "timer") == 0) {
+      if (json_obj_get_int(&jctx, "seconds", &val) != 0 || val <= 0 || val > FAN_TIMER_MAX_SEC)
+        err = "invalid timer";
+      else
+        batch.timer_sec = val;
+    } else if (strcmp(op, "cancel_timer") == 0) {
+      batch.timer_sec = 0;
+    } else {
+      err = "unknown op";
+    }
+    errors[count] = err;
+    ok = ok && err == NULL;
+    json_arr_leave_object(&jctx);
+  }
+  json_parse_end(&jctx);
+  if (count == 0) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    httpd_resp_sendstr(req, "{\"result\":false,\"error\":\"no ops\"}");
+    return ESP_OK;
+  }
+  if (!ok) {
+    httpd_resp_set_status(req, "400 Bad Request");
+  } else if (!fan_apply_batch(&batch)) {
+    ok = false;
+    httpd_resp_set_status(req, "500 Internal Server Error");
+  }
+
+  char resp[64 + BATCH_MAX_OPS * 48];
+  fan_state_t st = fan_get_state();
+  int len = snprintf(resp, sizeof(resp),
+                     "{\"result\":%s,\"status\":%d,\"last_fan_level\":%d,\"timer_left\":%d,"
+                     "\"ops\":[",
+                     ok ? "true" : "false", st.on, st.level, fan_timer_left());
+  for (int i = 0; i < count; i++) {
+    if (errors[i])
+      len += snprintf(resp + len, sizeof(resp) - len, "%s{\"result\":false,\"error\":\"%s\"}",
+                      i ? "," : "", errors[i]);
+    else
+      len += snprintf(resp + len, sizeof(resp) - len, "%s{\"result\":%s}", i ? "," : "",
+                      ok ? "true" : "false");
+  }
+  len += snprintf(resp + len, sizeof(resp) - len, "]}");
+  httpd_resp_send(req, resp, len);
+  ESP_LOGI(TAG, "/api/batch: %d ops, applied=%d, elapsed=%d us", count, ok,
+           (int)(esp_timer_get_time() - t0));
   return ESP_OK;
 }
+
+static int resp_chunk_write(const char *buf, size_t len, void *ctx) {
+  return httpd_resp_send_chunk((httpd_req_t *)ctx, buf, len) == ESP_OK ? 0 : -1;
+}
+
+// GET /api/trace 导出最近的延迟采样（Chrome Trace Event 格式，可直接在 Perfetto 中打开），
+// ?clear=1 导出后清空
+static esp_err_t api_trace_handler(httpd_req_t *req) {
+  api_metrics_scope metrics(PERF_METRICS_HTTP_API_TRACE);
+  set_cors_headers(req);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  int count = perf_trace_export(resp_chunk_write, req);
+  httpd_resp_send_chunk(req, NULL, 0);
+  char query[32], val[4];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+      httpd_query_key_value(query, "clear", val, sizeof(val)) == ESP_OK && val[0] == '1') {
+    perf_trace_clear();
+  }
+  ESP_LOGD(TAG, "/api/trace: %d spans", count);
+  return ESP_OK;
+}
+
+// GET /metrics Prometheus 文本格式的请求计数、延迟直方图以及堆和任务栈余量
+static esp_err_t metrics_handler(httpd_req_t *req) {
+  api_metrics_scope metrics(PERF_METRICS_HTTP_METRICS);
+  perf_metrics_watch_task("httpd", NULL); // 处理请求的就是 httpd 任务
+  httpd_resp_set_type(req, "text/plain; version=0.0.4");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  perf_metrics_export(resp_chunk_write, req);
+  httpd_resp_send_chunk(req, NULL, 0);
+  return ESP_OK;
+}
+
+static esp_err_t api_events_handler(httpd_req_t *req) {
+  api_metrics_scope metrics(PERF_METRICS_HTTP_API_EVENTS);
+  return web_events_handler(req);
+}
+
+// Accept-Encoding 中是否包含指定编码（忽略 q=0 的情况）
+static bool accepts_encoding(const char *accept, const char *enc) {
+  size_t n = strlen(enc);
+  for (const char *p = accept; (p = strstr(p, enc)) != NULL; p += n) {
+    bool start = p == accept || p[-1] == ' ' || p[-1] == ',';
+    const char *end = p + n;
+    if (start && (*end == '\0' || *end == ',' || *end == ';' || *end == ' ')) {
+      return strncmp(end, ";q=0", 4) != 0 || end[4] == '.';
+    }
+  }
+  return false;
+}
+
+// If-None-Match 中是否包含当前 ETag（或 *）
+static bool etag_matches(httpd_req_t *req, const char *etag) {
+  char inm[128] = {0};
+  esp_err_t ret = httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm));
+  if (ret != ESP_OK && ret != ESP_ERR_HTTPD_RESULT_TRUNC) {
+    return false;
+  }
+  return strcmp(inm, "*") == 0 || strstr(inm, etag) != NULL;
+}
+
+// /api/status 响应缓存：状态字（开关/挡位/定时器代数）和剩余秒数都没变时直接发送上次的结果，
+// 不再每次格式化。只在 httpd 任务中访问，无需加锁。
+typedef struct {
+  bool valid;
+  uint32_t version;
+  int timer_left;
+  int len;
+  char etag[24];
+  char body[96];
+} status_cache_t;
+
+static status_cache_t status_cache;
+
+static const status_cache_t *status_snapshot(void) {
+  fan_state_t st = fan_get_state();
+  int timer_left = fan_timer_left(); // 由截止时间直接计算，不查询定时器
+  if (status_cache.valid && status_cache.version == st.version &&
+      status_cache.timer_left == timer_left) {
+    return &status_cache;
+  }
+  status_cache.len = snprintf(status_cache.body, sizeof(status_cache.body),
+                              "{\"status\":%d,\"timer_left\":%d,\"last_fan_level\":%d}", st.on,
+                              timer_left, st.level);
+  snprintf(status_cache.etag, sizeof(status_cache.etag), "\"%08x-%d\"", (unsigned)st.version,
+           timer_left);
+  status_cache.version = st.version;
+  status_cache.timer_left = timer_left;
+  status_cache.valid = true;
+  return &status_cache;
+}
+
+// /api/status 处理函数，客户端带上当前 ETag 时返回 304
+static esp_err_t api_status_handler(httpd_req_t *req) {
+  api_metrics_scope metrics(PERF_METRICS_HTTP_API_STATUS);
+  set_cors_headers(req);
+  const status_cache_t *snap = status_snapshot();
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  httpd_resp_set_hdr(req, "ETag", snap->etag);
+  esp_err_t err;
+  if (etag_matches(req, snap->etag)) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    err = httpd_resp_send(req, NULL, 0);
+  } else {
+    err = httpd_resp_send(req, snap->body, snap->len);
+  }
+  ESP_LOGD(TAG, "/api/status called, resp=%.*s", snap->len, snap->body);
+  return err;
+}
+
+// 从固件内置资源直接发送，一次 httpd_resp_send 带上 Content-Length，按客户端支持选择压缩版本。
+// ETag 由编译期内容哈希生成；地址带 ?v=<哈希> 的请求可以长期缓存，其余请求每次协商。
+static esp_err_t send_web_asset(httpd_req_t *req, const web_asset_t *asset, const char *query) {
+  int64_t t0 = esp_timer_get_time();
+  const uint8_t *data = asset->data;
+  size_t len = asset->len;
+  const char *etag_suffix = "";
+  if (asset->gz || asset->br) {
+    char accept[64] = {0};
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    esp_err_t ret = httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept, sizeof(accept));
+    if (ret == ESP_OK || ret == ESP_ERR_HTTPD_RESULT_TRUNC) {
+      if (asset->br && accepts_encoding(accept, "br")) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "br");
+        data = asset->br;
+        len = asset->br_len;
+        etag_suffix = "-br";
+      } else if (asset->gz && accepts_encoding(accept, "gzip")) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        data = asset->gz;
+        len = asset->gz_len;
+        etag_suffix = "-gz";
+      }
+    }
+  }
+  // 不同编码是不同的表示，强 ETag 需要区分
+  char etag[32];
+  snprintf(etag, sizeof(etag), "\"%s%s\"", asset->hash, etag_suffix);
+  httpd_resp_set_hdr(req, "ETag", etag);
+  char version[24] = {0};
+  if (query && httpd_query_key_value(query, "v", version, sizeof(version)) == ESP_OK &&
+      strcmp(version, asset->hash) == 0) {
+    httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=31536000, immutable");
+  } else {
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  }
+  httpd_resp_set_type(req, asset->type);
+  esp_err_t err;
+  if (etag_matches(req, etag)) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    err = httpd_resp_send(req, NULL, 0);
+    len = 0;
+  } else {
+    err = httpd_resp_send(req, (const char *)data, len);
+  }
+  ESP_LOGD(TAG, "[STATIC] %s %u bytes in %d us", asset->uri, (unsigned)len,
+           (int)(esp_timer_get_time() - t0));
+  return err;
+}
+
 // / 主页处理函数，直接返回 index.html 内容，不跳转
 static esp_err_t index_html_handler(httpd_req_t *req) {
-  char filepath[128] = "/spiffs/index.html";
-  FILE *f = fopen(filepath, "r");
-  if (!f) {
-    ESP_LOGW(TAG, "File not found: %s", filepath);
+  api_metrics_scope metrics(PERF_METRICS_HTTP_STATIC);
+  const char *index = "/index.html";
+  const web_asset_t *asset = find_web_asset(index, strlen(index));
+  if (!asset) {
     httpd_resp_send_404(req);
     return ESP_FAIL;
   }
-  httpd_resp_set_type(req, "text/html");
-  char buf[256];
-  size_t read_bytes;
-  while ((read_bytes = fread(buf, 1, sizeof(buf), f)) > 0) {
-    httpd_resp_send_chunk(req, buf, read_bytes);
-  }
-  fclose(f);
-  httpd_resp_send_chunk(req, NULL, 0);
-  return ESP_OK;
+  return send_web_asset(req, asset, NULL);
 }
 
-// 新增静态文件通用处理函数
+// 静态文件通用处理函数，查询参数只用于识别 ?v= 版本号。
+// 共享服务器模式下每个资源单独注册，资源指针放在 user_ctx 中，不需要再查找。
 static esp_err_t static_file_handler(httpd_req_t *req) {
-  char filepath[128] = "/spiffs";
-  strncat(filepath, req->uri, sizeof(filepath) - strlen(filepath) - 1);
-  ESP_LOGI(TAG, "[STATIC] Try open: %s", filepath);
-  FILE *f = fopen(filepath, "r");
-  if (!f) {
-    ESP_LOGW(TAG, "File not found: %s", filepath);
+  api_metrics_scope metrics(PERF_METRICS_HTTP_STATIC);
+  size_t path_len = strcspn(req->uri, "?#");
+  const char *query = req->uri[path_len] == '?' ? req->uri + path_len + 1 : NULL;
+  const web_asset_t *asset = (const web_asset_t *)req->user_ctx;
+  if (!asset) {
+    asset = find_web_asset(req->uri, path_len);
+  }
+  if (!asset) {
+    ESP_LOGW(TAG, "File not found: %.*s", (int)path_len, req->uri);
     httpd_resp_send_404(req);
     return ESP_FAIL;
   }
-  char buf[256];
-  size_t read_bytes;
-  // 简单类型判断
-  if (strstr(filepath, ".html"))
-    httpd_resp_set_type(req, "text/html");
-  else if (strstr(filepath, ".js"))
-    httpd_resp_set_type(req, "application/javascript");
-  else if (strstr(filepath, ".css"))
-    httpd_resp_set_type(req, "text/css");
-  else if (strstr(filepath, ".json"))
-    httpd_resp_set_type(req, "application/json");
-  else if (strstr(filepath, ".ico"))
-    httpd_resp_set_type(req, "image/x-icon");
-  else
-    httpd_resp_set_type(req, "text/plain");
-  while ((read_bytes = fread(buf, 1, sizeof(buf), f)) > 0) {
-    httpd_resp_send_chunk(req, buf, read_bytes);
-  }
-  fclose(f);
-  httpd_resp_send_chunk(req, NULL, 0);
-  return ESP_OK;
+  return send_web_asset(req, asset, query);
 }
 
-void start_http_server() {
-  // 启动 HTTP 服务器前先挂载 SPIFFS
-  esp_vfs_spiffs_conf_t conf = {.base_path = "/spiffs",
-                                .partition_label = NULL,
-                                .max_files = 5,
-                                .format_if_mount_failed = true};
-  esp_vfs_spiffs_register(&conf);
+// 路由表满时直接停机：否则部分接口和网页资源会静默返回 404
+static void register_uri(httpd_handle_t server, const httpd_uri_t *uri) {
+  esp_err_t err = httpd_register_uri_handler(server, uri);
+  if (err == ESP_ERR_HTTPD_HANDLERS_FULL) {
+#ifdef CONFIG_FAN_HTTP_SHARED_SERVER
+    ESP_LOGE(TAG, "URI handler table full at %s, raise HAP_HTTP_MAX_URI_HANDLERS", uri->uri);
+#else
+    ESP_LOGE(TAG, "URI handler table full at %s", uri->uri);
+#endif
+    abort();
+  }
+}
+
+#ifdef CONFIG_FAN_HTTP_SHARED_SERVER
+// 共享 HomeKit 服务器，HAP 服务器只支持精确匹配，需要逐个注册资源
+static httpd_handle_t get_http_server(void) {
+  httpd_handle_t *hap_server = hap_platform_httpd_get_handle();
+  if (!hap_server || !*hap_server) {
+    ESP_LOGE(TAG, "HomeKit HTTP server not running");
+    return NULL;
+  }
+  return *hap_server;
+}
+
+static void register_static_files(httpd_handle_t server) {
+  for (size_t i = 0; i < web_assets_count; i++) {
+    httpd_uri_t asset_uri = {.uri = web_assets[i].uri,
+                             .method = HTTP_GET,
+                             .handler = static_file_handler,
+                             .user_ctx = (void *)&web_assets[i]};
+    register_uri(server, &asset_uri);
+  }
+}
+#else
+// 独立服务器：限制连接数给 HomeKit 留出套接字，开启 LRU 回收和 TCP keep-alive
+static httpd_handle_t get_http_server(void) {
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-  config.server_port = 8080;
+  config.server_port = CONFIG_FAN_HTTP_PORT;
   config.uri_match_fn = httpd_uri_match_wildcard; // 关键修正，支持 /* 匹配所有静态资源
+  config.max_uri_handlers = 16;
+  config.max_open_sockets = CONFIG_FAN_HTTP_MAX_OPEN_SOCKETS;
+  config.stack_size = CONFIG_FAN_HTTP_STACK_SIZE;
+  config.close_fn = web_events_close_fn; // 连接关闭时移除事件流订阅者
+#ifdef CONFIG_FAN_HTTP_LRU_PURGE
+  config.lru_purge_enable = true;
+#endif
+#ifdef CONFIG_FAN_HTTP_KEEP_ALIVE
+  config.keep_alive_enable = true;
+  config.keep_alive_idle = 30;
+  config.keep_alive_interval = 5;
+  config.keep_alive_count = 3;
+#endif
   httpd_handle_t server = NULL;
-  if (httpd_start(&server, &config) == ESP_OK) {
+  if (httpd_start(&server, &config) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to start HTTP server on port %d", config.server_port);
+    return NULL;
+  }
+  return server;
+}
+
+static void register_static_files(httpd_handle_t server) {
+  // 用 /* 通配符统一处理所有静态文件，必须最后注册
+  httpd_uri_t static_file_uri = {
+      .uri = "/*", .method = HTTP_GET, .handler = static_file_handler, .user_ctx = NULL};
+  register_uri(server, &static_file_uri);
+}
+#endif
+
+void start_http_server() {
+  httpd_handle_t server = get_http_server();
+  if (server) {
+    web_events_init(server);
     httpd_uri_t on_uri = {
         .uri = "/api/on", .method = HTTP_GET, .handler = api_on_handler, .user_ctx = NULL};
     httpd_uri_t off_uri = {
@@ -186,9 +542,6 @@ void start_http_server() {
                                 .method = HTTP_OPTIONS,
                                 .handler = cors_preflight_handler,
                                 .user_ctx = NULL};
-    // 用 /* 通配符统一处理所有静态文件
-    httpd_uri_t static_file_uri = {
-        .uri = "/*", .method = HTTP_GET, .handler = static_file_handler, .user_ctx = NULL};
     httpd_uri_t timer_off_uri = {.uri = "/api/timer_off",
                                  .method = HTTP_GET,
                                  .handler = api_timer_off_handler,
@@ -197,16 +550,30 @@ void start_http_server() {
                                     .method = HTTP_GET,
                                     .handler = api_cancel_timer_handler,
                                     .user_ctx = NULL};
-    // api
-    httpd_register_uri_handler(server, &cors_api_uri);
-    httpd_register_uri_handler(server, &on_uri);
-    httpd_register_uri_handler(server, &off_uri);
-    httpd_register_uri_handler(server, &status_uri);
-    httpd_register_uri_handler(server, &timer_off_uri);
-    httpd_register_uri_handler(server, &cancel_timer_uri);
+    httpd_uri_t batch_uri = {
+        .uri = "/api/batch", .method = HTTP_POST, .handler = api_batch_handler, .user_ctx = NULL};
+    httpd_uri_t trace_uri = {
+        .uri = "/api/trace", .method = HTTP_GET, .handler = api_trace_handler, .user_ctx = NULL};
+    httpd_uri_t metrics_uri = {
+        .uri = "/metrics", .method = HTTP_GET, .handler = metrics_handler, .user_ctx = NULL};
+    httpd_uri_t events_uri = {
+        .uri = "/api/events", .method = HTTP_GET, .handler = api_events_handler, .user_ctx = NULL};
+    // api，共享服务器模式不支持通配符，不注册跨域预检
+#ifndef CONFIG_FAN_HTTP_SHARED_SERVER
+    register_uri(server, &cors_api_uri);
+#endif
+    register_uri(server, &on_uri);
+    register_uri(server, &off_uri);
+    register_uri(server, &status_uri);
+    register_uri(server, &timer_off_uri);
+    register_uri(server, &cancel_timer_uri);
+    register_uri(server, &batch_uri);
+    register_uri(server, &events_uri);
+    register_uri(server, &trace_uri);
+    register_uri(server, &metrics_uri);
     // static files
-    httpd_register_uri_handler(server, &index_uri);
-    httpd_register_uri_handler(server, &static_file_uri);
+    register_uri(server, &index_uri);
+    register_static_files(server);
   }
 }
 